@@ -30,6 +30,10 @@
 #ifdef linux
 #include <unistd.h>
 #endif
+#if defined(unix) || defined(__unix__)
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 
 #include "abc2ps.h"
 #include "front.h"
@@ -50,6 +54,15 @@ int annotate;			/* output source references */
 int pagenumbers;		/* write page numbers */
 int epsf;			/* for EPSF (1) or SVG (2) output */
 int svg;			/* SVG (1) or XML (2 - HTML + SVG) output */
+int dlout;			/* display list outputs (DL_xxx) */
+int maxsys;			/* maximum number of music lines per tune */
+int compact_ps;			/* compact PostScript output */
+char *ps_prolog;		/* external PostScript prologue */
+char *svg_defs;			/* scope or file of the SVG definitions */
+int svg_merge;			/* merge the SVG stroked paths */
+int svg_css;			/* SVG graphic states as CSS classes */
+int gzip_out;			/* compressed output files */
+int async_write;		/* output by a writer thread */
 int showerror;			/* show the errors */
 
 char outfn[FILENAME_MAX];	/* output file name */
@@ -72,10 +85,13 @@ static char abc_fn[FILENAME_MAX]; /* buffer for ABC file name */
 static char *styd = DEFAULT_FDIR; /* format search directory */
 static int def_fmt_done = 0;	/* default format read */
 static struct SYMBOL notitle;
+static int ps_fmt;			/* PostScript with other formats (--formats) */
+#if defined(unix) || defined(__unix__)
+static pid_t ps_pid;			/* process of the PostScript output */
+static char ps_fn[FILENAME_MAX];	/* PostScript file */
+#endif
 
 /* memory arena (for clrarena, lvlarena & getarena) */
-#define MAXAREAL 3		/* max area levels:
-				 * 0; global, 1: tune, 2: generation */
 #define AREANASZ 8192		/* standard allocation size */
 #define MAXAREANASZ 0x20000	/* biggest allocation size */
 static int str_level;		/* current arena level */
@@ -90,6 +106,7 @@ static struct str_a {
 /* -- local functions -- */
 static void read_def_format(void);
 static void treat_file(char *fn, char *ext);
+static void ps_start(void);
 
 static FILE *open_ext(char *fn, char *ext)
 {
@@ -133,8 +150,9 @@ FILE *open_file(char *fn,	/* file name */
 	if ((fp = open_ext(rfn, ext)) != 0)
 		return fp;
 
-	/* try a format in the format directory */
-	if (*ext != 'f' || *styd == '\0')
+	/* try a format or a font metrics file in the format directory */
+	if ((*ext != 'f' && *ext != 'a' && *ext != 't')
+	 || *styd == '\0')
 		return 0;
 	l = strlen(styd) - 1;
 	if (styd[l] == DIRSEP)
@@ -244,6 +262,7 @@ static void treat_file(char *fn, char *ext)
 	}
 	if (!quiet)
 		fprintf(stderr, "File %s\n", tex_buf);
+	trace_begin(TR_FILE, tex_buf, 0);
 
 	/* convert the strings */
 	l = strlen(tex_buf);
@@ -257,18 +276,27 @@ static void treat_file(char *fn, char *ext)
 		strcpy(abc_fn, tex_buf);
 		in_fname = abc_fn;
 		mtime = fmtime;
+		if (ps_fmt && nbfiles == 0)
+			ps_start();		/* (first ABC file) */
 	}
 
 	nbfiles++;
+	stats_start(ST_FRONT);
 	file2 = (char *) frontend((unsigned char *) file, file_type);
+	stats_stop(ST_FRONT);
 	nbfiles--;
 	free(file);
 
-	if (file_type == FE_PS)			/* PostScript file */
+	if (file_type == FE_PS) {		/* PostScript file */
+		stats_start(ST_FRONT);
 		file2 = (char *) frontend((unsigned char *) "%%endps", 0);
+		stats_stop(ST_FRONT);
+	}
 
-	if (nbfiles > 0)		/* if %%format */
+	if (nbfiles > 0) {		/* if %%format */
+		trace_end(TR_FILE);
 		return;			/* don't free the preprocessed buffer */
+	}
 
 	memcpy(&deco_tune, &deco_glob, sizeof deco_tune);
 	if (file_type == FE_ABC) {		/* if ABC file */
@@ -276,20 +304,31 @@ static void treat_file(char *fn, char *ext)
 //			open_output_file();
 		clrarena(1);			/* clear previous tunes */
 	}
+	stats_start(ST_PARSE);
 	t = abc_parse(file2);
+	stats_stop(ST_PARSE);
 	free(file2);
 	front_init(0, 0, include_cb);		/* reinit the front-end */
+	stats_file(abc_fn);
 	if (t == 0) {
 		if (file_type == FE_ABC)
 			error(1, 0, "File '%s' is empty!", tex_buf);
+		trace_end(TR_FILE);
 		return;
 	}
 
 	while (t != 0) {
-		if (t->first_sym != 0)		/*fixme:last tune*/
+		if (t->first_sym != 0) {	/*fixme:last tune*/
+			trace_tune(t);
+			stats_start(ST_TUNE);
 			do_tune(t);		/* generate */
+			stats_stop(ST_TUNE);
+			stats_tune(t, abc_fn);
+			trace_end(TR_TUNE);
+		}
 		t = t->next;
 	}
+	trace_end(TR_FILE);
 /*	abc_free(t);	(useless) */
 }
 
@@ -341,6 +380,125 @@ static void display_version(int full)
 		fprintf(stderr, "Default format directory: %s\n", styd);
 }
 
+/* -- set the output formats of the display list (--formats) -- */
+static void set_formats(char *p)
+{
+	static char *fmt_tb[] = {"ps", "svg", "pdf", "png"};
+	unsigned i;
+	int l;
+
+	dlout = 0;
+	for (;;) {
+		l = strcspn(p, ",");
+		for (i = 0; i < sizeof fmt_tb / sizeof fmt_tb[0]; i++) {
+			if (strlen(fmt_tb[i]) == (unsigned) l
+			 && strncmp(p, fmt_tb[i], l) == 0)
+				break;
+		}
+		if (i < sizeof fmt_tb / sizeof fmt_tb[0])
+			dlout |= 1 << i;	/* DL_PS, DL_SVG.. */
+		else
+			error(1, 0, "Unknown output format '%.*s'", l, p);
+		p += l;
+		if (*p++ == '\0')
+			break;
+	}
+	if (!dlout)
+		dlout = DL_PS;
+
+	/* the PostScript output is generated as usual (see ps_start()) */
+	ps_fmt = (dlout & DL_PS) != 0;
+	dlout &= ~DL_PS;
+	if (!dlout) {			/* PostScript only */
+		ps_fmt = 0;
+		svg = 0;
+		if (epsf == 2)
+			epsf = 1;
+		return;
+	}
+	if (epsf != 2) {		/* one file per page */
+		svg = 1;
+		epsf = 0;
+	} else {			/* one file per tune */
+		svg = 0;
+	}
+}
+
+/* -- start the PostScript output of --formats -- */
+/* The PostScript code which is translated to the display list is not
+ * the one of the PostScript output (texts, fonts, user PostScript), so
+ * this output is generated in the normal way by a child process
+ * which starts at the first ABC file. The parse and layout are the
+ * same, so the child does not repeat the diagnostics. */
+static void ps_start(void)
+{
+#if defined(unix) || defined(__unix__)
+	int l;
+
+	ps_fmt = 0;
+	if (strcmp(outfn, "-") == 0) {
+		error(1, 0, "Cannot use stdout with these output formats - abort");
+		exit(EXIT_FAILURE);
+	}
+	if (epsf) {
+		ps_fn[0] = '\0';		/* one file per tune */
+	} else {
+		strcpy(ps_fn, outfn[0] != '\0' ? outfn : OUTPUTFILE);
+		l = strlen(ps_fn) - 1;
+		if (ps_fn[l] == '=' || ps_fn[l] == DIRSEP)
+			ps_fn[0] = '\0';	/* (name set later) */
+		else
+			strext(ps_fn, "ps");
+	}
+	if (ps_fn[0] != '\0' && gzip_out)
+		strcat(ps_fn, ".gz");
+	fflush(NULL);
+	ps_pid = fork();
+	if (ps_pid < 0) {
+		error(1, 0, "Cannot start the PostScript output");
+		return;
+	}
+	if (ps_pid != 0)
+		return;
+
+	/* child */
+	if (!freopen("/dev/null", "w", stderr))
+		exit(EXIT_FAILURE);
+	stats_off();
+	psprof = 0;
+	dlout = 0;
+	svg = 0;
+	if (epsf)
+		epsf = 1;		/* EPS */
+	else if (ps_fn[0] != '\0')
+		strcpy(outfn, ps_fn);
+#else
+	ps_fmt = 0;
+	error(1, 0, "Cannot generate PostScript with other formats on this system");
+#endif
+}
+
+/* -- wait for the PostScript output of --formats -- */
+static void ps_end(void)
+{
+#if defined(unix) || defined(__unix__)
+	struct stat sbuf;
+	int status;
+
+	if (ps_pid <= 0)
+		return;
+	if (waitpid(ps_pid, &status, 0) != ps_pid
+	 || !WIFEXITED(status)
+	 || (WEXITSTATUS(status) != EXIT_SUCCESS && severity == 0)) {
+		error(1, 0, "Error in the PostScript output");
+		return;
+	}
+	if (!quiet && ps_fn[0] != '\0' && stat(ps_fn, &sbuf) == 0)
+		fprintf(stderr, "Output written on %s (%ld bytes)\n",
+			ps_fn, (long) sbuf.st_size);
+#endif
+}
+
 /* -- display usage and exit -- */
 static void usage(void)
 {
@@ -354,6 +512,29 @@ static void usage(void)
 		"     -E      produce EPSF output, one tune per file\n"
 		"     -g      produce SVG output, one tune per file\n"
 		"     -v      produce SVG output, one page per file\n"
+		"     -p      produce PDF output\n"
+		"     -P      produce PNG images, one tune per file\n"
+		"     --formats list\n"
+		"             produce the outputs of the comma separated list\n"
+		"             (ps, svg, pdf, png) in one run\n"
+		"     --dpi n resolution of the PNG images (default 72)\n"
+		"     --compact-ps\n"
+		"             make the PostScript output smaller\n"
+		"     --ps-prolog fff\n"
+		"             write the PostScript prologue to the file fff\n"
+		"             and reference it from the PostScript outputs\n"
+		"     --svg-defs page|file|fff\n"
+		"             write the SVG symbol definitions once per page,\n"
+		"             once per file or to the external file fff\n"
+		"     --svg-merge\n"
+		"             merge the SVG lines which have the same style\n"
+		"     --svg-css\n"
+		"             set the SVG graphic states by CSS classes\n"
+		"     --gzip  compress the output files (.gz, .svgz)\n"
+		"     --async-write\n"
+		"             write the output files by a separate thread\n"
+		"     --systems n\n"
+		"             output only the n first music lines of the tunes\n"
 		"     -X      produce SVG output in one XHTML file\n"
 		"     -O fff  set outfile name to fff\n"
 		"     -O =    make outfile name from infile/title\n"
@@ -393,7 +574,13 @@ static void usage(void)
 		"     -h      show this command summary\n"
 		"     -H      show the format parameters\n"
 		"     -S      secure mode\n"
-		"     -q      quiet mode\n");
+		"     -q      quiet mode\n"
+		"     --stats [text|json]\n"
+		"             output the time of the generation stages\n"
+		"     --trace fff\n"
+		"             write a timeline of the generation to fff\n"
+		"     --psprof text|json\n"
+		"             profile the PostScript operators in SVG output\n");
 	exit(EXIT_SUCCESS);
 }
 
@@ -453,6 +640,28 @@ static struct cmdtblt_s *cmdtblt_parse(char *p)
 	return cmdtblt;
 }
 
+/* -- get the value of a long option in the first pass -- */
+/* the value is after '=' or in the next argument */
+static char *long_arg(char *p, char *name, int argc, char **argv)
+{
+	int l;
+
+	l = strlen(name);
+	if (strncmp(p + 2, name, l) != 0)
+		return 0;
+	if (p[2 + l] == '=')
+		return p + 2 + l + 1;
+	if (p[2 + l] == '\0' && argc > 1)
+		return argv[1];
+	return 0;
+}
+
+/* -- check if an argument is the format of --stats -- */
+static int stats_arg(char *p)
+{
+	return strcmp(p, "text") == 0 || strcmp(p, "json") == 0;
+}
+
 /* set a command line option */
 static void set_opt(char *w, char *v)
 {
@@ -471,7 +680,7 @@ static void set_opt(char *w, char *v)
 int main(int argc, char **argv)
 {
 	unsigned j;
-	char *p, c, *aaa;
+	char *p, *v, c, *aaa;
 
 	if (argc <= 1)
 		usage();
@@ -486,6 +695,18 @@ int main(int argc, char **argv)
 		if (*p != '-' || p[1] == '-') {
 			if (*p == '+' && p[1] == 'F')	/* +F : no default format */
 				def_fmt_done = 1;
+			else if (strcmp(p, "--stats") == 0)
+				stats_init(argc > 1 && stats_arg(argv[1])
+						? argv[1] : "text");
+			else if (strncmp(p, "--stats=", 8) == 0)
+				stats_init(p + 8);
+			else if ((v = long_arg(p, "trace", argc, argv)) != 0)
+				trace_init(v);
+			else if ((v = long_arg(p, "psprof", argc, argv)) != 0)
+				psprof = strcmp(v, "json") == 0
+						? STATS_JSON : STATS_TEXT;
+			else if ((v = long_arg(p, "formats", argc, argv)) != 0)
+				set_formats(v);
 			continue;
 		}
 		while ((c = *++p) != '\0') {	/* '-xxx' */
@@ -493,10 +714,14 @@ int main(int argc, char **argv)
 			case 'E':
 				svg = 0;	/* EPS */
 				epsf = 1;
+				dlout = 0;
+				ps_fmt = 0;
 				break;
 			case 'g':
 				svg = 0;	/* SVG one file per tune */
 				epsf = 2;
+				dlout = 0;
+				ps_fmt = 0;
 				break;
 			case 'h':
 				usage();	/* no return */
@@ -512,10 +737,26 @@ int main(int argc, char **argv)
 			case 'v':
 				svg = 1;	/* SVG one file per pagee */
 				epsf = 0;
+				dlout = 0;
+				ps_fmt = 0;
+				break;
+			case 'p':
+				svg = 1;	/* PDF (from the SVG pages) */
+				epsf = 0;
+				dlout = DL_PDF;
+				ps_fmt = 0;
+				break;
+			case 'P':
+				svg = 0;	/* PNG (from the SVG tunes) */
+				epsf = 2;
+				dlout = DL_PNG;
+				ps_fmt = 0;
 				break;
 			case 'X':
 				svg = 2;	/* SVG/XHTML */
 				epsf = 0;
+				dlout = 0;
+				ps_fmt = 0;
 				break;
 			case 'k':
 				if (p[1] == '\0') {
@@ -683,13 +924,90 @@ int main(int argc, char **argv)
 
 		if (c == '-') {		     /* interpret a flag with '-' */
 			if (p[1] == '-') {		/* long argument */
+				char w[64];
+
+				/* '--name=value' or '--name value' */
 				p += 2;
-				if (--argc <= 0) {
-					error(1, 0, "No argument for '--'");
-					return EXIT_FAILURE;
+				v = strchr(p, '=');
+				if (v) {
+					if (v - p >= (int) sizeof w) {
+						error(1, 0, "Bad option '--%s'", p);
+						return EXIT_FAILURE;
+					}
+					memcpy(w, p, v - p);
+					w[v - p] = '\0';
+					p = w;
+					v++;
+					if (strcmp(p, "compact-ps") == 0
+					 || strcmp(p, "svg-merge") == 0
+					 || strcmp(p, "svg-css") == 0
+					 || strcmp(p, "gzip") == 0
+					 || strcmp(p, "async-write") == 0) {
+						error(1, 0,
+							"No value for option '--%s'",
+							p);
+						return EXIT_FAILURE;
+					}
+				}
+				if (strcmp(p, "compact-ps") == 0) {
+					compact_ps = 1;
+					continue;
+				}
+				if (strcmp(p, "svg-merge") == 0) {
+					svg_merge = 1;
+					continue;
+				}
+				if (strcmp(p, "svg-css") == 0) {
+					svg_css = 1;
+					continue;
+				}
+				if (strcmp(p, "gzip") == 0) {
+					gzip_out = 1;
+					continue;
+				}
+				if (strcmp(p, "async-write") == 0) {
+					async_write = 1;
+					continue;
+				}
+				if (strcmp(p, "stats") == 0) {	/* (done) */
+					if (!v && argc > 1 && stats_arg(argv[1])) {
+						argc--;
+						argv++;
+					}
+					continue;
+				}
+				if (!v) {
+					if (--argc <= 0) {
+						error(1, 0, "No argument for '--%s'", p);
+						return EXIT_FAILURE;
+					}
+					v = *++argv;
+				}
+				if (strcmp(p, "trace") == 0
+				 || strcmp(p, "psprof") == 0
+				 || strcmp(p, "formats") == 0)
+					continue;	/* (done) */
+				if (strcmp(p, "dpi") == 0) {
+					png_dpi = atof(v);
+					if (png_dpi < 1 || png_dpi > 2400) {
+						error(1, 0, "Bad value for --dpi");
+						png_dpi = 72;
+					}
+					continue;
+				}
+				if (strcmp(p, "systems") == 0) {
+					maxsys = atoi(v);
+					continue;
+				}
+				if (strcmp(p, "ps-prolog") == 0) {
+					ps_prolog = v;
+					continue;
+				}
+				if (strcmp(p, "svg-defs") == 0) {
+					svg_defs = v;
+					continue;
 				}
-				argv++;
-				set_opt(p, *argv);
+				set_opt(p, v);
 				continue;
 			}
 			while ((c = *++p) != '\0') {
@@ -740,6 +1058,8 @@ int main(int argc, char **argv)
 					cfmt.abc2pscompat = 1;
 					lock_fmt(&cfmt.abc2pscompat);
 					break;
+				case 'p':
+				case 'P':
 				case 'v':
 				case 'X':
 					break;
@@ -925,6 +1245,9 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 	close_output_file();
+	ps_end();
+	stats_end();
+	psprof_end();
 	return severity == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -937,7 +1260,10 @@ void clrarena(int level)
 		str_r[level] = a_p = malloc(sizeof *str_r[0] + AREANASZ - 2);
 		a_p->sz = AREANASZ;
 		a_p->n = 0;
+		mem.a_chunks[level]++;
+		mem.a_alloc[level] += AREANASZ;
 	}
+	mem.a_used[level] = 0;
 	str_c[level] = a_p;
 	a_p->p = a_p->str;
 	a_p->r = sizeof a_p->str;
@@ -961,6 +1287,10 @@ void *getarena(int len)
 
 	a_p = str_c[str_level];
 	len = (len + 7) & ~7;		/* align at 64 bits boundary */
+	mem.a_req[str_level] += len;
+	mem.a_used[str_level] += len;
+	if (mem.a_used[str_level] > mem.a_thwm[str_level])
+		mem.a_thwm[str_level] = mem.a_used[str_level];
 	if (len > a_p->r) {
 		if (len > MAXAREANASZ) {
 			error(1, 0,
@@ -975,10 +1305,14 @@ void *getarena(int len)
 			a_p->n = malloc(sizeof *str_r[0] + len - 2);
 			a_p->n->n = a_n;
 			a_p->n->sz = len;
+			mem.a_big[str_level]++;
+			mem.a_alloc[str_level] += len;
 		} else if (a_p->n == 0) {		/* standard allocation */
 			a_p->n = malloc(sizeof *str_r[0] + AREANASZ - 2);
 			a_p->n->n = 0;
 			a_p->n->sz = AREANASZ;
+			mem.a_chunks[str_level]++;
+			mem.a_alloc[str_level] += AREANASZ;
 		}
 		str_c[str_level] = a_p = a_p->n;
 		a_p->p = a_p->str;
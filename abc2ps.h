@@ -313,6 +313,7 @@ extern INFO info;
 extern char *outbuf;		/* output buffer.. should hold one tune */
 extern char *mbf;		/* where to PUTx() */
 extern int use_buffer;		/* 1 if lines are being accumulated */
+extern int outbuf_wr;		/* number of writes of the output buffer */
 
 extern int outft;		/* last font in the output file */
 extern int tunenum;		/* number of current tune */
@@ -331,7 +332,55 @@ extern int annotate;		/* output source references */
 extern int pagenumbers; 	/* write page numbers */
 extern int epsf;		/* EPSF (1) / SVG (2) output */
 extern int svg;			/* SVG (1) or XML (2 - HTML + SVG) output */
+extern int dlout;		/* display list outputs (-p, -P, --formats) */
+#define DL_PS 0x01
+#define DL_SVG 0x02
+#define DL_PDF 0x04
+#define DL_PNG 0x08
+extern int maxsys;		/* maximum number of music lines per tune */
+extern int compact_ps;		/* compact PostScript output */
+extern char *ps_prolog;		/* external PostScript prologue */
+extern char *svg_defs;		/* scope or file of the SVG definitions */
+extern int svg_merge;		/* merge the SVG stroked paths */
+extern int svg_css;		/* SVG graphic states as CSS classes */
+extern int gzip_out;		/* compressed output files */
+extern int async_write;		/* output by a writer thread */
 extern int showerror;		/* show the errors */
+extern int stats;		/* statistics on stderr (--stats) */
+#define STATS_TEXT 1			/* summary */
+#define STATS_JSON 2			/* JSON records */
+
+/* timed stages (--stats) */
+enum stages {
+	ST_FRONT, ST_PARSE, ST_TUNE, ST_SORT, ST_MUSIC,
+	ST_WIDTH, ST_CUT, ST_GLUE, ST_DRAW, ST_BEAM, ST_SLUR,
+	ST_WRITE, ST_SVG,
+	ST_NSTAGES
+};
+/* memory usage (--stats) */
+#define MAXAREAL 3		/* max area levels:
+				 * 0; global, 1: tune, 2: generation */
+struct mem_s {
+	long a_req[MAXAREAL];		/* bytes requested in the arenas */
+	long a_used[MAXAREAL];		/* bytes used since the last clear */
+	long a_thwm[MAXAREAL];		/* max used bytes in the current tune */
+	long a_alloc[MAXAREAL];		/* bytes got from malloc */
+	int a_chunks[MAXAREAL];		/* number of standard chunks */
+	int a_big[MAXAREAL];		/* number of big allocations */
+	int outbuf_sz;			/* size of outbuf */
+	int outbuf_hwm;			/* max used bytes in outbuf */
+	int svg_blocks;			/* element blocks of the SVG interpreter */
+#define NELTS 2048			/* (number of elements per block) */
+	int svg_used;			/* SVG elements in use */
+	int svg_hwm;			/* max SVG elements in use */
+};
+extern struct mem_s mem;
+
+/* spans of the trace (--trace) */
+enum spans {
+	TR_FILE, TR_TUNE, TR_LINE, TR_PAGE,
+	TR_NSPANS
+};
 
 extern char outfn[FILENAME_MAX]; /* output file name */
 extern char *in_fname;		/* current input file name */
@@ -381,7 +430,7 @@ struct VOICE_S {
 	struct SYMBOL *sym;	/* associated symbols */
 	struct SYMBOL *last_sym; /* last symbol while scanning */
 	struct SYMBOL *lyric_start;	/* start of lyrics while scanning */
-	char id[VOICE_ID_SZ];	/* voice id */
+	char *id;		/* voice id (interned) */
 	char *nm;		/* voice name */
 	char *snm;		/* voice subname */
 	char *bar_text;		/* bar text at start of staff when bar_start */
@@ -470,6 +519,11 @@ void clrarena(int level);
 int lvlarena(int level);
 void *getarena(int len);
 void strext(char *fid, char *ext);
+/* afm.c */
+int afm_font(char *name);
+int afm_loaded(int fnum);
+float font_cwid(int fnum, unsigned short c);
+float font_kern(int fnum, unsigned short c1, unsigned short c2);
 /* buffer.c */
 void a2b(char *fmt, ...)
 #ifdef __GNUC__
@@ -482,6 +536,8 @@ void marg_init(void);
 void bskip(float h);
 void check_buffer(void);
 void init_outbuf(int kbsz);
+int fout_stdout(void);
+long fout_tell(void);
 void close_output_file(void);
 void close_page(void);
 float get_bposy(void);
@@ -492,6 +548,24 @@ int (*output)(FILE *out, const char *fmt, ...)
 #endif
 	;
 void write_eps(void);
+/* deflate.c */
+#define Z_ZLIB 0
+#define Z_GZIP 1
+unsigned long z_crc32(unsigned long crc, const unsigned char *p, long len);
+unsigned char *z_deflate(const unsigned char *p, long len,
+			long *p_olen, int fmt);
+FILE *z_open(FILE *f);
+long z_close(FILE *zf);
+long z_tell(FILE *zf);
+/* awrite.c */
+FILE *aw_open(FILE *f);
+long aw_close(FILE *af);
+long aw_tell(FILE *af);
+/* compact.c */
+void ps_compact(char *p, int len);
+int ps_cprintf(FILE *out, const char *fmt, ...);
+void ps_compact_flush(void);
+void ps_compact_init(void);
 /* deco.c */
 void deco_add(char *text);
 void deco_cnv(struct deco *dc, struct SYMBOL *s, struct SYMBOL *prev);
@@ -521,6 +595,56 @@ void y_set(int staff,
 		float x,
 		float w,
 		float y);
+/* dlist.c */
+#define DL_NFONTS 14		/* standard PDF fonts */
+#define DL_NTFONTS 32		/* fonts with 2-byte codes */
+struct DLSYM {			/* symbol of the display list */
+	struct DLSYM *next;
+	char *name;
+	char *ename;			/* name in the operations */
+	char *ops;			/* drawing operations */
+	int len;
+	int obj;			/* PDF object (pdf.c) */
+};
+struct DLFONT {			/* font with 2-byte codes (/T<n>) */
+	char *name;			/* base font name */
+	struct ttf *ttf;		/* TrueType font (glyph indexes) */
+	char *cmap, *ordering;		/* CJK font (UCS-2 codes) */
+	int supplement;
+	unsigned char *used;		/* used glyphs (bits, TrueType) */
+	int *uni;			/* unicode of the used glyphs */
+	int nused;			/* number of used characters */
+	int obj;			/* PDF object (pdf.c) */
+};
+struct DLIST {			/* display list of a page */
+	char *ops;			/* drawing operations (PDF syntax) */
+	int len;
+	float w, h;			/* page size */
+	int nlines;			/* number of music lines */
+	int *lines;			/* start of the music lines in ops */
+	char fonts[DL_NFONTS];		/* used fonts */
+	struct DLFONT tfonts[DL_NTFONTS]; /* fonts with 2-byte codes */
+	int ntfonts;
+	struct DLSYM *syms;		/* symbols (all pages) */
+};
+struct DLOP {			/* decoded drawing operation */
+	char op[4];
+	int nv;				/* operands */
+	float v[8];
+	int narr;			/* array */
+	float arr[8];
+	int slen;			/* string */
+	unsigned char str[256];
+	char name[64];			/* name (decoded) */
+	int end;			/* offset after the operator */
+};
+extern struct DLIST dl;
+void dl_reset(void);
+void dl_mark(long off);
+void dl_build(FILE *f);
+struct DLSYM *dl_sym(char *name);
+char *dl_fontname(int k);
+void dl_replay(char *p, int len, void (*f)(struct DLOP *o));
 /* draw.c */
 void draw_sym_near(void);
 void draw_all_symb(void);
@@ -565,6 +689,28 @@ void identify_note(struct SYMBOL *s,
 void sort_pitch(struct SYMBOL *s, int combine);
 struct SYMBOL *sym_add(struct VOICE_S *p_voice,
 			int type);
+/* pdf.c */
+void pdf_open(FILE *f);
+void pdf_page(void);
+long pdf_close(void);
+/* png.c */
+extern float png_dpi;
+long png_write(FILE *f);
+/* stats.c */
+void stats_init(char *arg);
+double stats_now(void);
+void json_str(FILE *f, char *s);
+void stats_start(int stage);
+void stats_stop(int stage);
+void stats_get(int stage, double *t, int *n);
+void stats_file(char *fn);
+void stats_tune(struct abctune *t, char *fn);
+void stats_end(void);
+void stats_off(void);
+void trace_init(char *fn);
+void trace_begin(int span, char *name, int num);
+void trace_tune(struct abctune *t);
+void trace_end(int span);
 /* subs.c */
 void bug(char *msg, int fatal);
 void error(int sev, struct SYMBOL *s, char *fmt, ...);
@@ -607,6 +753,26 @@ int svg_output(FILE *out, const char *fmt, ...)
 	;
 void svg_write(char *buf, int len);
 void svg_close();
+extern FILE *svg_capture;
+extern int psprof;
+void psprof_end(void);
 /* syms.c */
 void define_font(char *name, int num, int enc);
 void define_symbols(void);
+void ps_sym_scan(char *p, int len);
+void define_used_symbols(void);
+/* ttf.c */
+struct ttf_m {			/* TrueType font metrics (1/1000 em) */
+	char name[64];			/* PostScript name */
+	int ng;				/* number of glyphs */
+	int bbox[4];
+	int ascent, descent, capheight;
+	int italic;			/* italic angle */
+};
+struct ttf *ttf_get(char *name);
+struct ttf_m *ttf_metrics(struct ttf *f);
+int ttf_gid(struct ttf *f, int c);
+float ttf_adv(struct ttf *f, int gid);
+void ttf_outline(struct ttf *f, int gid, float *m,
+		void (*draw)(int op, float *v));
+unsigned char *ttf_subset(struct ttf *f, unsigned char *used, long *p_len);
@@ -0,0 +1,306 @@
+/*
+ * Synthetic ABC generator.
+ *
+ * Writes to stdout random but valid ABC tunes, the size and content
+ * of which are defined by the parameters. This is used to measure
+ * how abcm2ps scales with big or complex inputs.
+ *
+ * usage: abcgen [options]
+ *	-t n	number of tunes (default 1)
+ *	-v n	number of voices, up to 32 (default 1)
+ *	-b n	number of bars per tune (default 32)
+ *	-n n	number of bars per music line (default 4)
+ *	-c n	percentage of chords (default 10)
+ *	-d n	percentage of decorated notes (default 10)
+ *	-u n	percentage of tuplets (default 5)
+ *	-l n	number of lyric lines under each music line (default 0)
+ *	-s n	number of %%staves changes per tune (default 0)
+ *	-r n	random seed (default 1)
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXVOICE 32		/* as in abcparse.h */
+#define MAXSTAFF 16		/* as in abc2ps.h */
+#define BAR_LEN 8		/* bar duration in L: units (M:4/4 L:1/8) */
+
+static int ntunes = 1;
+static int nvoices = 1;
+static int nbars = 32;
+static int bars_per_line = 4;
+static int chord_pc = 10;
+static int deco_pc = 10;
+static int tuplet_pc = 5;
+static int nlyrics;
+static int nstaves;
+
+static unsigned long rnd_state = 1;
+
+static char *key_tb[] = {
+	"C", "G", "D", "A", "E", "F", "Bb", "Eb", "Ab",
+	"Am", "Em", "Dm", "Gm", "Ddor", "Amix",
+};
+static char *deco_tb[] = {
+	".", "~", "H", "T", "!trill!", "!accent!", "!tenuto!",
+	"!p!", "!mf!", "!f!", "!upbow!", "!downbow!", "!mordent!",
+	"!fermata!", "!>!", "!crescendo(!", "!crescendo)!",
+};
+static char *syl_tb[] = {
+	"la", "da", "di", "do", "re", "mi", "fa", "sol", "ti",
+	"hey", "ho", "na", "lo-", "ve", "sing", "ing",
+};
+#define NELEM(t) (sizeof t / sizeof t[0])
+
+/* -- pseudo random generator (same values on all systems) -- */
+static int rnd(int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (int) ((rnd_state >> 16) & 0x7fff) % n;
+}
+
+/* -- return 1 with a probability of 'pc' percent -- */
+static int chance(int pc)
+{
+	return rnd(100) < pc;
+}
+
+/* -- output a pitch (0 = C,, 14 = C 21 = c) -- */
+static void put_pitch(int p)
+{
+	int o;
+
+	if (chance(5))
+		putchar("^_="[rnd(3)]);
+	o = p / 7;
+	if (o >= 3) {
+		putchar("cdefgab"[p % 7]);
+		for (; o > 3; o--)
+			putchar('\'');
+	} else {
+		putchar("CDEFGAB"[p % 7]);
+		for (; o < 2; o++)
+			putchar(',');
+	}
+}
+
+/* -- output a note length -- */
+static void put_len(int len)
+{
+	if (len != 1)
+		printf("%d", len);
+}
+
+/* -- output a note or a chord and return the number of syllables -- */
+static int put_note(int *p, int len, int lo)
+{
+	int i, n;
+
+	/* random walk in the range of the voice */
+	*p += rnd(5) - 2;
+	if (*p < lo)
+		*p = lo + 1;
+	else if (*p > lo + 14)
+		*p = lo + 13;
+
+	if (chance(5)) {
+		putchar('z');
+		put_len(len);
+		return 0;
+	}
+	if (chance(deco_pc))
+		fputs(deco_tb[rnd(NELEM(deco_tb))], stdout);
+	if (chance(chord_pc)) {
+		n = 2 + rnd(3);
+		putchar('[');
+		for (i = 0; i < n; i++)
+			put_pitch(*p + i * 2);
+		putchar(']');
+	} else {
+		put_pitch(*p);
+	}
+	put_len(len);
+	return 1;
+}
+
+/* -- output a bar of a voice and return the number of syllables -- */
+static int put_bar(int *p, int lo)
+{
+	int r, len, nsyl;
+
+	nsyl = 0;
+	r = BAR_LEN;
+	while (r > 0) {
+		if (r >= 2 && chance(tuplet_pc)) {
+			fputs("(3", stdout);
+			nsyl += put_note(p, 1, lo);
+			nsyl += put_note(p, 1, lo);
+			nsyl += put_note(p, 1, lo);
+			putchar(' ');
+			r -= 2;
+			continue;
+		}
+		len = 1 + rnd(4);
+		if (len > r)
+			len = r;
+		nsyl += put_note(p, len, lo);
+		if (len > 1 || rnd(2))
+			putchar(' ');
+		r -= len;
+	}
+	return nsyl;
+}
+
+/* -- output a group of voices (one staff) -- */
+static void put_group(int v, int g)
+{
+	if (v + 1 <= nvoices && g == 2)
+		printf("(%d %d)", v, v + 1);
+	else
+		printf("%d", v);
+}
+
+/* -- output a %%staves line -- */
+static void put_staves(int n)
+{
+	int v, g;
+
+	/* two voices per staff if too many staves */
+	g = nvoices > MAXSTAFF ? 2 : 1;
+	fputs("%%staves ", stdout);
+	switch (n % 3) {
+	case 0:				/* bracket */
+		putchar('[');
+		for (v = 1; v <= nvoices; v += g) {
+			if (v != 1)
+				putchar(' ');
+			put_group(v, g);
+		}
+		putchar(']');
+		break;
+	case 1:				/* voices by pairs */
+		for (v = 1; v <= nvoices; v += 2) {
+			if (v != 1)
+				putchar(' ');
+			put_group(v, 2);
+		}
+		break;
+	default:			/* brace */
+		putchar('{');
+		for (v = 1; v <= nvoices; v += g) {
+			if (v != 1)
+				putchar(' ');
+			put_group(v, g);
+		}
+		putchar('}');
+		break;
+	}
+	putchar('\n');
+}
+
+/* -- output a tune -- */
+static void put_tune(int x)
+{
+	int v, bar, line, nlines, nsyl, i, j;
+	int pit[MAXVOICE];
+
+	printf("X:%d\n"
+		"T:Synthetic tune %d\n"
+		"M:4/4\n"
+		"L:1/8\n",
+		x, x);
+	if (nvoices > 1)
+		put_staves(0);
+	for (v = 1; v <= nvoices; v++) {
+		if (nvoices > 1)
+			printf("V:%d clef=%s\n", v,
+				v <= (nvoices + 1) / 2 ? "treble" : "bass");
+		pit[v - 1] = v <= (nvoices + 1) / 2 ? 21 : 9;
+	}
+	printf("K:%s\n", key_tb[rnd(NELEM(key_tb))]);
+
+	nlines = (nbars + bars_per_line - 1) / bars_per_line;
+	for (line = 0; line < nlines; line++) {
+		if (nstaves > 0 && nvoices > 1 && line > 0
+		 && line * (nstaves + 1) / nlines
+				!= (line - 1) * (nstaves + 1) / nlines)
+			put_staves(line * (nstaves + 1) / nlines);
+		for (v = 1; v <= nvoices; v++) {
+			if (nvoices > 1)
+				printf("[V:%d] ", v);
+			nsyl = 0;
+			for (bar = line * bars_per_line;
+			     bar < (line + 1) * bars_per_line && bar < nbars;
+			     bar++) {
+				nsyl += put_bar(&pit[v - 1],
+						v <= (nvoices + 1) / 2 ? 14 : 2);
+				fputs(bar == nbars - 1 ? "|]" : "| ", stdout);
+			}
+			putchar('\n');
+			for (i = 0; i < nlyrics; i++) {
+				fputs("w:", stdout);
+				for (j = 0; j < nsyl; j++)
+					printf(" %s", syl_tb[rnd(NELEM(syl_tb))]);
+				putchar('\n');
+			}
+		}
+	}
+	putchar('\n');
+}
+
+int main(int argc, char **argv)
+{
+	int c, x;
+
+	while ((c = getopt(argc, argv, "t:v:b:n:c:d:u:l:s:r:")) != -1) {
+		switch (c) {
+		case 't': ntunes = atoi(optarg); break;
+		case 'v': nvoices = atoi(optarg); break;
+		case 'b': nbars = atoi(optarg); break;
+		case 'n': bars_per_line = atoi(optarg); break;
+		case 'c': chord_pc = atoi(optarg); break;
+		case 'd': deco_pc = atoi(optarg); break;
+		case 'u': tuplet_pc = atoi(optarg); break;
+		case 'l': nlyrics = atoi(optarg); break;
+		case 's': nstaves = atoi(optarg); break;
+		case 'r': rnd_state = strtoul(optarg, NULL, 0); break;
+		default:
+			fprintf(stderr,
+				"usage: abcgen [-t tunes] [-v voices] [-b bars]"
+				" [-n bars_per_line]\n"
+				"\t[-c chord%%] [-d deco%%] [-u tuplet%%]"
+				" [-l lyric_lines] [-s staves_changes]"
+				" [-r seed]\n");
+			return EXIT_FAILURE;
+		}
+	}
+	if (nvoices < 1)
+		nvoices = 1;
+	else if (nvoices > MAXVOICE)
+		nvoices = MAXVOICE;
+	if (nbars < 1)
+		nbars = 1;
+	if (bars_per_line < 1)
+		bars_per_line = 1;
+
+	for (x = 1; x <= ntunes; x++)
+		put_tune(x);
+	return 0;
+}
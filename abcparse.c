@@ -46,7 +46,15 @@ static short meter;		/* upper value of time sig for n-plets */
 static signed char vover;	/* voice overlay (1: single bar, -1: multi-bar */
 static char lyric_started;	/* lyric started */
 static char *gchord;		/* guitar chord */
-static struct deco dc;		/* decorations */
+
+#define INTERN_HASH 1024	/* size of the string intern hash table */
+static struct istr {		/* interned string */
+	struct istr *next;
+	char s[1];
+} *intern_tb[INTERN_HASH];
+static unsigned char dc_tb[MAXDC];
+static struct deco dc = {0, 0, 0, dc_tb}; /* decorations */
+static struct notehd hd_tb[MAXHD]; /* note heads while parsing */
 static struct abcsym *deco_start; /* 1st note of the line for d: / s: */
 static struct abcsym *deco_cont; /* current symbol when d: / s: continuation */
 static unsigned short *p_micro;	/* ptr to the microtone table of the tune */
@@ -61,7 +69,7 @@ static struct abcsym *last_sym;	/* last symbol for errors */
 
 static short nvoice;		/* number of voices (0..n-1) */
 static struct {			/* voice table and current pointer */
-	char id[VOICE_ID_SZ];		/* voice ID */
+	char *id;			/* voice ID (interned) */
 	struct abcsym *last_note;	/* last note or rest */
 	short ulen;			/* unit note length */
 	short microscale;		/* microtone scale */
@@ -167,24 +175,39 @@ void abc_delete(struct abcsym *as)
 	case ABC_T_INFO:
 		switch (as->text[0]) {
 		case 'Q':
-			if (as->u.tempo.str1)
-				free_f(as->u.tempo.str1);
-			if (as->u.tempo.value)
-				free_f(as->u.tempo.value);
-			if (as->u.tempo.str2)
-				free_f(as->u.tempo.str2);
+			if (as->u.tempo->str1)
+				free_f(as->u.tempo->str1);
+			if (as->u.tempo->value)
+				free_f(as->u.tempo->value);
+			if (as->u.tempo->str2)
+				free_f(as->u.tempo->str2);
+			free_f(as->u.tempo);
 			break;
 		case 'V':
-			if (as->u.voice.fname)
-				free_f(as->u.voice.fname);
-			if (as->u.voice.nname)
-				free_f(as->u.voice.nname);
+			if (as->u.voice->fname)
+				free_f(as->u.voice->fname);
+			if (as->u.voice->nname)
+				free_f(as->u.voice->nname);
+			free_f(as->u.voice);
+			break;
+		case 'M':
+			free_f(as->u.meter);
 			break;
 		}
 		break;
 	}
-	if (as->text)
-		free_f(as->text);
+	switch (as->type) {
+	case ABC_T_NOTE:
+	case ABC_T_REST:
+	case ABC_T_BAR:
+	case ABC_T_MREST:
+	case ABC_T_MREP:
+		break;			/* interned text */
+	default:
+		if (as->text)
+			free_f(as->text);
+		break;
+	}
 	if (as->comment)
 		free_f(as->comment);
 
@@ -274,6 +297,40 @@ void abc_insert(char *file_api,
 	}
 }
 
+/* -- get the unique copy of a string of given length -- */
+char *abc_intern_n(char *s, int len)
+{
+	struct istr *is;
+	unsigned h;
+	int i;
+
+	h = 0;
+	for (i = 0; i < len; i++)
+		h = h * 31 + (unsigned char) s[i];
+	h %= INTERN_HASH;
+	for (is = intern_tb[h]; is; is = is->next) {
+		if (strncmp(is->s, s, len) == 0
+		 && is->s[len] == '\0')
+			return is->s;
+	}
+	is = malloc(sizeof *is + len);
+	if (!is) {
+		fprintf(stderr, "Out of memory - cannot intern strings\n");
+		exit(EXIT_FAILURE);
+	}
+	memcpy(is->s, s, len);
+	is->s[len] = '\0';
+	is->next = intern_tb[h];
+	intern_tb[h] = is;
+	return is->s;
+}
+
+/* -- get the unique copy of a string -- */
+char *abc_intern(char *s)
+{
+	return abc_intern_n(s, strlen(s));
+}
+
 /* -- new symbol -- */
 struct abcsym *abc_new(struct abctune *t,
 		       char *text,
@@ -307,6 +364,41 @@ struct abcsym *abc_new(struct abctune *t,
 	return s;
 }
 
+/* -- allocate note heads -- */
+/* the heads are copied from 'hd' if not null, else they are cleared */
+struct notehd *abc_hd_new(struct notehd *hd,
+			int n)
+{
+	struct notehd *new_hd;
+
+	new_hd = alloc_f(sizeof *new_hd * n);
+	if (hd)
+		memcpy(new_hd, hd, sizeof *new_hd * n);
+	else
+		memset(new_hd, 0, sizeof *new_hd * n);
+	return new_hd;
+}
+
+/* -- allocate a copy of the decoration types -- */
+unsigned char *abc_dc_new(struct deco *dc)
+{
+	unsigned char *t;
+
+	if (dc->n <= 0)
+		return NULL;
+	t = alloc_f(dc->n);
+	memcpy(t, dc->t, dc->n);
+	return t;
+}
+
+/* -- move the pending decorations to a note or a bar -- */
+static void deco_move(struct deco *d)
+{
+	memcpy(d, &dc, sizeof *d);
+	d->t = abc_dc_new(&dc);
+	dc.n = dc.h = dc.s = 0;
+}
+
 /* get the ABC version */
 static void get_vers(char *p)
 {
@@ -462,18 +554,18 @@ static void broken_rhythm(struct note *note,
 			num = 8;
 		n = num * 2 - 1;
 		for (m = 0; m <= note->nhd; m++)
-			note->lens[m] = (note->lens[m] * n) / num;
+			note->hd[m].len = (note->hd[m].len * n) / num;
 	} else {
 		n = -num;
 		if (n == 6)
 			n = 8;
 		for (m = 0; m <= note->nhd; m++)
-			note->lens[m] /= n;
+			note->hd[m].len /= n;
 	}
-	l = note->lens[0];
+	l = note->hd[0].len;
 	for (m = 1; m <= note->nhd; m++)
-		if (note->lens[m] < l)
-			l = note->lens[m];
+		if (note->hd[m].len < l)
+			l = note->hd[m].len;
 }
 
 /* -- check for the '!' as end of line (ABC2Win) -- */
@@ -585,11 +677,11 @@ static char *get_deco(char *p,
 	l = p - q;
 	if (*p == sep)
 		p++;
+	q = abc_intern_n(q, l);
 	for (i = 1, t = &deco_tb[1];
 	     *t && i < 128;
 	     i++, t++) {
-		if (strlen(*t) == l
-		 && strncmp(*t, q, l) == 0) {
+		if (*t == q) {
 			*p_deco = i + 128;
 			return p;
 		}
@@ -597,13 +689,7 @@ static char *get_deco(char *p,
 
 	/* new decoration */
 	if (i < 128) {
-		if (level_f && abc_state != ABC_S_GLOBAL)
-			level_f(0);
-		*t = alloc_f(l + 1);
-		if (level_f && abc_state != ABC_S_GLOBAL)
-			level_f(1);
-		memcpy(*t, q, l);
-		(*t)[l] = '\0';
+		*t = q;
 		*p_deco = i + 128;
 	} else {
 		syntax("Too many decoration types", q);
@@ -1195,9 +1281,9 @@ static char *top_err = "Cannot identify meter top";
 			return "Too many values in M:";
 		switch (*p) {
 		case 'C':
-			s->u.meter.meter[nm].top[0] = *p++;
+			s->u.meter->meter[nm].top[0] = *p++;
 			if (*p == '|')
-				s->u.meter.meter[nm].top[1] = *p++;
+				s->u.meter->meter[nm].top[1] = *p++;
 			m1 = 4;
 			m2 = 4;
 			break;
@@ -1208,14 +1294,14 @@ static char *top_err = "Cannot identify meter top";
 			else
 				m1 = 3;
 			m2 = 4;
-			s->u.meter.meter[nm].top[0] = *p++;
+			s->u.meter->meter[nm].top[0] = *p++;
 			if (*p == '.')
-				s->u.meter.meter[nm].top[1] = *p++;
+				s->u.meter->meter[nm].top[1] = *p++;
 			break;
 		case '(':
 			if (p[1] == '(') {	/* "M:5/4 ((2+3)/4)" */
 				in_parenth = 1;
-				s->u.meter.meter[nm++].top[0] = *p++;
+				s->u.meter->meter[nm++].top[0] = *p++;
 			}
 			q = p + 1;
 			while (*q != '\0') {
@@ -1230,7 +1316,7 @@ static char *top_err = "Cannot identify meter top";
 			/* fall thru */
 		case ')':
 			in_parenth = *p == '(';
-			s->u.meter.meter[nm++].top[0] = *p++;
+			s->u.meter->meter[nm++].top[0] = *p++;
 			continue;
 		default:
 			if (sscanf(p, "%d", &m1) != 1
@@ -1240,8 +1326,8 @@ static char *top_err = "Cannot identify meter top";
 			m2 = 2;			/* default when no bottom value */
 			for (;;) {
 				while (isdigit((unsigned char) *p)
-				    && i < sizeof s->u.meter.meter[0].top)
-					s->u.meter.meter[nm].top[i++] = *p++;
+				    && i < sizeof s->u.meter->meter[0].top)
+					s->u.meter->meter[nm].top[i++] = *p++;
 				if (*p == ')') {
 					if (p[1] != '/')
 						break;
@@ -1254,16 +1340,16 @@ static char *top_err = "Cannot identify meter top";
 						return "Cannot identify meter bottom";
 					i = 0;
 					while (isdigit((unsigned char) *p)
-					    && i < sizeof s->u.meter.meter[0].bot)
-						s->u.meter.meter[nm].bot[i++] = *p++;
+					    && i < sizeof s->u.meter->meter[0].bot)
+						s->u.meter->meter[nm].bot[i++] = *p++;
 					break;
 				}
 				if (*p != ' ' && *p != '+')
 					break;
 				if (*p == '\0' || p[1] == '(')	/* "M:5 (2/4+3/4)" */
 					break;
-				if (i < sizeof s->u.meter.meter[0].top)
-					s->u.meter.meter[nm].top[i++] = *p++;
+				if (i < sizeof s->u.meter->meter[0].top)
+					s->u.meter->meter[nm].top[i++] = *p++;
 				if (sscanf(p, "%d", &d) != 1
 				 || d <= 0)
 					return top_err;
@@ -1282,7 +1368,7 @@ static char *top_err = "Cannot identify meter top";
 		if (*p == ' ')
 			p++;
 		else if (*p == '+')
-			s->u.meter.meter[nm++].top[0] = *p++;
+			s->u.meter->meter[nm++].top[0] = *p++;
 	}
 	meter = m1;
 	if (*p == '=') {
@@ -1291,10 +1377,10 @@ static char *top_err = "Cannot identify meter top";
 		 || m2 <= 0)
 			return "Cannot identify meter explicit duration";
 		wmeasure = m1 * BASE_LEN / m2;
-		s->u.meter.expdur = 1;
+		s->u.meter->expdur = 1;
 	}
-	s->u.meter.wmeasure = wmeasure;
-	s->u.meter.nmeter = nm;
+	s->u.meter->wmeasure = wmeasure;
+	s->u.meter->nmeter = nm;
 
 	/* if in the header, change the unit note length */
 	if (abc_state == ABC_S_HEAD && ulen == 0) {
@@ -1358,8 +1444,8 @@ static char *parse_tempo(char *p,
 	/* string before */
 	if (*p == '"') {
 		p = get_str(str, p, sizeof str);
-		s->u.tempo.str1 = alloc_f(strlen(str) + 1);
-		strcpy(s->u.tempo.str1, str);
+		s->u.tempo->str1 = alloc_f(strlen(str) + 1);
+		strcpy(s->u.tempo->str1, str);
 	}
 
 	/* beat */
@@ -1373,7 +1459,7 @@ static char *parse_tempo(char *p,
 		p = parse_len(p + 1, &len);
 		if (len <= 0)
 			goto inval;
-		s->u.tempo.length[0] = len * ulen / BASE_LEN;
+		s->u.tempo->length[0] = len * ulen / BASE_LEN;
 		while (isspace((unsigned char) *p))
 			p++;
 		if (abc_vers >= (2 << 16))
@@ -1390,10 +1476,10 @@ static char *parse_tempo(char *p,
 				goto inval;
 			l = (BASE_LEN * top) / bot;
 			if (l <= 0
-			 || i >= sizeof s->u.tempo.length
-					/ sizeof s->u.tempo.length[0])
+			 || i >= sizeof s->u.tempo->length
+					/ sizeof s->u.tempo->length[0])
 				goto inval;
-			s->u.tempo.length[i++] = l;
+			s->u.tempo->length[i++] = l;
 			p += n;
 			while (isspace((unsigned char) *p))
 				p++;
@@ -1413,9 +1499,9 @@ static char *parse_tempo(char *p,
 		while (isspace((unsigned char) p[-1]))
 			p--;
 		l = p - q;
-		s->u.tempo.value = alloc_f(l + 1);
-		strncpy(s->u.tempo.value, q, l);
-		s->u.tempo.value[l] = '\0';
+		s->u.tempo->value = alloc_f(l + 1);
+		strncpy(s->u.tempo->value, q, l);
+		s->u.tempo->value[l] = '\0';
 		while (isspace((unsigned char) *p))
 			p++;
 	}
@@ -1423,13 +1509,13 @@ static char *parse_tempo(char *p,
 	/* string after */
 	if (*p == '"') {
 		p = get_str(str, p, sizeof str);
-		s->u.tempo.str2 = alloc_f(strlen(str) + 1);
-		strcpy(s->u.tempo.str2, str);
+		s->u.tempo->str2 = alloc_f(strlen(str) + 1);
+		strcpy(s->u.tempo->str2, str);
 	}
 
-	if (!s->u.tempo.str1 && !s->u.tempo.str2
-	 && s->u.tempo.length[0] == 0) {
-		if (s->u.tempo.value == 0)
+	if (!s->u.tempo->str1 && !s->u.tempo->str2
+	 && s->u.tempo->length[0] == 0) {
+		if (s->u.tempo->value == 0)
 			return "Empty tempo";
 		if (abc_vers >= (2 << 16))
 			syntax("Deprecated Q: value", p);
@@ -1534,30 +1620,33 @@ static struct kw_s {
 	curvoice->ulen = ulen;
 	curvoice->microscale = microscale;
 
-	if (voice_tb[0].id[0] == '\0') {
+	if (!voice_tb[0].id) {
 		switch (s->prev->type) {
 		case ABC_T_EOLN:
 		case ABC_T_NOTE:
 		case ABC_T_REST:
 		case ABC_T_BAR:
 			/* the previous voice was implicit (after K:) */
-			voice_tb[0].id[0] = '1';
+			voice_tb[0].id = abc_intern("1");
 			break;
 		}
 	}
 	{
-		char *id, sep;
+		char *id;
+		int l;
 
 		id = p;
 		while (isalnum((unsigned char) *p) || *p == '_')
 			p++;
-		sep = *p;
-		*p = '\0';
-		if (voice_tb[0].id[0] == '\0') {
+		l = p - id;
+		if (l > VOICE_ID_SZ - 1)
+			l = VOICE_ID_SZ - 1;
+		id = abc_intern_n(id, l);
+		if (!voice_tb[0].id) {
 			voice = 0;			/* first voice */
 		} else {
 			for (voice = 0; voice <= nvoice; voice++) {
-				if (strcmp(id, voice_tb[voice].id) == 0)
+				if (voice_tb[voice].id == id)
 					goto found;
 			}
 			if (voice >= MAXVOICE) {
@@ -1566,14 +1655,13 @@ static struct kw_s {
 			}
 		}
 		nvoice = voice;
-		strncpy(voice_tb[voice].id, id, sizeof voice_tb[voice].id - 1);
+		voice_tb[voice].id = id;
 		voice_tb[voice].mvoice = voice;
 	found:
-		strcpy(s->u.voice.id, voice_tb[voice].id);
-		*p = sep;
+		s->u.voice->id = voice_tb[voice].id;
 	}
 	curvoice = &voice_tb[voice];
-	s->u.voice.voice = voice;
+	s->u.voice->voice = voice;
 
 	/* if in tune, set the voice parameters */
 	if (abc_state == ABC_S_TUNE) {
@@ -1584,7 +1672,7 @@ static struct kw_s {
 	/* parse the other parameters */
 	clef_name = clef_middle = clef_lines = clef_scale = NULL;
 	p_octave = p_microscale = NULL;
-	p_stem = &s->u.voice.stem;
+	p_stem = &s->u.voice->stem;
 	for (;;) {
 		while (isspace((unsigned char) *p))
 			p++;
@@ -1607,16 +1695,16 @@ static struct kw_s {
 		switch (kw->index) {
 		case 0:			/* name */
 			p = get_str(name, p, VOICE_NAME_SZ);
-			s->u.voice.fname = alloc_f(strlen(name) + 1);
-			strcpy(s->u.voice.fname, name);
+			s->u.voice->fname = alloc_f(strlen(name) + 1);
+			strcpy(s->u.voice->fname, name);
 			break;
 		case 1:			/* subname */
 			p = get_str(name, p, VOICE_NAME_SZ);
-			s->u.voice.nname = alloc_f(strlen(name) + 1);
-			strcpy(s->u.voice.nname, name);
+			s->u.voice->nname = alloc_f(strlen(name) + 1);
+			strcpy(s->u.voice->nname, name);
 			break;
 		case 2:			/* merge */
-			s->u.voice.merge = 1;
+			s->u.voice->merge = 1;
 			break;
 		case 3:			/* up */
 			*p_stem = 1;
@@ -1625,26 +1713,26 @@ static struct kw_s {
 			*p_stem = -1;
 			break;
 		case 5:			/* stem= */
-			p_stem = &s->u.voice.stem;
+			p_stem = &s->u.voice->stem;
 			break;
 		case 6:			/* gstem= */
-			p_stem = &s->u.voice.gstem;
+			p_stem = &s->u.voice->gstem;
 			break;
 		case 7:			/* auto */
 			*p_stem = 2;
 			break;
 		case 8:			/* dyn= */
-			p_stem = &s->u.voice.dyn;
+			p_stem = &s->u.voice->dyn;
 			break;
 		case 9:			/* lyrics= */
-			p_stem = &s->u.voice.lyrics;
+			p_stem = &s->u.voice->lyrics;
 			break;
 		case 10: {		/* scale= */
 			float sc;
 
 			sc = atof(p);
 			if (sc >= 0.5 && sc <= 2)
-				s->u.voice.scale = sc;
+				s->u.voice->scale = sc;
 			else
 				error_txt = "Bad value for voice scale";
 			while (!isspace((unsigned char) *p) && *p != '\0')
@@ -1652,12 +1740,12 @@ static struct kw_s {
 			break;
 		    }
 		case 11:		/* gchord= */
-			p_stem = &s->u.voice.gchord;
+			p_stem = &s->u.voice->gchord;
 			break;
 		}
 	}
 
-	s->u.voice.octave = parse_octave(p_octave);
+	s->u.voice->octave = parse_octave(p_octave);
 
 	if (p_microscale)
 		microscale = atoi(p_microscale);
@@ -1722,8 +1810,9 @@ static char *parse_bar(struct abctune *t,
 		curvoice = &voice_tb[curvoice->mvoice];
 		vover = 0;
 	}
-	s = abc_new(t, gchord, NULL);
+	s = abc_new(t, NULL, NULL);
 	if (gchord) {
+		s->text = abc_intern(gchord);
 		if (free_f)
 			free_f(gchord);
 		gchord = NULL;
@@ -1731,10 +1820,8 @@ static char *parse_bar(struct abctune *t,
 	s->type = ABC_T_BAR;
 	s->u.bar.type = bar_type;
 
-	if (dc.n > 0) {
-		memcpy(&s->u.bar.dc, &dc, sizeof s->u.bar.dc);
-		dc.n = dc.h = dc.s = 0;
-	}
+	if (dc.n > 0)
+		deco_move(&s->u.bar.dc);
 	if (!isdigit((unsigned char) *p)	/* if not a repeat bar */
 	 && (*p != '"' || p[-1] != '['))	/* ('["' only) */
 		return p;
@@ -1758,13 +1845,11 @@ static char *parse_bar(struct abctune *t,
 	}
 	if (bar_type != B_OBRA
 	 || s->text) {
-		s = abc_new(t, repeat_value, NULL);
+		s = abc_new(t, NULL, NULL);
 		s->type = ABC_T_BAR;
 		s->u.bar.type = B_OBRA;
-	} else {
-		s->text = alloc_f(strlen(repeat_value) + 1);
-		strcpy(s->text, repeat_value);
 	}
+	s->text = abc_intern(repeat_value);
 	s->u.bar.repeat_bar = 1;
 	return p;
 }
@@ -1986,20 +2071,26 @@ static char *parse_decoline(char *p)
 				strcpy(gch, is->text);
 				gch[n] = '\n';
 				strcpy(gch + n + 1, gchord);
-				if (free_f) {
+				if (free_f)
 					free_f(gchord);
-					free_f(is->text);
-				}
 				gchord = gch;
 			}
-			is->text = gchord;
+			is->text = abc_intern(gchord);
+			if (free_f)
+				free_f(gchord);
 			gchord = NULL;
 		} else {
 			n = is->u.note.dc.n;
 			if (n >= MAXDC) {
 				syntax("Too many decorations for the note", p);
 			} else if (d != 0) {
-				is->u.note.dc.t[n] = d;
+				unsigned char *t;
+
+				t = alloc_f(n + 1);
+				if (n > 0)
+					memcpy(t, is->u.note.dc.t, n);
+				t[n] = d;
+				is->u.note.dc.t = t;
 				is->u.note.dc.n = n + 1;
 			}
 		}
@@ -2093,7 +2184,8 @@ static int parse_line(struct abctune *t,
 	struct abcsym *s;
 	char *comment, *q, c;
 	struct abcsym *last_note_sav = NULL;
-	struct deco dc_sav;
+	struct deco dc_sav = {0, 0, 0, dc_tb};
+	unsigned char dc_sav_tb[MAXDC];
 	int i, flags, flags_sav = 0, slur;
 	static char qtb[10] = {0, 1, 3, 2, 3, 0, 2, 0, 3, 0};
 
@@ -2256,6 +2348,7 @@ static int parse_line(struct abctune *t,
 			last_note_sav = curvoice->last_note;
 			curvoice->last_note = NULL;
 			memcpy(&dc_sav, &dc, sizeof dc);
+			memcpy(dc_sav_tb, dc_tb, dc.n);
 			dc.n = dc.h = dc.s = 0;
 			flags_sav = flags;
 			flags = ABC_F_GRACE;
@@ -2270,6 +2363,7 @@ static int parse_line(struct abctune *t,
 			t->last_sym->flags |= ABC_F_GR_END;
 			curvoice->last_note = last_note_sav;
 			memcpy(&dc, &dc_sav, sizeof dc);
+			memcpy(dc_tb, dc_sav_tb, dc.n);
 			flags = flags_sav;
 			break;
 		case CHAR_DECOS:
@@ -2307,7 +2401,9 @@ static int parse_line(struct abctune *t,
 			flags &= ABC_F_GRACE;
 			t->last_sym->u.note.slur_st = slur;
 			slur = 0;
-			if (t->last_sym->u.note.lens[0] > 0)	/* if not space */
+			if ((t->last_sym->type == ABC_T_NOTE
+			  || t->last_sym->type == ABC_T_REST)
+			 && t->last_sym->u.note.hd[0].len > 0)	/* if not space */
 				curvoice->last_note = t->last_sym;
 			break;
 		case CHAR_SLASH:		/* '/' */
@@ -2520,8 +2616,8 @@ static int parse_line(struct abctune *t,
 				break;
 			}
 			for (i = 0; i <= curvoice->last_note->u.note.nhd; i++) {
-				if (curvoice->last_note->u.note.ti1[i] == 0)
-					curvoice->last_note->u.note.ti1[i] = tie_pos;
+				if (curvoice->last_note->u.note.hd[i].ti1 == 0)
+					curvoice->last_note->u.note.hd[i].ti1 = tie_pos;
 				else if (curvoice->last_note->u.note.nhd == 0)
 					syntax("Too many ties", p);
 			}
@@ -2563,6 +2659,7 @@ static int parse_line(struct abctune *t,
 			curvoice->last_note->flags |= ABC_F_GR_END;
 		curvoice->last_note = last_note_sav;
 		memcpy(&dc, &dc_sav, sizeof dc);
+		memcpy(dc_tb, dc_sav_tb, dc.n);
 	}
 
 	/* add eoln */
@@ -2588,8 +2685,9 @@ static char *parse_note(struct abctune *t,
 	if (flags & ABC_F_GRACE) {	/* in a grace note sequence */
 		s = abc_new(t, NULL, NULL);
 	} else {
-		s = abc_new(t, gchord, NULL);
+		s = abc_new(t, NULL, NULL);
 		if (gchord) {
+			s->text = abc_intern(gchord);
 			if (free_f)
 				free_f(gchord);
 			gchord = NULL;
@@ -2597,6 +2695,7 @@ static char *parse_note(struct abctune *t,
 	}
 	s->type = ABC_T_NOTE;
 	s->flags |= flags;
+	memset(hd_tb, 0, sizeof hd_tb);
 
 	if (*p != 'X' && *p != 'Z'
 	 && !(flags & ABC_F_GRACE)) {
@@ -2631,12 +2730,13 @@ static char *parse_note(struct abctune *t,
 	case 'y':			/* space (BarFly) */
 		s->type = ABC_T_REST;
 		s->flags |= ABC_F_INVIS;
+		s->u.note.hd = hd_tb;
 		p++;
 		if (isdigit((unsigned char) *p)) {	/* number of points */
-			s->u.note.lens[1] = strtol(p, &q, 10);
+			s->u.note.hd[1].len = strtol(p, &q, 10);
 			p = q;
 		} else {
-			s->u.note.lens[1] = -1;
+			s->u.note.hd[1].len = -1;
 		}
 		goto add_deco;
 	case 'x':			/* invisible rest */
@@ -2644,11 +2744,13 @@ static char *parse_note(struct abctune *t,
 		/* fall thru */
 	case 'z':
 		s->type = ABC_T_REST;
+		s->u.note.hd = hd_tb;
 		p = parse_len(p + 1, &len);
-		s->u.note.lens[0] = len * ulen / BASE_LEN;
+		s->u.note.hd[0].len = len * ulen / BASE_LEN;
 		goto do_brhythm;
 	}
 
+	s->u.note.hd = hd_tb;
 	chord = 0;
 	q = p;
 	if (*p == '[') {	/* '[..]' = chord */
@@ -2687,7 +2789,7 @@ static char *parse_note(struct abctune *t,
 					tmp += SL_AUTO;
 					break;
 				}
-				s->u.note.sl1[m] = (s->u.note.sl1[m] << 3)
+				s->u.note.hd[m].sl1 = (s->u.note.hd[m].sl1 << 3)
 							+ tmp;
 			}
 		}
@@ -2698,7 +2800,7 @@ static char *parse_note(struct abctune *t,
 				syntax("Too many decorations on this head", p);
 				tmp = dc.n - 7;
 			}
-			s->u.note.decs[m] = (tmp << 3) + dc.n - tmp;
+			s->u.note.hd[m].decs = (tmp << 3) + dc.n - tmp;
 			dc.s = dc.n;
 		}
 		p = parse_basic_note(p, &pit, &len, &acc, &tmp);
@@ -2706,9 +2808,9 @@ static char *parse_note(struct abctune *t,
 			len = len * BASE_LEN / 4 / ulen;
 			tmp = 0;
 		}
-		s->u.note.pits[m] = pit;
-		s->u.note.lens[m] = len;
-		s->u.note.accs[m] = acc;
+		s->u.note.hd[m].pit = pit;
+		s->u.note.hd[m].len = len;
+		s->u.note.hd[m].acc = acc;
 		nostem |= tmp;
 
 		if (chord) {
@@ -2721,19 +2823,19 @@ static char *parse_note(struct abctune *t,
 				if (*p == '-') {
 					switch (p[1]) {
 					case '\'':
-						s->u.note.ti1[m] = SL_ABOVE;
+						s->u.note.hd[m].ti1 = SL_ABOVE;
 						p++;
 						break;
 					case ',':
-						s->u.note.ti1[m] = SL_BELOW;
+						s->u.note.hd[m].ti1 = SL_BELOW;
 						p++;
 						break;
 					default:
-						s->u.note.ti1[m] = SL_AUTO;
+						s->u.note.hd[m].ti1 = SL_AUTO;
 						break;
 					}
 				} else if (*p == ')') {
-					s->u.note.sl2[m]++;
+					s->u.note.hd[m].sl2++;
 				} else {
 					break;
 				}
@@ -2755,8 +2857,8 @@ static char *parse_note(struct abctune *t,
 				p = parse_len(p, &len);
 				s->u.note.chlen = len;
 				for (j = 0; j < m; j++) {
-					tmp = len * s->u.note.lens[j];
-					s->u.note.lens[j] = tmp / BASE_LEN;
+					tmp = len * s->u.note.hd[j].len;
+					s->u.note.hd[j].len = tmp / BASE_LEN;
 				}
 			}
 			break;
@@ -2785,12 +2887,22 @@ do_brhythm:
 		broken_rhythm(&s->u.note,
 			      -curvoice->last_note->u.note.brhythm);
 add_deco:
-	if (dc.n > 0) {
-		memcpy(s->type != ABC_T_MREST ? &s->u.note.dc
-				: &s->u.bar.dc,
-			&dc, sizeof dc);
-		dc.n = dc.h = dc.s = 0;
-	}
+	if (s->type != ABC_T_MREST)		/* keep the used heads only */
+		s->u.note.hd = abc_hd_new(hd_tb,
+				hd_tb[0].len != 0 ? s->u.note.nhd + 1 : 2);
+	if (dc.n > 0)
+		deco_move(s->type != ABC_T_MREST ? &s->u.note.dc
+				: &s->u.bar.dc);
+	return p;
+}
+
+/* -- allocate the cleared part of an information field -- */
+static void *info_new(int size)
+{
+	void *p;
+
+	p = alloc_f(size);
+	memset(p, 0, size);
 	return p;
 }
 
@@ -2841,15 +2953,18 @@ static int parse_info(struct abctune *t,
 			ulen = s->u.length.base_length;
 		break;
 	case 'M':
+		s->u.meter = info_new(sizeof *s->u.meter);
 		error_txt = parse_meter(p, s);
 		break;
 	case 'Q':
+		s->u.tempo = info_new(sizeof *s->u.tempo);
 		error_txt = parse_tempo(p, s);
 		break;
 	case 'U':
 		error_txt = get_user(p, s);
 		break;
 	case 'V':
+		s->u.voice = info_new(sizeof *s->u.voice);
 		if (abc_state == ABC_S_GLOBAL)
 			break;
 		error_txt = parse_voice(p, s);
@@ -2932,7 +3047,7 @@ static void vover_new(void)
 			return;
 		}
 		nvoice = voice;
-		voice_tb[voice].id[0] = '&';
+		voice_tb[voice].id = abc_intern("&");
 		voice_tb[voice].mvoice = mvoice;
 	}
 	voice_tb[voice].ulen = curvoice->ulen;
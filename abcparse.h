@@ -40,17 +40,21 @@ struct deco {		/* decorations */
 	char n;			/* whole number of decorations */
 	char h;			/* start of head decorations */
 	char s;			/* start of decorations from s: (d:) */
-	unsigned char t[MAXDC];	/* decoration type */
+	unsigned char *t;	/* decoration types (n) */
+};
+
+struct notehd {		/* note head */
+	short len;		/* note length (# pts in [1] if space) */
+	signed char pit;	/* pitch */
+	unsigned char acc;	/* code for accidental & index in micro_tb */
+	unsigned char sl1;	/* slur start */
+	char sl2;		/* number of slur end */
+	char ti1;		/* flag to start tie here */
+	unsigned char decs;	/* head decorations (index: 5 bits, len: 3 bits) */
 };
 
 struct note {		/* note or rest */
-	signed char pits[MAXHD]; /* pitches */
-	short lens[MAXHD];	/* note lengths (# pts in [1] if space) */
-	unsigned char accs[MAXHD]; /* code for accidentals & index in micro_tb */
-	unsigned char sl1[MAXHD]; /* slur start per head */
-	char sl2[MAXHD];	/* number of slur end per head */
-	char ti1[MAXHD];	/* flag to start tie here */
-	unsigned char decs[MAXHD]; /* head decorations (index: 5 bits, len: 3 bits) */
+	struct notehd *hd;	/* heads (nhd + 1 - 2 if space) */
 	short chlen;		/* chord length */
 	char nhd;		/* number of notes in chord - 1 */
 	unsigned char slur_st;	/* slurs starting here (2 bits array) */
@@ -59,6 +63,41 @@ struct note {		/* note or rest */
 	struct deco dc;		/* decorations */
 };
 
+/* information fields - they are pointed to by the symbols
+ * so that they don't increase the size of the notes */
+struct meter_s {	/* M: info */
+	short wmeasure;		/* duration of a measure */
+	unsigned char nmeter;	/* number of meter elements */
+	char expdur;		/* explicit measure duration */
+#define MAX_MEASURE 6
+	struct {
+		char top[8];	/* top value */
+		char bot[2];	/* bottom value */
+	} meter[MAX_MEASURE];
+};
+
+struct tempo_s {	/* Q: info */
+	char *str1;		/* string before */
+	short length[4];	/* up to 4 note lengths */
+	char *value;		/* tempo value */
+	char *str2;		/* string after */
+};
+
+struct voice_s {	/* V: info */
+	char *id;		/* voice ID (interned) */
+	char *fname;		/* full name */
+	char *nname;		/* nick name */
+	float scale;		/* != 0 when change */
+	unsigned char voice;	/* voice number */
+	signed char octave;	/* 'octave=' - same as in K: */
+	char merge;		/* merge with previous voice */
+	signed char stem;	/* have stems up or down (2 = auto) */
+	signed char gstem;	/* have grace stems up or down (2 = auto) */
+	signed char dyn;	/* have dynamic marks above or below the staff */
+	signed char lyrics;	/* have lyrics above or below the staff */
+	signed char gchord;	/* have gchord above or below the staff */
+};
+
 /* symbol definition */
 struct abctune;
 struct abcsym {
@@ -116,36 +155,9 @@ struct abcsym {
 		struct {		/* L: info */
 			int base_length;	/* basic note length */
 		} length;
-		struct meter_s {	/* M: info */
-			short wmeasure;		/* duration of a measure */
-			unsigned char nmeter;	/* number of meter elements */
-			char expdur;		/* explicit measure duration */
-#define MAX_MEASURE 6
-			struct {
-				char top[8];	/* top value */
-				char bot[2];	/* bottom value */
-			} meter[MAX_MEASURE];
-		} meter;
-		struct {		/* Q: info */
-			char *str1;		/* string before */
-			short length[4];	/* up to 4 note lengths */
-			char *value;		/* tempo value */
-			char *str2;		/* string after */
-		} tempo;
-		struct {		/* V: info */
-			char id[VOICE_ID_SZ];	/* voice ID */
-			char *fname;		/* full name */
-			char *nname;		/* nick name */
-			float scale;		/* != 0 when change */
-			unsigned char voice;	/* voice number */
-			signed char octave;	/* 'octave=' - same as in K: */
-			char merge;		/* merge with previous voice */
-			signed char stem;	/* have stems up or down (2 = auto) */
-			signed char gstem;	/* have grace stems up or down (2 = auto) */
-			signed char dyn;	/* have dynamic marks above or below the staff */
-			signed char lyrics;	/* have lyrics above or below the staff */
-			signed char gchord;	/* have gchord above or below the staff */
-		} voice;
+		struct meter_s *meter;	/* M: info */
+		struct tempo_s *tempo;	/* Q: info */
+		struct voice_s *voice;	/* V: info */
 		struct {		/* bar, mrest or mrep */
 			int type;
 			char repeat_bar;
@@ -225,6 +237,12 @@ struct abcsym *abc_new(struct abctune *t,
 		       char *p,
 		       char *comment);
 struct abctune *abc_parse(char *file_api);
+char *abc_intern(char *s);
+char *abc_intern_n(char *s,
+		   int len);
+struct notehd *abc_hd_new(struct notehd *hd,
+			int n);
+unsigned char *abc_dc_new(struct deco *dc);
 char *get_str(char *d,
 	      char *s,
 	      int maxlen);
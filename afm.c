@@ -0,0 +1,476 @@
+/*
+ * Font metrics (AFM files).
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "abc2ps.h"
+
+#ifdef WIN32
+#include <direct.h>
+#define mkdir(d, m) _mkdir(d)
+#endif
+
+/* The metrics of a font are searched in the file '<font name>.afm'.
+ * After parsing, they are saved in '<font name>.afb' in the user cache
+ * directory, and this file is used in further runs as long as the AFM
+ * file is unchanged. */
+
+struct kern {			/* kerning pair */
+	unsigned char c1, c2;	/* characters (ISO-8859-1) */
+	short v;		/* value (1/1000 em) */
+};
+
+struct afm {			/* metrics of a font */
+	struct afm *next;
+	char *name;		/* font name (interned) */
+	struct kern *kern;	/* kerning pairs, sorted */
+	int nkern;		/* number of kerning pairs */
+	short w[256];		/* character widths (1/1000 em) - < 0 if none */
+};
+
+/* binary cache - all values are little-endian
+ *	0 magic
+ *	4 size of the AFM file (4 bytes)
+ *	8 date of the AFM file (8 bytes)
+ *	16 number of kerning pairs (4 bytes)
+ *	20 length of the AFM file name (2 bytes)
+ *	22 AFM file name
+ * then the widths (256 * 2 bytes)
+ * and the kerning pairs (c1, c2, value: 4 bytes) */
+#define AFB_MAGIC "afb2"
+#define AFB_HSZ 22		/* size of the header */
+
+static struct afm *afm_list;		/* fonts with metrics */
+static char afm_done[MAXFONTS];		/* font searched */
+static struct afm *afm_tb[MAXFONTS];	/* metrics by font number */
+
+/* glyph names of the ISO-8859-1 characters */
+static const char *latin1_tb[256 - 32] = {
+	"space", "exclam", "quotedbl", "numbersign",
+	"dollar", "percent", "ampersand", "quoteright",
+	"parenleft", "parenright", "asterisk", "plus",
+	"comma", "hyphen", "period", "slash",
+	"zero", "one", "two", "three", "four", "five", "six", "seven",
+	"eight", "nine", "colon", "semicolon",
+	"less", "equal", "greater", "question",
+	"at", "A", "B", "C", "D", "E", "F", "G",
+	"H", "I", "J", "K", "L", "M", "N", "O",
+	"P", "Q", "R", "S", "T", "U", "V", "W",
+	"X", "Y", "Z", "bracketleft",
+	"backslash", "bracketright", "asciicircum", "underscore",
+	"quoteleft", "a", "b", "c", "d", "e", "f", "g",
+	"h", "i", "j", "k", "l", "m", "n", "o",
+	"p", "q", "r", "s", "t", "u", "v", "w",
+	"x", "y", "z", "braceleft",
+	"bar", "braceright", "asciitilde", 0,
+	0, 0, 0, 0, 0, 0, 0, 0,			/* 0x80 */
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0,			/* 0x90 */
+	0, 0, 0, 0, 0, 0, 0, 0,
+	"space", "exclamdown", "cent", "sterling",	/* 0xa0 */
+	"currency", "yen", "brokenbar", "section",
+	"dieresis", "copyright", "ordfeminine", "guillemotleft",
+	"logicalnot", "hyphen", "registered", "macron",
+	"degree", "plusminus", "twosuperior", "threesuperior", /* 0xb0 */
+	"acute", "mu", "paragraph", "periodcentered",
+	"cedilla", "onesuperior", "ordmasculine", "guillemotright",
+	"onequarter", "onehalf", "threequarters", "questiondown",
+	"Agrave", "Aacute", "Acircumflex", "Atilde",	/* 0xc0 */
+	"Adieresis", "Aring", "AE", "Ccedilla",
+	"Egrave", "Eacute", "Ecircumflex", "Edieresis",
+	"Igrave", "Iacute", "Icircumflex", "Idieresis",
+	"Eth", "Ntilde", "Ograve", "Oacute",		/* 0xd0 */
+	"Ocircumflex", "Otilde", "Odieresis", "multiply",
+	"Oslash", "Ugrave", "Uacute", "Ucircumflex",
+	"Udieresis", "Yacute", "Thorn", "germandbls",
+	"agrave", "aacute", "acircumflex", "atilde",	/* 0xe0 */
+	"adieresis", "aring", "ae", "ccedilla",
+	"egrave", "eacute", "ecircumflex", "edieresis",
+	"igrave", "iacute", "icircumflex", "idieresis",
+	"eth", "ntilde", "ograve", "oacute",		/* 0xf0 */
+	"ocircumflex", "otilde", "odieresis", "divide",
+	"oslash", "ugrave", "uacute", "ucircumflex",
+	"udieresis", "yacute", "thorn", "ydieresis",
+};
+
+/* -- get the ISO-8859-1 code of a glyph -- */
+static int glyph_code(char *name)
+{
+	int i;
+
+	for (i = 0; i < 256 - 32; i++) {
+		if (latin1_tb[i] && strcmp(latin1_tb[i], name) == 0)
+			return i + 32;
+	}
+	return -1;
+}
+
+/* -- compare 2 kerning pairs -- */
+static int kern_cmp(const void *a, const void *b)
+{
+	const struct kern *k1 = a, *k2 = b;
+
+	if (k1->c1 != k2->c1)
+		return k1->c1 - k2->c1;
+	return k1->c2 - k2->c2;
+}
+
+/* -- get a value after a keyword in a AFM line -- */
+static char *afm_val(char *line, char *kw)
+{
+	int l;
+
+	l = strlen(kw);
+	for (;;) {
+		while (*line == ' ' || *line == '\t' || *line == ';')
+			line++;
+		if (*line == '\0')
+			return 0;
+		if (strncmp(line, kw, l) == 0
+		 && (line[l] == ' ' || line[l] == '\t'))
+			return line + l + 1;
+		while (*line != ';' && *line != '\0')
+			line++;
+	}
+}
+
+/* -- parse an AFM file -- */
+static int afm_parse(struct afm *afm, FILE *fp)
+{
+	char line[256], name[64], n2[64], *p;
+	int c, c2, v, nk, in_kern;
+
+	nk = 0;
+	in_kern = 0;
+	while (fgets(line, sizeof line, fp)) {
+		if (strncmp(line, "StartKernPairs", 14) == 0) {
+			if (sscanf(line + 14, "%d", &v) != 1 || v <= 0)
+				continue;
+			afm->kern = malloc(sizeof *afm->kern * v);
+			if (!afm->kern)
+				return -1;
+			nk = v;
+			in_kern = 1;
+			continue;
+		}
+		if (strncmp(line, "EndKernPairs", 12) == 0) {
+			in_kern = 0;
+			continue;
+		}
+		if (in_kern) {
+			if (strncmp(line, "KPX ", 4) != 0
+			 || sscanf(line + 4, "%63s %63s %d", name, n2, &v) != 3
+			 || afm->nkern >= nk)
+				continue;
+			c = glyph_code(name);
+			c2 = glyph_code(n2);
+			if (c < 0 || c2 < 0)
+				continue;
+			afm->kern[afm->nkern].c1 = c;
+			afm->kern[afm->nkern].c2 = c2;
+			afm->kern[afm->nkern].v = v;
+			afm->nkern++;
+			continue;
+		}
+		if (line[0] != 'C' || (line[1] != ' ' && line[1] != 'H'))
+			continue;
+		p = afm_val(line, "WX");
+		if (!p)
+			p = afm_val(line, "W0X");
+		if (!p || sscanf(p, "%d", &v) != 1)
+			continue;
+		p = afm_val(line, "N");
+		if (!p || sscanf(p, "%63s", name) != 1)
+			continue;
+		c = glyph_code(name);
+		if (c < 0)
+			continue;
+		afm->w[c] = v;
+		if (c == ' ' || c == '-')	/* also at 0xa0 and 0xad */
+			afm->w[c + 0x80] = v;
+	}
+	if (afm->nkern > 1)
+		qsort(afm->kern, afm->nkern, sizeof *afm->kern, kern_cmp);
+	return afm->w['a'] < 0 ? -1 : 0;
+}
+
+/* -- put a little-endian value -- */
+static void put_le(unsigned char *p, unsigned long v, int n)
+{
+	while (--n >= 0) {
+		*p++ = v;
+		v >>= 8;
+	}
+}
+
+/* -- get a little-endian value -- */
+static unsigned long get_le(unsigned char *p, int n)
+{
+	unsigned long v;
+
+	v = 0;
+	while (--n >= 0)
+		v = (v << 8) | p[n];
+	return v;
+}
+
+/* -- get the name of the binary cache of a font -- */
+/* return 0 if no cache directory */
+static char *afb_name(char *fn, int sz, char *name, int create)
+{
+	char *dir;
+	int l;
+
+	dir = getenv("XDG_CACHE_HOME");
+	if (dir && *dir != '\0') {
+		if (create)
+			mkdir(dir, 0700);
+		l = snprintf(fn, sz, "%s%cabcm2ps", dir, DIRSEP);
+	} else {
+#ifdef WIN32
+		dir = getenv("LOCALAPPDATA");
+		if (!dir || *dir == '\0')
+			return 0;
+		l = snprintf(fn, sz, "%s%cabcm2ps", dir, DIRSEP);
+#else
+		dir = getenv("HOME");
+		if (!dir || *dir == '\0')
+			return 0;
+		l = snprintf(fn, sz, "%s/.cache", dir);
+		if (create && l < sz)
+			mkdir(fn, 0700);
+		l = snprintf(fn, sz, "%s/.cache/abcm2ps", dir);
+#endif
+	}
+	if (l >= sz)
+		return 0;
+	if (create)
+		mkdir(fn, 0755);		/* (may exist) */
+	if (snprintf(fn + l, sz - l, "%c%s.afb", DIRSEP, name) >= sz - l)
+		return 0;
+	return fn;
+}
+
+/* -- load the metrics from the binary cache -- */
+static int afb_read(struct afm *afm, char *afm_fn, struct stat *sbuf)
+{
+	FILE *fp;
+	unsigned char h[AFB_HSZ + 512], *p;
+	char fn[512];
+	int i, l, nkern;
+
+	if (!afb_name(fn, sizeof fn, afm->name, 0))
+		return -1;
+	fp = fopen(fn, "rb");
+	if (!fp)
+		return -1;
+	l = strlen(afm_fn);
+	if (fread(h, AFB_HSZ, 1, fp) != 1
+	 || memcmp(h, AFB_MAGIC, 4) != 0
+	 || get_le(h + 4, 4) != ((unsigned long) sbuf->st_size & 0xffffffff)
+	 || get_le(h + 8, 4) != ((unsigned long) sbuf->st_mtime & 0xffffffff)
+	 || get_le(h + 12, 4)
+		!= ((unsigned long) ((unsigned long long) sbuf->st_mtime >> 32)
+							& 0xffffffff)
+	 || get_le(h + 20, 2) != (unsigned) l
+	 || fread(h + AFB_HSZ, l, 1, fp) != 1
+	 || memcmp(h + AFB_HSZ, afm_fn, l) != 0)
+		goto err;
+	nkern = get_le(h + 16, 4);
+	if (nkern < 0 || nkern > 65536
+	 || fread(h, 512, 1, fp) != 1)
+		goto err;
+	for (i = 0; i < 256; i++)
+		afm->w[i] = (short) get_le(h + i * 2, 2);
+	if (nkern > 0) {
+		afm->kern = malloc(sizeof *afm->kern * nkern);
+		if (!afm->kern)
+			goto err;
+		for (i = 0; i < nkern; i++) {
+			p = h;
+			if (fread(p, 4, 1, fp) != 1)
+				goto err;
+			afm->kern[i].c1 = p[0];
+			afm->kern[i].c2 = p[1];
+			afm->kern[i].v = (short) get_le(p + 2, 2);
+		}
+	}
+	afm->nkern = nkern;
+	fclose(fp);
+	return 0;
+err:
+	fclose(fp);
+	free(afm->kern);
+	afm->kern = 0;
+	return -1;
+}
+
+/* -- save the metrics in the binary cache -- */
+static void afb_write(struct afm *afm, char *afm_fn, struct stat *sbuf)
+{
+	FILE *fp;
+	unsigned char *buf, *p;
+	char fn[512];
+	int i, l, sz;
+
+	if (!afb_name(fn, sizeof fn, afm->name, 1))
+		return;
+	l = strlen(afm_fn);
+	if (l > 0xffff)
+		return;
+	sz = AFB_HSZ + l + 512 + 4 * afm->nkern;
+	buf = malloc(sz);
+	if (!buf)
+		return;
+	memcpy(buf, AFB_MAGIC, 4);
+	put_le(buf + 4, (unsigned long) sbuf->st_size, 4);
+	put_le(buf + 8, (unsigned long) sbuf->st_mtime, 4);
+	put_le(buf + 12, (unsigned long)
+			((unsigned long long) sbuf->st_mtime >> 32), 4);
+	put_le(buf + 16, afm->nkern, 4);
+	put_le(buf + 20, l, 2);
+	memcpy(buf + AFB_HSZ, afm_fn, l);
+	p = buf + AFB_HSZ + l;
+	for (i = 0; i < 256; i++) {
+		put_le(p, (unsigned short) afm->w[i], 2);
+		p += 2;
+	}
+	for (i = 0; i < afm->nkern; i++) {
+		p[0] = afm->kern[i].c1;
+		p[1] = afm->kern[i].c2;
+		put_le(p + 2, (unsigned short) afm->kern[i].v, 2);
+		p += 4;
+	}
+	fp = fopen(fn, "wb");
+	if (!fp) {
+		free(buf);
+		return;				/* (no write access) */
+	}
+	if (fwrite(buf, 1, sz, fp) != (size_t) sz) {
+		fclose(fp);
+		remove(fn);
+	} else if (fclose(fp) != 0) {
+		remove(fn);
+	}
+	free(buf);
+}
+
+/* -- search and load the metrics of a font -- */
+static struct afm *afm_get(char *name)
+{
+	struct afm *afm;
+	FILE *fp;
+	struct stat sbuf;
+	char afm_fn[256], fn[512];
+	int i;
+
+	for (afm = afm_list; afm; afm = afm->next) {
+		if (afm->name == name)
+			return afm;
+	}
+	if (strlen(name) >= sizeof afm_fn - 8)
+		return 0;
+	sprintf(afm_fn, "%s.afm", name);
+	fp = open_file(afm_fn, "afm", fn);
+	if (!fp)
+		return 0;
+	afm = calloc(1, sizeof *afm);
+	if (!afm) {
+		fclose(fp);
+		return 0;
+	}
+	afm->name = name;
+	fstat(fileno(fp), &sbuf);
+	if (afb_read(afm, fn, &sbuf) != 0) {
+		for (i = 0; i < 256; i++)
+			afm->w[i] = -1;
+		if (afm_parse(afm, fp) != 0) {
+			error(1, 0, "Bad font metrics for %s", name);
+			fclose(fp);
+			free(afm->kern);
+			free(afm);
+			return 0;
+		}
+		afb_write(afm, fn, &sbuf);
+	}
+	fclose(fp);
+	afm->next = afm_list;
+	afm_list = afm;
+	return afm;
+}
+
+/* -- check if a font has metrics, loading them if needed -- */
+int afm_loaded(int fnum)
+{
+	if (fnum < 0 || fnum >= MAXFONTS || !fontnames[fnum])
+		return 0;
+	if (!afm_done[fnum]) {
+		afm_done[fnum] = 1;
+		afm_tb[fnum] = afm_get(fontnames[fnum]);
+	}
+	return afm_tb[fnum] != 0;
+}
+
+/* -- get a font number from its name (-1 if none) -- */
+int afm_font(char *name)
+{
+	int fnum;
+
+	name = abc_intern(name);
+	for (fnum = 0; fnum < MAXFONTS; fnum++) {
+		if (fontnames[fnum] == name)
+			return fnum;
+	}
+	return -1;
+}
+
+/* -- return the width of a character in a font (em) -- */
+float font_cwid(int fnum, unsigned short c)
+{
+	struct afm *afm;
+
+	if (c < 256 && afm_loaded(fnum)) {
+		afm = afm_tb[fnum];
+		if (afm->w[c] >= 0)
+			return (float) afm->w[c] / 1000.;
+	}
+	return cwid(c);
+}
+
+/* -- return the kerning between 2 characters in a font (em) -- */
+float font_kern(int fnum, unsigned short c1, unsigned short c2)
+{
+	struct afm *afm;
+	struct kern k, *r;
+
+	if (c1 >= 256 || c2 >= 256 || !afm_loaded(fnum))
+		return 0;
+	afm = afm_tb[fnum];
+	if (afm->nkern == 0)
+		return 0;
+	k.c1 = c1;
+	k.c2 = c2;
+	r = bsearch(&k, afm->kern, afm->nkern, sizeof *afm->kern, kern_cmp);
+	if (!r)
+		return 0;
+	return (float) r->v / 1000.;
+}
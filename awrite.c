@@ -0,0 +1,247 @@
+/*
+ * Asynchronous output.
+ *
+ * The output data are put in big blocks which are written to the
+ * output file by a writer thread, so that the generation of the music
+ * is not stopped by the file system latencies.
+ * There are two blocks: one is filled while the other one is written.
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE			/* for fopencookie() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "abc2ps.h"
+
+/* the writer thread needs the streams with user functions */
+#if defined(__GLIBC__)
+#define AW_COOKIE 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) \
+   || defined(__NetBSD__) || defined(__OpenBSD__)
+#define AW_FUNOPEN 1
+#endif
+
+#if defined(AW_COOKIE) || defined(AW_FUNOPEN)
+#include <pthread.h>
+
+#define AWBLK (256 * 1024)		/* size of the blocks */
+
+struct awfile {
+	FILE *f;			/* output file */
+	char *buf[2];			/* blocks */
+	int cur;			/* block being filled */
+	long len;			/* length of the data in this block */
+	long size;			/* size of the output */
+	pthread_t th;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	char *wbuf;			/* block given to the writer */
+	long wlen;			/* (0 when the writer is free) */
+	int quit;			/* no more data */
+	int err;			/* write error */
+	FILE *af;			/* asynchronous stream */
+};
+static long aw_size;			/* size of the last closed file */
+static struct awfile *aw_cur;		/* (only one file at a time) */
+
+/* -- writer thread -- */
+static void *aw_thread(void *c)
+{
+	struct awfile *a = c;
+	char *p;
+	long l;
+
+	pthread_mutex_lock(&a->mtx);
+	for (;;) {
+		while (a->wlen == 0 && !a->quit)
+			pthread_cond_wait(&a->cond, &a->mtx);
+		if (a->wlen == 0)
+			break;			/* quit */
+		p = a->wbuf;
+		l = a->wlen;
+		pthread_mutex_unlock(&a->mtx);
+		if (!a->err
+		 && fwrite(p, 1, l, a->f) != (size_t) l)
+			a->err = 1;
+		pthread_mutex_lock(&a->mtx);
+		a->wlen = 0;
+		pthread_cond_signal(&a->cond);
+	}
+	pthread_mutex_unlock(&a->mtx);
+	return NULL;
+}
+
+/* -- give the current block to the writer -- */
+static void aw_put(struct awfile *a)
+{
+	pthread_mutex_lock(&a->mtx);
+	while (a->wlen != 0)			/* wait for the previous block */
+		pthread_cond_wait(&a->cond, &a->mtx);
+	a->wbuf = a->buf[a->cur];
+	a->wlen = a->len;
+	pthread_cond_signal(&a->cond);
+	pthread_mutex_unlock(&a->mtx);
+	a->cur ^= 1;
+	a->len = 0;
+}
+
+/* -- add data to the output -- */
+static long aw_write(struct awfile *a, const char *p, long n)
+{
+	long l, r;
+
+	r = n;
+	a->size += n;
+	while (n > 0) {
+		l = AWBLK - a->len;
+		if (l > n)
+			l = n;
+		memcpy(a->buf[a->cur] + a->len, p, l);
+		a->len += l;
+		p += l;
+		n -= l;
+		if (a->len >= AWBLK)
+			aw_put(a);
+	}
+	return r;
+}
+
+/* -- flush the data, stop the writer and close the output file -- */
+static int aw_end(struct awfile *a)
+{
+	int r;
+
+	if (a->len > 0)
+		aw_put(a);
+	pthread_mutex_lock(&a->mtx);
+	a->quit = 1;
+	pthread_cond_signal(&a->cond);
+	pthread_mutex_unlock(&a->mtx);
+	pthread_join(a->th, NULL);
+	r = a->err ? -1 : 0;
+	if (a->f != stdout) {
+		if (fclose(a->f) != 0)
+			r = -1;
+	} else if (fflush(a->f) != 0) {
+		r = -1;
+	}
+	aw_size = a->size;
+	if (aw_cur == a)
+		aw_cur = NULL;
+	pthread_mutex_destroy(&a->mtx);
+	pthread_cond_destroy(&a->cond);
+	free(a->buf[0]);
+	free(a);
+	return r;
+}
+
+#ifdef AW_COOKIE
+static ssize_t ck_write(void *c, const char *p, size_t n)
+{
+	return aw_write(c, p, n);
+}
+static int ck_close(void *c)
+{
+	return aw_end(c);
+}
+#else
+static int fn_write(void *c, const char *p, int n)
+{
+	return aw_write(c, p, n);
+}
+static int fn_close(void *c)
+{
+	return aw_end(c);
+}
+#endif
+#endif /* AW_COOKIE || AW_FUNOPEN */
+
+/* -- open an asynchronous output stream to a file -- */
+/* return the file itself when no writer thread */
+FILE *aw_open(FILE *f)
+{
+#if defined(AW_COOKIE) || defined(AW_FUNOPEN)
+	struct awfile *a;
+	FILE *af;
+
+	a = calloc(1, sizeof *a);
+	if (a)
+		a->buf[0] = malloc(2 * AWBLK);
+	if (!a || !a->buf[0]) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	a->buf[1] = a->buf[0] + AWBLK;
+	a->f = f;
+	pthread_mutex_init(&a->mtx, NULL);
+	pthread_cond_init(&a->cond, NULL);
+	if (pthread_create(&a->th, NULL, aw_thread, a) != 0)
+		goto err;
+#ifdef AW_COOKIE
+	{
+		cookie_io_functions_t io = {NULL, ck_write, NULL, ck_close};
+
+		af = fopencookie(a, "w", io);
+	}
+#else
+	af = funopen(a, NULL, fn_write, NULL, fn_close);
+#endif
+	if (af) {
+		a->af = af;
+		aw_cur = a;
+		return af;
+	}
+	pthread_mutex_lock(&a->mtx);
+	a->quit = 1;
+	pthread_cond_signal(&a->cond);
+	pthread_mutex_unlock(&a->mtx);
+	pthread_join(a->th, NULL);
+err:
+	pthread_mutex_destroy(&a->mtx);
+	pthread_cond_destroy(&a->cond);
+	free(a->buf[0]);
+	free(a);
+#endif
+	return f;
+}
+
+/* -- close an asynchronous output stream -- */
+/* return the size of the output or -1 on write error */
+long aw_close(FILE *af)
+{
+#if defined(AW_COOKIE) || defined(AW_FUNOPEN)
+	if (fclose(af) != 0)
+		return -1;
+	return aw_size;
+#else
+	return fclose(af) != 0 ? -1 : 0;
+#endif
+}
+
+/* -- get the size of the data written to an asynchronous stream -- */
+long aw_tell(FILE *af)
+{
+#if defined(AW_COOKIE) || defined(AW_FUNOPEN)
+	if (aw_cur && aw_cur->af == af) {
+		fflush(af);
+		return aw_cur->size;
+	}
+#endif
+	return ftell(af);
+}
@@ -0,0 +1,310 @@
+/*
+ * Benchmark driver for abcm2ps.
+ *
+ * Runs abcm2ps on a set of ABC files in all the output modes
+ * and reports, for each mode, the wall time, the number of tunes
+ * per second, the output throughput and the peak memory size.
+ * The results are written to stdout as JSON lines.
+ *
+ * usage: abcbench [-c name] [-n repeat] [-x factor] abcm2ps file.abc ...
+ *	-c name		name of the set of files in the report (default "files")
+ *	-n repeat	number of runs per mode (the best time is kept)
+ *	-x factor	also run a tunebook made of 'factor' copies
+ *			of the input files (default 20, 0 = none)
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+static struct mode {
+	char *name;
+	char *opt;		/* abcm2ps option */
+} mode_tb[] = {
+	{"ps", NULL},
+	{"eps", "-E"},
+	{"svg-page", "-g"},
+	{"svg", "-v"},
+	{"xhtml", "-X"},
+};
+#define NMODES (sizeof mode_tb / sizeof mode_tb[0])
+
+static char *prog;		/* abcm2ps path */
+static char outdir[PATH_MAX];	/* temporary directory */
+
+/* -- error exit -- */
+static void fatal(char *msg, char *arg)
+{
+	fprintf(stderr, "abcbench: %s %s: %s\n",
+		msg, arg ? arg : "", strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+/* -- return the current time in seconds -- */
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* -- count the tunes of an ABC file -- */
+static int count_tunes(char *fn)
+{
+	FILE *f;
+	char line[256];
+	int n, bol;
+
+	f = fopen(fn, "r");
+	if (!f)
+		fatal("cannot read", fn);
+	n = 0;
+	bol = 1;
+	while (fgets(line, sizeof line, f)) {
+		if (bol && line[0] == 'X' && line[1] == ':')
+			n++;
+		bol = strchr(line, '\n') != NULL;
+	}
+	fclose(f);
+	return n;
+}
+
+/* -- build a tunebook from 'factor' copies of the files -- */
+static char *make_book(char **files, int nfiles, int factor)
+{
+	static char fn[PATH_MAX + 16];
+	FILE *f, *fin;
+	char buf[4096];
+	int i, j;
+	size_t l;
+
+	snprintf(fn, sizeof fn, "%s/book.abc", outdir);
+	f = fopen(fn, "w");
+	if (!f)
+		fatal("cannot create", fn);
+	for (j = 0; j < factor; j++) {
+		for (i = 0; i < nfiles; i++) {
+			fin = fopen(files[i], "r");
+			if (!fin)
+				fatal("cannot read", files[i]);
+			while ((l = fread(buf, 1, sizeof buf, fin)) > 0)
+				fwrite(buf, 1, l, f);
+			fclose(fin);
+			fputs("\n\n", f);	/* end of the last tune */
+		}
+	}
+	if (fclose(f) != 0)
+		fatal("cannot write", fn);
+	return fn;
+}
+
+/* -- remove the generated files and return their total size -- */
+static long long clean_outdir(void)
+{
+	DIR *d;
+	struct dirent *de;
+	struct stat st;
+	char fn[PATH_MAX + 256];
+	long long sz;
+
+	d = opendir(outdir);
+	if (!d)
+		fatal("cannot open", outdir);
+	sz = 0;
+	while ((de = readdir(d)) != NULL) {
+		if (strncmp(de->d_name, "out", 3) != 0)
+			continue;
+		snprintf(fn, sizeof fn, "%s/%s", outdir, de->d_name);
+		if (stat(fn, &st) == 0)
+			sz += st.st_size;
+		unlink(fn);
+	}
+	closedir(d);
+	return sz;
+}
+
+/* -- run abcm2ps once -- */
+static int run(struct mode *m, char **files, int nfiles,
+		double *t, long *rss, int *st)
+{
+	char *argv[nfiles + 8];
+	struct rusage ru;
+	pid_t pid;
+	double t0;
+	int i, argc, status, fd;
+
+	argc = 0;
+	argv[argc++] = prog;
+	argv[argc++] = "-q";
+	if (m->opt)
+		argv[argc++] = m->opt;
+	argv[argc++] = "-O";
+	argv[argc++] = "out";
+	for (i = 0; i < nfiles; i++)
+		argv[argc++] = files[i];
+	argv[argc] = NULL;
+
+	t0 = now();
+	pid = fork();
+	if (pid < 0)
+		fatal("cannot fork", NULL);
+	if (pid == 0) {
+		if (chdir(outdir) != 0)
+			_exit(127);
+		fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0) {
+			dup2(fd, 1);
+			dup2(fd, 2);
+			close(fd);
+		}
+		execv(prog, argv);
+		_exit(127);
+	}
+	if (wait4(pid, &status, 0, &ru) < 0)
+		fatal("wait", NULL);
+	*t = now() - t0;
+	*rss = ru.ru_maxrss;		/* kB on Linux */
+	if (!WIFEXITED(status) || WEXITSTATUS(status) == 127)
+		return -1;
+	*st = WEXITSTATUS(status);	/* 1 if errors in the ABC files */
+	return 0;
+}
+
+/* -- benchmark a set of files in all the modes -- */
+static void bench(char *corpus, char **files, int nfiles, int repeat)
+{
+	struct mode *m;
+	double t, tbest;
+	long rss, rssmax;
+	long long sz;
+	int i, r, ntunes, st, stmax;
+
+	ntunes = 0;
+	for (i = 0; i < nfiles; i++)
+		ntunes += count_tunes(files[i]);
+	for (m = mode_tb; m < &mode_tb[NMODES]; m++) {
+		tbest = 0;
+		rssmax = 0;
+		stmax = 0;
+		sz = 0;
+		for (r = 0; r < repeat; r++) {
+			if (run(m, files, nfiles, &t, &rss, &st) < 0) {
+				fprintf(stderr, "abcbench: %s failed in mode %s\n",
+					prog, m->name);
+				exit(EXIT_FAILURE);
+			}
+			sz = clean_outdir();
+			if (r == 0 || t < tbest)
+				tbest = t;
+			if (rss > rssmax)
+				rssmax = rss;
+			if (st > stmax)
+				stmax = st;
+		}
+		if (tbest <= 0)
+			tbest = 1e-6;
+		printf("{\"corpus\":\"%s\",\"mode\":\"%s\",\"files\":%d,"
+			"\"tunes\":%d,\"runs\":%d,\"wall_s\":%.4f,"
+			"\"tunes_per_s\":%.1f,\"out_bytes\":%lld,"
+			"\"mb_per_s\":%.2f,\"peak_rss_kb\":%ld,"
+			"\"status\":%d}\n",
+			corpus, m->name, nfiles,
+			ntunes, repeat, tbest,
+			ntunes / tbest, sz,
+			sz / tbest / 1e6, rssmax, stmax);
+		fflush(stdout);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char **files, *book;
+	char *tmp, *corpus;
+	int i, nfiles, repeat, factor;
+
+	corpus = "files";
+	repeat = 3;
+	factor = 20;
+	while ((i = getopt(argc, argv, "c:n:x:")) != -1) {
+		switch (i) {
+		case 'c':
+			corpus = optarg;
+			break;
+		case 'n':
+			repeat = atoi(optarg);
+			if (repeat <= 0)
+				repeat = 1;
+			break;
+		case 'x':
+			factor = atoi(optarg);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind < 2)
+		goto usage;
+	prog = realpath(argv[optind], NULL);
+	if (!prog)
+		fatal("cannot find", argv[optind]);
+	optind++;
+
+	/* the files are given with their absolute path */
+	nfiles = argc - optind;
+	files = malloc(nfiles * sizeof *files);
+	if (!files)
+		fatal("out of memory", NULL);
+	for (i = 0; i < nfiles; i++) {
+		files[i] = realpath(argv[optind + i], NULL);
+		if (!files[i])
+			fatal("cannot find", argv[optind + i]);
+	}
+
+	tmp = getenv("TMPDIR");
+	snprintf(outdir, sizeof outdir, "%s/abcbenchXXXXXX",
+		tmp ? tmp : "/tmp");
+	if (!mkdtemp(outdir))
+		fatal("cannot create", outdir);
+
+	bench(corpus, files, nfiles, repeat);
+	if (factor > 0) {
+		book = make_book(files, nfiles, factor);
+		bench("book", &book, 1, repeat);
+		unlink(book);
+	}
+	clean_outdir();
+	rmdir(outdir);
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: abcbench [-c name] [-n repeat] [-x factor]"
+		" abcm2ps file.abc ...\n");
+	return EXIT_FAILURE;
+}
@@ -34,6 +34,9 @@
 
 #define BUFFLN	80		/* max number of lines in output buffer */
 
+/* name, version and revision of the external prologue resource */
+#define PS_PROLOG "abcm2ps-" VERSION " 0 0"
+
 static int ln_num;		/* number of lines in buffer */
 static float ln_pos[BUFFLN];	/* vertical positions of buffered lines */
 static char *ln_buf[BUFFLN];	/* buffer location of buffered lines */
@@ -49,6 +52,8 @@ static int nepsf;		/* counter for -E/-g output files */
 static int nbpages;		/* number of pages in the output file */
 static int outbufsz;		/* size of outbuf */
 static char outfnam[FILENAME_MAX]; /* internal file name for open/close */
+static int fout_gz;			/* fout is a compressed stream */
+static int fout_aw;			/* fout is an asynchronous stream */
 static struct FORMAT *p_fmt;	/* current format while treating a new page */
 
 int (*output)(FILE *out, const char *fmt, ...);
@@ -57,6 +62,11 @@ int in_page;			/* filling a PostScript page */
 char *outbuf;			/* output buffer.. should hold one tune */
 char *mbf;			/* where to a2b() */
 int use_buffer;			/* 1 if lines are being accumulated */
+int outbuf_wr;			/* number of writes of the output buffer */
+
+static char dl_base[FILENAME_MAX];	/* base name of the display list outputs */
+static char dl_pdf_fn[FILENAME_MAX + 8];
+static int dl_num;			/* page number */
 
 /* -- cut off extension on a file identifier -- */
 static void cutext(char *fid)
@@ -69,10 +79,152 @@ static void cutext(char *fid)
 		*p = '\0';
 }
 
+/* -- open an output file of the display list (one page or tune) -- */
+static FILE *dl_fopen(char *fn, char *ext)
+{
+	FILE *f;
+
+	if (epsf)
+		sprintf(fn, "%s%s", dl_base, ext);
+	else
+		sprintf(fn, "%s%03d%s", dl_base, dl_num, ext);
+	if ((f = fopen(fn, "wb")) == NULL) {
+		error(1, 0, "Cannot create output file %s - abort", fn);
+		exit(EXIT_FAILURE);
+	}
+	return f;
+}
+
+/* -- open the output files of the display list (one file per page) -- */
+static void dl_open(char *fnm)
+{
+	FILE *f;
+
+	strcpy(dl_base, fnm);
+	if (strcmp(fnm, "-") == 0) {
+		if (dlout != DL_PDF) {
+			error(1, 0, "Cannot use stdout with these output formats - abort");
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		cutext(dl_base);
+	}
+	dl_num = 0;
+	dl_reset();
+	if (dlout & DL_PDF) {
+		f = stdout;
+		strcpy(dl_pdf_fn, "-");
+		if (strcmp(fnm, "-") != 0) {
+			sprintf(dl_pdf_fn, "%s.pdf", dl_base);
+			if ((f = fopen(dl_pdf_fn, "wb")) == NULL) {
+				error(1, 0, "Cannot create output file %s - abort",
+					dl_pdf_fn);
+				exit(EXIT_FAILURE);
+			}
+		}
+		pdf_open(f);
+	}
+
+	/* the SVG pages go to a temporary file */
+	if ((fout = tmpfile()) == NULL) {
+		error(1, 0, "Cannot create a temporary file - abort");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* -- output message of a display list file -- */
+static void dl_done(char *fn, long m)
+{
+	if (!quiet && strcmp(fn, "-") != 0)
+		fprintf(stderr, "Output written on %s (%ld bytes)\n", fn, m);
+}
+
+/* -- output the SVG page or tune of the temporary file -- */
+/* in the display list formats */
+static void dl_write(void)
+{
+	char fn[FILENAME_MAX + 8], buf[BUFSIZ];
+	FILE *f;
+	long l, m;
+	int n;
+
+	fflush(fout);
+	l = ftell(fout);
+	dl_build(fout);
+	if (!epsf) {
+		dl_num++;
+		if (dlout & DL_PDF)
+			pdf_page();
+	} else {
+		if (dlout & DL_PDF) {
+			f = dl_fopen(fn, ".pdf");
+			pdf_open(f);
+			pdf_page();
+			dl_done(fn, pdf_close());
+		}
+	}
+	if (dlout & DL_SVG) {
+		f = dl_fopen(fn, ".svg");
+		for (m = l; m > 0; m -= n) {
+			n = fread(buf, 1, m < (long) sizeof buf ? m : sizeof buf,
+					fout);
+			if (n <= 0)
+				break;
+			fwrite(buf, 1, n, f);
+		}
+		rewind(fout);
+		fclose(f);
+		dl_done(fn, l);
+	}
+	if (dlout & DL_PNG) {
+		f = dl_fopen(fn, ".png");
+		m = png_write(f);
+		fclose(f);
+		dl_done(fn, m);
+	}
+}
+
+/* -- check/set the name of a compressed output file -- */
+static int gz_name(char *fn)
+{
+	int l;
+
+	l = strlen(fn);
+	if (l > 3 && strcmp(&fn[l - 3], ".gz") == 0)
+		return 1;
+	if (l > 5 && strcmp(&fn[l - 5], ".svgz") == 0)
+		return 1;
+	if (!gzip_out)
+		return 0;
+	if (l + 3 >= FILENAME_MAX)
+		return 1;
+	if (l > 4 && strcmp(&fn[l - 4], ".svg") == 0)
+		strcat(fn, "z");
+	else
+		strcat(fn, ".gz");
+	return 1;
+}
+
+/* -- set the compressed and/or asynchronous output streams -- */
+static void fout_wrap(int gz)
+{
+	FILE *f;
+
+	f = fout;
+	if (async_write)
+		fout = aw_open(fout);
+	if (gz) {
+		fout = z_open(fout);	/* compress before the writer */
+		fout_gz = 1;
+	} else {
+		fout_aw = fout != f;
+	}
+}
+
 /* -- open the output file -- */
 static void open_fout(void)
 {
-	int i;
+	int i, gz;
 	char fnm[FILENAME_MAX];
 
 	strcpy(fnm, outfn);
@@ -107,19 +259,27 @@ static void open_fout(void)
 		else	...
 #endif
 	}
-	if (svg == 1
+	if (svg == 1 && !dlout
 	 && (i != 0 || fnm[0] != '-')) {
 		cutext(fnm);
 		i = strlen(fnm) - 1;
 		if (strncmp(fnm, outfnam, i) != 0)
 			nepsf = 0;
 		sprintf(&fnm[i + 1], "%03d.svg", ++nepsf);
-	} else if (strcmp(fnm, outfnam) == 0) {
-		return;				/* same output file */
+		gz = gz_name(fnm);
+	} else {
+		gz = !dlout
+		  && ((i == 0 && fnm[0] == '-') ? gzip_out : gz_name(fnm));
+		if (strcmp(fnm, outfnam) == 0)
+			return;			/* same output file */
 	}
 
 	close_output_file();
 	strcpy(outfnam, fnm);
+	if (dlout) {
+		dl_open(fnm);
+		return;
+	}
 	if (i != 0 || fnm[0] != '-') {
 		if ((fout = fopen(fnm, "w")) == NULL) {
 			error(1, 0, "Cannot create output file %s - abort", fnm);
@@ -128,6 +288,7 @@ static void open_fout(void)
 	} else {
 		fout = stdout;
 	}
+	fout_wrap(gz);
 }
 
 /* -- convert a date -- */
@@ -148,12 +309,110 @@ void marg_init(void)
 	max_rmarg = cfmt.pagewidth;
 }
 
+/* -- output the PostScript definitions which don't depend on the tunes -- */
+/* when 'used', only the symbols marked by ps_sym_scan() are defined */
+static void prolog_out(int used)
+{
+	unsigned i;
+	char version[32];
+
+	strcpy(version, "/creator [(abcm2ps) " VERSION "] def");
+	for (i = 0; i < strlen(version); i++) {
+		if (version[i] == '.')
+			version[i] = ' ';
+	}
+	fprintf(fout, "/!{bind def}bind def\n"
+		"/bdef{bind def}!\n"		/* for compatibility */
+		"/T/translate load def\n"
+		"/M/moveto load def\n"
+		"/RM/rmoveto load def\n"
+		"/L/lineto load def\n"
+		"/RL/rlineto load def\n"
+		"/C/curveto load def\n"
+		"/RC/rcurveto load def\n"
+		"/SLW/setlinewidth load def\n"
+		"/defl 0 def\n"	/* decoration flags - see deco.c for values */
+		"/dlw{0.7 SLW}!\n"
+
+		"%s\n", version);
+	if (used)
+		define_used_symbols();
+	else
+		define_symbols();
+}
+
+/* -- write the external prologue file (option '--ps-prolog') -- */
+/* this is done once, when the first PostScript file is created */
+static void prolog_write(void)
+{
+	static int done;
+	FILE *f, *fsave;
+
+	if (done)
+		return;
+	done = 1;
+	if ((f = fopen(ps_prolog, "w")) == NULL) {
+		error(1, 0, "Cannot open output file %s - abort", ps_prolog);
+		exit(EXIT_FAILURE);
+	}
+	fprintf(f, "%%!PS-Adobe-3.0 Resource-ProcSet\n"
+		"%%%%Title: abcm2ps prologue\n"
+		"%%%%Creator: abcm2ps-" VERSION "\n"
+		"%%%%EndComments\n"
+		"%%%%BeginResource: procset " PS_PROLOG "\n");
+	fsave = fout;
+	fout = f;
+	prolog_out(0);
+	fout = fsave;
+	fprintf(f, "/abcm2ps-prolog(" VERSION ")def\n"
+		"%%%%EndResource\n"
+		"%%%%EOF\n");
+	fclose(f);
+	if (!quiet)
+		fprintf(stderr, "Prologue written on %s\n", ps_prolog);
+}
+
+/* -- output the setup of an EPS file -- */
+/* the tune is in the output buffer, so only the procedures it uses,
+ * directly or from the user PostScript code, are defined */
+static void eps_setup(void)
+{
+	FILE *f;
+	char *buf;
+	long len;
+
+	/* get the user PostScript code and the font definitions */
+	f = fout;
+	if ((fout = tmpfile()) == NULL) {
+		error(1, 0, "Cannot create a temporary file - abort");
+		exit(EXIT_FAILURE);
+	}
+	user_ps_write();
+	define_fonts();
+	len = ftell(fout);
+	buf = malloc(len + 1);
+	if (!buf) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	rewind(fout);
+	len = fread(buf, 1, len, fout);
+	fclose(fout);
+	fout = f;
+
+	ps_sym_scan(buf, len);
+	ps_sym_scan(outbuf, mbf - outbuf);
+	prolog_out(1);
+	fwrite(buf, 1, len, fout);
+	free(buf);
+}
+
 /* -- initialize the postscript file (PS or EPS) -- */
 static void init_ps(char *str)
 {
 	time_t ltime;
 	unsigned i;
-	char version[32];
+	char *p;
 
 	if (epsf) {
 		cur_lmarg = min_lmarg - 10;
@@ -182,6 +441,9 @@ static void init_ps(char *str)
 		"%%%%CreationDate: %s\n", tex_buf);
 	if (!epsf)
 		fprintf(fout, "%%%%Pages: (atend)\n");
+	if (ps_prolog)
+		fprintf(fout, "%%%%DocumentNeededResources: procset "
+				PS_PROLOG "\n");
 	fprintf(fout, "%%%%LanguageLevel: 3\n"
 		"%%%%EndComments\n"
 		"%%CommandLine:");
@@ -208,34 +470,37 @@ static void init_ps(char *str)
 	fprintf(fout, "\n\n");
 	if (epsf)
 		fprintf(fout, "save\n");
-	strcpy(version, "/creator [(abcm2ps) " VERSION "] def");
-	for (i = 0; i < strlen(version); i++) {
-		if (version[i] == '.')
-			version[i] = ' ';
-	}
-	fprintf(fout, "%%%%BeginSetup\n"
-		"/!{bind def}bind def\n"
-		"/bdef{bind def}!\n"		/* for compatibility */
-		"/T/translate load def\n"
-		"/M/moveto load def\n"
-		"/RM/rmoveto load def\n"
-		"/L/lineto load def\n"
-		"/RL/rlineto load def\n"
-		"/C/curveto load def\n"
-		"/RC/rcurveto load def\n"
-		"/SLW/setlinewidth load def\n"
-		"/defl 0 def\n"	/* decoration flags - see deco.c for values */
-		"/dlw{0.7 SLW}!\n"
-
-		"%s\n", version);
-	define_symbols();
+	fprintf(fout, "%%%%BeginSetup\n");
 	output = fprintf;
+	if (!ps_prolog) {
+		if (epsf) {
+			eps_setup();
+			goto fonts_done;
+		}
+		prolog_out(0);
+	} else {
+		prolog_write();
+		fprintf(fout, "%%%%IncludeResource: procset " PS_PROLOG "\n"
+			"/abcm2ps-prolog where{pop abcm2ps-prolog(" VERSION ")ne}\n"
+			"	{true}ifelse{(");
+		for (p = ps_prolog; *p != '\0'; p++) {
+			if (*p == '(' || *p == ')' || *p == '\\')
+				fputc('\\', fout);
+			fputc(*p, fout);
+		}
+		fprintf(fout, ")run}if\n");
+	}
 	user_ps_write();
 	define_fonts();
+fonts_done:
 	if (!epsf)
 		fprintf(fout, "/setpagedevice where{pop\n"
 			"	<</PageSize[%.0f %.0f]>>setpagedevice}if\n",
 				p_fmt->pagewidth, p_fmt->pageheight);
+	if (compact_ps) {
+		ps_compact_init();
+		output = ps_cprintf;
+	}
 	fprintf(fout, "%%%%EndSetup\n");
 	file_initialized = 1;
 }
@@ -261,11 +526,41 @@ static void close_fout(void)
 {
 	long m;
 
-	if (fout == stdout)
+	if (dlout) {
+		if (epsf)			/* one tune */
+			dl_write();
+		fclose(fout);
+		if (epsf)
+			goto out2;
+		if (dlout & DL_PDF) {
+			m = pdf_close();
+			if (!quiet && strcmp(dl_pdf_fn, "-") != 0)
+				fprintf(stderr,
+					"Output written on %s (%d page%s, %d title%s, %ld bytes)\n",
+					dl_pdf_fn,
+					nbpages, nbpages == 1 ? "" : "s",
+					tunenum, tunenum == 1 ? "" : "s",
+					m);
+		}
+		goto out2;
+	}
+	if (fout_gz) {
+		m = z_close(fout);
+	} else if (fout_aw) {
+		m = aw_close(fout);
+	} else {
+		if (fout == stdout)
+			goto out2;
+		m = ftell(fout);
+		if (fclose(fout) != 0)
+			m = -1;
+	}
+	if (m < 0) {
+		error(1, 0, "Write error on %s", outfnam);
+		goto out2;
+	}
+	if (quiet || strcmp(outfnam, "-") == 0)	/* stdout */
 		goto out2;
-	if (quiet)
-		goto out1;
-	m = ftell(fout);
 	if (epsf || svg == 1)
 		fprintf(stderr, "Output written on %s (%ld bytes)\n",
 			outfnam, m);
@@ -276,13 +571,29 @@ static void close_fout(void)
 			nbpages, nbpages == 1 ? "" : "s",
 			tunenum, tunenum == 1 ? "" : "s",
 			m);
-out1:
-	fclose(fout);
 out2:
 	fout = NULL;
+	fout_gz = fout_aw = 0;
 	file_initialized = 0;
 }
 
+/* -- check if the output goes to stdout -- */
+int fout_stdout(void)
+{
+	return fout == stdout
+	    || ((fout_gz || fout_aw) && strcmp(outfnam, "-") == 0);
+}
+
+/* -- get the size of the data written to the output file -- */
+long fout_tell(void)
+{
+	if (fout_gz)
+		return z_tell(fout);
+	if (fout_aw)
+		return aw_tell(fout);
+	return ftell(fout);
+}
+
 /* -- close the output file -- */
 /* epsf is always null */
 void close_output_file(void)
@@ -302,10 +613,14 @@ void close_output_file(void)
 			"%%%%Pages: %d\n"
 			"%%EOF\n", nbpages);
 		close_fout();
+	} else if (dlout) {
+		close_fout();
 	} else if (svg == 2) {
 		fputs("</body>\n"
 			"</html>\n", fout);
 		close_fout();
+	} else if (fout_gz || fout_aw) { /* (svg == 1) to stdout */
+		close_fout();
 	}				/* else (svg == 1)
 					 * 'fout' is closed in close_page */
 	nbpages = tunenum = 0;
@@ -318,13 +633,19 @@ void close_page(void)
 	if (!in_page)
 		return;
 	in_page = 0;
+	trace_end(TR_PAGE);
 	if (svg) {
 		svg_close();
-		if (svg == 1 && fout != stdout)
+		if (dlout) {
+			dl_write();
+			file_initialized = 0;
+		} else if (svg == 1 && !fout_stdout())
 			close_fout();
 		else
 			fputs("</p>\n", fout);
 	} else {
+		if (compact_ps)
+			ps_compact_flush();
 #if 1
 		fprintf(fout, "grestore\n"
 				"showpage\n"
@@ -481,7 +802,7 @@ static float headfooter(int header,
 				if (svg)
 					svg_write(mbf, strlen(mbf));
 				else
-					fputs(mbf, fout);
+					output(fout, "%s", mbf);
 			}
 			p = q + 1;
 		}
@@ -498,7 +819,7 @@ static float headfooter(int header,
 			if (svg)
 				svg_write(mbf, strlen(mbf));
 			else
-				fputs(mbf, fout);
+				output(fout, "%s", mbf);
 		}
 
 		/* right side */
@@ -513,7 +834,7 @@ static float headfooter(int header,
 				if (svg)
 					svg_write(mbf, strlen(mbf));
 				else
-					fputs(mbf, fout);
+					output(fout, "%s", mbf);
 			}
 		}
 		if (r == 0)
@@ -540,6 +861,7 @@ static void init_page(void)
 	p_fmt = info['X' - 'A'] == 0 ? &cfmt : &dfmt;	/* global format */
 
 	nbpages++;
+	trace_begin(TR_PAGE, NULL, nbpages);
 	if (svg) {
 		if (!file_initialized) {
 			if (!fout)
@@ -676,11 +998,12 @@ void write_eps(void)
 	cutext(outfnam);
 	i = strlen(outfnam) - 1;
 	if (i == 0 && outfnam[0] == '-') {
-		if (epsf == 1) {
-			error(1, 0, "Cannot use stdout with '-E' - abort");
+		if (epsf == 1 || dlout) {
+			error(1, 0, "Cannot use stdout with '-E', '-P' or '--formats' - abort");
 			exit(EXIT_FAILURE);
 		}
 		fout = stdout;
+		fout_wrap(gzip_out);
 	} else {
 		if (outfnam[i] == '=') {
 			p = &info['T' - 'A']->as.text[2];
@@ -694,11 +1017,22 @@ void write_eps(void)
 				i = sizeof outfnam - 4 - 3;
 			sprintf(&outfnam[i + 1], "%03d", ++nepsf);
 		}
-		strcat(outfnam, epsf == 1 ? ".eps" : ".svg");
-		if ((fout = fopen(outfnam, "w")) == NULL) {
-			error(1, 0, "Cannot open output file %s - abort",
-					outfnam);
-			exit(EXIT_FAILURE);
+		if (dlout) {		/* the SVG image goes to a temporary file */
+			strcpy(dl_base, outfnam);
+			dl_reset();
+			if ((fout = tmpfile()) == NULL) {
+				error(1, 0, "Cannot create a temporary file - abort");
+				exit(EXIT_FAILURE);
+			}
+		} else {
+			strcat(outfnam, epsf == 1 ? ".eps" : ".svg");
+			i = gz_name(outfnam);
+			if ((fout = fopen(outfnam, "w")) == NULL) {
+				error(1, 0, "Cannot open output file %s - abort",
+						outfnam);
+				exit(EXIT_FAILURE);
+			}
+			fout_wrap(i);
 		}
 	}
 	epsf_title(title, sizeof title);
@@ -763,6 +1097,7 @@ void init_outbuf(int kbsz)
 	if (outbufsz < 0x10000)
 		outbufsz = 0x10000;
 	outbuf = malloc(outbufsz);
+	mem.outbuf_sz = outbufsz;
 	if (!outbuf) {
 		error(1, 0, "Out of memory for outbuf - abort");
 		exit(EXIT_FAILURE);
@@ -782,6 +1117,7 @@ void write_buffer(void)
 
 	if (mbf == outbuf || multicol_start != 0)
 		return;
+	stats_start(ST_WRITE);
 	if (!in_page && !epsf)
 		init_page();
 	outft_sav = outft;
@@ -828,14 +1164,21 @@ void write_buffer(void)
 			maxy -= cfmt.topspace * cfmt.scale;
 		}
 		if (*p_buf != '\001') {
+			if (dlout)
+				dl_mark(fout_tell());
 			if (epsf == 2 || svg)
 				svg_write(p_buf, ln_buf[l] - p_buf);
+			else if (compact_ps)
+				ps_compact(p_buf, ln_buf[l] - p_buf);
 			else
 				fwrite(p_buf, 1, ln_buf[l] - p_buf, fout);
 		} else {			/* %%EPS - see parse.c */
 			FILE *f;
 			char line[BSIZE], *p, *q;
 
+			if (compact_ps)
+				ps_compact_flush();
+
 			p = strchr(p_buf + 1, '\n');
 			fwrite(p_buf + 1, 1, p - p_buf, fout);
 			p_buf = p + 1;
@@ -882,10 +1225,16 @@ void write_buffer(void)
 	if (*p_buf != '\0')
 		fprintf(stderr, "??? bug - buffer not empty:\n%s\n", p_buf);
 #endif
+	if (compact_ps)
+		ps_compact_flush();
 	outft = outft_sav;
 	bposy = 0;
 	ln_num = 0;
+	if (mbf - outbuf > mem.outbuf_hwm)
+		mem.outbuf_hwm = mbf - outbuf;
 	mbf = outbuf;
+	outbuf_wr++;
+	stats_stop(ST_WRITE);
 }
 
 /* -- add a block in the output buffer -- */
@@ -0,0 +1,445 @@
+/*
+ * Compact PostScript output (--compact-ps).
+ *
+ * The PostScript code of the music goes through a small token rewriter
+ * before being written:
+ * - the numbers are written without the useless zeros ("59.0" -> "59",
+ *   "0.50" -> ".5"),
+ * - the comments are removed (but not the DSC ones),
+ * - the consecutive translations are merged, the null ones and the
+ *   moves which are followed by an other move are removed,
+ * - a font selection is removed when the same font is already selected,
+ * - the common sequences of a note head and its stem are replaced by
+ *   a call to a procedure defined once in the file.
+ * The spaces are output only where they are needed, but the line
+ * breaks are kept.
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "abc2ps.h"
+
+#define MAXNUM 16			/* maximum operands of an operator */
+#define NUMSZ 24
+
+static struct item {			/* operator and its operands */
+	char nl;			/* line break before */
+	int nnum;
+	char num[MAXNUM][NUMSZ];
+	char op[16];
+} cur, held;
+static int has_held;			/* 'held' is waiting for the next item */
+
+static char last_c;			/* last character written */
+static char nl;				/* line break before the next token */
+static int depth;			/* procedure depth */
+static char cur_font[NUMSZ + 16];	/* current font ("size Fn") */
+
+/* note head and stem */
+static struct {
+	char *head, *stem, *name;
+} fold_tb[] = {
+	{"hd", "su", "hdu"}, {"hd", "sd", "hdd"},
+	{"Hd", "su", "Hdu"}, {"Hd", "sd", "Hdd"},
+	{"ghd", "gu", "ghdu"}, {"ghd", "gd", "ghdd"},
+};
+#define NFOLD (sizeof fold_tb / sizeof fold_tb[0])
+
+/* operators which don't change the font */
+static char *keep_font[] = {
+	"M", "RM", "L", "RL", "C", "RC", "T", "!",
+	"hd", "Hd", "HD", "hl", "bm", "bar", "staff", "su", "sd",
+	"gu", "gd", "ghd", "dt", "y0", "tclef", "bclef", "cclef", "csig",
+	"show", "showc", "showr",
+	"hdu", "hdd", "Hdu", "Hdd", "ghdu", "ghdd",
+};
+
+/* -- check if a character is a regular PostScript character -- */
+static int regular(char c)
+{
+	return c != '\0' && !isspace((unsigned char) c)
+		&& !strchr("()<>[]{}/%", c);
+}
+
+/* -- output a token -- */
+static void put_tok(const char *s, int len, int brk)
+{
+	if (len <= 0)
+		return;
+	if (brk && last_c != '\0' && last_c != '\n') {
+		fputc('\n', fout);
+	} else if (regular(last_c) && regular(*s)) {
+		fputc(' ', fout);
+	}
+	fwrite(s, 1, len, fout);
+	last_c = s[len - 1];
+}
+
+/* -- output the operands without operator -- */
+static void put_nums(struct item *it)
+{
+	int i;
+
+	for (i = 0; i < it->nnum; i++)
+		put_tok(it->num[i], strlen(it->num[i]), i == 0 && it->nl);
+	it->nnum = 0;
+}
+
+/* -- output an item -- */
+static void put_item(struct item *it)
+{
+	int brk;
+
+	brk = it->nl && it->nnum == 0;
+	put_nums(it);
+	put_tok(it->op, strlen(it->op), brk);
+}
+
+/* -- shorten a number -- */
+static void num_short(char *d, const char *s, int len)
+{
+	char *p;
+	int i, neg;
+
+	neg = *s == '-';
+	if (neg || *s == '+') {
+		s++;
+		len--;
+	}
+	for (i = 0; i < len && i < NUMSZ - 2; i++)
+		d[i] = s[i];
+	d[i] = '\0';
+	if (strchr(d, '.')) {
+		p = d + strlen(d) - 1;
+		while (*p == '0')
+			*p-- = '\0';
+		if (*p == '.')
+			*p = '\0';
+	}
+	while (d[0] == '0' && d[1] != '\0')	/* "0.5" -> ".5" */
+		memmove(d, d + 1, strlen(d));
+	if (d[0] == '\0' || strcmp(d, "0") == 0) {
+		strcpy(d, "0");
+		return;
+	}
+	if (neg) {
+		memmove(d + 1, d, strlen(d) + 1);
+		d[0] = '-';
+	}
+}
+
+/* -- output the held item -- */
+static void flush_held(void)
+{
+	if (!has_held)
+		return;
+	has_held = 0;
+	if (strcmp(held.op, "T") == 0
+	 && strcmp(held.num[0], "0") == 0
+	 && strcmp(held.num[1], "0") == 0) {
+		nl |= held.nl;			/* null translation */
+		return;
+	}
+	put_item(&held);
+}
+
+/* -- check if an operator may be merged with the next one -- */
+static int holdable(char *op)
+{
+	unsigned i;
+
+	if (strcmp(op, "T") == 0 || strcmp(op, "M") == 0)
+		return 1;
+	for (i = 0; i < NFOLD; i++) {
+		if (strcmp(op, fold_tb[i].head) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+/* -- treat an operator -- */
+static void do_op(void)
+{
+	unsigned i;
+
+	if (has_held) {
+		if (strcmp(held.op, "T") == 0 && strcmp(cur.op, "T") == 0
+		 && cur.nnum == 2) {
+			char tmp[64];
+
+			sprintf(tmp, "%.4f", atof(held.num[0]) + atof(cur.num[0]));
+			num_short(held.num[0], tmp, strlen(tmp));
+			sprintf(tmp, "%.4f", atof(held.num[1]) + atof(cur.num[1]));
+			num_short(held.num[1], tmp, strlen(tmp));
+			cur.nnum = 0;
+			return;
+		}
+		if (strcmp(held.op, "M") == 0 && strcmp(cur.op, "M") == 0
+		 && cur.nnum == 2) {
+			cur.nl |= held.nl;	/* useless move */
+			has_held = 0;
+		} else if (cur.nnum == 1) {
+			for (i = 0; i < NFOLD; i++) {
+				if (strcmp(held.op, fold_tb[i].head) == 0
+				 && strcmp(cur.op, fold_tb[i].stem) == 0)
+					break;
+			}
+			if (i < NFOLD) {	/* head and stem */
+				strcpy(held.num[2], held.num[1]);
+				strcpy(held.num[1], held.num[0]);
+				strcpy(held.num[0], cur.num[0]);
+				held.nnum = 3;
+				strcpy(held.op, fold_tb[i].name);
+				has_held = 0;
+				put_item(&held);
+				cur.nnum = 0;
+				return;
+			}
+		}
+		flush_held();
+	}
+
+	/* font selection */
+	if (cur.op[0] == 'F' && isdigit((unsigned char) cur.op[1])
+	 && cur.nnum >= 1) {
+		char font[sizeof cur_font];
+
+		snprintf(font, sizeof font, "%s %s",
+			cur.num[cur.nnum - 1], cur.op);
+		if (strcmp(font, cur_font) == 0) {	/* same font */
+			cur.nnum--;
+			put_nums(&cur);
+			nl |= cur.nl;
+			return;
+		}
+		strcpy(cur_font, font);
+	} else {
+		for (i = 0; i < sizeof keep_font / sizeof keep_font[0]; i++) {
+			if (strcmp(cur.op, keep_font[i]) == 0)
+				break;
+		}
+		if (i >= sizeof keep_font / sizeof keep_font[0])
+			cur_font[0] = '\0';
+	}
+
+	/* keep the item if it may be merged with the next one */
+	if (cur.nnum == 2 && holdable(cur.op)) {
+		memcpy(&held, &cur, sizeof held);
+		has_held = 1;
+		cur.nnum = 0;
+		return;
+	}
+	put_item(&cur);
+}
+
+/* -- output a token which is not an operator of the top level -- */
+static void put_other(const char *s, int len)
+{
+	flush_held();
+	put_nums(&cur);
+	put_tok(s, len, nl);
+	nl = 0;
+}
+
+/* -- compact and output PostScript code -- */
+void ps_compact(char *p, int len)
+{
+	char *end, *q, tmp[NUMSZ];
+	int n;
+
+	end = p + len;
+	while (p < end) {
+		if (isspace((unsigned char) *p)) {
+			if (*p == '\n')
+				nl = 1;
+			p++;
+			continue;
+		}
+		q = p;
+		switch (*p) {
+		case '%':
+			while (q < end && *q != '\n')
+				q++;
+			if (p[1] == '%') {		/* DSC comment */
+				put_other(p, q - p);
+				fputc('\n', fout);
+				last_c = '\n';
+			}
+			p = q;
+			continue;
+		case '(':
+			n = 0;
+			while (q < end) {
+				if (*q == '\\')
+					q++;
+				else if (*q == '(')
+					n++;
+				else if (*q == ')' && --n == 0)
+					break;
+				q++;
+			}
+			if (q < end)
+				q++;
+			put_other(p, q - p);
+			p = q;
+			continue;
+		case '<':
+			if (p + 1 < end && p[1] == '<') {
+				q += 2;
+			} else {
+				while (q < end && *q != '>')
+					q++;
+				if (q < end)
+					q++;
+			}
+			put_other(p, q - p);
+			p = q;
+			continue;
+		case '>':
+			q += p + 1 < end && p[1] == '>' ? 2 : 1;
+			put_other(p, q - p);
+			p = q;
+			continue;
+		case '{':
+			put_other(p, 1);
+			depth++;
+			p++;
+			continue;
+		case '}':
+			put_other(p, 1);
+			if (depth > 0)
+				depth--;
+			p++;
+			continue;
+		case '[':
+		case ']':
+			put_other(p, 1);
+			p++;
+			continue;
+		case '/':
+			q++;
+			break;
+		}
+		while (q < end && regular(*q))
+			q++;
+
+		/* number */
+		n = p[0] == '-' || p[0] == '+';
+		if (p + n < q && (isdigit((unsigned char) p[n]) || p[n] == '.')
+		 && strspn(p + n, "0123456789.") == (unsigned) (q - p - n)
+		 && q - p < NUMSZ) {
+			num_short(tmp, p, q - p);
+			if (depth > 0) {
+				put_other(tmp, strlen(tmp));
+			} else {
+				if (cur.nnum >= MAXNUM) {
+					flush_held();
+					put_tok(cur.num[0], strlen(cur.num[0]),
+						cur.nl);
+					memmove(cur.num[0], cur.num[1],
+						(MAXNUM - 1) * NUMSZ);
+					cur.nnum--;
+					cur.nl = 0;
+				}
+				if (cur.nnum == 0) {
+					cur.nl = nl;
+					nl = 0;
+				}
+				strcpy(cur.num[cur.nnum++], tmp);
+			}
+			p = q;
+			continue;
+		}
+
+		/* name or operator */
+		if (*p == '/' || depth > 0
+		 || q - p >= (int) sizeof cur.op) {
+			put_other(p, q - p);
+		} else {
+			if (cur.nnum == 0) {
+				cur.nl = nl;
+				nl = 0;
+			}
+			memcpy(cur.op, p, q - p);
+			cur.op[q - p] = '\0';
+			do_op();
+		}
+		p = q;
+	}
+}
+
+/* -- formatted output of PostScript code (output function) -- */
+int ps_cprintf(FILE *out, const char *fmt, ...)
+{
+	static char *buf;
+	static int buf_sz;
+	va_list args;
+	int l;
+
+	va_start(args, fmt);
+	l = vsnprintf(buf, buf_sz, fmt, args);
+	va_end(args);
+	if (l >= buf_sz) {
+		buf_sz = l + 256;
+		buf = realloc(buf, buf_sz);
+		if (!buf) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+		va_start(args, fmt);
+		l = vsnprintf(buf, buf_sz, fmt, args);
+		va_end(args);
+	}
+	if (l > 0)
+		ps_compact(buf, l);
+	return l;
+}
+
+/* -- output the pending code -- */
+/* (before writing directly into the output file) */
+void ps_compact_flush(void)
+{
+	flush_held();
+	put_nums(&cur);
+	if (last_c != '\0' && last_c != '\n')
+		fputc('\n', fout);
+	last_c = '\0';
+	nl = 0;
+	depth = 0;
+	cur_font[0] = '\0';
+}
+
+/* -- define the procedures of the compact code -- */
+void ps_compact_init(void)
+{
+	unsigned i;
+
+	for (i = 0; i < NFOLD; i++)
+		fprintf(fout, "/%s{%s %s}!\n",
+			fold_tb[i].name, fold_tb[i].head, fold_tb[i].stem);
+	last_c = '\0';
+	has_held = 0;
+	cur.nnum = 0;
+	nl = 0;
+	depth = 0;
+	cur_font[0] = '\0';
+}
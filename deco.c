@@ -290,7 +290,7 @@ static void d_arp(struct deco_elt *de)
 	dd = &deco_def_tb[de->t];
 	xc = 0;
 	for (m = 0; m <= s->nhd; m++) {
-		if (s->as.u.note.accs[m])
+		if (s->as.u.note.hd[m].acc)
 			dx = 5 + s->shac[m];
 		else {
 			dx = 6 - s->shhd[m];
@@ -495,7 +495,7 @@ static void d_slide(struct deco_elt *de)
 	yc = s->pits[0];
 	xc = 5;
 	for (m = 0; m <= s->nhd; m++) {
-		if (s->as.u.note.accs[m])
+		if (s->as.u.note.hd[m].acc)
 			dx = 4 + s->shac[m];
 		else {
 			dx = 5 - s->shhd[m];
@@ -699,7 +699,7 @@ static unsigned char deco_build(char *text)
 	struct deco_def_s *dd;
 	int c_func, deco, h, o, wl, wr, n;
 	unsigned l, ps_x, strx;
-	char name[32];
+	char name[32], *dname;
 	char ps_func[16];
 
 	/* extract the arguments */
@@ -726,9 +726,10 @@ static unsigned char deco_build(char *text)
 		text++;
 
 	/* search the decoration */
+	dname = abc_intern(name);
 	for (deco = 1, dd = &deco_def_tb[1]; deco < 128; deco++, dd++) {
 		if (!dd->name
-		 || strcmp(dd->name, name) == 0)
+		 || dd->name == dname)
 			break;
 	}
 	if (deco == 128) {
@@ -779,7 +780,7 @@ static unsigned char deco_build(char *text)
 
 	/* set the values */
 	if (!dd->name)
-		dd->name = strdup(name);	/* new decoration */
+		dd->name = dname;		/* new decoration */
 	dd->func = c_func;
 	if (!ps_func_tb[ps_x]) {
 		if (ps_func[0] == '-' && ps_func[1] == '\0')
@@ -920,9 +921,9 @@ void deco_cnv(struct deco *dc,
 			prev->sflags &= ~S_BEAM_END;
 			s->u = prev->u = dd->name[4] - '0';
 			for (j = 0; j <= s->nhd; j++)
-				s->as.u.note.lens[j] *= 2;
+				s->as.u.note.hd[j].len *= 2;
 			for (j = 0; j <= prev->nhd; j++)
-				prev->as.u.note.lens[j] *= 2;
+				prev->as.u.note.hd[j].len *= 2;
 			break;
 		case 35:		/* 35 = xstem */
 			if (s->as.type != ABC_T_NOTE) {
@@ -1011,7 +1012,7 @@ unsigned char deco_intern(unsigned char deco)
 				deco = deco_define(name);
 			break;
 		}
-		if (strcmp(deco_def_tb[deco].name, name) == 0)
+		if (deco_def_tb[deco].name == name)
 			break;
 	}
 	if (deco == 128) {
@@ -1891,7 +1892,7 @@ static void draw_gchord(struct SYMBOL *s,
 			break;
 		case '<':			/* left */
 /*fixme: what symbol space?*/
-			if (s->as.u.note.accs[0])
+			if (s->as.u.note.hd[0].acc)
 				x -= s->shac[0];
 			y = s->yav + gch->y;
 			break;
@@ -1991,7 +1992,8 @@ void draw_measnb(void)
 			x = s->x - s->wl;
 			set_font(MEASUREFONT);
 			any_nb = 1;
-			w = cwid('0') * cfmt.font_tb[MEASUREFONT].size;
+			w = font_cwid(cfmt.font_tb[MEASUREFONT].fnum, '0')
+				* cfmt.font_tb[MEASUREFONT].size;
 			if (bar_num >= 10) {
 				if (bar_num >= 100)
 					w *= 3;
@@ -2040,7 +2042,8 @@ void draw_measnb(void)
 			any_nb = 1;
 			set_font(MEASUREFONT);
 		}
-		w = cwid('0') * cfmt.font_tb[MEASUREFONT].size;
+		w = font_cwid(cfmt.font_tb[MEASUREFONT].fnum, '0')
+			* cfmt.font_tb[MEASUREFONT].size;
 		if (bar_num >= 10) {
 			if (bar_num >= 100)
 				w *= 3;
@@ -2156,21 +2159,22 @@ float tempo_width(struct SYMBOL *s)
 	float w;
 
 	w = 0;
-	if (s->as.u.tempo.str1)
-		w += tex_str(s->as.u.tempo.str1);
-	if (s->as.u.tempo.value != 0) {
+	if (s->as.u.tempo->str1)
+		w += tex_str(s->as.u.tempo->str1);
+	if (s->as.u.tempo->value != 0) {
 		i = 1;
-		while (i < sizeof s->as.u.tempo.length
-				/ sizeof s->as.u.tempo.length[0]
-		       && s->as.u.tempo.length[i] > 0) {
+		while (i < sizeof s->as.u.tempo->length
+				/ sizeof s->as.u.tempo->length[0]
+		       && s->as.u.tempo->length[i] > 0) {
 			w += 10;
 			i++;
 		}
-		w += 6 + cwid(' ') * cfmt.font_tb[TEMPOFONT].size * 6
+		w += 6 + font_cwid(cfmt.font_tb[TEMPOFONT].fnum, ' ')
+				* cfmt.font_tb[TEMPOFONT].size * 6
 			+ 10 + 10;
 	}
-	if (s->as.u.tempo.str2)
-		w += tex_str(s->as.u.tempo.str2);
+	if (s->as.u.tempo->str2)
+		w += tex_str(s->as.u.tempo->str2);
 	return w;
 }
 
@@ -2182,32 +2186,32 @@ void write_tempo(struct SYMBOL *s,
 	int top, bot;
 	unsigned j;
 
-	if (s->as.u.tempo.str1)
-		put_str(s->as.u.tempo.str1, A_LEFT);
-	if (s->as.u.tempo.value != 0) {
+	if (s->as.u.tempo->str1)
+		put_str(s->as.u.tempo->str1, A_LEFT);
+	if (s->as.u.tempo->value != 0) {
 		sc *= 0.7 * cfmt.font_tb[TEMPOFONT].size / 15.0;
 						/*fixme: 15.0 = initial tempofont*/
-		if (s->as.u.tempo.length[0] == 0) {
+		if (s->as.u.tempo->length[0] == 0) {
 			if (beat == 0)
 				beat = get_beat(&voice_tb[cursys->top_voice].meter);
-			s->as.u.tempo.length[0] = beat;
+			s->as.u.tempo->length[0] = beat;
 		}
 		for (j = 0;
-		     j < sizeof s->as.u.tempo.length
-				/ sizeof s->as.u.tempo.length[0]
-			&& s->as.u.tempo.length[j] > 0;
+		     j < sizeof s->as.u.tempo->length
+				/ sizeof s->as.u.tempo->length[0]
+			&& s->as.u.tempo->length[j] > 0;
 		     j++) {
-			draw_notempo(s, s->as.u.tempo.length[j], sc);
+			draw_notempo(s, s->as.u.tempo->length[j], sc);
 		}
 		put_str("= ", A_LEFT);
-		if (sscanf(s->as.u.tempo.value, "%d/%d", &top, &bot) == 2
+		if (sscanf(s->as.u.tempo->value, "%d/%d", &top, &bot) == 2
 		 && bot > 0)
 			draw_notempo(s, top * BASE_LEN / bot, sc);
 		else
-			put_str(s->as.u.tempo.value, A_LEFT);
+			put_str(s->as.u.tempo->value, A_LEFT);
 	}
-	if (s->as.u.tempo.str2)
-		put_str(s->as.u.tempo.str2, A_LEFT);
+	if (s->as.u.tempo->str2)
+		put_str(s->as.u.tempo->str2, A_LEFT);
 }
 
 /* -- draw the parts and the tempo information -- */
@@ -2267,7 +2271,7 @@ float draw_partempo(int staff, float top)
 			if (!(s->sflags & S_SEQST))
 				continue;
 			if (s->type == TIMESIG)
-				beat = get_beat(&s->as.u.meter);
+				beat = get_beat(s->as.u.meter);
 			g = s->extra;
 			if (!g)
 				continue;
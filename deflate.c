@@ -0,0 +1,463 @@
+/*
+ * Data compression (deflate, RFC 1951) with the zlib (RFC 1950)
+ * and gzip (RFC 1952) wrappers.
+ *
+ * The compression is LZ77 with hash chains and the fixed Huffman codes.
+ * This is not as good as the real zlib, but it is small and it is enough
+ * for the PNG images and the output files.
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define _GNU_SOURCE			/* for fopencookie() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "abc2ps.h"
+
+/* streams with user functions, for the compressed output files */
+#if defined(__GLIBC__)
+#define Z_COOKIE 1
+#elif defined(__APPLE__) || defined(__FreeBSD__) \
+   || defined(__NetBSD__) || defined(__OpenBSD__)
+#define Z_FUNOPEN 1
+#endif
+
+#define WSIZE 32768			/* window size */
+#define HBITS 15			/* hash table */
+#define HSIZE (1 << HBITS)
+#define MAXCHAIN 64			/* maximum search in a hash chain */
+#define MINMATCH 3
+#define MAXMATCH 258
+#define MAXINSERT 16			/* no hash insertion in longer matches */
+
+static unsigned char *obuf;		/* output buffer */
+static long olen, osz;
+static unsigned long bitbuf;		/* pending bits */
+static int nbits;
+
+static const unsigned short len_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const unsigned char len_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const unsigned short dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577
+};
+static const unsigned char dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/* -- CRC-32 (gzip and PNG) -- */
+unsigned long z_crc32(unsigned long crc, const unsigned char *p, long len)
+{
+	static unsigned long crc_tb[256];
+	unsigned long c;
+	int i, k;
+
+	if (crc_tb[1] == 0) {
+		for (i = 0; i < 256; i++) {
+			c = i;
+			for (k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crc_tb[i] = c;
+		}
+	}
+	crc ^= 0xffffffff;
+	while (--len >= 0)
+		crc = crc_tb[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+	return crc ^ 0xffffffff;
+}
+
+/* -- Adler-32 (zlib) -- */
+static unsigned long adler32(const unsigned char *p, long len)
+{
+	unsigned long a, b;
+	long n;
+
+	a = 1;
+	b = 0;
+	while (len > 0) {
+		n = len < 5552 ? len : 5552;
+		len -= n;
+		while (--n >= 0) {
+			a += *p++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+/* -- output a byte -- */
+static void put_byte(int c)
+{
+	if (olen >= osz) {
+		osz = osz * 2 + 4096;
+		obuf = realloc(obuf, osz);
+		if (!obuf) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	obuf[olen++] = c;
+}
+
+/* -- output a 32 bits value -- */
+static void put_32(unsigned long v, int msb)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		if (msb)
+			put_byte((v >> (24 - i * 8)) & 0xff);
+		else
+			put_byte((v >> (i * 8)) & 0xff);
+	}
+}
+
+/* -- output bits (LSB first) -- */
+static void put_bits(unsigned v, int n)
+{
+	bitbuf |= (unsigned long) v << nbits;
+	nbits += n;
+	while (nbits >= 8) {
+		put_byte(bitbuf & 0xff);
+		bitbuf >>= 8;
+		nbits -= 8;
+	}
+}
+
+/* -- output a Huffman code (MSB first) -- */
+static void put_code(unsigned code, int n)
+{
+	unsigned v;
+	int i;
+
+	v = 0;
+	for (i = 0; i < n; i++) {
+		v = (v << 1) | (code & 1);
+		code >>= 1;
+	}
+	put_bits(v, n);
+}
+
+/* -- output a literal or a length symbol with the fixed codes -- */
+static void put_sym(int c)
+{
+	if (c < 144)
+		put_code(0x30 + c, 8);
+	else if (c < 256)
+		put_code(0x190 + c - 144, 9);
+	else if (c < 280)
+		put_code(c - 256, 7);
+	else
+		put_code(0xc0 + c - 280, 8);
+}
+
+/* -- output a match -- */
+static void put_match(int len, int dist)
+{
+	int i;
+
+	for (i = 28; len_base[i] > len; i--)
+		;
+	put_sym(257 + i);
+	if (len_extra[i])
+		put_bits(len - len_base[i], len_extra[i]);
+	for (i = 29; dist_base[i] > dist; i--)
+		;
+	put_code(i, 5);
+	if (dist_extra[i])
+		put_bits(dist - dist_base[i], dist_extra[i]);
+}
+
+/* -- compress data (raw deflate) -- */
+static void deflate_raw(const unsigned char *p, long len)
+{
+	static int head[HSIZE];
+	int *prev;
+	long i, j, m, best, best_d, lim;
+	unsigned h;
+	int n;
+
+	prev = malloc(WSIZE * sizeof *prev);
+	if (!prev) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < HSIZE; i++)
+		head[i] = -1;
+	put_bits(1, 1);				/* last block */
+	put_bits(1, 2);				/* fixed Huffman codes */
+	i = 0;
+	while (i < len) {
+		best = 0;
+		best_d = 0;
+		if (i + MINMATCH <= len) {
+			h = ((p[i] << 10) ^ (p[i + 1] << 5) ^ p[i + 2])
+					& (HSIZE - 1);
+			lim = len - i < MAXMATCH ? len - i : MAXMATCH;
+			n = MAXCHAIN;
+			for (j = head[h]; j >= 0 && i - j <= WSIZE - 1 && --n >= 0;
+			     j = prev[j & (WSIZE - 1)]) {
+				if (p[j + best] != p[i + best])
+					continue;
+				for (m = 0; m < lim && p[j + m] == p[i + m]; m++)
+					;
+				if (m > best) {
+					best = m;
+					best_d = i - j;
+					if (m >= lim)
+						break;
+				}
+			}
+			prev[i & (WSIZE - 1)] = head[h];
+			head[h] = i;
+		}
+		if (best < MINMATCH) {
+			put_sym(p[i]);
+			i++;
+			continue;
+		}
+		put_match(best, best_d);
+		if (best > MAXINSERT) {
+			i += best;
+			continue;
+		}
+
+		/* insert the strings of the match into the hash chains */
+		for (m = 1; m < best; m++) {
+			i++;
+			if (i + MINMATCH > len)
+				continue;
+			h = ((p[i] << 10) ^ (p[i + 1] << 5) ^ p[i + 2])
+					& (HSIZE - 1);
+			prev[i & (WSIZE - 1)] = head[h];
+			head[h] = i;
+		}
+		i++;
+	}
+	put_sym(256);				/* end of block */
+	if (nbits > 0)
+		put_bits(0, 8 - nbits);
+	free(prev);
+}
+
+/* -- compress a buffer -- */
+/* the result is in an allocated buffer */
+unsigned char *z_deflate(const unsigned char *p, long len,
+			long *p_olen, int fmt)
+{
+	obuf = NULL;
+	olen = osz = 0;
+	bitbuf = 0;
+	nbits = 0;
+	if (fmt == Z_GZIP) {
+		put_byte(0x1f);
+		put_byte(0x8b);
+		put_byte(8);			/* deflate */
+		put_byte(0);			/* no flags */
+		put_32(0, 0);			/* no time */
+		put_byte(0);
+		put_byte(3);			/* Unix */
+	} else {
+		put_byte(0x78);
+		put_byte(0x01);
+	}
+	deflate_raw(p, len);
+	if (fmt == Z_GZIP) {
+		put_32(z_crc32(0, p, len), 0);
+		put_32(len, 0);
+	} else {
+		put_32(adler32(p, len), 1);
+	}
+	*p_olen = olen;
+	return obuf;
+}
+
+/*
+ * compressed output files (.gz / .svgz)
+ *
+ * The data are compressed by chunks, each chunk being a gzip member.
+ * The gzip programs and libraries handle such multi-member files.
+ * When the system has no user defined streams, the data go to a
+ * temporary file which is compressed when closed.
+ */
+#define ZCHUNK (1024 * 1024)		/* size of the gzip members */
+
+struct zfile {
+	FILE *f;			/* compressed file */
+	unsigned char *buf;		/* data to compress */
+	long len;
+	long olen;			/* size of the compressed data */
+	long size;			/* size of the uncompressed data */
+	FILE *zf;			/* compressed stream */
+};
+static long z_olen;			/* size of the last closed file */
+static struct zfile *z_cur;		/* (only one file at a time) */
+
+/* -- compress the pending data as a gzip member -- */
+static void zf_member(struct zfile *z)
+{
+	unsigned char *p;
+	long l;
+
+	p = z_deflate(z->buf, z->len, &l, Z_GZIP);
+	fwrite(p, 1, l, z->f);
+	free(p);
+	z->olen += l;
+	z->len = 0;
+}
+
+/* -- add data to a compressed file -- */
+static long zf_write(struct zfile *z, const char *p, long n)
+{
+	long l, r;
+
+	r = n;
+	z->size += n;
+	while (n > 0) {
+		l = ZCHUNK - z->len;
+		if (l > n)
+			l = n;
+		memcpy(z->buf + z->len, p, l);
+		z->len += l;
+		p += l;
+		n -= l;
+		if (z->len >= ZCHUNK)
+			zf_member(z);
+	}
+	return r;
+}
+
+/* -- close a compressed file -- */
+static int zf_close(struct zfile *z)
+{
+	int r;
+
+	if (z->len > 0 || z->olen == 0)
+		zf_member(z);
+	r = ferror(z->f) ? -1 : 0;
+	if (z->f != stdout) {
+		if (fclose(z->f) != 0)
+			r = -1;
+	} else {
+		fflush(z->f);
+	}
+	z_olen = z->olen;
+	if (z_cur == z)
+		z_cur = NULL;
+	free(z->buf);
+	free(z);
+	return r;
+}
+
+#ifdef Z_COOKIE
+static ssize_t ck_write(void *c, const char *p, size_t n)
+{
+	return zf_write(c, p, n);
+}
+static int ck_close(void *c)
+{
+	return zf_close(c);
+}
+#endif
+#ifdef Z_FUNOPEN
+static int fn_write(void *c, const char *p, int n)
+{
+	return zf_write(c, p, n);
+}
+static int fn_close(void *c)
+{
+	return zf_close(c);
+}
+#endif
+
+/* -- open a compressed output stream to a file -- */
+FILE *z_open(FILE *f)
+{
+	struct zfile *z;
+	FILE *zf;
+
+	z = malloc(sizeof *z);
+	if (z)
+		z->buf = malloc(ZCHUNK);
+	if (!z || !z->buf) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	z->f = f;
+	z->len = z->olen = z->size = 0;
+	z_cur = z;
+#if defined(Z_COOKIE)
+	{
+		cookie_io_functions_t io = {NULL, ck_write, NULL, ck_close};
+
+		zf = fopencookie(z, "w", io);
+	}
+#elif defined(Z_FUNOPEN)
+	zf = funopen(z, NULL, fn_write, NULL, fn_close);
+#else
+	zf = tmpfile();
+#endif
+	if (!zf) {
+		error(1, 0, "Cannot create the compressed stream - abort");
+		exit(EXIT_FAILURE);
+	}
+	z->zf = zf;
+	return zf;
+}
+
+/* -- close a compressed output stream -- */
+/* return the size of the compressed data or -1 on write error */
+long z_close(FILE *zf)
+{
+	int r;
+#if !defined(Z_COOKIE) && !defined(Z_FUNOPEN)
+	char buf[BUFSIZ];
+	int n;
+
+	rewind(zf);
+	while ((n = fread(buf, 1, sizeof buf, zf)) > 0)
+		zf_write(z_cur, buf, n);
+	fclose(zf);
+	r = zf_close(z_cur);
+#else
+	r = fclose(zf);
+#endif
+	return r != 0 ? -1 : z_olen;
+}
+
+/* -- get the size of the data written to a compressed stream -- */
+long z_tell(FILE *zf)
+{
+#if defined(Z_COOKIE) || defined(Z_FUNOPEN)
+	if (z_cur && z_cur->zf == zf) {
+		fflush(zf);
+		return z_cur->size;
+	}
+#endif
+	return ftell(zf);
+}
@@ -0,0 +1,1515 @@
+/*
+ * Display list.
+ *
+ * The music is laid out and drawn once by the PostScript interpreter of
+ * svg.c, as with '-v'. The SVG image of each page (or tune with '-g')
+ * is then translated into a display list: the drawing operations in the
+ * syntax of the PDF content streams, the symbols of the SVG <defs>
+ * (called by the 'Do' operation), the used fonts and the start of the
+ * music lines. The PDF and PNG backends work from this list, so that
+ * they share the layout of the SVG output.
+ * The PostScript output is not built from this list: the PostScript
+ * code of the SVG pages differs from the one of the PostScript files
+ * (texts, fonts, user PostScript).
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "abc2ps.h"
+
+struct DLIST dl;			/* display list of the current page */
+
+/* growing buffer */
+struct buf_s {
+	char *p;
+	int len, sz;
+};
+
+static char *font_tb[DL_NFONTS] = {	/* standard PDF fonts */
+	"Times-Roman", "Times-Bold", "Times-Italic", "Times-BoldItalic",
+	"Helvetica", "Helvetica-Bold", "Helvetica-Oblique",
+		"Helvetica-BoldOblique",
+	"Courier", "Courier-Bold", "Courier-Oblique", "Courier-BoldOblique",
+	"Symbol", "ZapfDingbats",
+};
+
+static long *mark_tb;			/* start of the music lines (SVG) */
+static int nmarks, mark_sz;
+static int line_sz;
+
+/* SVG translation */
+#define P_NONE -1			/* paint */
+#define P_CURRENT -2
+static struct style {			/* inherited properties */
+	int fill, stroke;
+	int family;			/* 0: Times, 1: Helvetica, 2: Courier.. */
+	char fname[64];			/* font family name */
+	char bold, italic;
+	float size;
+} style;
+
+enum elt_type {
+	E_OTHER, E_SKIP, E_G, E_DEFS, E_TEXT, E_TSPAN
+};
+#define MAXDEPTH 32
+static struct elt_s {			/* open elements */
+	char type;
+	char q;				/* 'q' output */
+	struct style style;		/* style of the parent */
+	struct buf_s *out;		/* output of the parent (defs) */
+	char *name;			/* symbol name (defs) */
+} elt_tb[MAXDEPTH];
+static int depth;
+
+static struct buf_s page_buf;		/* page operations */
+static struct buf_s form_buf;		/* symbol operations */
+static struct buf_s *out;		/* current output */
+static float page_w, page_h;
+
+#define MAXRUNS 64
+static struct run_s {			/* text runs (<text> and <tspan>) */
+	int font;			/* standard font */
+	int tfont;			/* TrueType font (dl.tfonts), -1 if none */
+	float size, dx;
+	int start, len;
+} run_tb[MAXRUNS];
+static int nruns;
+static int run_txt[1024];		/* (unicode) */
+static int run_len;
+static float text_x, text_y, text_len;
+static char text_anchor;
+static char text_cjk;			/* CJK font of the text */
+
+static struct {				/* CJK fonts of the PDF viewers */
+	char *name, *cmap, *ordering;
+	int supplement;
+} cjk_tb[3] = {
+	{"STSong-Light", "UniGB-UCS2-H", "GB1", 4},
+	{"HeiseiMin-W3", "UniJIS-UCS2-H", "Japan1", 2},
+	{"HYSMyeongJo-Medium", "UniKS-UCS2-H", "Korea1", 1},
+};
+
+#define MAXATTR 16
+static char *attr_n[MAXATTR], *attr_v[MAXATTR];
+static int nattr;
+
+/* -- out of memory -- */
+static void dl_oom(void)
+{
+	fprintf(stderr, "Out of memory.\n");
+	exit(EXIT_FAILURE);
+}
+
+/* -- add data to a buffer -- */
+static void b_write(struct buf_s *b, const char *p, int len)
+{
+	if (b->len + len >= b->sz) {
+		b->sz = (b->len + len) * 2 + 4096;
+		b->p = realloc(b->p, b->sz);
+		if (!b->p)
+			dl_oom();
+	}
+	memcpy(b->p + b->len, p, len);
+	b->len += len;
+}
+
+/* -- formatted output to a buffer -- */
+static void b_printf(struct buf_s *b, const char *fmt, ...)
+{
+	va_list args;
+	char tmp[256];
+	int l;
+
+	va_start(args, fmt);
+	l = vsnprintf(tmp, sizeof tmp, fmt, args);
+	va_end(args);
+	if (l >= (int) sizeof tmp)
+		l = sizeof tmp - 1;
+	b_write(b, tmp, l);
+}
+
+/* -- get a symbol -- */
+struct DLSYM *dl_sym(char *name)
+{
+	struct DLSYM *x;
+
+	for (x = dl.syms; x; x = x->next) {
+		if (strcmp(x->name, name) == 0)
+			return x;
+	}
+	return NULL;
+}
+
+/* -- output a name (PDF syntax) -- */
+static void b_name(struct buf_s *b, char *name)
+{
+	b_write(b, "/", 1);
+	for (; *name != '\0'; name++) {
+		if (isalnum((unsigned char) *name))
+			b_write(b, name, 1);
+		else
+			b_printf(b, "#%02x", (unsigned char) *name);
+	}
+}
+
+/* -- get an attribute value -- */
+static char *attr(char *name)
+{
+	int i;
+
+	for (i = 0; i < nattr; i++) {
+		if (strcmp(attr_n[i], name) == 0)
+			return attr_v[i];
+	}
+	return NULL;
+}
+
+/* -- get a numeric attribute value -- */
+static float attr_f(char *name, float ref)
+{
+	char *p, *q;
+	float v;
+
+	p = attr(name);
+	if (!p)
+		return 0;
+	v = strtod(p, &q);
+	if (*q == '%')
+		v = v * ref / 100;
+	else if (q[0] == 'i' && q[1] == 'n')
+		v *= 72;
+	return v;
+}
+
+/* -- get a color (RGB or P_xxx) -- */
+static int color(char *p)
+{
+	static struct {
+		char *n;
+		int rgb;
+	} col_tb[] = {
+		{"black", 0}, {"white", 0xffffff}, {"red", 0xff0000},
+		{"green", 0x008000}, {"blue", 0x0000ff}, {"gray", 0x808080},
+		{"grey", 0x808080}, {"yellow", 0xffff00},
+	};
+	unsigned i;
+	int rgb;
+
+	while (isspace((unsigned char) *p))
+		p++;
+	if (strncmp(p, "none", 4) == 0)
+		return P_NONE;
+	if (*p == '#') {
+		rgb = strtol(p + 1, NULL, 16);
+		if (strspn(p + 1, "0123456789abcdefABCDEF") == 3)
+			rgb = ((rgb & 0xf00) << 12) | ((rgb & 0xf00) << 8)
+				| ((rgb & 0xf0) << 8) | ((rgb & 0xf0) << 4)
+				| ((rgb & 0xf) << 4) | (rgb & 0xf);
+		return rgb;
+	}
+	for (i = 0; i < sizeof col_tb / sizeof col_tb[0]; i++) {
+		if (strncmp(p, col_tb[i].n, strlen(col_tb[i].n)) == 0)
+			return col_tb[i].rgb;
+	}
+	return P_CURRENT;			/* 'currentColor' */
+}
+
+/* -- output a color -- */
+static void b_color(int rgb, char *op)
+{
+	b_printf(out, "%.3g %.3g %.3g %s\n",
+		(rgb >> 16) / 255., ((rgb >> 8) & 0xff) / 255.,
+		(rgb & 0xff) / 255., op);
+}
+
+/* -- output a transform attribute -- */
+static void transform(char *p)
+{
+	char fn[16];
+	float v[6];
+	int i, n;
+
+	for (;;) {
+		while (isspace((unsigned char) *p) || *p == ',')
+			p++;
+		for (i = 0; isalpha((unsigned char) *p); p++) {
+			if (i < (int) sizeof fn - 1)
+				fn[i++] = *p;
+		}
+		fn[i] = '\0';
+		if (i == 0 || *p != '(')
+			break;
+		p++;
+		for (n = 0; n < 6; n++) {
+			while (isspace((unsigned char) *p) || *p == ',')
+				p++;
+			if (*p == ')')
+				break;
+			v[n] = strtod(p, &p);
+		}
+		p = strchr(p, ')');
+		if (!p)
+			break;
+		p++;
+		if (strcmp(fn, "translate") == 0) {
+			if (n < 2)
+				v[1] = 0;
+			b_printf(out, "1 0 0 1 %.2f %.2f cm\n", v[0], v[1]);
+		} else if (strcmp(fn, "scale") == 0) {
+			if (n < 2)
+				v[1] = v[0];
+			b_printf(out, "%.4f 0 0 %.4f 0 0 cm\n", v[0], v[1]);
+		} else if (strcmp(fn, "rotate") == 0) {
+			float a, c, s;
+
+			if (n >= 3)
+				b_printf(out, "1 0 0 1 %.2f %.2f cm\n",
+					v[1], v[2]);
+			a = v[0] * M_PI / 180;
+			c = cos(a);
+			s = sin(a);
+			b_printf(out, "%.4f %.4f %.4f %.4f 0 0 cm\n",
+				c, s, -s, c);
+			if (n >= 3)
+				b_printf(out, "1 0 0 1 %.2f %.2f cm\n",
+					-v[1], -v[2]);
+		} else if (strcmp(fn, "matrix") == 0 && n == 6) {
+			b_printf(out, "%.4f %.4f %.4f %.4f %.2f %.2f cm\n",
+				v[0], v[1], v[2], v[3], v[4], v[5]);
+		}
+	}
+}
+
+/* -- output a SVG arc as Bezier curves -- */
+static void arc(float x1, float y1, float rx, float ry, float phi,
+		int large, int sweep, float x2, float y2)
+{
+	double c, s, dx, dy, x1p, y1p, l, num, den, coef, cxp, cyp, cx, cy;
+	double t1, dt, t, a1, a2, ux, uy, vx, vy;
+	double p[6];
+	int i, j, n;
+
+	rx = fabs(rx);
+	ry = fabs(ry);
+	if (rx == 0 || ry == 0) {
+		b_printf(out, "%.2f %.2f l\n", x2, y2);
+		return;
+	}
+	c = cos(phi * M_PI / 180);
+	s = sin(phi * M_PI / 180);
+	dx = (x1 - x2) / 2;
+	dy = (y1 - y2) / 2;
+	x1p = c * dx + s * dy;
+	y1p = -s * dx + c * dy;
+	l = x1p * x1p / (rx * rx) + y1p * y1p / (ry * ry);
+	if (l > 1) {
+		rx *= sqrt(l);
+		ry *= sqrt(l);
+	}
+	num = rx * rx * ry * ry - rx * rx * y1p * y1p - ry * ry * x1p * x1p;
+	den = rx * rx * y1p * y1p + ry * ry * x1p * x1p;
+	coef = den == 0 || num < 0 ? 0 : sqrt(num / den);
+	if (large == sweep)
+		coef = -coef;
+	cxp = coef * rx * y1p / ry;
+	cyp = -coef * ry * x1p / rx;
+	cx = c * cxp - s * cyp + (x1 + x2) / 2;
+	cy = s * cxp + c * cyp + (y1 + y2) / 2;
+
+	ux = (x1p - cxp) / rx;
+	uy = (y1p - cyp) / ry;
+	vx = (-x1p - cxp) / rx;
+	vy = (-y1p - cyp) / ry;
+	t1 = atan2(uy, ux);
+	dt = atan2(ux * vy - uy * vx, ux * vx + uy * vy);
+	if (!sweep && dt > 0)
+		dt -= 2 * M_PI;
+	else if (sweep && dt < 0)
+		dt += 2 * M_PI;
+
+	/* one Bezier curve per quarter of ellipse */
+	n = ceil(fabs(dt) / (M_PI / 2) - 0.001);
+	if (n < 1)
+		n = 1;
+	dt /= n;
+	t = 4. / 3 * tan(dt / 4);
+	for (i = 0; i < n; i++) {
+		a1 = t1 + i * dt;
+		a2 = a1 + dt;
+		p[0] = cos(a1) - t * sin(a1);
+		p[1] = sin(a1) + t * cos(a1);
+		p[2] = cos(a2) + t * sin(a2);
+		p[3] = sin(a2) - t * cos(a2);
+		p[4] = cos(a2);
+		p[5] = sin(a2);
+		for (j = 0; j < 6; j += 2) {
+			ux = p[j] * rx;
+			uy = p[j + 1] * ry;
+			p[j] = cx + c * ux - s * uy;
+			p[j + 1] = cy + s * ux + c * uy;
+		}
+		b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+			p[0], p[1], p[2], p[3], p[4], p[5]);
+	}
+}
+
+/* -- output an ellipse -- */
+static void ellipse(float cx, float cy, float rx, float ry)
+{
+	float kx, ky;
+
+	kx = rx * 0.5523;
+	ky = ry * 0.5523;
+	b_printf(out, "%.2f %.2f m\n", cx + rx, cy);
+	b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+		cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry);
+	b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+		cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy);
+	b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+		cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry);
+	b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c h\n",
+		cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy);
+}
+
+/* -- output the SVG path data -- */
+static void path_d(char *d)
+{
+	float a[7], x, y, x0, y0, cx, cy;
+	char cmd, last, *q;
+	int i, n, rel;
+
+	x = y = x0 = y0 = cx = cy = 0;
+	cmd = last = 0;
+	for (;;) {
+		while (isspace((unsigned char) *d) || *d == ',')
+			d++;
+		if (*d == '\0')
+			break;
+		if (isalpha((unsigned char) *d))
+			cmd = *d++;
+		else if (cmd == 0)
+			break;
+		switch (toupper((unsigned char) cmd)) {
+		case 'Z':
+			b_printf(out, "h\n");
+			x = x0;
+			y = y0;
+			last = 'Z';
+			cmd = 0;
+			continue;
+		case 'H':
+		case 'V':
+			n = 1;
+			break;
+		case 'C':
+			n = 6;
+			break;
+		case 'S':
+		case 'Q':
+			n = 4;
+			break;
+		case 'A':
+			n = 7;
+			break;
+		default:			/* M L T */
+			n = 2;
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			while (isspace((unsigned char) *d) || *d == ',')
+				d++;
+			a[i] = strtod(d, &q);
+			if (q == d)
+				return;		/* bad path */
+			d = q;
+		}
+		rel = islower((unsigned char) cmd);
+		switch (toupper((unsigned char) cmd)) {
+		case 'M':
+			if (rel) {
+				a[0] += x;
+				a[1] += y;
+			}
+			b_printf(out, "%.2f %.2f m\n", a[0], a[1]);
+			x = x0 = a[0];
+			y = y0 = a[1];
+			cmd = rel ? 'l' : 'L';	/* next pairs are lines */
+			break;
+		case 'L':
+		case 'T':
+			if (rel) {
+				a[0] += x;
+				a[1] += y;
+			}
+			b_printf(out, "%.2f %.2f l\n", a[0], a[1]);
+			x = a[0];
+			y = a[1];
+			break;
+		case 'H':
+			x = rel ? x + a[0] : a[0];
+			b_printf(out, "%.2f %.2f l\n", x, y);
+			break;
+		case 'V':
+			y = rel ? y + a[0] : a[0];
+			b_printf(out, "%.2f %.2f l\n", x, y);
+			break;
+		case 'C':
+			if (rel) {
+				for (i = 0; i < 6; i += 2) {
+					a[i] += x;
+					a[i + 1] += y;
+				}
+			}
+			b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+				a[0], a[1], a[2], a[3], a[4], a[5]);
+			cx = a[2];
+			cy = a[3];
+			x = a[4];
+			y = a[5];
+			break;
+		case 'S':
+			if (rel) {
+				for (i = 0; i < 4; i += 2) {
+					a[i] += x;
+					a[i + 1] += y;
+				}
+			}
+			if (last != 'C' && last != 'S') {
+				cx = x;
+				cy = y;
+			}
+			b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+				2 * x - cx, 2 * y - cy, a[0], a[1], a[2], a[3]);
+			cx = a[0];
+			cy = a[1];
+			x = a[2];
+			y = a[3];
+			break;
+		case 'Q':
+			if (rel) {
+				for (i = 0; i < 4; i += 2) {
+					a[i] += x;
+					a[i + 1] += y;
+				}
+			}
+			b_printf(out, "%.2f %.2f %.2f %.2f %.2f %.2f c\n",
+				x + (a[0] - x) * 2 / 3, y + (a[1] - y) * 2 / 3,
+				a[2] + (a[0] - a[2]) * 2 / 3,
+				a[3] + (a[1] - a[3]) * 2 / 3,
+				a[2], a[3]);
+			x = a[2];
+			y = a[3];
+			break;
+		case 'A':
+			if (rel) {
+				a[5] += x;
+				a[6] += y;
+			}
+			arc(x, y, a[0], a[1], a[2], a[3] != 0, a[4] != 0,
+				a[5], a[6]);
+			x = a[5];
+			y = a[6];
+			break;
+		}
+		last = toupper((unsigned char) cmd);
+	}
+}
+
+/* -- start drawing an element -- */
+/* return 1 if the graphic state is saved */
+static int draw_begin(int *fill, int *stroke)
+{
+	char *p;
+	int q;
+
+	q = 0;
+	*fill = style.fill;
+	*stroke = style.stroke;
+	if ((p = attr("fill")) != NULL)
+		*fill = color(p);
+	if ((p = attr("stroke")) != NULL)
+		*stroke = color(p);
+	if ((p = attr("transform")) != NULL) {
+		b_printf(out, "q\n");
+		q = 1;
+		transform(p);
+	}
+	if (*fill >= 0 || *stroke >= 0
+	 || attr("stroke-width") || attr("stroke-dasharray")
+	 || attr("stroke-linecap")) {
+		if (!q) {
+			b_printf(out, "q\n");
+			q = 1;
+		}
+		if (*fill >= 0)
+			b_color(*fill, "rg");
+		if (*stroke >= 0)
+			b_color(*stroke, "RG");
+		if ((p = attr("stroke-width")) != NULL)
+			b_printf(out, "%.2f w\n", atof(p));
+		if ((p = attr("stroke-dasharray")) != NULL) {
+			b_printf(out, "[");
+			while (*p != '\0') {
+				if (*p == ',')
+					b_write(out, " ", 1);
+				else
+					b_write(out, p, 1);
+				p++;
+			}
+			b_printf(out, "] 0 d\n");
+		}
+		if ((p = attr("stroke-linecap")) != NULL)
+			b_printf(out, "%d J\n", strcmp(p, "round") == 0 ? 1
+						: strcmp(p, "square") == 0 ? 2 : 0);
+	}
+	return q;
+}
+
+/* -- paint the path of an element -- */
+static void draw_end(int fill, int stroke, int q)
+{
+	char *p;
+	int eo;
+
+	p = attr("fill-rule");
+	eo = p && strcmp(p, "evenodd") == 0;
+	if (fill != P_NONE && stroke != P_NONE)
+		b_printf(out, eo ? "B*\n" : "B\n");
+	else if (fill != P_NONE)
+		b_printf(out, eo ? "f*\n" : "f\n");
+	else if (stroke != P_NONE)
+		b_printf(out, "S\n");
+	else
+		b_printf(out, "n\n");
+	if (q)
+		b_printf(out, "Q\n");
+}
+
+/* -- get the style from the attributes -- */
+static void get_style(void)
+{
+	char *p;
+	int v;
+
+	if ((p = attr("fill")) != NULL)
+		style.fill = color(p);
+	if ((p = attr("stroke")) != NULL)
+		style.stroke = color(p);
+	if ((p = attr("font-family")) != NULL) {
+		while (*p == '\'' || *p == '"' || isspace((unsigned char) *p))
+			p++;
+		for (v = 0; v < (int) sizeof style.fname - 1; v++) {
+			if (p[v] == '\0' || strchr("'\",", p[v]))
+				break;
+			style.fname[v] = p[v];
+		}
+		style.fname[v] = '\0';
+		if (strncasecmp(p, "Helvetica", 9) == 0
+		 || strncasecmp(p, "Arial", 5) == 0
+		 || strncasecmp(p, "AvantGarde", 10) == 0
+		 || strncasecmp(p, "sans", 4) == 0)
+			style.family = 1;
+		else if (strncasecmp(p, "Courier", 7) == 0
+		      || strncasecmp(p, "mono", 4) == 0)
+			style.family = 2;
+		else if (strncasecmp(p, "Symbol", 6) == 0)
+			style.family = 3;
+		else if (strncasecmp(p, "ZapfDingbats", 12) == 0)
+			style.family = 4;
+		else
+			style.family = 0;
+	}
+	if ((p = attr("font-size")) != NULL)
+		style.size = atof(p);
+	if ((p = attr("font-weight")) != NULL) {
+		v = atoi(p);
+		style.bold = strcmp(p, "bold") == 0 || strcmp(p, "bolder") == 0
+				|| v >= 600;
+	}
+	if ((p = attr("font-style")) != NULL)
+		style.italic = strcmp(p, "italic") == 0
+				|| strcmp(p, "oblique") == 0;
+}
+
+/* -- get the current font -- */
+static int cur_font(void)
+{
+	if (style.family >= 3)
+		return 12 + style.family - 3;
+	return style.family * 4 + style.bold + style.italic * 2;
+}
+
+/* -- get a font with 2-byte codes -- */
+/* return its index in dl.tfonts or -1 */
+static int tfont_get(struct ttf *f, int cjk)
+{
+	struct DLFONT *t;
+	int i, ng;
+
+	for (i = 0, t = dl.tfonts; i < dl.ntfonts; i++, t++) {
+		if (f ? t->ttf == f
+		      : !t->ttf && t->name == cjk_tb[cjk].name)
+			return i;
+	}
+	if (dl.ntfonts >= DL_NTFONTS)
+		return -1;
+	memset(t, 0, sizeof *t);
+	if (f) {
+		t->ttf = f;
+		t->name = ttf_metrics(f)->name;
+		ng = ttf_metrics(f)->ng;
+		t->used = calloc((ng + 7) / 8, 1);
+		t->uni = calloc(ng, sizeof *t->uni);
+		if (!t->used || !t->uni)
+			dl_oom();
+	} else {
+		t->name = cjk_tb[cjk].name;
+		t->cmap = cjk_tb[cjk].cmap;
+		t->ordering = cjk_tb[cjk].ordering;
+		t->supplement = cjk_tb[cjk].supplement;
+	}
+	return dl.ntfonts++;
+}
+
+/* -- get the TrueType font of the current style -- */
+/* The font files are "<family>[-<style>].ttf". */
+static int ttf_font(void)
+{
+	static char *sfx_tb[4][7] = {
+		{"", NULL},
+		{"-Bold", "", NULL},
+		{"-Italic", "-Oblique", "", NULL},
+		{"-BoldItalic", "-BoldOblique", "-Bold",
+			"-Italic", "-Oblique", "", NULL},
+	};
+	struct ttf *f;
+	char **sfx, fn[80];
+
+	if (style.fname[0] == '\0')
+		return -1;
+	for (sfx = sfx_tb[style.bold + style.italic * 2]; *sfx; sfx++) {
+		sprintf(fn, "%s%s", style.fname, *sfx);
+		if ((f = ttf_get(fn)) != NULL)
+			return tfont_get(f, 0);
+	}
+	return -1;
+}
+
+/* -- start a text run -- */
+static void run_new(float dx)
+{
+	struct run_s *r;
+
+	if (nruns > 0 && run_tb[nruns - 1].len == 0 && dx == 0) {
+		r = &run_tb[nruns - 1];	/* reuse the empty run */
+	} else {
+		if (nruns >= MAXRUNS)
+			return;
+		r = &run_tb[nruns++];
+		r->dx = dx;
+	}
+	r->font = cur_font();
+	r->tfont = ttf_font();
+	r->size = style.size;
+	r->start = run_len;
+	r->len = 0;
+}
+
+/* -- convert a unicode character to WinAnsiEncoding (-1 if none) -- */
+static int win_ansi(int c)
+{
+	static int w_tb[32] = {		/* 0x80..0x9f */
+		0x20ac, 0, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+		0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017d, 0,
+		0, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+		0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0, 0x017e, 0x0178,
+	};
+	int i;
+
+	if (c < 0x80 || (c >= 0xa0 && c < 0x100))
+		return c;
+	for (i = 0; i < 32; i++) {
+		if (w_tb[i] == c)
+			return 0x80 + i;
+	}
+	switch (c) {			/* music signs in texts */
+	case 0x266d: return 'b';
+	case 0x266e: return '=';
+	case 0x266f: return '#';
+	}
+	return -1;
+}
+
+/* -- check if a character may be drawn by the CJK fonts -- */
+static int cjk_char(int c)
+{
+	return (c >= 0x1100 && c < 0x1200)		/* hangul jamo */
+	    || (c >= 0x2e80 && c < 0xa4d0)		/* CJK, kana.. */
+	    || (c >= 0xac00 && c < 0xd7b0)		/* hangul */
+	    || (c >= 0xf900 && c < 0xfb00)
+	    || (c >= 0xfe30 && c < 0xfe50)
+	    || (c >= 0xff00 && c < 0xfff0);		/* full width */
+}
+
+/* -- warn about a character which cannot be drawn -- */
+static void no_glyph(int c)
+{
+	static int warn_tb[32];
+	static int nwarn;
+	int i;
+
+	for (i = 0; i < nwarn; i++) {
+		if (warn_tb[i] == c)
+			return;
+	}
+	if (nwarn >= (int) (sizeof warn_tb / sizeof warn_tb[0]))
+		return;
+	warn_tb[nwarn++] = c;
+	error(0, NULL, "No glyph for U+%04X in the PDF/PNG fonts - '?' instead"
+		" (define a TrueType font)", c);
+}
+
+/* -- get the font and the code of a character -- */
+/* return the font: standard font or DL_NFONTS + font with 2-byte codes */
+static int char_font(struct run_s *r, int c, int *code)
+{
+	int k;
+
+	if (r->tfont >= 0
+	 && (*code = ttf_gid(dl.tfonts[r->tfont].ttf, c)) != 0)
+		return DL_NFONTS + r->tfont;
+	if ((*code = win_ansi(c)) >= 0)
+		return r->font;
+	if (cjk_char(c) && (k = tfont_get(NULL, text_cjk)) >= 0) {
+		*code = c;
+		return DL_NFONTS + k;
+	}
+	*code = '?';
+	return r->font;
+}
+
+/* -- width of a character (em) -- */
+static float char_width(int font, int code, int *fnum)
+{
+	if (font < DL_NFONTS)
+		return font_cwid(fnum[font], code);
+	if (dl.tfonts[font - DL_NFONTS].ttf)
+		return ttf_adv(dl.tfonts[font - DL_NFONTS].ttf, code);
+	return 1;				/* (CJK) */
+}
+
+/* -- add characters to the current text run -- */
+static void run_add(char *p, char *end)
+{
+	char *q;
+	int c, n;
+
+	if (nruns == 0)
+		return;
+	while (p < end) {
+		c = (unsigned char) *p++;
+		if (c == '&') {			/* XML entity */
+			q = memchr(p, ';', end - p);
+			if (!q) {
+				;
+			} else if (*p == '#') {
+				c = p[1] == 'x' ? strtol(p + 2, NULL, 16)
+						: atoi(p + 1);
+				p = q + 1;
+			} else {
+				if (strncmp(p, "lt;", 3) == 0)
+					c = '<';
+				else if (strncmp(p, "gt;", 3) == 0)
+					c = '>';
+				else if (strncmp(p, "quot;", 5) == 0)
+					c = '"';
+				else if (strncmp(p, "apos;", 5) == 0)
+					c = '\'';
+				else if (strncmp(p, "nbsp;", 5) == 0)
+					c = 0xa0;
+				p = q + 1;
+			}
+		} else if (c >= 0xc0) {		/* UTF-8 */
+			n = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : 1;
+			c &= 0x3f >> n;
+			while (--n >= 0 && p < end)
+				c = (c << 6) | (*p++ & 0x3f);
+		}
+		if (run_len >= (int) (sizeof run_txt / sizeof run_txt[0]))
+			break;
+		run_txt[run_len++] = c;
+		run_tb[nruns - 1].len++;
+	}
+}
+
+/* -- width of a text run -- */
+static float run_width(struct run_s *r, int *fnum)
+{
+	float w;
+	int i, font, code;
+
+	w = 0;
+	for (i = 0; i < r->len; i++) {
+		font = char_font(r, run_txt[r->start + i], &code);
+		w += char_width(font, code, fnum);
+	}
+	return w * r->size;
+}
+
+/* -- output a text element -- */
+/* The runs are split in strings of a same font. */
+static void text_out(void)
+{
+	struct run_s *r;
+	struct DLFONT *t;
+	float x, w, sc, size;
+	int i, j, n, c, font, cfont, code, fnum[DL_NFONTS];
+	unsigned char b;
+
+	for (i = 0; i < DL_NFONTS; i++)
+		fnum[i] = afm_font(font_tb[i]);
+	text_cjk = 0;				/* (chinese) */
+	for (i = 0; i < run_len; i++) {
+		c = run_txt[i];
+		if (c >= 0x3040 && c < 0x3100) {	/* kana */
+			text_cjk = 1;
+			break;
+		}
+		if ((c >= 0xac00 && c < 0xd7b0)
+		 || (c >= 0x1100 && c < 0x1200))	/* hangul */
+			text_cjk = 2;
+	}
+
+	w = 0;
+	for (i = 0, r = run_tb; i < nruns; i++, r++)
+		w += r->dx + run_width(r, fnum);
+	sc = 1;
+	if (text_len > 0 && w > 0) {
+		sc = text_len / w;
+		w = text_len;
+	}
+	x = text_x;
+	if (text_anchor == 'm')
+		x -= w / 2;
+	else if (text_anchor == 'e')
+		x -= w;
+
+	b_printf(out, "BT\n");
+	if (sc != 1)
+		b_printf(out, "%.1f Tz\n", sc * 100);
+	cfont = -1;				/* current font */
+	size = 0;
+	for (i = 0, r = run_tb; i < nruns; i++, r++) {
+		x += r->dx * sc;
+		n = 0;				/* characters in the string */
+		for (j = 0; j < r->len; j++) {
+			c = run_txt[r->start + j];
+			font = char_font(r, c, &code);
+			if (n == 0 || font != cfont || n >= 120) {
+				if (n > 0)
+					b_printf(out, cfont < DL_NFONTS
+							? ")Tj\n" : ">Tj\n");
+				n = 0;
+				if (font != cfont || r->size != size) {
+					cfont = font;
+					size = r->size;
+					b_printf(out, font < DL_NFONTS
+							? "/F%d %.2f Tf\n"
+							: "/T%d %.2f Tf\n",
+						font < DL_NFONTS ? font
+							: font - DL_NFONTS,
+						r->size);
+				}
+				b_printf(out, "1 0 0 -1 %.2f %.2f Tm\n%c",
+					x, text_y,
+					font < DL_NFONTS ? '(' : '<');
+			}
+			n++;
+			x += char_width(font, code, fnum) * r->size * sc;
+			if (font >= DL_NFONTS) {
+				t = &dl.tfonts[font - DL_NFONTS];
+				if (t->ttf) {
+					if (!(t->used[code >> 3]
+							& (1 << (code & 7)))) {
+						t->used[code >> 3] |=
+							1 << (code & 7);
+						t->uni[code] = c;
+						t->nused++;
+					}
+				} else {
+					t->nused++;
+				}
+				b_printf(out, "%04X", code);
+				continue;
+			}
+			dl.fonts[font] = 1;
+			if (code == '?' && c != '?')
+				no_glyph(c);
+			b = code;
+			if (b == '(' || b == ')' || b == '\\')
+				b_printf(out, "\\%c", b);
+			else if (b < ' ' || b >= 0x7f)
+				b_printf(out, "\\%03o", b);
+			else
+				b_write(out, (char *) &b, 1);
+		}
+		if (n > 0)
+			b_printf(out, cfont < DL_NFONTS ? ")Tj\n" : ">Tj\n");
+	}
+	b_printf(out, "ET\n");
+}
+
+/* -- start of a SVG element -- */
+static void elt_start(char *name)
+{
+	struct elt_s *e, *p;
+	struct DLSYM *x;
+	char *v;
+	int fill, stroke, q;
+
+	p = depth > 0 ? &elt_tb[depth - 1] : NULL;
+	if (depth >= MAXDEPTH) {
+		depth++;
+		return;
+	}
+	e = &elt_tb[depth++];
+	e->type = E_OTHER;
+	e->q = 0;
+	e->out = NULL;
+	e->name = NULL;
+	memcpy(&e->style, &style, sizeof style);
+	if (p && p->type == E_SKIP) {
+		e->type = E_SKIP;
+		return;
+	}
+
+	/* symbol definition */
+	if (p && p->type == E_DEFS) {
+		v = attr("id");
+		if (!v || dl_sym(v)) {
+			e->type = E_SKIP;	/* already defined */
+			return;
+		}
+		e->out = out;
+		e->name = v;
+		form_buf.len = 0;
+		out = &form_buf;
+	} else if (p && p->type != E_G && p->type != E_OTHER
+		&& p->type != E_TEXT) {
+		e->type = E_SKIP;
+		return;
+	}
+
+	if (strcmp(name, "g") == 0) {
+		e->type = E_G;
+		get_style();
+		if (attr("transform") || attr("stroke-width")
+		 || attr("style") || attr("stroke-dasharray")) {
+			b_printf(out, "q\n");
+			e->q = 1;
+			if ((v = attr("transform")) != NULL)
+				transform(v);
+			if ((v = attr("stroke-width")) != NULL)
+				b_printf(out, "%.2f w\n", atof(v));
+			if ((v = attr("stroke-dasharray")) != NULL)
+				b_printf(out, "[%s] 0 d\n", v);
+			if ((v = attr("style")) != NULL
+			 && (v = strstr(v, "color:")) != NULL
+			 && (q = color(v + 6)) >= 0) {
+				b_color(q, "rg");
+				b_color(q, "RG");
+			}
+		}
+		return;
+	}
+	if (strcmp(name, "path") == 0) {
+		q = draw_begin(&fill, &stroke);
+		if ((v = attr("d")) != NULL)
+			path_d(v);
+		draw_end(fill, stroke, q);
+		return;
+	}
+	if (strcmp(name, "use") == 0) {
+		v = attr("xlink:href");
+		if (!v)
+			v = attr("href");
+		if (!v || *v != '#' || (x = dl_sym(v + 1)) == NULL)
+			return;
+		b_printf(out, "q\n");
+		if (attr("x") || attr("y"))
+			b_printf(out, "1 0 0 1 %.2f %.2f cm\n",
+				attr_f("x", page_w), attr_f("y", page_h));
+		if ((v = attr("transform")) != NULL)
+			transform(v);
+		b_name(out, x->name);
+		b_printf(out, " Do\nQ\n");
+		return;
+	}
+	if (strcmp(name, "text") == 0) {
+		e->type = E_TEXT;
+		get_style();
+		text_x = attr_f("x", page_w);
+		text_y = attr_f("y", page_h);
+		text_len = attr_f("textLength", page_w);
+		v = attr("text-anchor");
+		text_anchor = v ? *v : 's';
+		nruns = 0;
+		run_len = 0;
+		run_new(0);
+		return;
+	}
+	if (strcmp(name, "tspan") == 0) {
+		if (!p || (p->type != E_TEXT && p->type != E_TSPAN))
+			return;
+		e->type = E_TSPAN;
+		get_style();
+		run_new(attr_f("dx", page_w));
+		return;
+	}
+	if (strcmp(name, "rect") == 0) {
+		q = draw_begin(&fill, &stroke);
+		b_printf(out, "%.2f %.2f %.2f %.2f re\n",
+			attr_f("x", page_w), attr_f("y", page_h),
+			attr_f("width", page_w), attr_f("height", page_h));
+		draw_end(fill, stroke, q);
+		return;
+	}
+	if (strcmp(name, "circle") == 0 || strcmp(name, "ellipse") == 0) {
+		float rx, ry;
+
+		q = draw_begin(&fill, &stroke);
+		if (name[0] == 'c') {
+			rx = ry = attr_f("r", page_w);
+		} else {
+			rx = attr_f("rx", page_w);
+			ry = attr_f("ry", page_h);
+		}
+		ellipse(attr_f("cx", page_w), attr_f("cy", page_h), rx, ry);
+		draw_end(fill, stroke, q);
+		return;
+	}
+	if (strcmp(name, "line") == 0) {
+		q = draw_begin(&fill, &stroke);
+		b_printf(out, "%.2f %.2f m %.2f %.2f l\n",
+			attr_f("x1", page_w), attr_f("y1", page_h),
+			attr_f("x2", page_w), attr_f("y2", page_h));
+		draw_end(P_NONE, stroke == P_NONE ? P_CURRENT : stroke, q);
+		return;
+	}
+	if (strcmp(name, "defs") == 0) {
+		e->type = E_DEFS;
+		return;
+	}
+	if (strcmp(name, "svg") == 0) {
+		page_w = attr_f("width", 0);
+		page_h = attr_f("height", 0);
+		if (page_w <= 0 || page_h <= 0) {
+			page_w = 595;
+			page_h = 842;
+		}
+		b_printf(out, "1 0 0 -1 0 %.2f cm\n", page_h);
+		return;
+	}
+	if (strcmp(name, "title") == 0)
+		e->type = E_SKIP;
+}
+
+/* -- end of a SVG element -- */
+static void elt_end(void)
+{
+	struct elt_s *e;
+	struct DLSYM *x;
+	struct buf_s b;
+
+	if (depth <= 0)
+		return;
+	if (--depth >= MAXDEPTH)
+		return;
+	e = &elt_tb[depth];
+	switch (e->type) {
+	case E_TEXT:
+		text_out();
+		break;
+	case E_TSPAN:
+		memcpy(&style, &e->style, sizeof style);
+		run_new(0);
+		break;
+	}
+	if (e->q)
+		b_printf(out, "Q\n");
+	memcpy(&style, &e->style, sizeof style);
+
+	/* end of symbol definition */
+	if (e->out) {
+		x = malloc(sizeof *x);
+		if (!x)
+			dl_oom();
+		memset(x, 0, sizeof *x);
+		x->name = strdup(e->name);
+		x->ops = malloc(form_buf.len + 1);
+		b.p = NULL;
+		b.len = b.sz = 0;
+		b_name(&b, x->name);
+		b_write(&b, "", 1);
+		x->ename = b.p;
+		if (!x->name || !x->ops)
+			dl_oom();
+		memcpy(x->ops, form_buf.p, form_buf.len);
+		x->len = form_buf.len;
+		x->next = dl.syms;
+		dl.syms = x;
+		out = e->out;
+	}
+}
+
+/* -- start of a music line in the page -- */
+static void line_add(void)
+{
+	if (dl.nlines >= line_sz) {
+		line_sz = line_sz * 2 + 16;
+		dl.lines = realloc(dl.lines, line_sz * sizeof *dl.lines);
+		if (!dl.lines)
+			dl_oom();
+	}
+	dl.lines[dl.nlines++] = page_buf.len;
+}
+
+/* -- translate a SVG page -- */
+static void svg_page(char *p)
+{
+	char *q, *name, c, empty, *svg;
+	int imark;
+
+	svg = p;
+	imark = 0;
+	depth = 0;
+	style.fill = P_CURRENT;
+	style.stroke = P_NONE;
+	style.family = 0;
+	style.bold = style.italic = 0;
+	style.size = 12;
+	for (;;) {
+		q = strchr(p, '<');
+		if (!q)
+			break;
+		while (imark < nmarks && q - svg >= mark_tb[imark]) {
+			line_add();
+			imark++;
+		}
+		if (depth > 0 && depth <= MAXDEPTH
+		 && elt_tb[depth - 1].type >= E_TEXT)
+			run_add(p, q);
+		p = q + 1;
+		if (*p == '!' || *p == '?') {	/* comment or declaration */
+			q = strncmp(p, "!--", 3) == 0
+				? strstr(p, "-->") : strchr(p, '>');
+			if (!q)
+				break;
+			p = q + 1;
+			continue;
+		}
+		if (*p == '/') {		/* end tag */
+			q = strchr(p, '>');
+			if (!q)
+				break;
+			p = q + 1;
+			elt_end();
+			continue;
+		}
+
+		/* start tag */
+		name = p;
+		while (*p != '\0' && !isspace((unsigned char) *p)
+		    && *p != '>' && *p != '/')
+			p++;
+		c = *p;
+		*p = '\0';
+		nattr = 0;
+		empty = 0;
+		for (;;) {
+			if (c != '\0') {	/* (character overwritten by '\0') */
+				p++;
+				if (c == '>')
+					break;
+				if (c == '/')
+					empty = 1;
+				c = '\0';
+			}
+			while (isspace((unsigned char) *p))
+				p++;
+			if (*p == '\0')
+				return;
+			if (*p == '/') {
+				empty = 1;
+				p++;
+				continue;
+			}
+			if (*p == '>') {
+				p++;
+				break;
+			}
+			q = p;
+			while (*p != '\0' && *p != '='
+			    && !isspace((unsigned char) *p)
+			    && *p != '>' && *p != '/')
+				p++;
+			if (*p != '=')
+				continue;	/* attribute without value */
+			*p++ = '\0';
+			if (*p != '"' && *p != '\'')
+				continue;
+			c = *p++;
+			if (nattr < MAXATTR) {
+				attr_n[nattr] = q;
+				attr_v[nattr++] = p;
+			}
+			q = strchr(p, c);
+			if (!q)
+				return;
+			*q = '\0';
+			p = q + 1;
+			c = '\0';
+		}
+		elt_start(name);
+		if (empty)
+			elt_end();
+	}
+}
+
+/* -- remove the symbols (new output file) -- */
+void dl_reset(void)
+{
+	struct DLSYM *x;
+
+	while ((x = dl.syms) != NULL) {
+		dl.syms = x->next;
+		free(x->name);
+		free(x->ename);
+		free(x->ops);
+		free(x);
+	}
+	nmarks = 0;
+}
+
+/* -- mark the start of a music line in the SVG output -- */
+void dl_mark(long off)
+{
+	if (nmarks >= mark_sz) {
+		mark_sz = mark_sz * 2 + 16;
+		mark_tb = realloc(mark_tb, mark_sz * sizeof *mark_tb);
+		if (!mark_tb)
+			dl_oom();
+	}
+	mark_tb[nmarks++] = off;
+}
+
+/* -- build the display list from the SVG image of a file -- */
+void dl_build(FILE *f)
+{
+	static char *svg_buf;
+	static long svg_sz;
+	long l;
+
+	fflush(f);
+	l = ftell(f);
+	if (l >= svg_sz) {
+		svg_sz = l + 4096;
+		free(svg_buf);
+		svg_buf = malloc(svg_sz);
+		if (!svg_buf)
+			dl_oom();
+	}
+	rewind(f);
+	l = fread(svg_buf, 1, l, f);
+	svg_buf[l] = '\0';
+	rewind(f);
+
+	page_buf.len = 0;
+	out = &page_buf;
+	page_w = 595;
+	page_h = 842;
+	dl.nlines = 0;
+	memset(dl.fonts, 0, sizeof dl.fonts);
+	svg_page(svg_buf);
+	nmarks = 0;
+	dl.ops = page_buf.p;
+	dl.len = page_buf.len;
+	dl.w = page_w;
+	dl.h = page_h;
+}
+
+/* -- get the name of a font of the display list -- */
+char *dl_fontname(int k)
+{
+	if (k < 0 || k >= DL_NFONTS)
+		return font_tb[0];
+	return font_tb[k];
+}
+
+/* -- decode a name -- */
+static char *get_name(char *p, char *end, char *name, int sz)
+{
+	int i;
+
+	p++;					/* skip '/' */
+	i = 0;
+	while (p < end && !isspace((unsigned char) *p)
+	    && !strchr("/[]()<>", *p)) {
+		if (*p == '#' && p + 2 < end
+		 && isxdigit((unsigned char) p[1])) {
+			char hex[3];
+
+			hex[0] = p[1];
+			hex[1] = p[2];
+			hex[2] = '\0';
+			if (i < sz - 1)
+				name[i++] = strtol(hex, NULL, 16);
+			p += 3;
+			continue;
+		}
+		if (i < sz - 1)
+			name[i++] = *p;
+		p++;
+	}
+	name[i] = '\0';
+	return p;
+}
+
+/* -- call a function for each operation of a display list -- */
+void dl_replay(char *p, int len, void (*f)(struct DLOP *o))
+{
+	struct DLOP o;
+	char *start, *end, *q;
+	float v;
+	int i, h;
+
+	start = p;
+	end = p + len;
+	o.nv = o.narr = o.slen = 0;
+	o.name[0] = '\0';
+	while (p < end) {
+		if (isspace((unsigned char) *p)) {
+			p++;
+			continue;
+		}
+		if (isdigit((unsigned char) *p) || *p == '-' || *p == '.') {
+			if (o.nv >= 8) {
+				memmove(o.v, o.v + 1, 7 * sizeof o.v[0]);
+				o.nv--;
+			}
+			o.v[o.nv++] = strtod(p, &q);
+			if (q == p)
+				q++;
+			p = q;
+			continue;
+		}
+		if (*p == '/') {
+			p = get_name(p, end, o.name, sizeof o.name);
+			continue;
+		}
+		if (*p == '[') {		/* (dash) array */
+			p++;
+			o.narr = 0;
+			while (p < end && *p != ']') {
+				if (isspace((unsigned char) *p)) {
+					p++;
+					continue;
+				}
+				v = strtod(p, &q);
+				if (q == p)
+					q++;
+				p = q;
+				if (o.narr < 8)
+					o.arr[o.narr++] = v;
+			}
+			p++;
+			continue;
+		}
+		if (*p == '(') {		/* string */
+			p++;
+			o.slen = 0;
+			while (p < end && *p != ')') {
+				if (*p == '\\') {
+					p++;
+					if (*p >= '0' && *p <= '7') {
+						i = 0;
+						while (*p >= '0' && *p <= '7')
+							i = i * 8 + *p++ - '0';
+						if (o.slen < (int) sizeof o.str)
+							o.str[o.slen++] = i;
+						continue;
+					}
+				}
+				if (o.slen < (int) sizeof o.str)
+					o.str[o.slen++] = *p;
+				p++;
+			}
+			p++;
+			continue;
+		}
+		if (*p == '<') {		/* hexadecimal string */
+			p++;
+			o.slen = 0;
+			i = -1;
+			while (p < end && *p != '>') {
+				if (isxdigit((unsigned char) *p)) {
+					h = isdigit((unsigned char) *p)
+						? *p - '0'
+						: (*p | 0x20) - 'a' + 10;
+					if (i < 0) {
+						i = h;
+					} else {
+						if (o.slen < (int) sizeof o.str)
+							o.str[o.slen++] = i * 16 + h;
+						i = -1;
+					}
+				}
+				p++;
+			}
+			p++;
+			continue;
+		}
+
+		/* operator */
+		for (i = 0; p < end && isalpha((unsigned char) *p); p++) {
+			if (i < (int) sizeof o.op - 2)
+				o.op[i++] = *p;
+		}
+		if (i == 0) {			/* (unknown) */
+			p++;
+			o.nv = 0;
+			continue;
+		}
+		if (p < end && *p == '*')	/* f* B* */
+			o.op[i++] = *p++;
+		o.op[i] = '\0';
+		o.end = p - start;
+		f(&o);
+		o.nv = o.narr = o.slen = 0;
+		o.name[0] = '\0';
+	}
+}
@@ -103,13 +103,17 @@ static float b_pos(int grace,
 static struct SYMBOL *sym_dup(struct SYMBOL *s_orig)
 {
 	struct SYMBOL *s;
+	int m;
 
 	s = (struct SYMBOL *) getarena(sizeof *s);
 	memcpy(s, s_orig, sizeof *s);
 	s->as.flags |= ABC_F_INVIS;
 	s->as.text = NULL;
-	memset(s->as.u.note.sl1, 0, sizeof s->as.u.note.sl1);
-	memset(s->as.u.note.decs, 0, sizeof s->as.u.note.decs);
+	s->as.u.note.hd = abc_hd_new(s_orig->as.u.note.hd, s->nhd + 1);
+	for (m = 0; m <= s->nhd; m++) {
+		s->as.u.note.hd[m].sl1 = 0;
+		s->as.u.note.hd[m].decs = 0;
+	}
 	memset(&s->as.u.note.dc, 0, sizeof s->as.u.note.dc);
 	s->gch = NULL;
 	s->ly = NULL;
@@ -118,8 +122,8 @@ static struct SYMBOL *sym_dup(struct SYMBOL *s_orig)
 
 /* -- calculate a beam -- */
 /* (the staves may be defined or not) */
-static int calculate_beam(struct BEAM *bm,
-			  struct SYMBOL *s1)
+static int calc_beam(struct BEAM *bm,
+		     struct SYMBOL *s1)
 {
 	struct SYMBOL *s, *s2;
 	int notes, nflags, staff, voice, two_staves, two_dir;
@@ -530,6 +534,18 @@ static int calculate_beam(struct BEAM *bm,
 	return 1;
 }
 
+/* -- calculate a beam (timed by --stats) -- */
+static int calculate_beam(struct BEAM *bm,
+			  struct SYMBOL *s1)
+{
+	int r;
+
+	stats_start(ST_BEAM);
+	r = calc_beam(bm, s1);
+	stats_stop(ST_BEAM);
+	return r;
+}
+
 /* -- draw a single beam -- */
 /* (the staves are defined) */
 static void draw_beam(float x1,
@@ -833,27 +849,27 @@ static void draw_timesig(float x,
 	char *f, meter[64];
 	float dx;
 
-	if (s->as.u.meter.nmeter == 0)
+	if (s->as.u.meter->nmeter == 0)
 		return;
 	staff = s->staff;
 	x -= s->wl;
-	for (i = 0; i < s->as.u.meter.nmeter; i++) {
-		l = strlen(s->as.u.meter.meter[i].top);
-		if (l > sizeof s->as.u.meter.meter[i].top)
-			l = sizeof s->as.u.meter.meter[i].top;
-		if (s->as.u.meter.meter[i].bot[0] != '\0') {
+	for (i = 0; i < s->as.u.meter->nmeter; i++) {
+		l = strlen(s->as.u.meter->meter[i].top);
+		if (l > sizeof s->as.u.meter->meter[i].top)
+			l = sizeof s->as.u.meter->meter[i].top;
+		if (s->as.u.meter->meter[i].bot[0] != '\0') {
 			sprintf(meter, "(%.8s)(%.2s)",
-				s->as.u.meter.meter[i].top,
-				s->as.u.meter.meter[i].bot);
+				s->as.u.meter->meter[i].top,
+				s->as.u.meter->meter[i].bot);
 			f = "tsig";
-			l2 = strlen(s->as.u.meter.meter[i].bot);
-			if (l2 > sizeof s->as.u.meter.meter[i].bot)
-				l2 = sizeof s->as.u.meter.meter[i].bot;
+			l2 = strlen(s->as.u.meter->meter[i].bot);
+			if (l2 > sizeof s->as.u.meter->meter[i].bot)
+				l2 = sizeof s->as.u.meter->meter[i].bot;
 			if (l2 > l)
 				l = l2;
-		} else switch (s->as.u.meter.meter[i].top[0]) {
+		} else switch (s->as.u.meter->meter[i].top[0]) {
 			case 'C':
-				if (s->as.u.meter.meter[i].top[1] != '|')
+				if (s->as.u.meter->meter[i].top[1] != '|')
 					f = "csig";
 				else {
 					f = "ctsig";
@@ -862,7 +878,7 @@ static void draw_timesig(float x,
 				meter[0] = '\0';
 				break;
 			case 'c':
-				if (s->as.u.meter.meter[i].top[1] != '.')
+				if (s->as.u.meter->meter[i].top[1] != '.')
 					f = "imsig";
 				else {
 					f = "iMsig";
@@ -871,7 +887,7 @@ static void draw_timesig(float x,
 				meter[0] = '\0';
 				break;
 			case 'o':
-				if (s->as.u.meter.meter[i].top[1] != '.')
+				if (s->as.u.meter->meter[i].top[1] != '.')
 					f = "pmsig";
 				else {
 					f = "pMsig";
@@ -882,12 +898,12 @@ static void draw_timesig(float x,
 			case '(':
 			case ')':
 				sprintf(meter, "(\\%s)",
-					s->as.u.meter.meter[i].top);
+					s->as.u.meter->meter[i].top);
 				f = "stsig";
 				break;
 			default:
 				sprintf(meter, "(%.8s)",
-					s->as.u.meter.meter[i].top);
+					s->as.u.meter->meter[i].top);
 				f = "stsig";
 				break;
 		}
@@ -1511,11 +1527,11 @@ static void draw_basic_note(float x,
 	no_head = (s->sflags & S_OTHER_HEAD);
 	if (no_head)
 		draw_all_deco_head(s, x + shhd, y + staffb);
-	if (s->as.u.note.decs[m] != 0) {
+	if (s->as.u.note.hd[m].decs != 0) {
 		int n;
 
-		i = s->as.u.note.decs[m] >> 3;		/* index */
-		n = i + (s->as.u.note.decs[m] & 0x07);	/* # deco */
+		i = s->as.u.note.hd[m].decs >> 3;		/* index */
+		n = i + (s->as.u.note.hd[m].decs & 0x07);	/* # deco */
 		for ( ; i < n; i++)
 			no_head |= draw_deco_head(s->as.u.note.dc.t[i],
 						  x + shhd,
@@ -1538,7 +1554,7 @@ static void draw_basic_note(float x,
 		}
 	}
 
-	identify_note(s, s->as.u.note.lens[m],
+	identify_note(s, s->as.u.note.hd[m].len,
 		      &head, &dots, &nflags);
 
 	/* output a ledger line if horizontal shift / chord
@@ -1572,14 +1588,14 @@ static void draw_basic_note(float x,
 	} else if (s->type == CUSTOS) {
 		p = "custos";
 	} else if ((s->sflags & S_PERC)
-	        && (i = s->as.u.note.accs[m]) != 0) {
+	        && (i = s->as.u.note.hd[m].acc) != 0) {
 		i &= 0x07;
 		sprintf(perc_hd, "p%shd", acc_tb[i]);
 		p = perc_hd;
 	} else {
 		switch (head) {
 		case H_OVAL:
-			if (s->as.u.note.lens[m] < BREVE) {
+			if (s->as.u.note.hd[m].len < BREVE) {
 				p = "HD";
 				break;
 			}
@@ -1589,7 +1605,7 @@ static void draw_basic_note(float x,
 			}
 			/* fall thru */
 		case H_SQUARE:
-			if (s->as.u.note.lens[m] < BREVE * 2)
+			if (s->as.u.note.hd[m].len < BREVE * 2)
 				p = "breve";
 			else
 				p = "longa";
@@ -1622,7 +1638,7 @@ static void draw_basic_note(float x,
 	}
 
 	/* draw the accidental */
-	if ((i = s->as.u.note.accs[m]) != 0
+	if ((i = s->as.u.note.hd[m].acc) != 0
 	 && !(s->sflags & S_PERC)) {
 		int n, d;
 
@@ -1971,7 +1987,7 @@ static int slur_multi(struct SYMBOL *k1,
 /* -- draw a phrasing slur between two symbols -- */
 /* (the staves are not yet defined) */
 /* (not a pretty routine, this) */
-static int draw_slur(struct SYMBOL *k1,
+static int slur_draw(struct SYMBOL *k1,
 		     struct SYMBOL *k2,
 		     int m1,
 		     int m2,
@@ -2333,6 +2349,19 @@ if (two_staves) error(0, k1, "*** multi-staves slurs not treated yet");
 	return (s > 0 ? SL_ABOVE : SL_BELOW) | (slur_type & SL_DOTTED);
 }
 
+/* -- draw a phrasing slur (timed by --stats) -- */
+static int draw_slur(struct SYMBOL *k1,
+		     struct SYMBOL *k2,
+		     int m1,
+		     int m2,
+		     int slur_type)
+{
+	stats_start(ST_SLUR);
+	slur_type = slur_draw(k1, k2, m1, m2, slur_type);
+	stats_stop(ST_SLUR);
+	return slur_type;
+}
+
 /* -- draw the slurs between 2 symbols --*/
 static void draw_slurs(struct SYMBOL *first,
 		       struct SYMBOL *last)
@@ -2452,13 +2481,13 @@ static void draw_slurs(struct SYMBOL *first,
 			m1 = -1;
 		} else {
 			for (m1 = 0; m1 <= s->nhd; m1++)
-				if (s->as.u.note.sl1[m1])
+				if (s->as.u.note.hd[m1].sl1)
 					break;
-			slur_type = s->as.u.note.sl1[m1] & 0x07;
-			s->as.u.note.sl1[m1] >>= 3;
-			if (s->as.u.note.sl1[m1] == 0) {
+			slur_type = s->as.u.note.hd[m1].sl1 & 0x07;
+			s->as.u.note.hd[m1].sl1 >>= 3;
+			if (s->as.u.note.hd[m1].sl1 == 0) {
 				for (i = m1 + 1; i <= s->nhd; i++)
-					if (s->as.u.note.sl1[i])
+					if (s->as.u.note.hd[i].sl1)
 						break;
 				if (i > s->nhd)
 					s->sflags &= ~S_SL1;
@@ -2473,12 +2502,12 @@ static void draw_slurs(struct SYMBOL *first,
 				k->as.u.note.slur_end--;
 			} else {
 				for (m2 = 0; m2 <= k->nhd; m2++)
-					if (k->as.u.note.sl2[m2])
+					if (k->as.u.note.hd[m2].sl2)
 						break;
-				k->as.u.note.sl2[m2]--;
-				if (k->as.u.note.sl2[m2] == 0) {
+				k->as.u.note.hd[m2].sl2--;
+				if (k->as.u.note.hd[m2].sl2 == 0) {
 					for (i = m2 + 1; i <= k->nhd; i++)
-						if (k->as.u.note.sl2[i])
+						if (k->as.u.note.hd[i].sl2)
 							break;
 					if (i > k->nhd)
 						k->sflags &= ~S_SL2;
@@ -2991,7 +3020,7 @@ static void draw_note_ties(struct SYMBOL *k1,
 		p1 = k1->pits[m1];
 		m2 = mhead2[i];
 		p2 = k2->pits[m2];
-		if ((k1->as.u.note.ti1[m1] & 0x03) == SL_ABOVE)
+		if ((k1->as.u.note.hd[m1].ti1 & 0x03) == SL_ABOVE)
 			s = 1;
 		else
 			s = -1;
@@ -3098,8 +3127,8 @@ static void draw_note_ties(struct SYMBOL *k1,
 //				y1 = y2;
 //		} else {
 //			if (k1 == k2) {		/* if continuation on next line */
-//				k1->as.u.note.ti1[m1] &= SL_DOTTED;
-//				k1->as.u.note.ti1[m1] +=
+//				k1->as.u.note.hd[m1].ti1 &= SL_DOTTED;
+//				k1->as.u.note.hd[m1].ti1 +=
 //					s > 0 ? SL_ABOVE : SL_BELOW;
 //			}
 		}
@@ -3107,7 +3136,7 @@ static void draw_note_ties(struct SYMBOL *k1,
 		h = (.04 * (x2 - x1) + 10) * s;
 		slur_out(x1, staff_tb[staff].y + y,
 			 x2, staff_tb[staff].y + y,
-			 s, h, k1->as.u.note.ti1[m1] & SL_DOTTED, -1);
+			 s, h, k1->as.u.note.hd[m1].ti1 & SL_DOTTED, -1);
 	}
 }
 
@@ -3150,7 +3179,7 @@ static void draw_ties(struct SYMBOL *k1,
 	/* half ties from last note in line or before new repeat */
 	if (job == 2) {
 		for (i = 0; i <= nh1; i++) {
-			if (k1->as.u.note.ti1[i])
+			if (k1->as.u.note.hd[i].ti1)
 				mhead3[ntie3++] = i;
 		}
 		draw_note_ties(k1, k2, ntie3, mhead3, mhead3, job);
@@ -3159,15 +3188,15 @@ static void draw_ties(struct SYMBOL *k1,
 
 	/* set up list of ties to draw */
 	for (i = 0; i <= nh1; i++) {
-		if (k1->as.u.note.ti1[i] == 0)
+		if (k1->as.u.note.hd[i].ti1 == 0)
 			continue;
 		tie2 = -1;
-		pit = k1->as.u.note.pits[i];
+		pit = k1->as.u.note.hd[i].pit;
 		for (m1 = k2->nhd; m1 >= 0; m1--) {
-			switch (k2->as.u.note.pits[m1] - pit) {
+			switch (k2->as.u.note.hd[m1].pit - pit) {
 			case 1:			/* maybe ^c - _d */
 			case -1:		/* _d - ^c */
-				if (k1->as.u.note.accs[i] != k2->as.u.note.accs[m1])
+				if (k1->as.u.note.hd[i].acc != k2->as.u.note.hd[m1].acc)
 					tie2 = m1;
 				break;
 			case 0:
@@ -3203,9 +3232,9 @@ found:
 		}
 		ntie = 0;
 		for (i = ntie3; --i >= 0; ) {
-			pit = k1->as.u.note.pits[mhead3[i]];
+			pit = k1->as.u.note.hd[mhead3[i]].pit;
 			for (m1 = k3->nhd; m1 >= 0; m1--) {
-				if (k3->as.u.note.pits[m1] == pit) {
+				if (k3->as.u.note.hd[m1].pit == pit) {
 					mhead1[ntie] = mhead3[i];
 					mhead2[ntie++] = m1;
 					ntie3--;
@@ -3404,12 +3433,12 @@ static void draw_all_slurs(struct VOICE_S *p_voice)
 				m2 = -1;
 			} else {
 				for (m2 = 0; m2 <= s->nhd; m2++)
-					if (s->as.u.note.sl2[m2])
+					if (s->as.u.note.hd[m2].sl2)
 						break;
-				s->as.u.note.sl2[m2]--;
-				if (s->as.u.note.sl2[m2] == 0) {
+				s->as.u.note.hd[m2].sl2--;
+				if (s->as.u.note.hd[m2].sl2 == 0) {
 					for (i = m2 + 1; i <= s->nhd; i++)
-						if (s->as.u.note.sl2[i])
+						if (s->as.u.note.hd[i].sl2)
 							break;
 					if (i > s->nhd)
 						s->sflags &= ~S_SL2;
@@ -3565,7 +3594,7 @@ static void draw_tblt_p(struct VOICE_S *p_voice,
 			if (s->as.type == ABC_T_REST)
 				continue;
 			if (tied) {
-				tied = s->as.u.note.ti1[0];
+				tied = s->as.u.note.hd[0].ti1;
 				continue;
 			}
 			break;
@@ -3584,8 +3613,8 @@ static void draw_tblt_p(struct VOICE_S *p_voice,
 		default:
 			continue;
 		}
-		pitch = s->as.u.note.pits[0] + 19;
-		acc = s->as.u.note.accs[0];
+		pitch = s->as.u.note.hd[0].pit + 19;
+		acc = s->as.u.note.hd[0].acc;
 		if (acc != 0) {
 			workmap[pitch] = acc == A_NT
 				? A_NULL
@@ -3622,7 +3651,7 @@ static void draw_tblt_p(struct VOICE_S *p_voice,
 			micro_p = (float) pitch + (float) n / d;
 			a2b("%d %.3f %.2f %s\n", octave, micro_p, s->x, tblt->note);
 		}
-		tied = s->as.u.note.ti1[0];
+		tied = s->as.u.note.hd[0].ti1;
 	}
 	a2b("grestore\n");
 }
@@ -4059,16 +4088,16 @@ void draw_sym_near(void)
 			continue;
 
 		/* have room for the accidentals */
-		if (s->as.u.note.accs[s->nhd]) {
+		if (s->as.u.note.hd[s->nhd].acc) {
 			y = s->y + 8;
 			if (s->ymx < y)
 				s->ymx = y;
 			y_set(s->staff, 1, s->x, 0., y);
 		}
-		if (s->as.u.note.accs[0]) {
+		if (s->as.u.note.hd[0].acc) {
 			y = s->y;
-			if ((s->as.u.note.accs[0] & 0x07) == A_SH
-			 || s->as.u.note.accs[0] == A_NT)
+			if ((s->as.u.note.hd[0].acc & 0x07) == A_SH
+			 || s->as.u.note.hd[0].acc == A_NT)
 				y -= 7;
 			else
 				y -= 5;
@@ -4749,7 +4778,7 @@ static void draw_symbols(struct VOICE_S *p_voice)
 				anno_out(s, 'c');
 			break;
 		case TIMESIG:
-			memcpy(&p_voice->meter, &s->as.u.meter,
+			memcpy(&p_voice->meter, s->as.u.meter,
 			       sizeof p_voice->meter);
 			if ((s->sflags & S_SECOND)
 			 || staff_tb[s->staff].empty)
@@ -4928,10 +4957,10 @@ static void set_tie_dir(struct SYMBOL *sym)
 			if (s2->time == s->time && s2->staff == s->staff) { */
 				dir = s->multi > 0 ? SL_ABOVE : SL_BELOW;
 				for (i = 0; i <= s->nhd; i++) {
-					ti = s->as.u.note.ti1[i];
+					ti = s->as.u.note.hd[i].ti1;
 					if (!((ti & 0x03) == SL_AUTO))
 						continue;
-					s->as.u.note.ti1[i] = (ti & SL_DOTTED) | dir;
+					s->as.u.note.hd[i].ti1 = (ti & SL_DOTTED) | dir;
 				}
 				continue;
 /*			} */
@@ -4941,21 +4970,21 @@ static void set_tie_dir(struct SYMBOL *sym)
 		sec = ntie = 0;
 		pit = 128;
 		for (i = 0; i <= s->nhd; i++) {
-			if (s->as.u.note.ti1[i]) {
+			if (s->as.u.note.hd[i].ti1) {
 				ntie++;
 				if (pit < 128
-				 && s->as.u.note.pits[i] <= pit + 1)
+				 && s->as.u.note.hd[i].pit <= pit + 1)
 					sec++;
-				pit = s->as.u.note.pits[i];
+				pit = s->as.u.note.hd[i].pit;
 			}
 		}
 		if (ntie <= 1) {
 			dir = s->stem < 0 ? SL_ABOVE : SL_BELOW;
 			for (i = 0; i <= s->nhd; i++) {
-				ti = s->as.u.note.ti1[i];
+				ti = s->as.u.note.hd[i].ti1;
 				if (ti != 0) {
 					if ((ti & 0x03) == SL_AUTO)
-						s->as.u.note.ti1[i] =
+						s->as.u.note.hd[i].ti1 =
 							(ti & SL_DOTTED) | dir;
 					break;
 				}
@@ -4970,15 +4999,15 @@ static void set_tie_dir(struct SYMBOL *sym)
 				ntie = ntie / 2 + 1;
 				dir = SL_BELOW;
 				for (i = 0; i <= s->nhd; i++) {
-					ti = s->as.u.note.ti1[i];
+					ti = s->as.u.note.hd[i].ti1;
 					if (ti == 0)
 						continue;
 					if (--ntie == 0) {	/* central tie */
-						if (s->as.u.note.pits[i] >= 22)
+						if (s->as.u.note.hd[i].pit >= 22)
 							dir = SL_ABOVE;
 					}
 					if ((ti & 0x03) == SL_AUTO)
-						s->as.u.note.ti1[i] =
+						s->as.u.note.hd[i].ti1 =
 							(ti & SL_DOTTED) | dir;
 					if (ntie == 0)
 						dir = SL_ABOVE;
@@ -4989,11 +5018,11 @@ static void set_tie_dir(struct SYMBOL *sym)
 				ntie /= 2;
 				dir = SL_BELOW;
 				for (i = 0; i <= s->nhd; i++) {
-					ti = s->as.u.note.ti1[i];
+					ti = s->as.u.note.hd[i].ti1;
 					if (ti == 0)
 						continue;
 					if ((ti & 0x03) == SL_AUTO)
-						s->as.u.note.ti1[i] =
+						s->as.u.note.hd[i].ti1 =
 							(ti & SL_DOTTED) | dir;
 					if (--ntie == 0)
 						dir = SL_ABOVE;
@@ -5007,24 +5036,24 @@ static void set_tie_dir(struct SYMBOL *sym)
  * opposition; then fill in the remaining notes of the chord accordingly */
 			pit = 128;
 			for (i = 0; i <= s->nhd; i++) {
-				if (s->as.u.note.ti1[i]) {
+				if (s->as.u.note.hd[i].ti1) {
 					if (pit < 128
-					 && s->as.u.note.pits[i] <= pit + 1) {
+					 && s->as.u.note.hd[i].pit <= pit + 1) {
 						ntie = i;
 						break;
 					}
-					pit = s->as.u.note.pits[i];
+					pit = s->as.u.note.hd[i].pit;
 				}
 			}
 			dir = SL_BELOW;
 			for (i = 0; i <= s->nhd; i++) {
-				ti = s->as.u.note.ti1[i];
+				ti = s->as.u.note.hd[i].ti1;
 				if (ti == 0)
 					continue;
 				if (ntie == i)
 					dir = SL_ABOVE;
 				if ((ti & 0x03) == SL_AUTO)
-					s->as.u.note.ti1[i] =
+					s->as.u.note.hd[i].ti1 =
 							(ti & SL_DOTTED) | dir;
 			}
 /*fixme..
@@ -5055,10 +5084,10 @@ static void set_tie_room(void)
 
 			if (!(s->sflags & S_TI1))
 				continue;
-			if (s->pits[0] < 20 && s->as.u.note.ti1[0] == SL_BELOW)
+			if (s->pits[0] < 20 && s->as.u.note.hd[0].ti1 == SL_BELOW)
 				;
 			else if (s->pits[s->nhd] > 24
-			      && s->as.u.note.ti1[s->nhd] == SL_ABOVE)
+			      && s->as.u.note.hd[s->nhd].ti1 == SL_ABOVE)
 				;
 			else
 				continue;
@@ -29,7 +29,7 @@
 
 struct FORMAT cfmt;		/* current format for output */
 
-char *fontnames[MAXFONTS];		/* list of font names */
+char *fontnames[MAXFONTS];		/* list of font names (interned) */
 static char font_enc[MAXFONTS];		/* font encoding */
 static char def_font_enc[MAXFONTS];	/* default font encoding */
 static char used_font[MAXFONTS];	/* used fonts */
@@ -171,8 +171,9 @@ static int get_font(char *fname, int encoding)
 	int fnum;
 
 	/* get or set the default encoding */
+	fname = abc_intern(fname);
 	for (fnum = nfontnames; --fnum >= 0; )
-		if (strcmp(fname, fontnames[fnum]) == 0) {
+		if (fontnames[fnum] == fname) {
 			if (encoding < 0)
 				encoding = def_font_enc[fnum];
 			if (encoding == font_enc[fnum])
@@ -180,7 +181,7 @@ static int get_font(char *fname, int encoding)
 			break;
 		}
 	while (--fnum >= 0) {
-		if (strcmp(fname, fontnames[fnum]) == 0
+		if (fontnames[fnum] == fname
 		 && encoding == font_enc[fnum])
 			return fnum;
 	}
@@ -195,7 +196,7 @@ static int get_font(char *fname, int encoding)
 		error(1, 0,
 		      "Cannot have a new font when the output file is opened");
 	fnum = nfontnames++;
-	fontnames[fnum] = strdup(fname);
+	fontnames[fnum] = fname;
 	if (encoding < 0)
 		encoding = 0;
 	font_enc[fnum] = encoding;
@@ -235,6 +236,8 @@ static void fontspec(struct FONTSPEC *f,
 	f->swfac = size;
 	if (swfac_font[f->fnum] != 0) {
 		f->swfac *= swfac_font[f->fnum];
+	} else if (afm_loaded(f->fnum)) {
+		;				/* real metrics */
 	} else if (strncmp(name, "Times", 5) == 0) {
 		if (strcmp(name, "Times-Bold") == 0)
 			f->swfac *= 1.05;
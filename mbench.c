@@ -0,0 +1,302 @@
+/*
+ * Micro-benchmark of the abcm2ps kernels.
+ *
+ * This program is linked with the abcm2ps objects, abc2ps.c being
+ * compiled with '-Dmain=abcm2ps_main'. It first runs abcm2ps on
+ * 'factor' copies of an ABC file (SVG output to /dev/null), which
+ * sets up the fonts, the format and the staves, and gives:
+ *	- the PostScript stream given to svg_write(), which is replayed,
+ *	- the time per call of calculate_beam(), draw_slur() and
+ *	  set_sym_glue() measured by the --stats hooks (these functions
+ *	  are static and work on the symbols of a music line).
+ * Then y_get(), y_set(), tex_str(), frontend() and svg_write() are
+ * called in loops with fixed inputs.
+ * The results are written to stdout as JSON lines, with the time
+ * in nanoseconds per operation.
+ *
+ * usage: abcmbench [-t seconds] [-x factor] [file.abc]
+ *	-t seconds	minimum time of a loop (default 0.2)
+ *	-x factor	number of copies of the ABC file (default 10)
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+
+#include "abc2ps.h"
+#include "front.h"
+
+int abcm2ps_main(int argc, char **argv);
+
+static double min_t = 0.2;		/* minimum time of a loop */
+
+static char *ps_buf;			/* PostScript of the pages */
+static int ps_len;
+static unsigned char *abc_buf;		/* copies of the ABC file */
+static float yx;			/* x offset for y_get() / y_set() */
+
+static char *tex_tb[] = {		/* strings for tex_str() */
+	"Sonata in E minor",
+	"Caf\\'e \\`a la cr\\^eme - Fr\\\"uhling",
+	"Allegro $1con brio$0 &amp; &#x263A; \\u00e9t\\u00e9",
+	"Th\\oe\\ se\\~nor \\ss -- 1\\3 \\l / \\cC",
+};
+#define NTEX (sizeof tex_tb / sizeof tex_tb[0])
+
+/* -- error exit -- */
+static void fatal(char *msg, char *arg)
+{
+	fprintf(stderr, "abcmbench: %s %s: %s\n",
+		msg, arg ? arg : "", strerror(errno));
+	exit(EXIT_FAILURE);
+}
+
+/* -- read a file -- */
+static char *read_file(char *fn, int *p_len)
+{
+	FILE *f;
+	char *buf;
+	long l;
+
+	f = fopen(fn, "rb");
+	if (!f)
+		fatal("cannot read", fn);
+	fseek(f, 0, SEEK_END);
+	l = ftell(f);
+	rewind(f);
+	buf = malloc(l + 1);
+	if (!buf)
+		fatal("out of memory", NULL);
+	if (fread(buf, 1, l, f) != (size_t) l)
+		fatal("cannot read", fn);
+	buf[l] = '\0';
+	fclose(f);
+	*p_len = l;
+	return buf;
+}
+
+/* -- run abcm2ps and keep the PostScript stream of the SVG output -- */
+static void run_abcm2ps(char *fn, int factor)
+{
+	FILE *f;
+	char **argv;
+	int i, argc, fd1, fd2, fd;
+	long l;
+
+	/* (the arguments are kept for the SVG headers) */
+	argv = malloc((factor + 8) * sizeof *argv);
+	if (!argv)
+		fatal("out of memory", NULL);
+	argc = 0;
+	argv[argc++] = "abcm2ps";
+	argv[argc++] = "-q";
+	argv[argc++] = "--stats";
+	argv[argc++] = "json";
+	argv[argc++] = "-v";
+	argv[argc++] = "-O";
+	argv[argc++] = "-";
+	for (i = 0; i < factor; i++)
+		argv[argc++] = fn;
+	argv[argc] = NULL;
+
+	svg_capture = tmpfile();
+	if (!svg_capture)
+		fatal("cannot create a temporary file", NULL);
+
+	/* stdout and stderr to /dev/null */
+	fflush(stdout);
+	fflush(stderr);
+	fd1 = dup(1);
+	fd2 = dup(2);
+	fd = open("/dev/null", O_WRONLY);
+	if (fd1 < 0 || fd2 < 0 || fd < 0)
+		fatal("cannot redirect the output", NULL);
+	dup2(fd, 1);
+	dup2(fd, 2);
+	close(fd);
+
+	i = abcm2ps_main(argc, argv);
+
+	fflush(stdout);
+	fflush(stderr);
+	dup2(fd1, 1);
+	dup2(fd2, 2);
+	close(fd1);
+	close(fd2);
+	if (i != EXIT_SUCCESS)
+		fprintf(stderr, "abcmbench: errors in %s\n", fn);
+
+	f = svg_capture;
+	svg_capture = NULL;
+	l = ftell(f);
+	rewind(f);
+	ps_buf = malloc(l + 1);
+	if (!ps_buf)
+		fatal("out of memory", NULL);
+	ps_len = fread(ps_buf, 1, l, f);
+	ps_buf[ps_len] = '\0';
+	fclose(f);
+}
+
+/* -- output a result -- */
+static void report(char *kernel, long ops, double t, long bytes)
+{
+	printf("{\"kernel\":\"%s\",\"ops\":%ld,\"ns_per_op\":%.1f",
+		kernel, ops, ops > 0 ? t / ops * 1e9 : 0);
+	if (bytes > 0)
+		printf(",\"mb_per_s\":%.2f", t > 0 ? bytes * ops / t / 1e6 : 0);
+	printf("}\n");
+	fflush(stdout);
+}
+
+/* -- report a kernel timed by the --stats hooks -- */
+static void report_stage(char *kernel, int stage)
+{
+	double t;
+	int n;
+
+	stats_get(stage, &t, &n);
+	report(kernel, n, t, 0);
+}
+
+/* -- call a kernel until the minimum time is reached -- */
+static void loop(char *kernel, void (*f)(long i), long bytes)
+{
+	double t0, t;
+	long i, n;
+
+	f(0);				/* warm up */
+	n = 1;
+	for (;;) {
+		t0 = stats_now();
+		for (i = 0; i < n; i++)
+			f(i);
+		t = stats_now() - t0;
+		if (t >= min_t)
+			break;
+		n *= 2;
+	}
+	report(kernel, n, t, bytes);
+}
+
+/* -- the kernels -- */
+static void k_y_get(long i)
+{
+	y_get(0, i & 1, (i & 255) * yx, 10 + (i & 7) * 8);
+}
+
+static void k_y_set(long i)
+{
+	y_set(0, i & 1, (i & 255) * yx, 10 + (i & 7) * 8,
+		i & 1 ? 30 + (i & 15) : -10 - (i & 15));
+}
+
+static void k_tex_str(long i)
+{
+	tex_str(tex_tb[i % NTEX]);
+}
+
+static void include_none(unsigned char *fn)
+{
+}
+
+static void k_frontend(long i)
+{
+	front_init(0, 0, include_none);
+	free(frontend(abc_buf, FE_ABC));
+}
+
+static void k_svg_write(long i)
+{
+	file_initialized = 0;
+	define_svg_symbols("abcmbench", 1, 595, 842);
+	svg_write(ps_buf, ps_len);
+	svg_close();
+}
+
+static void k_stats(long i)
+{
+	stats_start(ST_FRONT);
+	stats_stop(ST_FRONT);
+}
+
+int main(int argc, char **argv)
+{
+	char *fn, *abc;
+	int i, l, factor;
+
+	factor = 10;
+	while ((i = getopt(argc, argv, "t:x:")) != -1) {
+		switch (i) {
+		case 't':
+			min_t = atof(optarg);
+			break;
+		case 'x':
+			factor = atoi(optarg);
+			if (factor <= 0)
+				factor = 1;
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind > 1)
+		goto usage;
+	fn = optind < argc ? argv[optind] : "sample3.abc";
+
+	/* the kernels working on the symbols */
+	run_abcm2ps(fn, factor);
+	report_stage("calculate_beam", ST_BEAM);
+	report_stage("draw_slur", ST_SLUR);
+	report_stage("set_sym_glue", ST_GLUE);
+
+	/* the kernels called with fixed inputs */
+	if (realwidth <= 0)
+		realwidth = 500;
+	yx = realwidth / 256;
+	loop("y_get", k_y_get, 0);
+	loop("y_set", k_y_set, 0);
+	loop("tex_str", k_tex_str, 0);
+
+	abc = read_file(fn, &l);
+	abc_buf = malloc(l * factor + 1);
+	if (!abc_buf)
+		fatal("out of memory", NULL);
+	for (i = 0; i < factor; i++)
+		memcpy(abc_buf + l * i, abc, l);
+	abc_buf[l * factor] = '\0';
+	free(abc);
+	loop("frontend", k_frontend, (long) l * factor);
+
+	fout = fopen("/dev/null", "w");
+	if (!fout)
+		fatal("cannot open", "/dev/null");
+	loop("svg_write", k_svg_write, ps_len);
+
+	/* cost of a --stats start/stop pair, included in the times above */
+	loop("stats_timer", k_stats, 0);
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: abcmbench [-t seconds] [-x factor] [file.abc]\n");
+	return EXIT_FAILURE;
+}
@@ -21,6 +21,7 @@
  * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335  USA
  */
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
@@ -58,6 +59,24 @@ static struct {
 	{10, 13}
 };
 
+/* vertical time slices (symbols at a same time, grouped by staff) */
+static struct tslice {
+	struct SYMBOL *s;	/* first symbol of the slice */
+	int time;		/* time of the slice */
+	int sym;		/* index of the first member in tsl_sym[] */
+	short stx[MAXSTAFF + 1]; /* index of the members of each staff */
+} *tsl;
+static int ntsl, tsl_sz;	/* number of slices / size of tsl[] */
+static struct SYMBOL **tsl_sym;	/* slice members */
+static struct SYMBOL **tsl_seq;	/* starts of the vertical sequences */
+static int ntsl_seq, tsl_sym_sz;
+static struct SYMBOL *tsl_last;	/* last symbol */
+static int tsl_grace;		/* some grace note */
+
+/* members of a staff in a time slice */
+#define TSL_ST(sl, staff) (&tsl_sym[(sl)->sym + (sl)->stx[staff]])
+#define TSL_NST(sl, staff) ((sl)->stx[(staff) + 1] - (sl)->stx[staff])
+
 /* -- decide whether to shift heads to other side of stem on chords -- */
 /* also position accidentals to avoid too much overlap */
 /* this routine is called only once per tune */
@@ -81,7 +100,7 @@ static void set_head_directions(struct SYMBOL *s)
 	/* special case when single note */
 	n = s->nhd;
 	if (n == 0) {
-		if (s->as.u.note.accs[0] != 0) {
+		if (s->as.u.note.hd[0].acc != 0) {
 			dx = dx_tb[s->head];
 			if (s->as.flags & ABC_F_GRACE)
 				dx *= 0.7;
@@ -128,7 +147,7 @@ static void set_head_directions(struct SYMBOL *s)
 	/* set the accidental shifts */
 	nac = 0;
 	for (i = n; i >= 0; i--) {	/* from top to bottom */
-		if ((i1 = s->as.u.note.accs[i]) != 0) {
+		if ((i1 = s->as.u.note.hd[i].acc) != 0) {
 			ax_tb[nac++] = i;
 			if (i1 & 0xf8)
 				i1 = A_SH;	/* micro-tone same as sharp */
@@ -174,7 +193,7 @@ static void set_head_directions(struct SYMBOL *s)
 		}
 		d = dt_tb[ac_tb[i2]][ac_tb[i1]];
 		if (p2 - p1 < d) {		/* if possible overlap */
-			if (s->as.u.note.accs[i1] & 0xf8) { /* microtonal */
+			if (s->as.u.note.hd[i1].acc & 0xf8) { /* microtonal */
 				shmin = 6.5;
 				shmax = 9;
 			} else {
@@ -289,8 +308,11 @@ static int may_combine(struct SYMBOL *s)
 		return 0;
 	if (s2->as.u.note.dc.n != 0) {
 		if (s2->as.u.note.dc.h != s2->as.u.note.dc.h
-		 || memcmp(&s->as.u.note.dc, &s2->as.u.note.dc,
-				sizeof s->as.u.note.dc) != 0)
+		 || s->as.u.note.dc.n != s2->as.u.note.dc.n
+		 || s->as.u.note.dc.h != s2->as.u.note.dc.h
+		 || s->as.u.note.dc.s != s2->as.u.note.dc.s
+		 || memcmp(s->as.u.note.dc.t, s2->as.u.note.dc.t,
+				s2->as.u.note.dc.n) != 0)
 			return 0;
 	}
 	if (s->gch && s2->gch)
@@ -316,6 +338,7 @@ static int may_combine(struct SYMBOL *s)
 static void do_combine(struct SYMBOL *s)
 {
 	struct SYMBOL *s2;
+	struct notehd *hd;
 	int nhd, nhd2, type;
 
 again:
@@ -339,18 +362,10 @@ again:
 	/* combine the voices */
 	memcpy(&s->pits[nhd + 1], s2->pits,
 		sizeof s->pits[0] * (nhd2 + 1));
-#define COMBINEV(f)\
-    memcpy(&s->as.u.note.f[nhd + 1], s2->as.u.note.f,\
-	sizeof s->as.u.note.f[0] * (nhd2 + 1));\
-
-		COMBINEV(pits);
-		COMBINEV(lens);
-		COMBINEV(accs);
-		COMBINEV(sl1);
-		COMBINEV(sl2);
-		COMBINEV(ti1);
-		COMBINEV(decs);
-#undef COMBINEV
+	hd = abc_hd_new(NULL, nhd + nhd2 + 2);
+	memcpy(hd, s->as.u.note.hd, sizeof *hd * (nhd + 1));
+	memcpy(&hd[nhd + 1], s2->as.u.note.hd, sizeof *hd * (nhd2 + 1));
+	s->as.u.note.hd = hd;
 	nhd += nhd2 + 1;
 	s->nhd = nhd;
 /*fixme:should recalculate yav*/
@@ -359,12 +374,12 @@ again:
 	sort_pitch(s, 1);		/* sort the notes by pitch */
 
 	/* force the tie directions */
-	type = s->as.u.note.ti1[0];
+	type = s->as.u.note.hd[0].ti1;
 	if ((type & 0x03) == SL_AUTO)
-		s->as.u.note.ti1[0] = SL_BELOW | (type & ~SL_DOTTED);
-	type = s->as.u.note.ti1[nhd];
+		s->as.u.note.hd[0].ti1 = SL_BELOW | (type & ~SL_DOTTED);
+	type = s->as.u.note.hd[nhd].ti1;
 	if ((type & 0x03) == SL_AUTO)
-		s->as.u.note.ti1[nhd] = SL_ABOVE | (type & ~SL_DOTTED);
+		s->as.u.note.hd[nhd].ti1 = SL_ABOVE | (type & ~SL_DOTTED);
 delsym2:
 	if (s2->as.text && !s->as.text) {
 		s->as.text = s2->as.text;
@@ -860,9 +875,9 @@ static float set_graceoffs(struct SYMBOL *s)
 		}
 		set_head_directions(g);
 		for (m = g->nhd; m >= 0; m--) {
-			if (g->as.u.note.accs[m]) {
+			if (g->as.u.note.hd[m].acc) {
 				xx += 5;
-				if (g->as.u.note.accs[m] & 0xf8)
+				if (g->as.u.note.hd[m].acc & 0xf8)
 					xx += 2;
 				break;
 			}
@@ -1017,13 +1032,15 @@ static float ly_width(struct SYMBOL *s, float wlw)
 	for (i = 0; i < MAXLY; i++) {
 		float swfac, shift;
 		char *p;
+		int fnum;
 
 		if ((lyl = ly->lyl[i]) == 0)
 			continue;
 		p = lyl->t;
 		w = lyl->w;
+		fnum = lyl->f->fnum;
 		swfac = lyl->f->swfac;
-		xx = w + 2 * cwid(' ') * swfac;
+		xx = w + 2 * font_cwid(fnum, ' ') * swfac;
 		if (isdigit((unsigned char) *p)
 		 || p[1] == ':'
 //		 || p[1] == '(' || p[1] == ')') {
@@ -1033,7 +1050,7 @@ static float ly_width(struct SYMBOL *s, float wlw)
 //			if (p[1] == '(')
 			if (*p == '(') {
 //				sz = cwid((unsigned char) p[1]);
-				sz = cwid((unsigned char) *p);
+				sz = font_cwid(fnum, (unsigned char) *p);
 			} else {
 				sz = 0;
 				while (*p != '\0') {
@@ -1042,14 +1059,14 @@ static float ly_width(struct SYMBOL *s, float wlw)
 						p++;
 						continue;
 					}
-					sz += cwid((unsigned char) *p);
+					sz += font_cwid(fnum, (unsigned char) *p);
 					if (*p == ' ')
 						break;
 					p++;
 				}
 			}
 			sz *= swfac;
-			shift = (w - sz + 2 * cwid(' ') * swfac)
+			shift = (w - sz + 2 * font_cwid(fnum, ' ') * swfac)
 				* VOCPRE;
 			if (shift > 20)
 				shift = 20;
@@ -1068,7 +1085,7 @@ static float ly_width(struct SYMBOL *s, float wlw)
 		lyl->s = shift;
 		AT_LEAST(wlw, shift);
 		xx -= shift;
-		shift = 2 * cwid(' ') * swfac;
+		shift = 2 * font_cwid(fnum, ' ') * swfac;
 		for (k = s->next; k; k = k->next) {
 			switch (k->type) {
 			case NOTEREST:
@@ -1156,9 +1173,9 @@ static void set_width(struct SYMBOL *s)
 			xx = s->shhd[m];
 			if (xx < 0)
 				AT_LEAST(wlnote, -xx + 5);
-			if (s->as.u.note.accs[m]) {
+			if (s->as.u.note.hd[m].acc) {
 				AT_LEAST(wlnote, s->shac[m]
-					 + ((s->as.u.note.accs[m] & 0xf8)
+					 + ((s->as.u.note.hd[m].acc & 0xf8)
 					    ? 6.5 : 4.5));
 			}
 		}
@@ -1292,10 +1309,10 @@ static void set_width(struct SYMBOL *s)
 			s->wl = wlw;
 		break;
 	case SPACE:
-		if (s->as.u.note.lens[1] < 0)
+		if (s->as.u.note.hd[1].len < 0)
 			xx = 10;
 		else
-			xx = (float) s->as.u.note.lens[1] * 0.5;
+			xx = (float) s->as.u.note.hd[1].len * 0.5;
 		s->wr = xx;
 		if (s->gch)
 			xx = gchord_width(s, xx, xx);
@@ -1405,22 +1422,22 @@ static void set_width(struct SYMBOL *s)
 	case TIMESIG:
 		/* !!tied to draw_timesig()!! */
 		w = 0;
-		for (i = 0; i < s->as.u.meter.nmeter; i++) {
+		for (i = 0; i < s->as.u.meter->nmeter; i++) {
 			int l;
 
-			l = sizeof s->as.u.meter.meter[i].top;
-			if (s->as.u.meter.meter[i].top[l - 1] == '\0') {
-				l = strlen(s->as.u.meter.meter[i].top);
-				if (s->as.u.meter.meter[i].top[1] == '|'
-				 || s->as.u.meter.meter[i].top[1] == '.')
+			l = sizeof s->as.u.meter->meter[i].top;
+			if (s->as.u.meter->meter[i].top[l - 1] == '\0') {
+				l = strlen(s->as.u.meter->meter[i].top);
+				if (s->as.u.meter->meter[i].top[1] == '|'
+				 || s->as.u.meter->meter[i].top[1] == '.')
 					l--;		/* 'C|' */
 			}
-			if (s->as.u.meter.meter[i].bot[0] != '\0') {
+			if (s->as.u.meter->meter[i].bot[0] != '\0') {
 				int l2;
 
-				l2 = sizeof s->as.u.meter.meter[i].bot;
-				if (s->as.u.meter.meter[i].bot[l2 - 1] == '\0')
-					l2 = strlen(s->as.u.meter.meter[i].bot);
+				l2 = sizeof s->as.u.meter->meter[i].bot;
+				if (s->as.u.meter->meter[i].bot[l2 - 1] == '\0')
+					l2 = strlen(s->as.u.meter->meter[i].bot);
 				if (l2 > l)
 					l = l2;
 			}
@@ -1702,6 +1719,17 @@ static void set_allsymwidth(struct SYMBOL *last_s)
 	}
 }
 
+/* -- change a symbol into a rest -- */
+static void rest_set(struct SYMBOL *s)
+{
+	if (s->as.type != ABC_T_NOTE && s->as.type != ABC_T_REST) {
+		memset(&s->as.u.note, 0, sizeof s->as.u.note);
+		s->as.u.note.hd = abc_hd_new(NULL, 1);
+	}
+	s->type = NOTEREST;
+	s->as.type = ABC_T_REST;
+}
+
 /* -- set the repeat sequences / measures -- */
 static void set_repeat(struct SYMBOL *g,	/* repeat format */
 			struct SYMBOL *s)	/* first note */
@@ -1772,9 +1800,8 @@ static void set_repeat(struct SYMBOL *g,	/* repeat format */
 				unlksym(s2);
 				s2 = s2->ts_next;
 			}
-			s3->type = NOTEREST;
-			s3->as.type = ABC_T_REST;
-			s3->dur = s3->as.u.note.lens[0]
+			rest_set(s3);
+			s3->dur = s3->as.u.note.hd[0].len
 				= s2->time - s3->time;
 			s3->sflags &= S_NL | S_SEQST;
 //			s3->sflags |= S_REPEAT | S_BEAM_ST;
@@ -1855,9 +1882,8 @@ static void set_repeat(struct SYMBOL *g,	/* repeat format */
 			s2->extra = NULL;
 			unlksym(s2);
 		}
-		s3->type = NOTEREST;
-		s3->as.type = ABC_T_REST;
-		s3->dur = s3->as.u.note.lens[0] = dur;
+		rest_set(s3);
+		s3->dur = s3->as.u.note.hd[0].len = dur;
 		s3->as.flags = ABC_F_INVIS;
 /*fixme: should set many parameters for set_width*/
 //		set_width(s3);
@@ -1875,9 +1901,8 @@ static void set_repeat(struct SYMBOL *g,	/* repeat format */
 			unlksym(s2);
 			s2 = s2->next;
 		}
-		s3->type = NOTEREST;
-		s3->as.type = ABC_T_REST;
-		s3->dur = s3->as.u.note.lens[0] = dur;
+		rest_set(s3);
+		s3->dur = s3->as.u.note.hd[0].len = dur;
 		s3->as.flags = ABC_F_INVIS;
 		set_width(s3);
 		if (s3->sflags & S_SEQST)
@@ -1899,9 +1924,8 @@ static void set_repeat(struct SYMBOL *g,	/* repeat format */
 			s2->extra = NULL;
 			unlksym(s2);
 		}
-		s3->type = NOTEREST;
-		s3->as.type = ABC_T_REST;
-		s3->dur = s3->as.u.note.lens[0] = dur;
+		rest_set(s3);
+		s3->dur = s3->as.u.note.hd[0].len = dur;
 		s3->sflags &= S_NL | S_SEQST;
 //		s3->sflags |= S_REPEAT | S_BEAM_ST;
 		s3->sflags |= S_REPEAT;
@@ -1962,11 +1986,10 @@ static void custos_add(struct SYMBOL *s)
 	new_s->shrink = 8 + 4;
 
 	new_s->nhd = s2->nhd;
-	memcpy(new_s->as.u.note.lens, s2->as.u.note.lens,
-			sizeof new_s->as.u.note.lens);
+	new_s->as.u.note.hd = abc_hd_new(NULL, new_s->nhd + 1);
 	memcpy(new_s->pits, s2->pits, sizeof new_s->pits);
 	for (i = 0; i <= new_s->nhd; i++)
-		new_s->as.u.note.lens[i] = CROTCHET;
+		new_s->as.u.note.hd[i].len = CROTCHET;
 	new_s->as.flags = ABC_F_STEMLESS;
 }
 
@@ -2552,6 +2575,64 @@ static void set_pitch(struct SYMBOL *last_s)
 	smallest_duration = dur;
 }
 
+/* -- build the vertical time slices from tsfirst -- */
+/* this function is called at start of generation, after voice combine
+ * and for each music line (the line cut changes the time linkage) */
+static void set_tslices(void)
+{
+	struct SYMBOL *s, *s2;
+	struct tslice *sl;
+	int nsym, staff;
+	short cnt[MAXSTAFF];
+
+	ntsl = nsym = 0;
+	for (s = tsfirst; s; s = s->ts_next) {
+		if (s == tsfirst || s->time != s->ts_prev->time)
+			ntsl++;
+		nsym++;
+	}
+	if (ntsl > tsl_sz) {
+		tsl_sz = ntsl + 256;
+		tsl = realloc(tsl, sizeof *tsl * tsl_sz);
+	}
+	if (nsym > tsl_sym_sz) {
+		tsl_sym_sz = nsym + 1024;
+		tsl_sym = realloc(tsl_sym, sizeof *tsl_sym * tsl_sym_sz);
+		tsl_seq = realloc(tsl_seq, sizeof *tsl_seq * tsl_sym_sz);
+	}
+	if (!tsl || !tsl_sym || !tsl_seq) {
+		error(1, 0, "Out of memory for time slices - abort");
+		exit(EXIT_FAILURE);
+	}
+
+	ntsl = nsym = ntsl_seq = 0;
+	tsl_last = NULL;
+	tsl_grace = 0;
+	for (s = tsfirst; s; s = s2) {
+		sl = &tsl[ntsl++];
+		sl->s = s;
+		sl->time = s->time;
+		sl->sym = nsym;
+		memset(cnt, 0, sizeof cnt);
+		for (s2 = s; s2 && s2->time == s->time; s2 = s2->ts_next) {
+			cnt[s2->staff]++;
+			if (s2->sflags & S_SEQST)
+				tsl_seq[ntsl_seq++] = s2;
+			if (s2->type == GRACE)
+				tsl_grace = 1;
+			tsl_last = s2;
+		}
+		sl->stx[0] = 0;
+		for (staff = 0; staff < MAXSTAFF; staff++) {
+			sl->stx[staff + 1] = sl->stx[staff] + cnt[staff];
+			cnt[staff] = sl->stx[staff];
+		}
+		for (s2 = s; s2 && s2->time == s->time; s2 = s2->ts_next)
+			tsl_sym[nsym + cnt[s2->staff]++] = s2;
+		nsym += sl->stx[MAXSTAFF];
+	}
+}
+
 /* -- set the stem direction when multi-voices -- */
 /* this function is called only once per tune */
 static void set_stem_dir(void)
@@ -2786,8 +2867,10 @@ static void set_rest_offset(void)
 {
 #if 1 // 13/11/18
 	struct SYSTEM *sy;
-	struct SYMBOL *s, *s2;
-	int nvoice, voice, end_time, not_alone;
+	struct SYMBOL *s, *s2, **p_st;
+	struct tslice *sl, *sl2;
+	int nvoice, voice, end_time, not_alone, i, n;
+	short cur[MAXSTAFF];
 	struct {
 		struct SYMBOL *s;
 		int staff;
@@ -2798,7 +2881,14 @@ static void set_rest_offset(void)
 	
 	sy = cursys;
 	nvoice = 0;
+	sl = tsl;
+	memset(cur, 0, sizeof cur);
 	for (s = tsfirst; s; s = s->ts_next) {
+		if (sl + 1 < &tsl[ntsl] && s == sl[1].s) {
+			sl++;
+			memset(cur, 0, sizeof cur);
+		}
+		i = cur[s->staff]++;	/* index in the staff members */
 		v = &vtb[s->voice];
 		if (s->as.flags & ABC_F_INVIS)
 			continue;
@@ -2833,16 +2923,20 @@ static void set_rest_offset(void)
 
 		/* check if clash with next symbols */
 		end_time = s->time + s->dur;
-		for (s2 = s->ts_next; s2; s2 = s2->ts_next) {
-			if (s2->time >= end_time)
+		for (sl2 = sl; sl2 < &tsl[ntsl]; sl2++, i = -1) {
+			if (sl2->time >= end_time)
 				break;
-			if (s2->staff != s->staff
-			 || s2->type != NOTEREST
-			 || (s2->as.flags & ABC_F_INVIS))
-				continue;
-			not_alone++;
-			if (s2->as.type != ABC_T_REST)
-				shift_rest(s, s2, sy);
+			p_st = TSL_ST(sl2, s->staff);
+			n = TSL_NST(sl2, s->staff);
+			while (++i < n) {
+				s2 = p_st[i];
+				if (s2->type != NOTEREST
+				 || (s2->as.flags & ABC_F_INVIS))
+					continue;
+				not_alone++;
+				if (s2->as.type != ABC_T_REST)
+					shift_rest(s, s2, sy);
+			}
 		}
 		if (!not_alone) {
 			s->y = 12;
@@ -3301,8 +3395,10 @@ static void init_music_line(void)
 				continue;
 			}
 			s = sym_new(TIMESIG, p_voice, last_s);
-			memcpy(&s->as.u.meter, &p_voice->meter,
-			       sizeof s->as.u.meter);
+			s->as.u.meter = (struct meter_s *)
+					getarena(sizeof *s->as.u.meter);
+			memcpy(s->as.u.meter, &p_voice->meter,
+			       sizeof *s->as.u.meter);
 			set_yval(s);
 		}
 	}
@@ -3536,6 +3632,7 @@ static void set_global(void)
 	init_music_line();
 	insert_meter &= ~1;		/* keep the 'first line' flag */
 	set_pitch(NULL);		/* adjust the note pitches */
+	set_tslices();			/* build the vertical time slices */
 }
 
 /* -- return the left indentation of the staves -- */
@@ -3583,7 +3680,8 @@ static float set_indent(int keep)
 			 && w == 0)
 				w = 10;
 		}
-		maxw += 4 * cwid(' ') * cfmt.font_tb[VOICEFONT].swfac + w;
+		maxw += 4 * font_cwid(cfmt.font_tb[VOICEFONT].fnum, ' ')
+				* cfmt.font_tb[VOICEFONT].swfac + w;
 	}
 	if (insert_meter & 2) {			/* if indent */
 		maxw += cfmt.indent;
@@ -3688,11 +3786,20 @@ static void set_beams(struct SYMBOL *sym)
 /* this routine is called only once per tune */
 static void set_overlap(void)
 {
-	struct SYMBOL *s, *s1, *s2;
-	int d, i1, i2, m, sd1, sd2, t;
+	struct SYMBOL *s, *s1, *s2, **p_st;
+	struct tslice *sl;
+	int d, i1, i2, m, sd1, sd2, t, i, n;
+	short cur[MAXSTAFF];
 	float d1, d2, dy1, dy2, noteshift;
 
+	sl = tsl;
+	memset(cur, 0, sizeof cur);
 	for (s = tsfirst; s; s = s->ts_next) {
+		if (sl + 1 < &tsl[ntsl] && s == sl[1].s) {
+			sl++;
+			memset(cur, 0, sizeof cur);
+		}
+		i = cur[s->staff]++;	/* index in the staff members */
 		if (s->as.type != ABC_T_NOTE
 		 || (s->as.flags & ABC_F_INVIS))
 			continue;
@@ -3709,19 +3816,15 @@ static void set_overlap(void)
 		}
 
 		/* search the next note at the same time on the same staff */
-		s2 = s;
-		for (;;) {
-			s2 = s2->ts_next;
-			if (!s2)
-				break;
-			if (s2->time != s->time) {
-				s2 = NULL;
+		p_st = TSL_ST(sl, s->staff);
+		n = TSL_NST(sl, s->staff);
+		s2 = NULL;
+		while (++i < n) {
+			if (p_st[i]->as.type == ABC_T_NOTE
+			 && !(p_st[i]->as.flags & ABC_F_INVIS)) {
+				s2 = p_st[i];
 				break;
 			}
-			if (s2->as.type == ABC_T_NOTE
-			 && !(s2->as.flags & ABC_F_INVIS)
-			 && s2->staff == s->staff)
-				break;
 		}
 		if (!s2)
 			continue;
@@ -3746,7 +3849,7 @@ static void set_overlap(void)
 				dp = s1->pits[i1] - s2->pits[i2];
 				switch (dp) {
 				case 0:
-					if (s1->as.u.note.accs[i1] != s2->as.u.note.accs[i2])
+					if (s1->as.u.note.hd[i1].acc != s2->as.u.note.hd[i2].acc)
 						t = -1;
 					else
 						t |= 4;
@@ -3791,8 +3894,8 @@ static void set_overlap(void)
 				 && s1->stem > 0 &&  s2->stem < 0) {
 					if (s1->shac[0] < 8)
 						s1->shac[0] += 5;
-					if (s1->as.u.note.accs[0] != 0
-					 && s2->as.u.note.accs[s2->nhd] != 0)
+					if (s1->as.u.note.hd[0].acc != 0
+					 && s2->as.u.note.hd[s2->nhd].acc != 0)
 						s2->shac[s2->nhd] += 10;
 					continue;
 				}
@@ -3802,9 +3905,9 @@ static void set_overlap(void)
 
 		/* if unison and different accidentals */
 		if (t < 0) {
-			if (s2->as.u.note.accs[i2] == 0) {
+			if (s2->as.u.note.hd[i2].acc == 0) {
 				d1 = noteshift + s2->xmx + s1->shac[i1];
-				if (s1->as.u.note.accs[i1] & 0xf8)
+				if (s1->as.u.note.hd[i1].acc & 0xf8)
 					d1 += 2;
 				if (s2->dots)
 					d1 += 6;
@@ -3815,7 +3918,7 @@ static void set_overlap(void)
 				s1->xmx += d1;
 			} else {
 				d2 = noteshift + s1->xmx + s2->shac[i2];
-				if (s2->as.u.note.accs[i2] & 0xf8)
+				if (s2->as.u.note.hd[i2].acc & 0xf8)
 					d2 += 2;
 				if (s1->dots)
 					d2 += 6;
@@ -3939,12 +4042,12 @@ static void set_overlap(void)
 		head_1:
 			s2->nohdix = i2;	/* keep heads of 1st voice */
 			for (; i2 <= s2->nhd; i2++)
-				s2->as.u.note.accs[i2] = 0;
+				s2->as.u.note.hd[i2].acc = 0;
 			goto do_shift;
 		head_2:
 			s1->nohdix = i1;	/* keep heads of 2nd voice */
 			for (; i1 >= 0; i1--)
-				s1->as.u.note.accs[i1] = 0;
+				s1->as.u.note.hd[i1].acc = 0;
 			goto do_shift;
 		}
 
@@ -4039,13 +4142,13 @@ static void set_overlap(void)
 			int dp;
 			float shft;
 
-			if (s1->as.u.note.accs[i1] == 0)
+			if (s1->as.u.note.hd[i1].acc == 0)
 				continue;
 			for (i2 = 0; i2 <= s2->nhd; i2++) {
 				dp = s1->pits[i1] - s2->pits[i2];
 				if (dp > 5 || dp < -5)
 					continue;
-				if (s2->as.u.note.accs[i2] == 0) {
+				if (s2->as.u.note.hd[i2].acc == 0) {
 					if (s2->shhd[i2] < 0
 					 && dp == 3) {
 						s1->shac[i1] = 9 + 7;
@@ -4053,18 +4156,18 @@ static void set_overlap(void)
 					continue;
 				}
 				if (dp == 0) {
-					s2->as.u.note.accs[i2] = 0;
+					s2->as.u.note.hd[i2].acc = 0;
 					continue;
 				}
 				shft = (dp <= -4 || dp >= 4) ? 4.5 : 7;
 				if (dp > 0) {
-					if (s1->as.u.note.accs[i1] & 0xf8)
+					if (s1->as.u.note.hd[i1].acc & 0xf8)
 						shft += 2;
 					if (s2->shac[i2] < s1->shac[i1] + shft
 					 && s2->shac[i2] > s1->shac[i1] - shft)
 						s2->shac[i2] = s1->shac[i1] + shft;
 				} else {
-					if (s2->as.u.note.accs[i2] & 0xf8)
+					if (s2->as.u.note.hd[i2].acc & 0xf8)
 						shft += 2;
 					if (s1->shac[i1] < s2->shac[i2] + shft
 					 && s1->shac[i1] > s2->shac[i2] - shft)
@@ -4095,7 +4198,7 @@ static void set_overlap(void)
 				d2 += 8 + 3.5 * (s1->dots - 1);
 			for (m = s2->nhd; m >= 0; m--) {
 				s2->shhd[m] += d2;
-				if (s2->as.u.note.accs[m] != 0
+				if (s2->as.u.note.hd[m].acc != 0
 				 && s2->pits[m] < s1->pits[0] - 4)
 					s2->shac[m] -= d2;
 			}
@@ -4227,7 +4330,7 @@ static void set_stems(void)
 					slen -= 2;
 			}
 			s->y = ymn;
-			if (s->as.u.note.ti1[0] != 0)
+			if (s->as.u.note.hd[0].ti1 != 0)
 /*fixme
  *			 || s->as.u.note.ti2[0] != 0) */
 				ymn -= 3;
@@ -4251,7 +4354,7 @@ static void set_stems(void)
 			s->ymn = (int) (s->ys - 2.5);
 			s->y = ymx;
 /*fixme:the tie may be lower*/
-			if (s->as.u.note.ti1[s->nhd] != 0)
+			if (s->as.u.note.hd[s->nhd].ti1 != 0)
 /*fixme
  *			 || s->as.u.note.ti2[s->nhd] != 0)*/
 				ymx += 3;
@@ -4435,29 +4538,22 @@ static void set_sym_glue(float width)
 {
 	struct SYMBOL *s;
 	float beta0, alfa, beta;
-	int some_grace;
+	int i;
 	float xmin, x, xmax, spafac;
 
 	/* calculate the whole space of the symbols */
-	some_grace = 0;
-	s = tsfirst;
 	xmin = x = xmax = 0;
-	for (;;) {
-		if (s->type == GRACE)
-			some_grace = 1;
-		if (s->sflags & S_SEQST) {
-			float space;
-
-			xmin += s->shrink;
-			if ((space = s->space) < s->shrink)
-				space = s->shrink;
-			x += space;
-			xmax += space * 1.8;
-		}
-		if (!s->ts_next)
-			break;
-		s = s->ts_next;
+	for (i = 0; i < ntsl_seq; i++) {
+		float space;
+
+		s = tsl_seq[i];
+		xmin += s->shrink;
+		if ((space = s->space) < s->shrink)
+			space = s->shrink;
+		x += space;
+		xmax += space * 1.8;
 	}
+	s = tsl_last;
 #if 0
 	if (s->type == FMTCHG		/* if PS/SVG sequence at end of line */
 	 && (s->u == PSSEQ || s-> == SVGSEQ)) {
@@ -4511,26 +4607,22 @@ static void set_sym_glue(float width)
 
 	/* define the x offsets of all starting symbols */
 	x = xmax = 0;
-	s = tsfirst;
-	for (;;) {
-		if (s->sflags & S_SEQST) {
-			float new_space;
-
-			new_space = s->shrink;
-			if (s->space != 0) {
-				if (new_space < s->space * spafac)
-					new_space = s->space * spafac;
-				xmax += s->space * spafac * 1.8;
-			}
-			x += new_space;
-			xmax += new_space;
-			s->x = x;
-			s->xmax = xmax;
-		}
-		if (!s->ts_next)
-			break;
-		s = s->ts_next;
+	for (i = 0; i < ntsl_seq; i++) {
+		float new_space;
+
+		s = tsl_seq[i];
+		new_space = s->shrink;
+		if (s->space != 0) {
+			if (new_space < s->space * spafac)
+				new_space = s->space * spafac;
+			xmax += s->space * spafac * 1.8;
+		}
+		x += new_space;
+		xmax += new_space;
+		s->x = x;
+		s->xmax = xmax;
 	}
+	s = tsl_last;
 
 	/* if the last symbol is not a bar, add some extra space */
 	switch (s->type) {
@@ -4624,7 +4716,7 @@ static void set_sym_glue(float width)
 	}
 
 	/* set the x offsets of the grace notes */
-	if (some_grace) {
+	if (tsl_grace) {
 		for (s = tsfirst; s; s = s->ts_next) {
 			struct SYMBOL *g;
 
@@ -4756,16 +4848,21 @@ void output_music(void)
 {
 	struct VOICE_S *p_voice;
 	float lwidth, indent;
+	static int nline;		/* (for the trace) */
+	static int sys_tune, nsys;	/* (for --systems) */
 
 	/* set the staff system if any STAVES at start of the next line */
 	gen_init();
 	if (!tsfirst)
 		return;
+	stats_start(ST_MUSIC);
 	check_buffer();
 	set_global();			/* initialize the generator */
 	if (first_voice->next) {	/* if many voices */
-		if (cfmt.combinevoices > 0)
+		if (cfmt.combinevoices > 0) {
 			combine_voices();
+			set_tslices();	/* (some symbols may be removed) */
+		}
 		set_stem_dir();		/* set the stems direction in 'multi' */
 	}
 	for (p_voice = first_voice; p_voice; p_voice = p_voice->next)
@@ -4775,7 +4872,9 @@ void output_music(void)
 		set_rest_offset();	/* set the vertical offset of rests */
 		set_overlap();		/* shift the notes on voice overlap */
 	}
+	stats_start(ST_WIDTH);
 	set_allsymwidth(NULL);		/* set the width of all symbols */
+	stats_stop(ST_WIDTH);
 
 	lwidth = ((cfmt.landscape ? cfmt.pageheight : cfmt.pagewidth)
 		- cfmt.leftmargin - cfmt.rightmargin)
@@ -4785,15 +4884,39 @@ void output_music(void)
 		lwidth = 10 CM;
 	}
 	indent = set_indent(1);		/* (keep the indentation flag) */
+	stats_start(ST_CUT);
 	cut_tune(lwidth, indent);
+	stats_stop(ST_CUT);
 	alfa_last = 0.1;
 	beta_last = 0;
+	if (tunenum != sys_tune) {
+		sys_tune = tunenum;
+		nsys = 0;
+	}
 	for (;;) {			/* loop per music line */
 		float line_height;
 
+		if (maxsys > 0 && nsys >= maxsys) {
+
+			/* skip the music lines after the --systems limit */
+			set_piece();
+			update_clefs();
+			tsfirst = tsnext;
+			gen_init();
+			if (!tsfirst)
+				break;
+			new_music_line();
+			continue;
+		}
+		nsys++;
+		trace_begin(TR_LINE, NULL, ++nline);
 		set_piece();
+		set_tslices();
 		indent = set_indent(0);
+		stats_start(ST_GLUE);
 		set_sym_glue(lwidth - indent);
+		stats_stop(ST_GLUE);
+		stats_start(ST_DRAW);
 		if (indent != 0)
 			a2b("%.2f 0 T\n", indent); /* do indentation */
 		line_height = delayed_output(indent);
@@ -4802,9 +4925,11 @@ void output_music(void)
 		if (showerror)
 			error_show();
 		bskip(line_height);
+		stats_stop(ST_DRAW);
 		if (indent != 0)
 			a2b("%.2f 0 T\n", -indent);
 		update_clefs();
+		trace_end(TR_LINE);
 		tsfirst = tsnext;
 		gen_init();
 		if (!tsfirst)
@@ -4813,6 +4938,7 @@ void output_music(void)
 		new_music_line();
 	}
 	outft = -1;
+	stats_stop(ST_MUSIC);
 }
 
 /* -- reset the generator -- */
@@ -64,6 +64,22 @@ struct FORMAT dfmt;			/* current global format */
 unsigned short *micro_tb;		/* ptr to the microtone table of the tune */
 int nbar;				/* current measure number */
 
+/* guitar chord cache (per tune) */
+#define GCH_HASH 256
+struct gch_c {
+	struct gch_c *next;
+	char *text;			/* source text (interned) */
+	char *otext;			/* resulting text */
+	struct gch *gch;		/* guitar chords / annotations */
+	struct FONTSPEC gf, af;		/* gchord and annotation fonts */
+	unsigned char gcf, anf;		/* font indexes */
+	char box;			/* gchordbox */
+	char below;			/* guitar chords below the staff */
+	char transp;			/* transposition active */
+	signed char sf;			/* transposition (in fifths) */
+};
+static struct gch_c *gch_c_tb[GCH_HASH];
+
 static struct voice_opt_s *voice_opts;
 static struct tune_opt_s *tune_opts, *cur_tune_opts;
 static struct brk_s *brks;
@@ -138,7 +154,8 @@ static void mrest_expand(struct SYMBOL *s)
 	s->type = NOTEREST;
 	s->as.type = ABC_T_REST;
 	s->as.u.note.nhd = 0;
-	s->dur = s->as.u.note.lens[0] = dt;
+	s->as.u.note.hd = abc_hd_new(NULL, 1);
+	s->dur = s->as.u.note.hd[0].len = dt;
 	s->head = H_FULL;
 	s->nflags = -2;
 
@@ -160,7 +177,8 @@ static void mrest_expand(struct SYMBOL *s)
 		s2->as.flags = s->as.flags;
 		s2->as.linenum = s->as.linenum;
 		s2->as.colnum = s->as.colnum;
-		s2->dur = s2->as.u.note.lens[0] = dt;
+		s2->as.u.note.hd = abc_hd_new(NULL, 1);
+		s2->dur = s2->as.u.note.hd[0].len = dt;
 		s2->head = H_FULL;
 		s2->nflags = -2;
 		p_voice->time += dt;
@@ -446,7 +464,8 @@ static void voice_compress(void)
 				s2 = (struct SYMBOL *) getarena(sizeof *s);
 				memset(s2, 0, sizeof *s2);
 				s2->type = SPACE;
-				s2->as.u.note.lens[1] = -1;
+				s2->as.u.note.hd = abc_hd_new(NULL, 2);
+				s2->as.u.note.hd[1].len = -1;
 				s2->as.flags = ABC_F_INVIS;
 				s2->voice = s->voice;
 				s2->staff = s->staff;
@@ -510,6 +529,23 @@ static void voice_compress(void)
 	}
 }
 
+/* -- give a copied note its own heads and decorations -- */
+static void note_dup(struct SYMBOL *s)
+{
+	switch (s->as.type) {
+	case ABC_T_NOTE:
+	case ABC_T_REST:
+		s->as.u.note.hd = abc_hd_new(s->as.u.note.hd,
+				s->as.u.note.hd[0].len != 0 ? s->nhd + 1 : 2);
+		s->as.u.note.dc.t = abc_dc_new(&s->as.u.note.dc);
+		break;
+	case ABC_T_BAR:
+	case ABC_T_MREST:
+		s->as.u.bar.dc.t = abc_dc_new(&s->as.u.bar.dc);
+		break;
+	}
+}
+
 /* -- duplicate the voices as required -- */
 static void voice_dup(void)
 {
@@ -548,6 +584,7 @@ static void voice_dup(void)
 			else
 				s2->sflags &= ~S_FLOATING;
 			s2->ly = NULL;
+			note_dup(s2);
 			g = s2->extra;
 			if (!g)
 				continue;
@@ -565,6 +602,7 @@ static void voice_dup(void)
 				s2 = g2;
 				s2->voice = voice;
 				s2->staff = p_voice2->staff;
+				note_dup(s2);
 			}
 		}
 	}
@@ -723,7 +761,9 @@ static void system_init(void)
 {
 	voice_compress();
 	voice_dup();
+	stats_start(ST_SORT);
 	sort_all();			/* define the time / vertical sequences */
+	stats_stop(ST_SORT);
 	if (!tsfirst)
 		return;
 	parsys->nstaff = nstaff;	/* save the number of staves */
@@ -821,7 +861,7 @@ static void do_clip(void)
 					sizeof voice_tb[0].key);
 				break;
 			case TIMESIG:
-				memcpy(&voice_tb[s2->voice].meter, &s2->as.u.meter,
+				memcpy(&voice_tb[s2->voice].meter, s2->as.u.meter,
 					sizeof voice_tb[0].meter);
 				break;
 			}
@@ -917,7 +957,7 @@ static void set_bar_num(void)
 	for ( ; s; s = s->ts_next) {
 		switch (s->type) {
 		case TIMESIG:
-			wmeasure = s->as.u.meter.wmeasure;
+			wmeasure = s->as.u.meter->wmeasure;
 			if (wmeasure == 0)
 				wmeasure = 1;
 			if (s->time < bar_time)
@@ -1062,8 +1102,8 @@ static int acc_same_pitch(int pitch)
 		}
 
 		for (i = 0; i <= s->nhd; i++) {
-			if (s->as.u.note.pits[i] == pitch)
-				return s->as.u.note.accs[i];
+			if (s->as.u.note.hd[i].pit == pitch)
+				return s->as.u.note.hd[i].acc;
 		}
 	}
 	return -1;
@@ -1085,10 +1125,10 @@ static void note_transpose(struct SYMBOL *s)
 		dp -= 7;
 	dp += curvoice->transpose / 3 / 12 * 7;
 	for (i = 0; i <= m; i++) {
-		n = s->as.u.note.pits[i];
-		s->as.u.note.pits[i] += dp;
+		n = s->as.u.note.hd[i].pit;
+		s->as.u.note.hd[i].pit += dp;
 		i1 = cde2fcg[(n + 5 + 16 * 7) % 7];	/* fcgdaeb */
-		a = s->as.u.note.accs[i] & 0x07;
+		a = s->as.u.note.hd[i].acc & 0x07;
 		if (a == 0) {
 			if (curvoice->okey.nacc == 0) {
 				if (sf_old > 0) {
@@ -1116,8 +1156,8 @@ static void note_transpose(struct SYMBOL *s)
 		if (curvoice->ckey.empty != 0) {	/* key none */
 			int other_acc;
 
-			other_acc = acc_same_pitch(s->as.u.note.pits[i]);
-			switch (s->as.u.note.accs[i]) {
+			other_acc = acc_same_pitch(s->as.u.note.hd[i].pit);
+			switch (s->as.u.note.hd[i].acc) {
 			case 0:
 				if (other_acc >= 0 || a == A_NT)
 					continue;
@@ -1134,7 +1174,7 @@ static void note_transpose(struct SYMBOL *s)
 				}
 				break;
 			}
-		} else if (s->as.u.note.accs[i] != 0) {
+		} else if (s->as.u.note.hd[i].acc != 0) {
 			;
 		} else if (curvoice->ckey.nacc > 0) {	/* acc list */
 			i4 = cgd2cde[(unsigned) ((i3 + 16 * 7) % 7)];
@@ -1148,8 +1188,8 @@ static void note_transpose(struct SYMBOL *s)
 		} else {
 			continue;
 		}
-		i1 = s->as.u.note.accs[i] & 0x07;
-		i4 = s->as.u.note.accs[i] >> 3;
+		i1 = s->as.u.note.hd[i].acc & 0x07;
+		i4 = s->as.u.note.hd[i].acc >> 3;
 		if (i4 != 0				/* microtone */
 		 && i1 != a) {				/* different accidental type */
 			n = micro_tb[i4];
@@ -1183,7 +1223,7 @@ static void note_transpose(struct SYMBOL *s)
 				i4 = 0;
 			}
 		}
-		s->as.u.note.accs[i] = (i4 << 3) | a;
+		s->as.u.note.hd[i].acc = (i4 << 3) | a;
 	}
 }
 
@@ -1333,10 +1373,46 @@ static void gch_transpose(struct SYMBOL *s)
 	strcpy(new_txt, p);
 }
 
+/* -- set the key of a guitar chord in the cache -- */
+static void gch_c_key(struct gch_c *gc, struct SYMBOL *s)
+{
+	gc->text = s->as.text;
+	gc->gf = cfmt.font_tb[cfmt.gcf];
+	gc->af = cfmt.font_tb[cfmt.anf];
+	gc->gcf = cfmt.gcf;
+	gc->anf = cfmt.anf;
+	gc->box = cfmt.gchordbox;
+	gc->below = s->posit.gch == SL_BELOW;
+	gc->transp = curvoice->transpose != 0;
+	gc->sf = gc->transp ? curvoice->ckey.sf - curvoice->okey.sf : 0;
+}
+
+/* -- search a guitar chord in the cache -- */
+static struct gch_c *gch_c_get(struct gch_c *key)
+{
+	struct gch_c *gc;
+
+	gc = gch_c_tb[((unsigned long) key->text >> 3) % GCH_HASH];
+	for ( ; gc; gc = gc->next) {
+		if (gc->text == key->text
+		 && gc->gcf == key->gcf
+		 && gc->anf == key->anf
+		 && gc->box == key->box
+		 && gc->below == key->below
+		 && gc->transp == key->transp
+		 && gc->sf == key->sf
+		 && memcmp(&gc->gf, &key->gf, sizeof gc->gf) == 0
+		 && memcmp(&gc->af, &key->af, sizeof gc->af) == 0)
+			return gc;
+	}
+	return NULL;
+}
+
 /* -- build the guitar chords / annotations -- */
 static void gch_build(struct SYMBOL *s)
 {
 	struct gch *gch;
+	struct gch_c key, *gc;
 	char *p, *q, antype, sep;
 	float w, h_ann, h_gch, y_above, y_below, y_left, y_right;
 	float xspc;
@@ -1344,9 +1420,24 @@ static void gch_build(struct SYMBOL *s)
 
 	if (s->posit.gch == SL_HIDDEN)
 		return;
+
+	/* a same guitar chord in a same context is built only once */
+	gch_c_key(&key, s);
+	gc = gch_c_get(&key);
+	if (gc) {
+		s->as.text = gc->otext;
+		s->gch = gc->gch;
+		return;
+	}
+
 	s->gch = getarena(sizeof *s->gch * MAXGCH);
 	memset(s->gch, 0, sizeof *s->gch * MAXGCH);
 
+	/* the text is shared (interned) and it is changed by the split */
+	p = getarena(strlen(s->as.text) + 1);
+	strcpy(p, s->as.text);
+	s->as.text = p;
+
 	if (curvoice->transpose != 0)
 		gch_transpose(s);
 
@@ -1575,6 +1666,15 @@ static void gch_build(struct SYMBOL *s)
 			break;
 		}
 	}
+
+	/* put the result in the cache */
+	gc = getarena(sizeof *gc);
+	*gc = key;
+	gc->otext = s->as.text;
+	gc->gch = s->gch;
+	ix = ((unsigned long) gc->text >> 3) % GCH_HASH;
+	gc->next = gch_c_tb[ix];
+	gch_c_tb[ix] = gc;
 }
 
 /* get the note which will receive a lyric word */
@@ -1873,8 +1973,7 @@ static char tx_wrong_dur[] = "Wrong duration in voice overlay";
 			cfmt.abc2pscompat = 0;
 		}
 		clone = p_voice->clone >= 0;
-		p_voice2->id[0] = '&';
-		p_voice2->id[1] = '\0';
+		p_voice2->id = abc_intern("&");
 		p_voice2->second = 1;
 		parsys->voice[voice2].second = 1;
 		p_voice2->scale = p_voice->scale;
@@ -1901,7 +2000,7 @@ static char tx_wrong_dur[] = "Wrong duration in voice overlay";
 			}
 			if (voice3 > 0) {
 				p_voice3 = &voice_tb[voice3];
-				strcpy(p_voice3->id, p_voice2->id);
+				p_voice3->id = p_voice2->id;
 				p_voice3->second = 1;
 				parsys->voice[voice3].second = 1;
 				p_voice3->scale = voice_tb[p_voice->clone].scale;
@@ -2031,7 +2130,7 @@ static void parse_staves(struct SYMBOL *s,
 			}
 			{
 				int i, v;
-				char sep, *q;
+				char sep, *q, *id;
 
 				q = p;
 				while (isalnum((unsigned char) *p) || *p == '_')
@@ -2041,8 +2140,9 @@ static void parse_staves(struct SYMBOL *s,
 
 				/* search the voice in the voice table */
 				v = -1;
+				id = abc_intern(q);
 				for (i = 0; i < MAXVOICE; i++) {
-					if (strcmp(q, voice_tb[i].id) == 0) {
+					if (voice_tb[i].id == id) {
 						v = i;
 						break;
 					}
@@ -2974,9 +3074,9 @@ static void adjust_dur(struct SYMBOL *s)
 				int i, head, dots, nflags;
 
 				for (i = 0; i <= s2->nhd; i++)
-					s2->as.u.note.lens[i] = s2->as.u.note.lens[i]
+					s2->as.u.note.hd[i].len = s2->as.u.note.hd[i].len
 						 * curvoice->wmeasure / auto_time;
-				identify_note(s2, s2->as.u.note.lens[0],
+				identify_note(s2, s2->as.u.note.hd[0].len,
 						&head, &dots, &nflags);
 				s2->head = head;
 				s2->dots = dots;
@@ -3122,6 +3222,7 @@ void do_tune(struct abctune *t)
 
 	/* initialize */
 	lvlarena(0);
+	memset(gch_c_tb, 0, sizeof gch_c_tb);
 	nstaff = 0;
 	staves_found = -1;
 	memset(staff_tb, 0, sizeof staff_tb);
@@ -3174,23 +3275,29 @@ void do_tune(struct abctune *t)
 		case ABC_T_NOTE:
 		case ABC_T_REST:
 			s = (struct SYMBOL *) as;
-			s->dur = s->as.u.note.lens[0];
+			s->dur = s->as.u.note.hd[0].len;
 			break;
 		case ABC_T_INFO:
 			if (as->text[0] == 'V') {
 				int v;
 
-				v = as->u.voice.voice;
-				if (voice_tb[v].id[0] == '\0')
-					strcpy(voice_tb[v].id, as->u.voice.id);
+				v = as->u.voice->voice;
+				if (!voice_tb[v].id)
+					voice_tb[v].id = as->u.voice->id;
 			}
 			break;
 		}
 	}
 
-	if (voice_tb[0].id[0] == '\0') {	/* single voice */
-		voice_tb[0].id[0] = '1';	/* implicit V:1 */
-		voice_tb[0].id[1] = '\0';
+	if (!voice_tb[0].id)			/* single voice */
+		voice_tb[0].id = abc_intern("1");	/* implicit V:1 */
+	{
+		int v;
+
+		for (v = 1; v < MAXVOICE; v++) {
+			if (!voice_tb[v].id)
+				voice_tb[v].id = abc_intern("");
+		}
 	}
 
 	/* scan the tune */
@@ -3296,6 +3403,7 @@ void do_tune(struct abctune *t)
 			}
 			s2 = sym_add(curvoice, NOTEREST);
 			s2->as.type = ABC_T_REST;
+			s2->as.u.note.hd = abc_hd_new(NULL, 1);
 			s2->as.linenum = as->linenum;
 			s2->as.colnum = as->colnum;
 			s2->as.flags |= ABC_F_INVIS;
@@ -3314,6 +3422,7 @@ void do_tune(struct abctune *t)
 					s2->as.u.bar.len = as->u.bar.len;
 				s2 = sym_add(curvoice, NOTEREST);
 				s2->as.type = ABC_T_REST;
+				s2->as.u.note.hd = abc_hd_new(NULL, 1);
 				s2->as.linenum = as->linenum;
 				s2->as.colnum = as->colnum;
 				s2->as.flags |= ABC_F_INVIS;
@@ -3425,7 +3534,7 @@ static void get_clef(struct SYMBOL *s)
 			}
 			return;
 		case 'V':	/* clef relative to a voice definition in the header */
-			p_voice = &voice_tb[(int) s->as.prev->u.voice.voice];
+			p_voice = &voice_tb[(int) s->as.prev->u.voice->voice];
 			break;
 		}
 	}
@@ -3808,20 +3917,20 @@ static void get_meter(struct SYMBOL *s)
 		for (i = MAXVOICE, p_voice = voice_tb;
 		     --i >= 0;
 		     p_voice++) {
-			memcpy(&p_voice->meter, &s->as.u.meter,
+			memcpy(&p_voice->meter, s->as.u.meter,
 			       sizeof p_voice->meter);
-			p_voice->wmeasure = s->as.u.meter.wmeasure;
+			p_voice->wmeasure = s->as.u.meter->wmeasure;
 		}
 		break;
 	case ABC_S_TUNE:
-		curvoice->wmeasure = s->as.u.meter.wmeasure;
+		curvoice->wmeasure = s->as.u.meter->wmeasure;
 		if (is_tune_sig()) {
-			memcpy(&curvoice->meter, &s->as.u.meter,
+			memcpy(&curvoice->meter, s->as.u.meter,
 				       sizeof curvoice->meter);
 			reset_gen();	/* (display the time signature) */
 			break;
 		}
-		if (s->as.u.meter.nmeter == 0)
+		if (s->as.u.meter->nmeter == 0)
 			break;		/* M:none */
 		sym_link(s, TIMESIG);
 		break;
@@ -3834,14 +3943,14 @@ static void get_voice(struct SYMBOL *s)
 	struct VOICE_S *p_voice;
 	int voice;
 
-	voice = s->as.u.voice.voice;
+	voice = s->as.u.voice->voice;
 	p_voice = &voice_tb[voice];
 	if (parsys->voice[voice].range < 0) {
 		if (cfmt.alignbars) {
 			error(1, s, "V: does not work with %%%%alignbars");
 		}
 		if (staves_found < 0) {
-			if (!s->as.u.voice.merge) {
+			if (!s->as.u.voice->merge) {
 #if MAXSTAFF < MAXVOICE
 				if (nstaff >= MAXSTAFF - 1) {
 					error(1, s, "Too many staves");
@@ -3873,15 +3982,15 @@ static void get_voice(struct SYMBOL *s)
 	}
 
 	/* if something has changed, update */
-	if (s->as.u.voice.octave != NO_OCTAVE)
-		p_voice->octave = s->as.u.voice.octave;
-	if (s->as.u.voice.fname != 0) {
-		p_voice->nm = s->as.u.voice.fname;
+	if (s->as.u.voice->octave != NO_OCTAVE)
+		p_voice->octave = s->as.u.voice->octave;
+	if (s->as.u.voice->fname != 0) {
+		p_voice->nm = s->as.u.voice->fname;
 		p_voice->new_name = 1;
 	}
-	if (s->as.u.voice.nname != 0)
-		p_voice->snm = s->as.u.voice.nname;
-	switch (s->as.u.voice.dyn) {
+	if (s->as.u.voice->nname != 0)
+		p_voice->snm = s->as.u.voice->nname;
+	switch (s->as.u.voice->dyn) {
 	case 1:
 		p_voice->posit.dyn = SL_ABOVE;
 		p_voice->posit.vol = SL_ABOVE;
@@ -3891,7 +4000,7 @@ static void get_voice(struct SYMBOL *s)
 		p_voice->posit.vol = SL_BELOW;
 		break;
 	}
-	switch (s->as.u.voice.lyrics) {
+	switch (s->as.u.voice->lyrics) {
 	case 1:
 		p_voice->posit.voc = SL_ABOVE;
 		break;
@@ -3899,7 +4008,7 @@ static void get_voice(struct SYMBOL *s)
 		p_voice->posit.voc = SL_BELOW;
 		break;
 	}
-	switch (s->as.u.voice.gchord) {
+	switch (s->as.u.voice->gchord) {
 	case 1:
 		p_voice->posit.gch = SL_ABOVE;
 		break;
@@ -3907,7 +4016,7 @@ static void get_voice(struct SYMBOL *s)
 		p_voice->posit.gch = SL_BELOW;
 		break;
 	}
-	switch (s->as.u.voice.stem) {
+	switch (s->as.u.voice->stem) {
 	case 1:
 		p_voice->posit.std = SL_ABOVE;
 		break;
@@ -3918,7 +4027,7 @@ static void get_voice(struct SYMBOL *s)
 		p_voice->posit.std = 0;		/* auto */
 		break;
 	}
-	switch (s->as.u.voice.gstem) {
+	switch (s->as.u.voice->gstem) {
 	case 1:
 		p_voice->posit.gsd = SL_ABOVE;
 		break;
@@ -3929,8 +4038,8 @@ static void get_voice(struct SYMBOL *s)
 		p_voice->posit.gsd = 0;		/* auto */
 		break;
 	}
-	if (s->as.u.voice.scale != 0)
-		p_voice->scale = s->as.u.voice.scale;
+	if (s->as.u.voice->scale != 0)
+		p_voice->scale = s->as.u.voice->scale;
 
 	set_tblt(p_voice);
 
@@ -3942,24 +4051,16 @@ static void get_voice(struct SYMBOL *s)
 /* sort the notes of the chord by pitch (lowest first) */
 void sort_pitch(struct SYMBOL *s, int combine)
 {
+	struct notehd hd;
 	int i, nx, k;
 	for (;;) {
 		nx = 0;
 		for (i = 1; i <= s->nhd; i++) {
-			if (s->as.u.note.pits[i] >= s->as.u.note.pits[i-1])
+			if (s->as.u.note.hd[i].pit >= s->as.u.note.hd[i-1].pit)
 				continue;
-#define xch(f) \
-	k = s->as.u.note.f[i]; \
-	s->as.u.note.f[i] = s->as.u.note.f[i-1]; \
-	s->as.u.note.f[i-1] = k
-			xch(pits);
-			xch(lens);
-			xch(accs);
-			xch(sl1);
-			xch(sl2);
-			xch(ti1);
-			xch(decs);
-#undef xch
+			hd = s->as.u.note.hd[i];
+			s->as.u.note.hd[i] = s->as.u.note.hd[i - 1];
+			s->as.u.note.hd[i - 1] = hd;
 			if (combine) {
 				k = s->pits[i];
 				s->pits[i] = s->pits[i-1];
@@ -3983,7 +4084,7 @@ static void get_note(struct SYMBOL *s)
 
 	if (curvoice->octave != 0) {
 		for (i = 0; i <= m; i++)
-			s->as.u.note.pits[i] += curvoice->octave * 7;
+			s->as.u.note.hd[i].pit += curvoice->octave * 7;
 	}
 
 	if (curvoice->perc)
@@ -4015,7 +4116,7 @@ static void get_note(struct SYMBOL *s)
 			div = 8;
 		}
 		for (i = 0; i <= m; i++)
-			s->as.u.note.lens[i] /= div;
+			s->as.u.note.hd[i].len /= div;
 		s->dur /= div;
 	}
 
@@ -4025,7 +4126,7 @@ static void get_note(struct SYMBOL *s)
 		deco_cnv(&s->as.u.note.dc, s, prev);
 
 	/* insert the note/rest in the voice */
-	sym_link(s,  s->as.u.note.lens[0] != 0 ? NOTEREST : SPACE);
+	sym_link(s,  s->as.u.note.hd[0].len != 0 ? NOTEREST : SPACE);
 	if (!(s->as.flags & ABC_F_GRACE))
 		curvoice->time += s->dur;
 	s->nohdix = -1;
@@ -4034,11 +4135,11 @@ static void get_note(struct SYMBOL *s)
 	if (s->as.type == ABC_T_REST) {
 		if (s->dur == curvoice->wmeasure) {
 			if (s->dur < BASE_LEN * 2)
-				s->as.u.note.lens[0] = BASE_LEN;
+				s->as.u.note.hd[0].len = BASE_LEN;
 			else if (s->dur < BASE_LEN * 4)
-				s->as.u.note.lens[0] = BASE_LEN * 2;
+				s->as.u.note.hd[0].len = BASE_LEN * 2;
 			else
-				s->as.u.note.lens[0] = BASE_LEN * 4;
+				s->as.u.note.hd[0].len = BASE_LEN * 4;
 		}
 	} else {
 
@@ -4046,21 +4147,22 @@ static void get_note(struct SYMBOL *s)
 		sort_pitch(s, 0);
 	}
 
-	memcpy(s->pits, s->as.u.note.pits, sizeof s->pits);
+	for (i = 0; i <= m; i++)
+		s->pits[i] = s->as.u.note.hd[i].pit;
 
 	/* get the max head type, number of dots and number of flags */
 	{
 		int head, dots, nflags, l;
 
-		if ((l = s->as.u.note.lens[0]) != 0) {
+		if ((l = s->as.u.note.hd[0].len) != 0) {
 			identify_note(s, l, &head, &dots, &nflags);
 			s->head = head;
 			s->dots = dots;
 			s->nflags = nflags;
 			for (i = 1; i <= m; i++) {
-				if (s->as.u.note.lens[i] == l)
+				if (s->as.u.note.hd[i].len == l)
 					continue;
-				identify_note(s, s->as.u.note.lens[i],
+				identify_note(s, s->as.u.note.hd[i].len,
 						&head, &dots, &nflags);
 				if (head > s->head)
 					s->head = head;
@@ -4091,11 +4193,11 @@ static void get_note(struct SYMBOL *s)
 	}
 
 	for (i = 0; i <= m; i++) {
-		if (s->as.u.note.sl1[i] != 0)
+		if (s->as.u.note.hd[i].sl1 != 0)
 			s->sflags |= S_SL1;
-		if (s->as.u.note.sl2[i] != 0)
+		if (s->as.u.note.hd[i].sl2 != 0)
 			s->sflags |= S_SL2;
-		if (s->as.u.note.ti1[i] != 0)
+		if (s->as.u.note.hd[i].ti1 != 0)
 			s->sflags |= S_TI1;
 	}
 
@@ -5131,7 +5233,7 @@ static void set_tuplet(struct SYMBOL *t)
 				default:
 					continue;
 				}
-				if (as2->u.note.lens[0] == 0)
+				if (as2->u.note.hd[0].len == 0)
 					continue;
 				if (grace ^ (as2->flags & ABC_F_GRACE))
 					continue;
@@ -5167,7 +5269,7 @@ static void set_tuplet(struct SYMBOL *t)
 		default:
 			continue;
 		}
-		if (as->u.note.lens[0] == 0)	/* space ('y') */
+		if (as->u.note.hd[0].len == 0)	/* space ('y') */
 			continue;
 		if (grace ^ (as->flags & ABC_F_GRACE))
 			continue;
@@ -5203,7 +5305,7 @@ static void set_tuplet(struct SYMBOL *t)
 				if (as->type != ABC_T_NOTE
 				 && as->type != ABC_T_REST)
 					continue;
-				if (as->u.note.lens[0] == 0)
+				if (as->u.note.hd[0].len == 0)
 					continue;
 				if (grace ^ (as->flags & ABC_F_GRACE))
 					continue;
@@ -5216,7 +5318,7 @@ static void set_tuplet(struct SYMBOL *t)
 		}
 		if (as->type != ABC_T_NOTE && as->type != ABC_T_REST)
 			continue;
-		if (as->u.note.lens[0] == 0)
+		if (as->u.note.hd[0].len == 0)
 			continue;
 		if (grace ^ (as->flags & ABC_F_GRACE))
 			continue;
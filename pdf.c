@@ -0,0 +1,371 @@
+/*
+ * PDF output.
+ *
+ * The pages come from the display list of dlist.c. The symbols of the
+ * display list become Form XObjects which are written only once. The
+ * texts use the standard Type 1 fonts of the PDF viewers (WinAnsi),
+ * the TrueType fonts found by dlist.c, embedded with their used glyphs
+ * (Identity-H encoding and ToUnicode map), and, for the other CJK
+ * characters, the CJK fonts of the PDF viewers (UCS-2 encodings).
+ * All the pages and symbols share the same resource dictionary.
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+
+#include "abc2ps.h"
+
+static FILE *pdf_f;			/* PDF file */
+static long pdf_len;			/* bytes written */
+static long *obj_off;			/* object offsets */
+static int nobj, obj_sz;
+static int *page_tb;			/* page objects */
+static int npages, page_sz;
+
+/* reserved objects, written at end of file */
+#define O_CATALOG 1
+#define O_PAGES 2
+#define O_RES 3				/* shared resources */
+#define O_INFO 4
+
+static int font_obj[DL_NFONTS];		/* object of the used fonts */
+
+/* -- out of memory -- */
+static void pdf_oom(void)
+{
+	fprintf(stderr, "Out of memory.\n");
+	exit(EXIT_FAILURE);
+}
+
+/* -- output to the PDF file -- */
+static void pdf_printf(const char *fmt, ...)
+{
+	va_list args;
+	int l;
+
+	va_start(args, fmt);
+	l = vfprintf(pdf_f, fmt, args);
+	va_end(args);
+	if (l > 0)
+		pdf_len += l;
+}
+
+/* -- create a new object -- */
+static int obj_new(void)
+{
+	if (++nobj >= obj_sz) {
+		obj_sz = obj_sz * 2 + 64;
+		obj_off = realloc(obj_off, obj_sz * sizeof *obj_off);
+		if (!obj_off)
+			pdf_oom();
+	}
+	obj_off[nobj] = 0;
+	return nobj;
+}
+
+/* -- start an object -- */
+static void obj_begin(int n)
+{
+	obj_off[n] = pdf_len;
+	pdf_printf("%d 0 obj\n", n);
+}
+
+/* -- output a stream object -- */
+static void obj_stream(int n, char *dict, char *p, int len)
+{
+	obj_begin(n);
+	pdf_printf("<<%s/Length %d>>\nstream\n", dict, len);
+	fwrite(p, 1, len, pdf_f);
+	pdf_len += len;
+	pdf_printf("\nendstream\nendobj\n");
+}
+
+/* -- output a TrueType font -- */
+static void ttf_out(struct DLFONT *t)
+{
+	struct ttf_m *m;
+	unsigned char *font, *z;
+	char *cmap, *p, tag[8], dict[64];
+	long len, zlen;
+	int i, n, g, u, o_cid, o_desc, o_file, o_uni;
+	unsigned h;
+
+	m = ttf_metrics(t->ttf);
+	font = ttf_subset(t->ttf, t->used, &len);
+	z = z_deflate(font, len, &zlen, Z_ZLIB);
+	if (!z)
+		pdf_oom();
+	h = 0;					/* subset tag */
+	for (g = 0; g < m->ng; g++) {
+		if (t->used[g >> 3] & (1 << (g & 7)))
+			h = h * 31 + g;
+	}
+	for (i = 0; i < 6; i++) {
+		tag[i] = 'A' + h % 26;
+		h /= 26;
+	}
+	tag[6] = '\0';
+	o_cid = obj_new();
+	o_desc = obj_new();
+	o_file = obj_new();
+	o_uni = obj_new();
+
+	obj_begin(t->obj);
+	pdf_printf("<</Type/Font/Subtype/Type0/BaseFont/%s+%s"
+		"/Encoding/Identity-H\n/DescendantFonts[%d 0 R]"
+		"/ToUnicode %d 0 R>>\nendobj\n",
+		tag, m->name, o_cid, o_uni);
+	obj_begin(o_cid);
+	pdf_printf("<</Type/Font/Subtype/CIDFontType2/BaseFont/%s+%s\n"
+		"/CIDSystemInfo<</Registry(Adobe)/Ordering(Identity)"
+		"/Supplement 0>>\n/FontDescriptor %d 0 R"
+		"/CIDToGIDMap/Identity\n/W[",
+		tag, m->name, o_desc);
+	n = 0;
+	for (g = 0; g < m->ng; g++) {
+		if (!(t->used[g >> 3] & (1 << (g & 7))))
+			continue;
+		pdf_printf("%s%d[%d]", ++n % 8 == 0 ? "\n" : " ",
+			g, (int) (ttf_adv(t->ttf, g) * 1000 + .5));
+	}
+	pdf_printf("]>>\nendobj\n");
+	obj_begin(o_desc);
+	pdf_printf("<</Type/FontDescriptor/FontName/%s+%s/Flags 4\n"
+		"/FontBBox[%d %d %d %d]/ItalicAngle %d/Ascent %d/Descent %d"
+		"/CapHeight %d/StemV 80/FontFile2 %d 0 R>>\nendobj\n",
+		tag, m->name,
+		m->bbox[0], m->bbox[1], m->bbox[2], m->bbox[3],
+		m->italic, m->ascent, m->descent, m->capheight, o_file);
+	sprintf(dict, "/Filter/FlateDecode/Length1 %ld", len);
+	obj_stream(o_file, dict, (char *) z, zlen);
+	free(z);
+	free(font);
+
+	/* unicode of the glyphs */
+	cmap = malloc(512 + t->nused * 24);
+	if (!cmap)
+		pdf_oom();
+	p = cmap;
+	p += sprintf(p, "/CIDInit/ProcSet findresource begin\n"
+		"12 dict begin\nbegincmap\n"
+		"/CIDSystemInfo<</Registry(Adobe)/Ordering(UCS)"
+		"/Supplement 0>>def\n"
+		"/CMapName/Adobe-Identity-UCS def\n/CMapType 2 def\n"
+		"1 begincodespacerange\n<0000><FFFF>\nendcodespacerange\n");
+	n = 0;
+	for (g = 0; g < m->ng; g++) {
+		u = t->uni[g];
+		if (u == 0)
+			continue;
+		if (n % 100 == 0) {
+			if (n != 0)
+				p += sprintf(p, "endbfchar\n");
+			p += sprintf(p, "%d beginbfchar\n",
+				t->nused - n < 100 ? t->nused - n : 100);
+		}
+		if (u < 0x10000)
+			p += sprintf(p, "<%04X><%04X>\n", g, u);
+		else
+			p += sprintf(p, "<%04X><%04X%04X>\n", g,
+				0xd800 + ((u - 0x10000) >> 10),
+				0xdc00 + ((u - 0x10000) & 0x3ff));
+		n++;
+	}
+	if (n != 0)
+		p += sprintf(p, "endbfchar\n");
+	p += sprintf(p, "endcmap\n"
+		"CMapName currentdict/CMap defineresource pop\n"
+		"end\nend\n");
+	obj_stream(o_uni, "", cmap, p - cmap);
+	free(cmap);
+}
+
+/* -- output a CJK font of the PDF viewers -- */
+static void cjk_out(struct DLFONT *t)
+{
+	int o_cid, o_desc;
+
+	o_cid = obj_new();
+	o_desc = obj_new();
+	obj_begin(t->obj);
+	pdf_printf("<</Type/Font/Subtype/Type0/BaseFont/%s-%s"
+		"/Encoding/%s\n/DescendantFonts[%d 0 R]>>\nendobj\n",
+		t->name, t->cmap, t->cmap, o_cid);
+	obj_begin(o_cid);
+	pdf_printf("<</Type/Font/Subtype/CIDFontType0/BaseFont/%s\n"
+		"/CIDSystemInfo<</Registry(Adobe)/Ordering(%s)"
+		"/Supplement %d>>\n/FontDescriptor %d 0 R/DW 1000>>\n"
+		"endobj\n",
+		t->name, t->ordering, t->supplement, o_desc);
+	obj_begin(o_desc);
+	pdf_printf("<</Type/FontDescriptor/FontName/%s/Flags 4\n"
+		"/FontBBox[0 -200 1000 900]/ItalicAngle 0/Ascent 880"
+		"/Descent -120/CapHeight 880/StemV 80>>\nendobj\n",
+		t->name);
+}
+
+/* -- start the PDF output -- */
+void pdf_open(FILE *f)
+{
+	struct DLSYM *x;
+	int i;
+
+	pdf_f = f;
+	pdf_len = 0;
+	nobj = 0;
+	npages = 0;
+	for (x = dl.syms; x; x = x->next)
+		x->obj = 0;
+	for (i = 0; i < dl.ntfonts; i++)
+		dl.tfonts[i].obj = 0;
+	memset(font_obj, 0, sizeof font_obj);
+	obj_new();				/* O_CATALOG */
+	obj_new();				/* O_PAGES */
+	obj_new();				/* O_RES */
+	obj_new();				/* O_INFO */
+	pdf_printf("%%PDF-1.4\n%%\342\343\317\323\n");
+}
+
+/* -- output the page of the display list -- */
+void pdf_page(void)
+{
+	struct DLSYM *x;
+	int i, n;
+
+	for (i = 0; i < DL_NFONTS; i++) {
+		if (dl.fonts[i] && !font_obj[i])
+			font_obj[i] = obj_new();
+	}
+	for (i = 0; i < dl.ntfonts; i++) {
+		if (dl.tfonts[i].nused && !dl.tfonts[i].obj)
+			dl.tfonts[i].obj = obj_new();
+	}
+	for (x = dl.syms; x; x = x->next) {	/* new symbols */
+		if (x->obj)
+			continue;
+		x->obj = obj_new();
+		obj_stream(x->obj, "/Type/XObject/Subtype/Form"
+				"/BBox[-2000 -2000 2000 2000]"
+				"/Resources 3 0 R", x->ops, x->len);
+	}
+	n = obj_new();
+	obj_stream(n, "", dl.ops, dl.len);
+	if (npages >= page_sz) {
+		page_sz = page_sz * 2 + 16;
+		page_tb = realloc(page_tb, page_sz * sizeof *page_tb);
+		if (!page_tb)
+			pdf_oom();
+	}
+	page_tb[npages] = obj_new();
+	obj_begin(page_tb[npages]);
+	pdf_printf("<</Type/Page/Parent %d 0 R/MediaBox[0 0 %.2f %.2f]\n"
+		"/Resources %d 0 R/Contents %d 0 R>>\nendobj\n",
+		O_PAGES, dl.w, dl.h, O_RES, n);
+	npages++;
+}
+
+/* -- end of the PDF output -- */
+/* return the size of the file */
+long pdf_close(void)
+{
+	struct DLSYM *x;
+	struct DLFONT *t;
+	time_t ltime;
+	long xref;
+	unsigned i;
+
+	/* fonts */
+	for (i = 0; i < DL_NFONTS; i++) {
+		if (!font_obj[i])
+			continue;
+		obj_begin(font_obj[i]);
+		pdf_printf("<</Type/Font/Subtype/Type1/BaseFont/%s%s>>\n"
+			"endobj\n",
+			dl_fontname(i),
+			i < 12 ? "/Encoding/WinAnsiEncoding" : "");
+	}
+	for (i = 0, t = dl.tfonts; i < (unsigned) dl.ntfonts; i++, t++) {
+		if (!t->obj)
+			continue;
+		if (t->ttf)
+			ttf_out(t);
+		else
+			cjk_out(t);
+	}
+
+	/* shared resources */
+	obj_begin(O_RES);
+	pdf_printf("<</ProcSet[/PDF/Text]\n/Font<<");
+	for (i = 0; i < DL_NFONTS; i++) {
+		if (font_obj[i])
+			pdf_printf("/F%d %d 0 R", i, font_obj[i]);
+	}
+	for (i = 0; i < (unsigned) dl.ntfonts; i++) {
+		if (dl.tfonts[i].obj)
+			pdf_printf("/T%d %d 0 R", i, dl.tfonts[i].obj);
+	}
+	pdf_printf(">>\n/XObject<<");
+	for (x = dl.syms; x; x = x->next) {
+		if (x->obj)
+			pdf_printf("%s %d 0 R\n", x->ename, x->obj);
+	}
+	pdf_printf(">>>>\nendobj\n");
+
+	/* page tree, catalog and information */
+	obj_begin(O_PAGES);
+	pdf_printf("<</Type/Pages/Count %d/Kids[", npages);
+	for (i = 0; i < (unsigned) npages; i++)
+		pdf_printf("%s%d 0 R", i % 8 == 7 ? "\n" : " ", page_tb[i]);
+	pdf_printf("]>>\nendobj\n");
+	obj_begin(O_CATALOG);
+	pdf_printf("<</Type/Catalog/Pages %d 0 R>>\nendobj\n", O_PAGES);
+	time(&ltime);
+	strftime(tex_buf, TEX_BUF_SZ, "%Y%m%d%H%M%S", localtime(&ltime));
+	obj_begin(O_INFO);
+	pdf_printf("<</Creator(abcm2ps-" VERSION ")/CreationDate(D:%s)>>\n"
+		"endobj\n", tex_buf);
+
+	/* cross-reference table */
+	xref = pdf_len;
+	pdf_printf("xref\n0 %d\n0000000000 65535 f \n", nobj + 1);
+	for (i = 1; i <= (unsigned) nobj; i++)
+		pdf_printf("%010ld 00000 n \n", obj_off[i]);
+	pdf_printf("trailer\n<</Size %d/Root %d 0 R/Info %d 0 R>>\n"
+		"startxref\n%ld\n%%%%EOF\n",
+		nobj + 1, O_CATALOG, O_INFO, xref);
+
+	/* the glyphs of the next file */
+	for (i = 0, t = dl.tfonts; i < (unsigned) dl.ntfonts; i++, t++) {
+		if (t->ttf) {
+			memset(t->used, 0, (ttf_metrics(t->ttf)->ng + 7) / 8);
+			memset(t->uni, 0,
+				ttf_metrics(t->ttf)->ng * sizeof *t->uni);
+		}
+		t->nused = 0;
+		t->obj = 0;
+	}
+	if (pdf_f != stdout)
+		fclose(pdf_f);
+	else
+		fflush(pdf_f);
+	pdf_f = NULL;
+	return pdf_len;
+}
@@ -0,0 +1,836 @@
+/*
+ * PNG output.
+ *
+ * The display list of a page or tune (dlist.c) is drawn here by a small
+ * anti-aliased scanline rasterizer (paths, strokes and the music
+ * symbols).
+ * The texts are drawn from the glyph outlines of the TrueType fonts
+ * found by dlist.c. Without such fonts (standard PDF fonts and CJK
+ * fonts of the PDF viewers), they are drawn as greyed bars having the
+ * width of the words (this is enough for thumbnails).
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#include "abc2ps.h"
+
+float png_dpi = 72;			/* resolution (--dpi) */
+
+#define SS 4				/* sub-scanlines per pixel */
+#define MAXSIZE 16000			/* maximum image width / height */
+
+static FILE *png_f;			/* PNG file */
+
+static unsigned char *img;		/* RGB image */
+static int img_w, img_h;
+static float *cov;			/* coverage of a pixel row */
+
+/* graphic state */
+#define MAXDASH 8
+static struct gstate {
+	float ctm[6];
+	float fill[3], stroke[3];
+	float lw;			/* line width */
+	float dash[MAXDASH];
+	int ndash;
+	int cap;			/* line cap */
+	int font;			/* text */
+	float size, hscale;
+} gs, gs_tb[32];
+static int gs_depth;
+
+/* path (in device space) */
+static struct pt {
+	float x, y;
+} *pts;
+static int npts, pts_sz;
+static struct sub {			/* subpaths */
+	int start, n;
+	char closed;
+} *subs;
+static int nsubs, subs_sz;
+static float cur_x, cur_y;		/* current point (user space) */
+
+/* polygon edges (in device space) */
+static struct edge {
+	float x0, y0, x1, y1;
+	int dir;
+} *edges;
+static int nedges, edges_sz;
+
+/* text */
+static float tm[6];			/* text matrix */
+
+/* -- out of memory -- */
+static void png_oom(void)
+{
+	fprintf(stderr, "Out of memory.\n");
+	exit(EXIT_FAILURE);
+}
+
+/* -- grow a table -- */
+static void *grow(void *p, int *sz, int elsz)
+{
+	*sz = *sz * 2 + 256;
+	p = realloc(p, *sz * elsz);
+	if (!p)
+		png_oom();
+	return p;
+}
+
+/* -- transform a point -- */
+static void xform(float *m, float x, float y, float *px, float *py)
+{
+	*px = m[0] * x + m[2] * y + m[4];
+	*py = m[1] * x + m[3] * y + m[5];
+}
+
+/* -- multiply the CTM by a matrix -- */
+static void concat(float *ctm, float *m)
+{
+	float r[6];
+
+	r[0] = m[0] * ctm[0] + m[1] * ctm[2];
+	r[1] = m[0] * ctm[1] + m[1] * ctm[3];
+	r[2] = m[2] * ctm[0] + m[3] * ctm[2];
+	r[3] = m[2] * ctm[1] + m[3] * ctm[3];
+	r[4] = m[4] * ctm[0] + m[5] * ctm[2] + ctm[4];
+	r[5] = m[4] * ctm[1] + m[5] * ctm[3] + ctm[5];
+	memcpy(ctm, r, sizeof r);
+}
+
+/* -- add a point to the path -- */
+static void path_pt(float x, float y)
+{
+	if (npts >= pts_sz)
+		pts = grow(pts, &pts_sz, sizeof *pts);
+	xform(gs.ctm, x, y, &pts[npts].x, &pts[npts].y);
+	npts++;
+	subs[nsubs - 1].n++;
+	cur_x = x;
+	cur_y = y;
+}
+
+/* -- start a subpath -- */
+static void path_move(float x, float y)
+{
+	if (nsubs > 0 && subs[nsubs - 1].n <= 1) {
+		nsubs--;			/* remove the lone moveto */
+		npts = subs[nsubs].start;
+	}
+	if (nsubs >= subs_sz)
+		subs = grow(subs, &subs_sz, sizeof *subs);
+	subs[nsubs].start = npts;
+	subs[nsubs].n = 0;
+	subs[nsubs].closed = 0;
+	nsubs++;
+	path_pt(x, y);
+}
+
+/* -- add a Bezier curve to the path -- */
+static void path_curve(float x1, float y1, float x2, float y2,
+			float x3, float y3)
+{
+	float x0, y0, dx, dy, l, t, u;
+	float ax, ay, bx, by, cx, cy, dx2, dy2;
+	int i, n;
+
+	x0 = cur_x;
+	y0 = cur_y;
+
+	/* number of segments from the device length of the control polygon */
+	xform(gs.ctm, x0, y0, &ax, &ay);
+	xform(gs.ctm, x1, y1, &bx, &by);
+	xform(gs.ctm, x2, y2, &cx, &cy);
+	xform(gs.ctm, x3, y3, &dx2, &dy2);
+	dx = bx - ax;
+	dy = by - ay;
+	l = sqrt(dx * dx + dy * dy);
+	dx = cx - bx;
+	dy = cy - by;
+	l += sqrt(dx * dx + dy * dy);
+	dx = dx2 - cx;
+	dy = dy2 - cy;
+	l += sqrt(dx * dx + dy * dy);
+	n = 1 + (int) (sqrt(l) * 1.5);
+	if (n > 64)
+		n = 64;
+	for (i = 1; i <= n; i++) {
+		t = (float) i / n;
+		u = 1 - t;
+		path_pt(u * u * u * x0 + 3 * u * u * t * x1
+				+ 3 * u * t * t * x2 + t * t * t * x3,
+			u * u * u * y0 + 3 * u * u * t * y1
+				+ 3 * u * t * t * y2 + t * t * t * y3);
+	}
+}
+
+/* -- add an edge -- */
+static void edge_add(float x0, float y0, float x1, float y1)
+{
+	struct edge *e;
+
+	if (y0 == y1)
+		return;
+	if (nedges >= edges_sz)
+		edges = grow(edges, &edges_sz, sizeof *edges);
+	e = &edges[nedges++];
+	if (y0 < y1) {
+		e->x0 = x0;
+		e->y0 = y0;
+		e->x1 = x1;
+		e->y1 = y1;
+		e->dir = 1;
+	} else {
+		e->x0 = x1;
+		e->y0 = y1;
+		e->x1 = x0;
+		e->y1 = y0;
+		e->dir = -1;
+	}
+}
+
+/* -- add a polygon with a positive orientation -- */
+static void poly_add(struct pt *p, int n)
+{
+	float a;
+	int i, j;
+
+	a = 0;
+	for (i = 0; i < n; i++) {
+		j = (i + 1) % n;
+		a += p[i].x * p[j].y - p[j].x * p[i].y;
+	}
+	for (i = 0; i < n; i++) {
+		j = (i + 1) % n;
+		if (a >= 0)
+			edge_add(p[i].x, p[i].y, p[j].x, p[j].y);
+		else
+			edge_add(p[j].x, p[j].y, p[i].x, p[i].y);
+	}
+}
+
+/* -- add a disc (round joins and caps) -- */
+static void disc_add(float x, float y, float r)
+{
+	struct pt p[16];
+	int i, n;
+
+	n = r < 2 ? 8 : 16;
+	for (i = 0; i < n; i++) {
+		p[i].x = x + r * cos(2 * M_PI * i / n);
+		p[i].y = y + r * sin(2 * M_PI * i / n);
+	}
+	poly_add(p, n);
+}
+
+/* -- fill the edges with a color -- */
+static void fill_edges(float *rgb, float alpha, int evenodd)
+{
+	struct edge *e;
+	float ymin, ymax, xmin, xmax, y, x, xs[256];
+	int ds[256];
+	int i, j, k, n, row, r0, r1, c0, c1, wind, ia, ib;
+	float xa, xb, v;
+	unsigned char *p;
+
+	if (nedges == 0)
+		return;
+	ymin = edges[0].y0;
+	ymax = edges[0].y1;
+	xmin = xmax = edges[0].x0;
+	for (i = 0, e = edges; i < nedges; i++, e++) {
+		if (e->y0 < ymin)
+			ymin = e->y0;
+		if (e->y1 > ymax)
+			ymax = e->y1;
+		if (e->x0 < xmin)
+			xmin = e->x0;
+		if (e->x0 > xmax)
+			xmax = e->x0;
+		if (e->x1 < xmin)
+			xmin = e->x1;
+		if (e->x1 > xmax)
+			xmax = e->x1;
+	}
+	r0 = floor(ymin);
+	r1 = ceil(ymax);
+	if (r0 < 0)
+		r0 = 0;
+	if (r1 > img_h)
+		r1 = img_h;
+	c0 = floor(xmin);
+	c1 = ceil(xmax) + 1;
+	if (c0 < 0)
+		c0 = 0;
+	if (c1 > img_w)
+		c1 = img_w;
+	if (c0 >= c1)
+		r1 = r0;
+	for (row = r0; row < r1; row++) {
+		memset(&cov[c0], 0, (c1 - c0) * sizeof *cov);
+		for (k = 0; k < SS; k++) {
+			y = row + (k + 0.5) / SS;
+
+			/* crossings, sorted by x */
+			n = 0;
+			for (i = 0, e = edges; i < nedges; i++, e++) {
+				if (y < e->y0 || y >= e->y1)
+					continue;
+				if (n >= 256)
+					break;
+				x = e->x0 + (y - e->y0) * (e->x1 - e->x0)
+						/ (e->y1 - e->y0);
+				for (j = n; j > 0 && xs[j - 1] > x; j--) {
+					xs[j] = xs[j - 1];
+					ds[j] = ds[j - 1];
+				}
+				xs[j] = x;
+				ds[j] = e->dir;
+				n++;
+			}
+
+			/* spans */
+			wind = 0;
+			for (i = 0; i < n - 1; i++) {
+				wind += ds[i];
+				if (evenodd ? !(wind & 1) : wind == 0)
+					continue;
+				xa = xs[i];
+				xb = xs[i + 1];
+				if (xa < 0)
+					xa = 0;
+				if (xb > img_w)
+					xb = img_w;
+				if (xa >= xb)
+					continue;
+				ia = xa;
+				ib = xb;
+				if (ia == ib) {
+					cov[ia] += (xb - xa) / SS;
+					continue;
+				}
+				cov[ia] += (ia + 1 - xa) / SS;
+				for (j = ia + 1; j < ib; j++)
+					cov[j] += 1. / SS;
+				if (ib < img_w)
+					cov[ib] += (xb - ib) / SS;
+			}
+		}
+
+		/* blend the row */
+		p = &img[((long) row * img_w + c0) * 3];
+		for (i = c0; i < c1; i++, p += 3) {
+			v = cov[i];
+			if (v <= 0)
+				continue;
+			if (v > 1)
+				v = 1;
+			v *= alpha;
+			p[0] += (rgb[0] * 255 - p[0]) * v + 0.5;
+			p[1] += (rgb[1] * 255 - p[1]) * v + 0.5;
+			p[2] += (rgb[2] * 255 - p[2]) * v + 0.5;
+		}
+	}
+	nedges = 0;
+}
+
+/* -- fill the current path -- */
+static void fill(int evenodd)
+{
+	struct sub *s;
+	struct pt *p;
+	int i, j;
+
+	for (i = 0, s = subs; i < nsubs; i++, s++) {
+		p = &pts[s->start];
+		for (j = 0; j < s->n; j++)
+			edge_add(p[j].x, p[j].y,
+				p[(j + 1) % s->n].x, p[(j + 1) % s->n].y);
+	}
+	fill_edges(gs.fill, 1, evenodd);
+}
+
+/* -- add a stroke segment -- */
+static void seg_add(float x0, float y0, float x1, float y1, float hw)
+{
+	struct pt q[4];
+	float dx, dy, l;
+
+	dx = x1 - x0;
+	dy = y1 - y0;
+	l = sqrt(dx * dx + dy * dy);
+	if (l == 0)
+		return;
+	dx = dx / l * hw;
+	dy = dy / l * hw;
+	if (gs.cap == 2) {			/* square cap */
+		x0 -= dx;
+		y0 -= dy;
+		x1 += dx;
+		y1 += dy;
+	}
+	q[0].x = x0 - dy;
+	q[0].y = y0 + dx;
+	q[1].x = x1 - dy;
+	q[1].y = y1 + dx;
+	q[2].x = x1 + dy;
+	q[2].y = y1 - dx;
+	q[3].x = x0 + dy;
+	q[3].y = y0 - dx;
+	poly_add(q, 4);
+}
+
+/* -- stroke the current path -- */
+static void stroke(void)
+{
+	struct sub *s;
+	struct pt *p;
+	float hw, sc, dx, dy, l, d, pos, x0, y0, x1, y1, t0, t1;
+	float dash[MAXDASH], dlen;
+	int i, j, n, k, on, ndash;
+
+	sc = sqrt(fabs(gs.ctm[0] * gs.ctm[3] - gs.ctm[1] * gs.ctm[2]));
+	hw = gs.lw * sc;
+	if (hw < 1)
+		hw = 1;				/* (thin lines) */
+	hw /= 2;
+	dlen = 0;
+	for (k = 0; k < gs.ndash; k++) {
+		dash[k] = gs.dash[k] * sc;
+		dlen += dash[k];
+	}
+	ndash = dlen > 0 ? gs.ndash : 0;
+	for (i = 0, s = subs; i < nsubs; i++, s++) {
+		p = &pts[s->start];
+		n = s->closed ? s->n + 1 : s->n;
+		k = 0;
+		on = 1;
+		pos = 0;
+		for (j = 0; j < n - 1; j++) {
+			x0 = p[j].x;
+			y0 = p[j].y;
+			x1 = p[(j + 1) % s->n].x;
+			y1 = p[(j + 1) % s->n].y;
+			if (ndash == 0) {
+				seg_add(x0, y0, x1, y1, hw);
+				if (j > 0 || s->closed)
+					disc_add(x0, y0, hw);	/* join */
+				continue;
+			}
+			dx = x1 - x0;
+			dy = y1 - y0;
+			l = sqrt(dx * dx + dy * dy);
+			d = 0;
+			while (d < l) {
+				t0 = d;
+				t1 = d + dash[k] - pos;
+				if (t1 > l) {
+					pos += l - d;
+					t1 = l;
+				} else {
+					pos = 0;
+				}
+				if (on)
+					seg_add(x0 + dx * t0 / l, y0 + dy * t0 / l,
+						x0 + dx * t1 / l, y0 + dy * t1 / l,
+						hw);
+				d = t1;
+				if (pos == 0) {
+					on = !on;
+					if (++k >= ndash)
+						k = 0;
+				}
+			}
+		}
+		if (gs.cap == 1 && !s->closed && s->n > 0) {
+			disc_add(p[0].x, p[0].y, hw);
+			disc_add(p[s->n - 1].x, p[s->n - 1].y, hw);
+		}
+	}
+	fill_edges(gs.stroke, 1, 0);
+}
+
+/* -- get a character of a string and its width -- */
+/* return the index of the next character */
+static int get_char(unsigned char *s, int i, int fnum, int *c, float *w)
+{
+	struct DLFONT *t;
+
+	if (gs.font < DL_NFONTS) {
+		*c = s[i];
+		*w = font_cwid(fnum, *c);
+		return i + 1;
+	}
+	*c = (s[i] << 8) | s[i + 1];		/* 2-byte codes */
+	t = &dl.tfonts[gs.font - DL_NFONTS];
+	if (t->ttf) {
+		*w = ttf_adv(t->ttf, *c);
+		if (*c == ttf_gid(t->ttf, ' '))
+			*c = ' ';
+	} else {
+		*w = 1;
+	}
+	return i + 2;
+}
+
+/* -- add a greyed bar for a word -- */
+static void bar(float *m, float x0, float x1, float h)
+{
+	struct pt q[4];
+
+	if (x1 <= x0)
+		return;
+	xform(m, x0, 0, &q[0].x, &q[0].y);
+	xform(m, x1, 0, &q[1].x, &q[1].y);
+	xform(m, x1, h, &q[2].x, &q[2].y);
+	xform(m, x0, h, &q[3].x, &q[3].y);
+	poly_add(q, 4);
+}
+
+/* -- add a path operation of a glyph outline -- */
+static void glyph_path(int op, float *v)
+{
+	float x0, y0;
+
+	switch (op) {
+	case 'm':
+		path_move(v[0], v[1]);
+		break;
+	case 'l':
+		path_pt(v[0], v[1]);
+		break;
+	case 'q':				/* quadratic -> cubic */
+		x0 = cur_x;
+		y0 = cur_y;
+		path_curve(x0 + (v[0] - x0) * 2 / 3, y0 + (v[1] - y0) * 2 / 3,
+			v[2] + (v[0] - v[2]) * 2 / 3,
+			v[3] + (v[1] - v[3]) * 2 / 3,
+			v[2], v[3]);
+		break;
+	case 'h':
+		subs[nsubs - 1].closed = 1;
+		break;
+	}
+}
+
+/* -- draw a text -- */
+/* from the glyph outlines or as greyed bars */
+static void show(unsigned char *s, int len)
+{
+	struct ttf *t;
+	float m[6], g[6], gm[6], x, x0, w, h;
+	int fnum, i, c;
+
+	memcpy(m, gs.ctm, sizeof m);
+	concat(m, tm);
+	if (gs.font >= DL_NFONTS)
+		len &= ~1;
+	fnum = afm_font(dl_fontname(gs.font));
+	h = gs.size * 0.5;			/* about the x-height */
+	t = gs.font >= DL_NFONTS ? dl.tfonts[gs.font - DL_NFONTS].ttf : NULL;
+	x = x0 = 0;
+	for (i = 0; i < len; ) {
+		if (t) {			/* glyph outline */
+			gm[0] = gs.size * gs.hscale;
+			gm[1] = gm[2] = 0;
+			gm[3] = gs.size;
+			gm[4] = x;
+			gm[5] = 0;
+			memcpy(g, tm, sizeof g);
+			concat(g, gm);
+			c = (s[i] << 8) | s[i + 1];
+			npts = nsubs = 0;
+			ttf_outline(t, c, g, glyph_path);
+			fill(0);
+			npts = nsubs = 0;
+			i += 2;
+			x += ttf_adv(t, c) * gs.size * gs.hscale;
+			continue;
+		}
+		i = get_char(s, i, fnum, &c, &w);
+		if (c == ' ') {
+			bar(m, x0, x, h);
+			x0 = x + w * gs.size * gs.hscale;
+		}
+		x += w * gs.size * gs.hscale;
+	}
+	if (!t) {
+		bar(m, x0, x, h);
+		fill_edges(gs.fill, 0.45, 0);
+	}
+
+	/* move the text position */
+	tm[4] += tm[0] * x;
+	tm[5] += tm[1] * x;
+}
+
+/* -- draw an operation of the display list -- */
+static void draw_op(struct DLOP *o)
+{
+	static int level;
+	float *v;
+	int i, nv;
+
+	v = o->v;
+	nv = o->nv;
+	switch (o->op[0]) {
+	case 'm':
+		if (nv >= 2)
+			path_move(v[0], v[1]);
+		break;
+	case 'l':
+		if (nv >= 2 && nsubs > 0)
+			path_pt(v[0], v[1]);
+		break;
+	case 'c':
+		if (o->op[1] == 'm') {
+			if (nv >= 6)
+				concat(gs.ctm, v);
+		} else if (nv >= 6 && nsubs > 0) {
+			path_curve(v[0], v[1], v[2], v[3], v[4], v[5]);
+		}
+		break;
+	case 'h':
+		if (nsubs > 0)
+			subs[nsubs - 1].closed = 1;
+		break;
+	case 'r':
+		if (o->op[1] == 'e' && nv >= 4) {
+			path_move(v[0], v[1]);
+			path_pt(v[0] + v[2], v[1]);
+			path_pt(v[0] + v[2], v[1] + v[3]);
+			path_pt(v[0], v[1] + v[3]);
+			subs[nsubs - 1].closed = 1;
+		} else if (o->op[1] == 'g' && nv >= 3) {
+			memcpy(gs.fill, v, sizeof gs.fill);
+		}
+		break;
+	case 'R':
+		if (o->op[1] == 'G' && nv >= 3)
+			memcpy(gs.stroke, v, sizeof gs.stroke);
+		break;
+	case 'f':
+	case 'B':
+	case 'S':
+	case 'n':
+		if (o->op[1] == 'T')		/* BT */
+			break;
+		if (o->op[0] == 'f' || o->op[0] == 'B')
+			fill(o->op[1] == '*');
+		if (o->op[0] == 'S' || o->op[0] == 'B')
+			stroke();
+		npts = nsubs = 0;
+		break;
+	case 'q':
+		if (gs_depth < (int) (sizeof gs_tb / sizeof gs_tb[0]))
+			memcpy(&gs_tb[gs_depth], &gs, sizeof gs);
+		gs_depth++;
+		break;
+	case 'Q':
+		if (gs_depth > 0
+		 && --gs_depth < (int) (sizeof gs_tb / sizeof gs_tb[0]))
+			memcpy(&gs, &gs_tb[gs_depth], sizeof gs);
+		break;
+	case 'w':
+		if (nv >= 1)
+			gs.lw = v[0];
+		break;
+	case 'J':
+		if (nv >= 1)
+			gs.cap = v[0];
+		break;
+	case 'd':
+		gs.ndash = 0;
+		for (i = 0; i < o->narr && i < MAXDASH; i++) {
+			if (o->arr[i] >= 0)
+				gs.dash[gs.ndash++] = o->arr[i];
+		}
+		break;
+	case 'T':
+		switch (o->op[1]) {
+		case 'f':
+			if (o->name[0] == 'F')
+				gs.font = atoi(o->name + 1);
+			else if (o->name[0] == 'T'
+			      && atoi(o->name + 1) < dl.ntfonts)
+				gs.font = DL_NFONTS + atoi(o->name + 1);
+			if (nv >= 1)
+				gs.size = v[0];
+			break;
+		case 'm':
+			if (nv >= 6)
+				memcpy(tm, v, sizeof tm);
+			break;
+		case 'z':
+			if (nv >= 1)
+				gs.hscale = v[0] / 100;
+			break;
+		case 'j':
+			show(o->str, o->slen);
+			break;
+		}
+		break;
+	case 'D':
+		if (o->op[1] == 'o' && level < 16) {
+			struct gstate sv_gs;
+			struct DLSYM *x;
+			int sv_depth;
+
+			x = dl_sym(o->name);
+			if (!x)
+				break;
+			memcpy(&sv_gs, &gs, sizeof gs);
+			sv_depth = gs_depth;
+			level++;
+			dl_replay(x->ops, x->len, draw_op);
+			level--;
+			gs_depth = sv_depth;
+			memcpy(&gs, &sv_gs, sizeof gs);
+		}
+		break;
+	case 'E':				/* ET */
+		gs.hscale = 1;
+		break;
+	}
+}
+
+/* -- output a PNG chunk -- */
+static long chunk(char *type, unsigned char *data, long len)
+{
+	unsigned char hd[8];
+	unsigned long crc;
+
+	hd[0] = len >> 24;
+	hd[1] = len >> 16;
+	hd[2] = len >> 8;
+	hd[3] = len;
+	memcpy(&hd[4], type, 4);
+	fwrite(hd, 1, 8, png_f);
+	if (len > 0)
+		fwrite(data, 1, len, png_f);
+	crc = z_crc32(z_crc32(0, hd + 4, 4), data, len);
+	hd[0] = crc >> 24;
+	hd[1] = crc >> 16;
+	hd[2] = crc >> 8;
+	hd[3] = crc;
+	fwrite(hd, 1, 4, png_f);
+	return len + 12;
+}
+
+/* -- set a 32 bits value -- */
+static void set_32(unsigned char *p, unsigned long v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* -- write the image -- */
+static long img_write(void)
+{
+	unsigned char hd[13], *raw, *z;
+	long zlen, size;
+	unsigned long ppm;
+	int y;
+
+	fwrite("\211PNG\r\n\032\n", 1, 8, png_f);
+	size = 8;
+	set_32(hd, img_w);
+	set_32(hd + 4, img_h);
+	hd[8] = 8;				/* bit depth */
+	hd[9] = 2;				/* RGB */
+	hd[10] = hd[11] = hd[12] = 0;
+	size += chunk("IHDR", hd, 13);
+	ppm = png_dpi / 0.0254 + 0.5;		/* resolution */
+	set_32(hd, ppm);
+	set_32(hd + 4, ppm);
+	hd[8] = 1;				/* meter */
+	size += chunk("pHYs", hd, 9);
+
+	raw = malloc((long) img_h * (img_w * 3 + 1));
+	if (!raw)
+		png_oom();
+	for (y = 0; y < img_h; y++) {
+		raw[(long) y * (img_w * 3 + 1)] = 0;	/* no filter */
+		memcpy(&raw[(long) y * (img_w * 3 + 1) + 1],
+			&img[(long) y * img_w * 3], img_w * 3);
+	}
+	z = z_deflate(raw, (long) img_h * (img_w * 3 + 1), &zlen, Z_ZLIB);
+	free(raw);
+	size += chunk("IDAT", z, zlen);
+	free(z);
+	size += chunk("IEND", NULL, 0);
+	return size;
+}
+
+/* -- render the display list into a PNG file -- */
+/* return the size of the PNG file */
+long png_write(FILE *f)
+{
+	float w, h, sc;
+	long size;
+
+	png_f = f;
+	w = dl.w;
+	h = dl.h;
+	sc = png_dpi / 72;
+	img_w = ceil(w * sc);
+	img_h = ceil(h * sc);
+	if (img_w < 1)
+		img_w = 1;
+	else if (img_w > MAXSIZE)
+		img_w = MAXSIZE;
+	if (img_h < 1)
+		img_h = 1;
+	else if (img_h > MAXSIZE)
+		img_h = MAXSIZE;
+	img = malloc((long) img_w * img_h * 3);
+	cov = malloc(img_w * sizeof *cov);
+	if (!img || !cov)
+		png_oom();
+	memset(img, 0xff, (long) img_w * img_h * 3);
+
+	/* the content stream has y upwards */
+	memset(&gs, 0, sizeof gs);
+	gs.ctm[0] = sc;
+	gs.ctm[3] = -sc;
+	gs.ctm[5] = h * sc;
+	gs.lw = 1;
+	gs.size = 12;
+	gs.hscale = 1;
+	gs_depth = 0;
+	npts = nsubs = nedges = 0;
+	dl_replay(dl.ops, dl.len, draw_op);
+
+	size = img_write();
+	free(img);
+	free(cov);
+	img = NULL;
+	cov = NULL;
+	png_f = NULL;
+	return size;
+}
@@ -0,0 +1,444 @@
+/*
+ * Run-time statistics.
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(unix) || defined(__unix__)
+#include <sys/time.h>
+#endif
+
+#include "abc2ps.h"
+
+int stats;				/* statistics (STATS_xxx) */
+struct mem_s mem;			/* memory usage */
+static FILE *trace_f;			/* trace events (--trace) */
+
+static char *stage_names[ST_NSTAGES] = {
+	"frontend", "abc_parse", "do_tune", "sort_all", "output_music",
+	"set_allsymwidth", "cut_tune", "set_sym_glue", "drawing",
+	"calculate_beam", "draw_slur", "write_buffer", "svg_write"
+};
+
+/* the time of a stage does not include the time of the inner stages */
+#define STACK_SZ 32
+static int stack[STACK_SZ];		/* running stages */
+static int nstack;
+static double t_last;			/* time of the last stage change */
+static double t_start;
+
+static double tot[ST_NSTAGES];		/* total time per stage */
+static int calls[ST_NSTAGES];		/* number of calls per stage */
+static double base[ST_NSTAGES];		/* stage times at the last record */
+static long a_base[MAXAREAL];		/* arena requests at the last record */
+static long a_hwm[MAXAREAL];		/* max used bytes in the arenas */
+static int svg_hwm;			/* max SVG elements in use */
+
+#define NSLOW 5
+static struct slow {			/* slowest tunes */
+	double t;
+	long m;				/* arena bytes of the tune */
+	int x;
+	char title[64];
+	char fn[64];
+} slow_tb[NSLOW], big_tb[NSLOW];
+static int ntunes;
+
+static char *span_names[TR_NSPANS] = {
+	"file", "tune", "line", "page"
+};
+static int cur_x;			/* current tune */
+static char cur_title[64];
+
+/* -- return the current time in seconds -- */
+double stats_now(void)
+{
+#if defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#elif defined(unix) || defined(__unix__)
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+#else
+	return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* -- get the X: number and the title of a tune -- */
+static int tune_id(struct abctune *t, char **p_title)
+{
+	struct abcsym *as;
+	int x;
+
+	x = -1;
+	*p_title = "";
+	for (as = t->first_sym; as; as = as->next) {
+		if (as->state == ABC_S_TUNE)
+			break;
+		if (as->type != ABC_T_INFO)
+			continue;
+		if (as->text[0] == 'X' && x < 0)
+			x = atoi(&as->text[2]);
+		else if (as->text[0] == 'T' && **p_title == '\0')
+			*p_title = &as->text[2];
+	}
+	return x;
+}
+
+/* -- charge the elapsed time to the running stage -- */
+static void charge(void)
+{
+	double t;
+
+	t = stats_now();
+	if (nstack > 0 && nstack <= STACK_SZ)
+		tot[stack[nstack - 1]] += t - t_last;
+	t_last = t;
+}
+
+/* -- set the statistics output (--stats text|json) -- */
+void stats_init(char *arg)
+{
+	if (strcmp(arg, "json") == 0)
+		stats = STATS_JSON;
+	else if (strcmp(arg, "0") == 0 || strcmp(arg, "none") == 0)
+		stats = 0;
+	else
+		stats = STATS_TEXT;
+	if (t_start == 0)
+		t_start = t_last = stats_now();
+}
+
+/* -- start a stage -- */
+void stats_start(int stage)
+{
+	if (!stats)
+		return;
+	charge();
+	if (nstack < STACK_SZ)
+		stack[nstack] = stage;
+	nstack++;
+	calls[stage]++;
+}
+
+/* -- stop a stage -- */
+void stats_stop(int stage)
+{
+	if (!stats)
+		return;
+	charge();
+	if (nstack > 0)
+		nstack--;
+}
+
+/* -- get the total time and the number of calls of a stage -- */
+void stats_get(int stage, double *t, int *n)
+{
+	*t = tot[stage];
+	*n = calls[stage];
+}
+
+/* -- output a string in JSON -- */
+void json_str(FILE *f, char *s)
+{
+	putc('"', f);
+	for (; *s != '\0'; s++) {
+		if (*s == '"' || *s == '\\')
+			putc('\\', f);
+		if ((unsigned char) *s < ' ')
+			fprintf(f, "\\u%04x", *s);
+		else
+			putc(*s, f);
+	}
+	putc('"', f);
+}
+
+/* -- open the trace file (--trace file) -- */
+void trace_init(char *fn)
+{
+	trace_f = fopen(fn, "w");
+	if (!trace_f) {
+		error(1, 0, "Cannot create the trace file '%s'", fn);
+		return;
+	}
+	fputs("[\n", trace_f);
+	if (t_start == 0)
+		t_start = t_last = stats_now();
+}
+
+/* -- start a span of the trace -- */
+/* the pages are on their own track as they don't nest with the tunes */
+void trace_begin(int span, char *name, int num)
+{
+	if (!trace_f)
+		return;
+	fputs("{\"name\":", trace_f);
+	if (name)
+		json_str(trace_f, name);
+	else
+		fprintf(trace_f, "\"%s %d\"", span_names[span], num);
+	fprintf(trace_f, ",\"cat\":\"%s\",\"ph\":\"B\",\"ts\":%.0f,"
+			"\"pid\":1,\"tid\":%d",
+		span_names[span], (stats_now() - t_start) * 1e6,
+		span == TR_PAGE ? 2 : 1);
+	if (span != TR_FILE) {
+		fprintf(trace_f, ",\"args\":{\"x\":%d,\"title\":", cur_x);
+		json_str(trace_f, cur_title);
+		putc('}', trace_f);
+	}
+	fputs("},\n", trace_f);
+}
+
+/* -- start the span of a tune -- */
+void trace_tune(struct abctune *t)
+{
+	char *title;
+
+	if (!trace_f)
+		return;
+	cur_x = tune_id(t, &title);
+	snprintf(cur_title, sizeof cur_title, "%s", title);
+	trace_begin(TR_TUNE, *title != '\0' ? title : NULL, cur_x);
+}
+
+/* -- stop a span of the trace -- */
+void trace_end(int span)
+{
+	if (!trace_f)
+		return;
+	fprintf(trace_f, "{\"ph\":\"E\",\"ts\":%.0f,\"pid\":1,\"tid\":%d},\n",
+		(stats_now() - t_start) * 1e6,
+		span == TR_PAGE ? 2 : 1);
+}
+
+/* -- output the stage times since the last record -- */
+static double json_stages(void)
+{
+	double t, sum;
+	int i;
+
+	sum = 0;
+	for (i = 0; i < ST_NSTAGES; i++) {
+		t = tot[i] - base[i];
+		base[i] = tot[i];
+		sum += t;
+		if (stats == STATS_JSON && t != 0)
+			fprintf(stderr, ",\"%s_ms\":%.3f",
+				stage_names[i], t * 1000);
+	}
+	return sum;
+}
+
+/* -- output the arena usage since the last record -- */
+static long json_mem(void)
+{
+	long m, sum;
+	int i;
+
+	sum = 0;
+	for (i = 0; i < MAXAREAL; i++) {
+		m = mem.a_req[i] - a_base[i];
+		a_base[i] = mem.a_req[i];
+		sum += m;
+		if (stats == STATS_JSON)
+			fprintf(stderr, ",\"arena%d_req\":%ld,\"arena%d_hwm\":%ld",
+				i, m, i, mem.a_thwm[i]);
+		if (mem.a_thwm[i] > a_hwm[i])
+			a_hwm[i] = mem.a_thwm[i];
+		mem.a_thwm[i] = mem.a_used[i];
+	}
+	return sum;
+}
+
+/* -- insert a tune in a table of the biggest values -- */
+static void top_put(struct slow *tb, double v,
+			struct slow *sl)
+{
+	int i;
+
+	for (i = 0; i < NSLOW; i++) {
+		if (v > (tb == slow_tb ? tb[i].t : tb[i].m))
+			break;
+	}
+	if (i >= NSLOW)
+		return;
+	memmove(&tb[i + 1], &tb[i], (NSLOW - 1 - i) * sizeof tb[0]);
+	tb[i] = *sl;
+}
+
+/* -- record the time of the front-end and of the parsing of a file -- */
+void stats_file(char *fn)
+{
+	double t;
+
+	if (!stats)
+		return;
+	charge();
+	if (stats == STATS_JSON) {
+		fputs("{\"type\":\"file\",\"file\":", stderr);
+		json_str(stderr, fn);
+	}
+	t = json_stages();
+	json_mem();
+	if (stats == STATS_JSON)
+		fprintf(stderr, ",\"total_ms\":%.3f}\n", t * 1000);
+}
+
+/* -- record the time of a tune -- */
+void stats_tune(struct abctune *t, char *fn)
+{
+	struct slow sl;
+	char *title;
+	double ttune;
+	long m;
+	int x;
+
+	if (!stats)
+		return;
+	charge();
+	x = tune_id(t, &title);
+	ntunes++;
+	if (stats == STATS_JSON) {
+		fprintf(stderr, "{\"type\":\"tune\",\"file\":");
+		json_str(stderr, fn);
+		fprintf(stderr, ",\"x\":%d,\"title\":", x);
+		json_str(stderr, title);
+	}
+	ttune = json_stages();
+	m = json_mem();
+	if (stats == STATS_JSON)
+		fprintf(stderr, ",\"svg_elts_hwm\":%d,\"total_ms\":%.3f}\n",
+			mem.svg_hwm, ttune * 1000);
+	if (mem.svg_hwm > svg_hwm)
+		svg_hwm = mem.svg_hwm;
+	mem.svg_hwm = mem.svg_used;
+
+	/* keep the slowest and the biggest tunes */
+	sl.t = ttune;
+	sl.m = m;
+	sl.x = x;
+	snprintf(sl.title, sizeof sl.title, "%s", title);
+	snprintf(sl.fn, sizeof sl.fn, "%s", fn);
+	top_put(slow_tb, ttune, &sl);
+	top_put(big_tb, m, &sl);
+}
+
+/* -- stop the statistics and the trace (other process) -- */
+void stats_off(void)
+{
+	stats = 0;
+	if (trace_f) {
+		fclose(trace_f);	/* (empty buffer) */
+		trace_f = NULL;
+	}
+}
+
+/* -- output the summary and close the trace -- */
+void stats_end(void)
+{
+	double t, ttot;
+	int i;
+
+	if (trace_f) {
+		fprintf(trace_f,
+			"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+			"\"args\":{\"name\":\"abcm2ps\"}}\n"
+			"]\n");
+		fclose(trace_f);
+		trace_f = NULL;
+	}
+	if (!stats)
+		return;
+	charge();
+	ttot = t_last - t_start;
+	if (ttot <= 0)
+		ttot = 1e-9;
+	for (i = 0; i < MAXAREAL; i++) {
+		if (mem.a_thwm[i] > a_hwm[i])
+			a_hwm[i] = mem.a_thwm[i];
+	}
+	if (mem.svg_hwm > svg_hwm)
+		svg_hwm = mem.svg_hwm;
+	if (stats == STATS_JSON) {
+		fprintf(stderr, "{\"type\":\"total\",\"tunes\":%d", ntunes);
+		for (i = 0; i < ST_NSTAGES; i++)
+			fprintf(stderr, ",\"%s_ms\":%.3f",
+				stage_names[i], tot[i] * 1000);
+		for (i = 0; i < MAXAREAL; i++)
+			fprintf(stderr, ",\"arena%d\":{\"req\":%ld,\"hwm\":%ld,"
+					"\"alloc\":%ld,\"chunks\":%d,\"big\":%d}",
+				i, mem.a_req[i], a_hwm[i],
+				mem.a_alloc[i], mem.a_chunks[i], mem.a_big[i]);
+		fprintf(stderr, ",\"outbuf_sz\":%d,\"outbuf_hwm\":%d,"
+				"\"svg_blocks\":%d,\"svg_elts_hwm\":%d",
+			mem.outbuf_sz, mem.outbuf_hwm,
+			mem.svg_blocks, svg_hwm);
+		fprintf(stderr, ",\"total_ms\":%.3f}\n", ttot * 1000);
+		return;
+	}
+	fprintf(stderr, "Time per stage (%d tunes):\n", ntunes);
+	t = 0;
+	for (i = 0; i < ST_NSTAGES; i++) {
+		t += tot[i];
+		fprintf(stderr, "  %-16s %6d calls %10.3f ms %5.1f%%\n",
+			stage_names[i], calls[i], tot[i] * 1000,
+			tot[i] * 100 / ttot);
+	}
+	fprintf(stderr, "  %-16s %23.3f ms %5.1f%%\n",
+		"other", (ttot - t) * 1000, (ttot - t) * 100 / ttot);
+	fprintf(stderr, "  %-16s %23.3f ms\n", "total", ttot * 1000);
+
+	fprintf(stderr, "Memory:\n"
+		"  arena      requested   max used  allocated chunks  big\n");
+	for (i = 0; i < MAXAREAL; i++)
+		fprintf(stderr, "  %-8s %11ld %10ld %10ld %6d %4d\n",
+			i == 0 ? "global" : i == 1 ? "tunes" : "gen",
+			mem.a_req[i], a_hwm[i], mem.a_alloc[i],
+			mem.a_chunks[i], mem.a_big[i]);
+	fprintf(stderr, "  outbuf: %d of %d bytes used (%.1f%%)\n",
+		mem.outbuf_hwm, mem.outbuf_sz,
+		mem.outbuf_sz ? mem.outbuf_hwm * 100. / mem.outbuf_sz : 0);
+	if (mem.svg_blocks)
+		fprintf(stderr, "  SVG elements: %d blocks of %d, max %d in use\n",
+			mem.svg_blocks, NELTS, svg_hwm);
+
+	if (slow_tb[0].t == 0)
+		return;
+	fprintf(stderr, "Slowest tunes:\n");
+	for (i = 0; i < NSLOW; i++) {
+		if (slow_tb[i].t == 0)
+			break;
+		fprintf(stderr, "  %10.3f ms  X:%d %s (%s)\n",
+			slow_tb[i].t * 1000, slow_tb[i].x,
+			slow_tb[i].title, slow_tb[i].fn);
+	}
+	fprintf(stderr, "Biggest tunes (arena bytes):\n");
+	for (i = 0; i < NSLOW; i++) {
+		if (big_tb[i].m == 0)
+			break;
+		fprintf(stderr, "  %10ld  X:%d %s (%s)\n",
+			big_tb[i].m, big_tb[i].x,
+			big_tb[i].title, big_tb[i].fn);
+	}
+}
@@ -46,6 +46,15 @@ static char strtx;		/* PostScript text outputing (bits) */
 #define TX_ARR 2			/* glyph/string array started */
 #define TX_EXT 4			/* glyph/string array needed */
 
+/* cache of the strings converted by tex_str() */
+#define TEX_C_SZ 1024
+static struct tex_c {
+	char *s;		/* source string, followed by the result */
+	int fnum;		/* starting font */
+	float swfac;		/* width factor of the starting font */
+	float w;		/* width */
+} tex_c_tb[TEX_C_SZ];
+
 /* width of characters according to the encoding */
 /* these are the widths for Times-Roman, extracted from the 'a2ps' package */
 /*fixme-hack: set 500 to control characters for utf-8*/
@@ -193,24 +202,46 @@ float cwid(unsigned short c)
 /* Return an estimated width of the string. */
 float tex_str(char *s)
 {
-	char *d;
+	struct tex_c *tc;
+	char *d, *s0;
 	signed char c1;
-	unsigned maxlen, i;
+	unsigned short pc;
+	unsigned maxlen, i, h, l;
 	float w, swfac;
+	int fnum, cache;
 
-	w = 0;
-	d = tex_buf;
-	maxlen = sizeof tex_buf - 1;		/* have room for EOS */
 	if ((i = curft) <= 0)
 		i = defft;
+	fnum = cfmt.font_tb[i].fnum;
 	swfac = cfmt.font_tb[i].swfac;
+
+	/* look in the cache */
+	h = 0;
+	for (d = s; *d != '\0'; d++)
+		h = h * 31 + (unsigned char) *d;
+	l = d - s;
+	tc = &tex_c_tb[h % TEX_C_SZ];
+	if (tc->s
+	 && tc->fnum == fnum
+	 && tc->swfac == swfac
+	 && strcmp(tc->s, s) == 0) {
+		strcpy(tex_buf, tc->s + l + 1);
+		return tc->w;
+	}
+
+	s0 = s;
+	cache = 1;
+	pc = 0;
+	w = 0;
+	d = tex_buf;
+	maxlen = sizeof tex_buf - 1;		/* have room for EOS */
 	while ((c1 = *s++) != '\0') {
 		switch (c1) {
 		case '\\':
 			c1 = *s++;
 			if (c1 == '\0') {
 				*d = '\0';
-				return w;
+				return w;		/* (not cached) */
 			}
 			switch (c1) {
 			case 'n':
@@ -224,10 +255,13 @@ float tex_str(char *s)
 		case '$':
 			if (isdigit((unsigned char) *s)
 			 && (unsigned) (*s - '0') < FONT_UMAX) {
+				cache = 0;		/* font change */
 				i = *s - '0';
 				if (i == 0)
 					i = defft;
+				fnum = cfmt.font_tb[i].fnum;
 				swfac = cfmt.font_tb[i].swfac;
+				pc = 0;
 				if (--maxlen <= 0)
 					break;
 				*d++ = c1;
@@ -246,6 +280,8 @@ float tex_str(char *s)
 				int j;
 				long v;
 
+				cache = 0;
+
 				if (s[1] == 'x')
 					i = sscanf(s, "#x%lx;%n", &v, &j);
 				else
@@ -280,7 +316,16 @@ float tex_str(char *s)
 
 /*fixme: does not work with utf-8 on 3 characters*/
 				unicode = ((d[-1] & 0x0f) << 6) | (c1 & 0x3f);
-				w += cwid(unicode) * swfac;
+				w += font_cwid(fnum, unicode) * swfac;
+				if ((d[-1] & 0xe0) == 0xc0) {	/* 2 bytes */
+					unicode = ((d[-1] & 0x1f) << 6)
+							| (c1 & 0x3f);
+					w += font_kern(fnum, pc, unicode)
+							* swfac;
+					pc = unicode;
+				} else {
+					pc = 0;
+				}
 			}
 		} else if (c1 <= 5) {		/* accidentals from gchord */
 			if (--maxlen < 4)
@@ -314,10 +359,13 @@ float tex_str(char *s)
 				*d++ = 0xab;
 				break;
 			}
-			w += cwid('a') * swfac;
+			w += font_cwid(fnum, 'a') * swfac;
+			pc = 0;
 			continue;
 		} else {
-			w += cwid((unsigned short) c1) * swfac;
+			w += (font_cwid(fnum, (unsigned short) c1)
+				+ font_kern(fnum, pc, c1)) * swfac;
+			pc = c1;
 		}
 	addchar_nowidth:
 		if (--maxlen <= 0)
@@ -325,8 +373,23 @@ float tex_str(char *s)
 		*d++ = c1;
 	}
 	*d = '\0';
-	if (maxlen <= 0)
+	if (maxlen <= 0) {
 		error(0, 0, "Text too large - ignored part: '%s'", s);
+		return w;
+	}
+
+	/* put the result in the cache */
+	if (cache) {
+		free(tc->s);
+		tc->s = malloc(l + 1 + (d - tex_buf) + 1);
+		if (tc->s) {
+			strcpy(tc->s, s0);
+			strcpy(tc->s + l + 1, tex_buf);
+			tc->fnum = fnum;
+			tc->swfac = swfac;
+			tc->w = w;
+		}
+	}
 	return w;
 }
 
@@ -338,6 +401,26 @@ static PangoLayout *layout = (PangoLayout *) -1;
 static PangoAttrList *attrs;
 static int out_pg_ft = -1;		/* current pango font */
 static GString *pg_str;
+static GString *pg_sig;			/* font changes in pg_str */
+static GString *pg_key;			/* key of the shaped string */
+static unsigned pg_key_h;		/* hash of the key */
+
+/* cache of the PostScript output of the shaped strings (LRU) */
+#define PG_C_MAX 256			/* max number of strings */
+#define PG_C_HASH 256
+static struct pg_c {
+	struct pg_c *prev, *next;	/* LRU list (most recent first) */
+	struct pg_c *hnext;		/* hash chain */
+	unsigned h;			/* hash of the key */
+	int keylen;
+	char *key;			/* key, followed by the output */
+	char *ps;			/* PostScript output */
+	int pslen;			/* length of the output */
+	float y;			/* height of a paragraph */
+} *pg_c_hash[PG_C_HASH], *pg_c_first, *pg_c_last;
+static int pg_c_n;
+static int pg_c_wr;			/* output buffer writes at start */
+static int pg_c_err;			/* error while shaping */
 
 /* -- initialize the pango mechanism -- */
 void pg_init(void)
@@ -358,6 +441,8 @@ void pg_init(void)
 		pango_layout_set_wrap(layout, PANGO_WRAP_WORD);
 //		pango_layout_set_spacing(layout, 0);
 		pg_str = g_string_sized_new(256);
+		pg_sig = g_string_sized_new(64);
+		pg_key = g_string_sized_new(256);
 	}
 }
 void pg_reset_font(void)
@@ -381,6 +466,120 @@ static void desc_font(int fnum)
 	}
 }
 
+/* -- build the key of the shaped string -- */
+static void pg_key_set(int type, int len)
+{
+	char *p;
+	unsigned h;
+
+	g_string_truncate(pg_key, 0);
+	g_string_append_printf(pg_key, "%c %d %d\n",
+			type,
+			pango_layout_get_width(layout),
+			pango_layout_get_justify(layout));
+	g_string_append_len(pg_key, pg_str->str, len);
+	g_string_append_c(pg_key, '\0');
+	g_string_append_len(pg_key, pg_sig->str, pg_sig->len);
+	h = 0;
+	for (p = pg_key->str; p < pg_key->str + pg_key->len; p++)
+		h = h * 31 + (unsigned char) *p;
+	pg_key_h = h;
+}
+
+/* -- search the shaped string in the cache -- */
+/* the string is not taken from the cache when the output buffer could be
+ * flushed while it is output, as the flush would not occur at the same
+ * place as when the string is shaped */
+static struct pg_c *pg_c_get(void)
+{
+	struct pg_c *pc;
+
+	for (pc = pg_c_hash[pg_key_h % PG_C_HASH]; pc; pc = pc->hnext) {
+		if (pc->h == pg_key_h
+		 && pc->keylen == pg_key->len
+		 && memcmp(pc->key, pg_key->str, pc->keylen) == 0)
+			break;
+	}
+	if (pc && mbf + pc->pslen + BSIZE > outbuf + mem.outbuf_sz)
+		return NULL;
+	if (!pc || pc == pg_c_first)
+		return pc;
+
+	/* move to the head of the LRU list */
+	pc->prev->next = pc->next;
+	if (pc->next)
+		pc->next->prev = pc->prev;
+	else
+		pg_c_last = pc->prev;
+	pc->prev = NULL;
+	pc->next = pg_c_first;
+	pg_c_first->prev = pc;
+	pg_c_first = pc;
+	return pc;
+}
+
+/* -- put the output of a shaped string in the cache -- */
+static void pg_c_put(char *ps, int len, float y)
+{
+	struct pg_c *pc, **pp;
+
+	if (outbuf_wr != pg_c_wr		/* output buffer flushed */
+	 || pg_c_err)			/* keep the error messages */
+		return;
+
+	/* remove the least recently used string */
+	if (pg_c_n >= PG_C_MAX) {
+		pc = pg_c_last;
+		pg_c_last = pc->prev;
+		pg_c_last->next = NULL;
+		for (pp = &pg_c_hash[pc->h % PG_C_HASH]; *pp != pc;
+		     pp = &(*pp)->hnext)
+			;
+		*pp = pc->hnext;
+		free(pc);
+		pg_c_n--;
+	}
+
+	pc = malloc(sizeof *pc + pg_key->len + len + 1);
+	if (!pc)
+		return;
+	pc->h = pg_key_h;
+	pc->keylen = pg_key->len;
+	pc->key = (char *) (pc + 1);
+	memcpy(pc->key, pg_key->str, pg_key->len);
+	pc->ps = pc->key + pg_key->len;
+	memcpy(pc->ps, ps, len);
+	pc->ps[len] = '\0';
+	pc->pslen = len;
+	pc->y = y;
+	pp = &pg_c_hash[pc->h % PG_C_HASH];
+	pc->hnext = *pp;
+	*pp = pc;
+	pc->prev = NULL;
+	pc->next = pg_c_first;
+	if (pg_c_first)
+		pg_c_first->prev = pc;
+	else
+		pg_c_last = pc;
+	pg_c_first = pc;
+	pg_c_n++;
+}
+
+/* -- output the PostScript sequence of a cached string -- */
+static void pg_c_out(struct pg_c *pc)
+{
+	char *p;
+	int l;
+
+	outft = -1;
+	for (p = pc->ps; *p != '\0'; p += l) {
+		l = strlen(p);
+		if (l > BSIZE / 2)
+			l = BSIZE / 2;
+		a2b("%.*s", l, p);
+	}
+}
+
 /* output a line */
 static void pg_line_output(PangoLayoutLine *line)
 {
@@ -417,6 +616,7 @@ static void pg_line_output(PangoLayoutLine *line)
 			if (c & PANGO_GLYPH_UNKNOWN_FLAG) {
 				c &= ~PANGO_GLYPH_UNKNOWN_FLAG;
 				error(0, 0, "char %04x not treated\n", c);
+				pg_c_err = 1;
 				continue;
 			}
 
@@ -425,6 +625,7 @@ static void pg_line_output(PangoLayoutLine *line)
 					FT_LOAD_NO_SCALE);
 			if (ret != 0) {
 				error(0, 0, "freetype error %d\n", ret);
+				pg_c_err = 1;
 			} else if (FT_HAS_GLYPH_NAMES(face)) {
 				if (FT_Get_Postscript_Name(face) != fontname) {
 					fontname = FT_Get_Postscript_Name(face);
@@ -465,6 +666,8 @@ static void str_font_change(int start,
 		f->size = 8;
 	}
 	desc_font(fnum);
+	g_string_append_printf(pg_sig, "%d %d %d %.2f\n",
+			start, end, fnum, f->size);
 	
 	attr1 = pango_attr_font_desc_new(desc_tb[fnum]);
 	attr1->start_index = start;
@@ -522,6 +725,8 @@ static void str_set_font(char *p)
 static void str_pg_out(char *p, int action)
 {
 	PangoLayoutLine *line;
+	struct pg_c *pc;
+	char *ps;
 	int wi;
 	float w;
 
@@ -552,8 +757,22 @@ static void str_pg_out(char *p, int action)
 	}
 
 	attrs = pango_attr_list_new();
+	g_string_truncate(pg_sig, 0);
 	str_set_font(p);
 
+	/* if the same string was already shaped, output the result */
+	pg_key_set('a' + action, pg_str->len);
+	pc = pg_c_get();
+	if (pc) {
+		pg_c_out(pc);
+		pg_str = g_string_truncate(pg_str, 0);
+		pango_attr_list_unref(attrs);
+		return;
+	}
+	ps = mbf;
+	pg_c_wr = outbuf_wr;
+	pg_c_err = 0;
+
 	pango_layout_set_text(layout, pg_str->str, pg_str->len);
 	pango_layout_set_attributes(layout, attrs);
 
@@ -571,6 +790,7 @@ static void str_pg_out(char *p, int action)
 		break;
 	}
 	pg_line_output(line);
+	pg_c_put(ps, mbf - ps, 0);
 	pango_layout_set_attributes(layout, NULL);
 	pg_str = g_string_truncate(pg_str, 0);
 	pango_attr_list_unref(attrs);
@@ -582,12 +802,26 @@ static void pg_para_output(int job)
 	GSList *lines, *runs_list;
 	PangoLayoutLine *line;
 	PangoGlyphInfo *glyph_info;
-	char tmp[256];
+	struct pg_c *pc;
+	char tmp[256], *ps;
 	const char *fontname = NULL;
 	int ret, glypharray;
 	int wi;
 	float y;
 
+	/* if the same paragraph was already shaped, output the result */
+	pg_key_set('0' + job, pg_str->len - 1);
+	pc = pg_c_get();
+	if (pc) {
+		pg_c_out(pc);
+		bskip(pc->y);
+		pg_str = g_string_truncate(pg_str, 0);
+		return;
+	}
+	ps = mbf;
+	pg_c_wr = outbuf_wr;
+	pg_c_err = 0;
+
 	pango_layout_set_text(layout, pg_str->str,
 			pg_str->len - 1);	/* remove the last space */
 	pango_layout_set_attributes(layout, attrs);
@@ -646,6 +880,7 @@ static void pg_para_output(int job)
 				if (g & PANGO_GLYPH_UNKNOWN_FLAG) {
 					g &= ~PANGO_GLYPH_UNKNOWN_FLAG;
 					error(0, 0, "char %04x not treated\n", g);
+					pg_c_err = 1;
 					continue;
 				}
 
@@ -654,6 +889,7 @@ static void pg_para_output(int job)
 						FT_LOAD_NO_SCALE);
 				if (ret != 0) {
 					fprintf(stdout, "%%%% freetype error %d\n", ret);
+					pg_c_err = 1;
 				} else if (FT_HAS_GLYPH_NAMES(face)) {
 					if (FT_Get_Postscript_Name(face) != fontname) {
 						fontname = FT_Get_Postscript_Name(face);
@@ -692,6 +928,7 @@ static void pg_para_output(int job)
 			glypharray = 0;
 		}
 	}
+	pg_c_put(ps, mbf - ps, y);
 	bskip(y);
 	pango_layout_set_attributes(layout, NULL);
 	pg_str = g_string_truncate(pg_str, 0);
@@ -706,6 +943,7 @@ static void pg_write_text(char *s, int job, float baseskip)
 	pango_layout_set_width(layout, strlw * PANGO_SCALE);
 	pango_layout_set_justify(layout, job == T_JUSTIFY);
 	attrs = pango_attr_list_new();
+	g_string_truncate(pg_sig, 0);
 
 	p = s;
 	while (*p != '\0') {
@@ -817,16 +1055,76 @@ static char *strop_tb[] = {	/* index = action (A_xxxx) */
 	"gxshow",
 };
 
+/* -- get the character at 'p' for kerning -- */
+static unsigned short kern_char(char *p)
+{
+	unsigned char c;
+
+	c = *p;
+	if (c < 0x80)
+		return c;
+	if ((c & 0xe0) == 0xc0 && (p[1] & 0xc0) == 0x80)
+		return ((c & 0x1f) << 6) | (p[1] & 0x3f);
+	return 0;				/* no kerning */
+}
+
+/* -- check if a ASCII string has some kerning -- */
+static int kern_p(char *p)
+{
+	int fnum;
+	unsigned short pc;
+
+	if (svg || epsf == 2)
+		return 0;			/* kerned by the SVG output */
+	fnum = cfmt.font_tb[curft].fnum;
+	pc = 0;
+	while (*p != '\0') {
+		if (font_kern(fnum, pc, (unsigned char) *p) != 0)
+			return 1;
+		pc = (unsigned char) *p++;
+	}
+	return 0;
+}
+
+/* -- move the current point by the kerning of a string -- */
+static void str_kern(float k)
+{
+	str_end(strtx & TX_ARR);
+	a2b(" %.2f 0 RM", k);
+}
+
 /* -- output a string and the font changes -- */
 static void str_ft_out(char *p, int end)
 {
-	int use_glyph;
+	int use_glyph, kern;
+	unsigned short c, pc;
+	float k;
 	char *q;
 
 	use_glyph = !svg && epsf != 2 &&		/* not SVG */
 		 get_font_encoding(curft) == 0;		/* utf-8 */
+	kern = !svg && epsf != 2 &&
+		strop != strop_tb[A_GCHEXP];
+	pc = 0;
 	q = p;
 	while (*p != '\0') {
+
+		/* kerning as in tex_str() */
+		if (kern
+		 && ((unsigned char) *p & 0xc0) != 0x80	/* not in UTF-8 */
+		 && (*p != '$'
+		  || !isdigit((unsigned char) p[1])
+		  || (unsigned) (p[1] - '0') >= FONT_UMAX)) {
+			c = kern_char(p);
+			k = font_kern(cfmt.font_tb[curft].fnum, pc, c);
+			pc = c;
+			if (k != 0) {
+				if (p > q)
+					str_ft_out1(q, p - q);
+				q = p;
+				str_kern(k * cfmt.font_tb[curft].size);
+			}
+		}
 		if ((unsigned char) *p >= 0x80
 		 && use_glyph) {
 			if (p > q) {
@@ -857,6 +1155,7 @@ static void str_ft_out(char *p, int end)
 					use_glyph = !svg && epsf != 2 &&
 						 get_font_encoding(curft) == 0;
 				}
+				pc = 0;
 				p += 2;
 				q = p;
 				continue;
@@ -922,9 +1221,12 @@ void str_out(char *p, int action)
 #endif
 
 	/* direct output if no font change
-	 * nor non ASCII characters */
+	 * nor non ASCII characters
+	 * nor kerning when PostScript aligns the string */
 	if (strchr(p, '$') == 0
-	 && !non_ascii_p(p)) {
+	 && !non_ascii_p(p)
+	 && ((action != A_CENTER && action != A_RIGHT)
+	  || !kern_p(p))) {
 		strop = strop_tb[action];
 		str_ft_out(p, 1);		/* output the string */
 		return;
@@ -1176,7 +1478,8 @@ void write_text(char *cmd, char *s, int job)
 
 		if (nw != 0) {
 			str_ft_out1(" ", 1);
-			strw += cwid(' ') * cfmt.font_tb[curft].swfac;
+			strw += font_cwid(cfmt.font_tb[curft].fnum, ' ')
+					* cfmt.font_tb[curft].swfac;
 		}
 		str_ft_out(tex_buf, 0);
 		strw += lw;
@@ -1256,7 +1559,9 @@ void put_words(struct SYMBOL *words)
 	/* see if we may have 2 columns */
 	middle = 0.5 * ((cfmt.landscape ? cfmt.pageheight : cfmt.pagewidth)
 		- cfmt.leftmargin - cfmt.rightmargin) / cfmt.scale;
-	max2col = (int) ((middle - 45.) / (cwid('a') * cfmt.font_tb[WORDSFONT].swfac));
+	max2col = (int) ((middle - 45.) /
+			(font_cwid(cfmt.font_tb[WORDSFONT].fnum, 'a')
+				* cfmt.font_tb[WORDSFONT].swfac));
 	n = 0;
 	have_text = 0;
 	for (s = words; s != 0; s = s->next) {
@@ -55,7 +55,6 @@ struct ps_sym_s {
 };
 /* -- PostScript tiny interpreter -- */
 //jfm test
-#define NELTS 2048	/* number of elements per block */
 //#define NSYMS 128	/* max number of symbols */
 #define NSYMS 512	/* max number of symbols */
 static struct elt_s *elts;
@@ -616,6 +615,99 @@ static struct {
 #define D_showerror 85
 {	"<circle id=\"showerror\" r=\"30\" stroke=\"#ffc0c0\" stroke-width=\"2.5\" fill=\"none\"/>\n"},
 };
+static char *defs_ref = "";	/* file of the definitions (external sprite) */
+
+/* CSS classes of the graphic states (option '--svg-css') */
+static int css_on;			/* (not with the display list) */
+static char **css_tb;			/* properties of the classes */
+static int ncss, css_sz;
+static int css_out;			/* classes already in the output */
+
+/* pending stroked path - the consecutive ones with the same attributes
+ * are merged into one element with option '--svg-merge'.
+ * As the music symbols are drawn with the same color in the same
+ * container, the pending path is kept when they are output. */
+static char mrg_attr[128];		/* attributes, empty if none */
+static char *mrg_d;			/* path data */
+static int mrg_len, mrg_sz;
+static int mrg_keep;			/* output without flushing the path */
+
+/* -- output the pending stroked path -- */
+static void mrg_flush(void)
+{
+	if (mrg_attr[0] == '\0' || mrg_keep)
+		return;
+	fprintf(fout, "<path%s\n\td=\"%s\"/>\n", mrg_attr, mrg_d);
+	mrg_attr[0] = '\0';
+	mrg_len = 0;
+}
+
+/* SVG output - the pending path is written first */
+static void out_printf(const char *fmt, ...)
+{
+	va_list args;
+
+	mrg_flush();
+	va_start(args, fmt);
+	vfprintf(fout, fmt, args);
+	va_end(args);
+}
+
+static void out_puts(const char *p)
+{
+	mrg_flush();
+	fputs(p, fout);
+}
+
+static void out_putc(int c)
+{
+	mrg_flush();
+	fputc(c, fout);
+}
+
+static void out_write(const char *p, int len)
+{
+	mrg_flush();
+	fwrite(p, 1, len, fout);
+}
+
+/* -- start or continue a stroked path -- */
+static void stroke_begin(const char *attr)
+{
+	if (strcmp(attr, mrg_attr) == 0)
+		return;
+	mrg_flush();
+	strncpy(mrg_attr, attr, sizeof mrg_attr - 1);
+}
+
+/* -- add data to the stroked path -- */
+static void stroke_printf(const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	for (;;) {
+		va_start(args, fmt);
+		len = vsnprintf(mrg_d + mrg_len, mrg_sz - mrg_len, fmt, args);
+		va_end(args);
+		if (mrg_d && mrg_len + len < mrg_sz)
+			break;
+		mrg_sz = mrg_sz * 2 + len + 256;
+		mrg_d = realloc(mrg_d, mrg_sz);
+		if (!mrg_d) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	mrg_len += len;
+}
+
+/* -- end of a stroked path -- */
+static void stroke_end(void)
+{
+	if (!svg_merge)
+		mrg_flush();
+}
 
 /* PS functions */
 static void elts_link(struct elt_s *e)
@@ -637,10 +729,13 @@ static void elts_reset(void)
 {
 	struct elt_s *e;
 
-	if (!elts)
+	if (!elts) {
 		elts = calloc(sizeof *elts, NELTS);
+		mem.svg_blocks++;
+	}
 	elts_link(elts);
 	free_elt = elts + 1;
+	mem.svg_used = 0;
 
 	/* link all blocks */
 	for (e = elts; e->u.e; e = e->u.e) {
@@ -665,10 +760,13 @@ static struct elt_s *elt_new(void)
 		e->u.e = elts;
 		elts = e;
 		e++;
+		mem.svg_blocks++;
 	}
 	free_elt = e->next;
 	e->next = NULL;
 	e->type = VAL;
+	if (++mem.svg_used > mem.svg_hwm)
+		mem.svg_hwm = mem.svg_used;
 	return e;
 }
 
@@ -678,6 +776,7 @@ static void elt_free(struct elt_s *e)
 
 	e->next = free_elt;
 	free_elt = e;
+	mem.svg_used--;
 	switch (e->type) {
 	case STR:
 		free(e->u.s);
@@ -857,6 +956,7 @@ static float pop_free_val(void)
 		return 0;
 	e->next = free_elt;
 	free_elt = e;
+	mem.svg_used--;
 	return e->u.v;
 }
 
@@ -872,6 +972,7 @@ static char *pop_free_str(void)
 	e->type = VAL;
 	e->next = free_elt;
 	free_elt = e;
+	mem.svg_used--;
 	return s;
 }
 
@@ -940,7 +1041,7 @@ static void gen_info(void)
 #else
 	strftime(tex_buf, TEX_BUF_SZ, "%b %#d, %Y %H:%M", localtime(&ltime));
 #endif
-	fprintf(fout, "<!-- CreationDate: %s -->\n"
+	out_printf("<!-- CreationDate: %s -->\n"
 			"<!-- CommandLine:",
 			tex_buf);
 
@@ -950,20 +1051,48 @@ static void gen_info(void)
 
 		p = s_argv[i];
 		space = strchr(p, ' ') != NULL || strchr(p, '\n') != NULL;
-		fputc(' ', fout);
+		out_putc(' ');
 		if (space)
-			fputc('\'', fout);
+			out_putc('\'');
 
 		/* cannot have '--' inside comment ! */
 		if (*p == '-' && p[1] == '-') {
-			fputs("-\\", fout);
+			out_puts("-\\");
 			p++;
 		}
-		fputs(p, fout);
+		out_puts(p);
 		if (space)
-			fputc('\'', fout);
+			out_putc('\'');
+	}
+	out_puts(" -->\n");
+}
+
+/* -- write the external file of the definitions (option '--svg-defs') -- */
+/* this is done once, with all the definitions */
+static void sprite_write(void)
+{
+	FILE *f;
+	unsigned i;
+
+	if (*defs_ref != '\0')
+		return;
+	defs_ref = svg_defs;
+	if ((f = fopen(svg_defs, "w")) == NULL) {
+		error(1, 0, "Cannot open output file %s - abort", svg_defs);
+		exit(EXIT_FAILURE);
 	}
-	fputs(" -->\n", fout);
+	fputs("<?xml version=\"1.0\" standalone=\"no\"?>\n"
+		"<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\"\n"
+		"\txmlns:xlink=\"http://www.w3.org/1999/xlink\">\n"
+		"<!-- Creator: abcm2ps-" VERSION " -->\n"
+		"<defs>\n", f);
+	for (i = 0; i < sizeof def_tb / sizeof def_tb[0]; i++)
+		fputs(def_tb[i].def, f);
+	fputs("</defs>\n"
+		"</svg>\n", f);
+	fclose(f);
+	if (!quiet)
+		fprintf(stderr, "Definitions written on %s\n", svg_defs);
 }
 
 /* -- output the symbol definitions -- */
@@ -984,8 +1113,22 @@ void define_svg_symbols(char *title, int num, float w, float h)
 	gcur.linewidth = DLW;
 	memcpy(&gold, &gcur, sizeof gold);
 	nsave = 0;
-	for (i = 0; i < sizeof def_tb / sizeof def_tb[0]; i++)
-		def_tb[i].defined = 0;
+	if (!file_initialized) {		/* new file */
+		css_on = svg_css && !dlout;
+		while (ncss > 0)
+			free(css_tb[--ncss]);
+		css_out = 0;
+	}
+	if (svg_defs && !dlout
+	 && strcmp(svg_defs, "page") != 0 && strcmp(svg_defs, "file") != 0) {
+		sprite_write();
+		for (i = 0; i < sizeof def_tb / sizeof def_tb[0]; i++)
+			def_tb[i].defined = 1;
+	} else if (!svg_defs || strcmp(svg_defs, "file") != 0
+		|| !file_initialized) {
+		for (i = 0; i < sizeof def_tb / sizeof def_tb[0]; i++)
+			def_tb[i].defined = 0;
+	}
 
 	if (svg == 2) {			/* if XHTML */
 		if (!file_initialized) {
@@ -993,21 +1136,20 @@ void define_svg_symbols(char *title, int num, float w, float h)
 				s = in_fname;
 			else
 				s++;
-			fputs("<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n"
+			out_puts("<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.1//EN\"\n"
 				"\"http://www.w3.org/TR/xhtml1/DTD/xhtml1.dtd\">\n"
 				"<html xmlns=\"http://www.w3.org/1999/xhtml\">\n"
 				"<head>\n"
 				"<meta http-equiv=\"Content-Type\" content=\"text/html; charset=UTF-8\"/>\n"
-				"<meta name=\"generator\" content=\"abcm2ps-" VERSION "\"/>\n",
-				fout);
+				"<meta name=\"generator\" content=\"abcm2ps-" VERSION "\"/>\n");
 			gen_info();
-			fprintf(fout,
+			out_printf(
 				"<style type=\"text/css\">\n"
 				"\tbody {margin:0; padding:0; border:0;");
 			if (cfmt.bgcolor != 0 && cfmt.bgcolor[0] != '\0')
-				fprintf(fout, " background-color:%s",
+				out_printf(" background-color:%s",
 						cfmt.bgcolor);
-			fprintf(fout,
+			out_printf(
 				"}\n"
 				"\t@page {margin:0;}\n"
 				"</style>\n"
@@ -1017,26 +1159,25 @@ void define_svg_symbols(char *title, int num, float w, float h)
 				
 				s);
 		}
-		fputs("<p>\n", fout);
-		fprintf(fout, svg_head, w / 72, h / 72, w, h, title, "page", num);
+		out_puts("<p>\n");
+		out_printf(svg_head, w / 72, h / 72, w, h, title, "page", num);
 		if (cfmt.bgcolor != 0 && cfmt.bgcolor[0] != '\0')
-			fprintf(fout,
+			out_printf(
 				"<rect width=\"100%%\" height=\"100%%\" fill=\"%s\"/>\n",
 				cfmt.bgcolor);
 	} else {				/* -g or -v */
-		if (fout != stdout)
-			fputs("<?xml version=\"1.0\" standalone=\"no\"?>\n"
+		if (!fout_stdout())
+			out_puts("<?xml version=\"1.0\" standalone=\"no\"?>\n"
 				"<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
-				"\t\"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n",
-				fout);
+				"\t\"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n");
 		else if (svg)
-			fputs("<p>\n", fout);
-		fprintf(fout, svg_head, w / 72, h / 72, w, h, title,
+			out_puts("<p>\n");
+		out_printf(svg_head, w / 72, h / 72, w, h, title,
 			epsf ? "tune" : "page", num);
-		fputs("<!-- Creator: abcm2ps-" VERSION " -->\n", fout);
+		out_puts("<!-- Creator: abcm2ps-" VERSION " -->\n");
 		gen_info();
 		if (cfmt.bgcolor != 0 && cfmt.bgcolor[0] != '\0')
-			fprintf(fout,
+			out_printf(
 				"<rect width=\"100%%\" height=\"100%%\" fill=\"%s\"/>\n",
 				cfmt.bgcolor);
 	}
@@ -1058,97 +1199,243 @@ void define_svg_symbols(char *title, int num, float w, float h)
 	free(s);
 }
 
-static void selfont(int back)
+/* -- add a property of the graphic state -- */
+/* this is a presentation attribute, or a CSS property with '--svg-css' */
+static char *prop(char *p, const char *name, const char *value)
 {
-	char *p;
+	if (css_on)
+		return p + sprintf(p, "%s:%s;", name, value);
+	return p + sprintf(p, " %s=\"%s\"", name, value);
+}
+
+/* -- get the CSS class of a graphic state -- */
+static int css_class(char *props)
+{
+	int i;
+
+	for (i = 0; i < ncss; i++) {
+		if (strcmp(css_tb[i], props) == 0)
+			return i;
+	}
+	if (ncss >= css_sz) {
+		css_sz = css_sz * 2 + 32;
+		css_tb = realloc(css_tb, css_sz * sizeof *css_tb);
+		if (!css_tb) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	css_tb[ncss] = strdup(props);
+	return ncss++;
+}
+
+/* -- output the new CSS classes -- */
+/* (the style elements cannot be in the texts) */
+static void css_flush(void)
+{
+	if (css_out >= ncss)
+		return;
+	out_puts("<style type=\"text/css\">\n");
+	while (css_out < ncss) {
+		out_printf(".g%d{%s}\n", css_out, css_tb[css_out]);
+		css_out++;
+	}
+	out_puts("</style>\n");
+}
+
+/* -- output the graphic state attributes or class -- */
+static void gstate_out(char *attr)
+{
+	if (!css_on)
+		out_puts(attr);
+	else if (attr[0] != '\0')
+		out_printf(" class=\"g%d\"", css_class(attr));
+}
+
+static char *selfont(char *p, int back)
+{
+	char *q, tmp[sizeof gcur.font_n + 8];
 	int flags;
 
 	if (gcur.font_n[0] == '\0')
-		return;
+		return p;
 	flags = 0;
-	p = strchr(gcur.font_n, '-');
-	if (!p) {
-		fprintf(fout, " font-family=\"%s\" font-size=\"%.2f\"",
-			gcur.font_n, gcur.font_s);
+	q = strchr(gcur.font_n, '-');
+	if (!q) {
+		p = prop(p, "font-family", gcur.font_n);
 	} else {
-		fprintf(fout, " font-family=\"%.*s\" font-size=\"%.2f\"",
-			(int) (p - gcur.font_n), gcur.font_n, gcur.font_s);
+		sprintf(tmp, "%.*s", (int) (q - gcur.font_n), gcur.font_n);
+		p = prop(p, "font-family", tmp);
+	}
+	sprintf(tmp, css_on ? "%.2fpx" : "%.2f", gcur.font_s);
+	p = prop(p, "font-size", tmp);
+	if (q) {
 		if (strstr(gcur.font_n, "Bold") != 0) {
-			fprintf(fout, " font-weight=\"bold\"");
+			p = prop(p, "font-weight", "bold");
 			flags = 1;
 		}
 		if (strstr(gcur.font_n, "Italic") != 0) {
-			fprintf(fout, " font-style=\"italic\"");
+			p = prop(p, "font-style", "italic");
 			flags |= 2;
 		} else if (strstr(gcur.font_n, "Oblique") != 0) {
-			fprintf(fout, " font-style=\"oblique\"");
+			p = prop(p, "font-style", "oblique");
 			flags |= 2;
 		}
 	}
 	if (!back)
-		return;
+		return p;
 	if (!(flags & 1)
 	 && strstr(gold.font_n, "Bold") != 0)
-		fprintf(fout, " font-weight=\"normal\"");
+		p = prop(p, "font-weight", "normal");
 	if (!(flags & 2)
 	 && (strstr(gold.font_n, "Italic") != 0
 	  || strstr(gold.font_n, "Oblique") != 0))
-		fprintf(fout, " font-style=\"normal\"");
+		p = prop(p, "font-style", "normal");
+	return p;
+}
+
+/* -- get the number of the current font -- */
+static int cur_fnum(void)
+{
+	static char font_n[64];		/* last font and its number */
+	static int fnum = -1;
+
+	if (strcmp(font_n, gcur.font_n) != 0) {
+		strcpy(font_n, gcur.font_n);
+		fnum = afm_font(font_n);
+	}
+	return fnum;
+}
+
+/* -- get the kerning of a string (em) -- */
+/* When 'dx' is not set, strk_n is set to the number of characters
+ * up to the last kerned one.
+ * When 'dx' is set, the kerning values of these characters
+ * are output as a SVG attribute. */
+static int strk_n;
+static float strk(char *s, int dx)
+{
+	unsigned short c, pc;
+	int fnum, n;
+	float k, w;
+
+	if (!dx)
+		strk_n = 0;
+	fnum = cur_fnum();
+	if (!afm_loaded(fnum))
+		return 0;
+	if (dx)
+		out_puts(" dx=\"");
+	w = 0;
+	n = 0;
+	pc = 0;
+	while ((c = (unsigned char) *s++) != '\0') {
+		if (c == '&' && *s == '#') {	/* XML character reference */
+			while (*s != '\0' && *s++ != ';')
+				;
+			c = 0;
+		} else if (c >= 0x80) {
+			if ((c & 0xe0) == 0xc0 && (*s & 0xc0) == 0x80) {
+				c = ((c & 0x1f) << 6) | (*s++ & 0x3f);
+			} else {		/* no kerning */
+				while ((*s & 0xc0) == 0x80)
+					s++;
+				c = 0;
+			}
+		}
+		k = font_kern(fnum, pc, c);
+		pc = c;
+		w += k;
+		if (dx) {
+			if (n >= strk_n)
+				break;
+			out_printf(n == 0 ? "%.2f" : " %.2f",
+					k * gcur.font_s);
+		}
+		n++;
+		if (k != 0 && !dx)
+			strk_n = n;
+	}
+	if (dx)
+		out_puts("\"");
+	return w;
 }
 
 static float strw(char *s)
 {
 	unsigned short c;
-	float w;
+	char *p;
+	int fnum;
+	float w, swfac;
 
+	fnum = cur_fnum();
+	swfac = afm_loaded(fnum) ? 1 : 1.1;
 	w = 0;
+	p = s;
 	for (;;) {
-		c = *s++;
+		c = *p++;
 		if (c == '\0')
 			break;
-		w += cwid(c) * 1.1;
+		w += font_cwid(fnum, c) * swfac;
 	}
-	return w * gcur.font_s;
+	return (w + strk(s, 0)) * gcur.font_s;
 }
 
 /* define the global container */
 static void setg(int newg);
 static void defg1(void)
 {
+	char attr[256], tmp[32], *p;
+
 	setg(0);
-	fputs("<g", fout);
+	p = attr;
+	*p = '\0';
+	if (gcur.linewidth != 1) {
+		sprintf(tmp, css_on ? "%.2fpx" : "%.2f", gcur.linewidth);
+		p = prop(p, "stroke-width", tmp);
+	}
+	p = selfont(p, 0);
+	if (gcur.rgb != 0) {
+		if (css_on)
+			sprintf(p, "color:#%06x;fill:#%06x;",
+				gcur.rgb, gcur.rgb);
+		else
+			sprintf(p, " style=\"color:#%06x;fill:#%06x\"",
+				gcur.rgb, gcur.rgb);
+	}
+	if (css_on && attr[0] != '\0') {
+		sprintf(tmp, " class=\"g%d\"", css_class(attr));
+		strcpy(attr, tmp);
+		css_flush();
+	}
+	out_puts("<g");
 	if (gcur.xscale != 1 || gcur.yscale != 1 || gcur.rotate != 0) {
-		fprintf(fout, " transform=\"");
+		out_printf(" transform=\"");
 		if (gcur.xscale != 1 || gcur.yscale != 1) {
 			if (gcur.xscale == gcur.yscale)
-				fprintf(fout, "scale(%.3f)", gcur.xscale);
+				out_printf("scale(%.3f)", gcur.xscale);
 			else
-				fprintf(fout, "scale(%.3f,%.3f)",
+				out_printf("scale(%.3f,%.3f)",
 						gcur.xscale, gcur.yscale);
 		}
 		if (gcur.rotate != 0) {
 			if (xoffs != 0 || yoffs != 0) {
-				fprintf(fout, " translate(%.2f, %.2f)",
+				out_printf(" translate(%.2f, %.2f)",
 						xoffs, yoffs);
 				x_rot = xoffs;
 				y_rot = yoffs;
 				xoffs = 0;
 				yoffs = 0;
 			}
-			fprintf(fout, " rotate(%.2f)",
+			out_printf(" rotate(%.2f)",
 					gcur.rotate);
 		}
-		fputs("\"", fout);
+		out_puts("\"");
 	}
-	if (gcur.linewidth != 1)
-		fprintf(fout, " stroke-width=\"%.2f\"", gcur.linewidth);
-	selfont(0);
-	if (gcur.rgb != 0)
-		fprintf(fout, " style=\"color:#%06x;fill:#%06x\"",
-				gcur.rgb, gcur.rgb);
+	out_puts(attr);
 //jfm test
-//	fprintf(fout, "%s>\n", gcur.dash);
-	fprintf(fout, ">\n");
+//	out_printf("%s>\n", gcur.dash);
+	out_printf(">\n");
 	g = 1;
 	memcpy(&gold, &gcur, sizeof gold);
 }
@@ -1167,19 +1454,19 @@ static void setg(int newg)
 {
 #if 0 //path change
 	if (in_path) {
-		fputs("\"/>\n", fout);
+		out_puts("\"/>\n");
 		fprintf(stderr, "svg setg: No stroke nor fill\n");
 //		ps_error = 1;
 		in_path = 0;
 	}
 #endif
 	if (g == 2) {
-		fputs("</text>\n", fout);
+		out_puts("</text>\n");
 		g = 1;
 	}
 	if (newg == 0) {
 		if (g != 0) {
-			fputs("</g>\n", fout);
+			out_puts("</g>\n");
 			if (gcur.rotate != 0) {
 				xoffs = x_rot;
 				yoffs = y_rot;
@@ -1227,7 +1514,7 @@ static void path_def(void)
 static void path_end(void)
 {
 	setg(1);
-	fputs(path, fout);
+	out_puts(path);
 	free(path);
 	path = NULL;
 }
@@ -1241,26 +1528,47 @@ static void def_use(int def)
 	if (def_tb[def].defined)
 		return;
 	def_tb[def].defined = 1;
-	fputs("<defs>\n", fout);
+	mrg_keep = svg_merge;
+	out_puts("<defs>\n");
 	i = def_tb[def].use;
 	while (i != 0 && !def_tb[i].defined) {
 		def_tb[i].defined = 1;
-		fputs(def_tb[i].def, fout);
+		out_puts(def_tb[i].def);
 		i = def_tb[i].use;
 	}
-	fputs(def_tb[def].def, fout);
-	fputs("</defs>\n", fout);
+	out_puts(def_tb[def].def);
+	out_puts("</defs>\n");
+	mrg_keep = 0;
 }
 
 static void xysym(char *op, int use)
 {
 	float x, y;
+	int w;
 
+	switch (use) {
+	case D_hl: w = 6; break;
+	case D_hl1: w = 7; break;
+	case D_hl2: w = 9; break;
+	case D_ghl: w = 3; break;
+	default: w = 0; break;
+	}
+	if (w != 0 && svg_merge) {		/* ledger line */
+		gcur.linewidth = DLW;
+		setg(1);
+		y = yoffs - pop_free_val();
+		x = xoffs + pop_free_val();
+		stroke_begin(" stroke=\"currentColor\" fill=\"none\"");
+		stroke_printf("M%.2f %.2fh%d", x - w, y, w * 2);
+		return;
+	}
 	def_use(use);
 	y = yoffs - pop_free_val();
 	x = xoffs + pop_free_val();
-	fprintf(fout, "<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"#%s\"/>\n",
-		x, y, op);
+	mrg_keep = svg_merge;
+	out_printf("<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#%s\"/>\n",
+		x, y, defs_ref, op);
+	mrg_keep = 0;
 }
 
 static void setxory(char *s, float v)
@@ -1290,8 +1598,10 @@ static void setxysym(char *op, int use)
 	setxory("x", x);
 	setxory("y", y);
 	def_use(use);
-	fprintf(fout, "<use id=\"sym%d\" x=\"%.2f\" y=\"%.2f\" xlink:href=\"#%s\"/>\n",
-		id++, xoffs + x, yoffs - y, op);
+	mrg_keep = svg_merge;
+	out_printf("<use id=\"sym%d\" x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#%s\"/>\n",
+		id++, xoffs + x, yoffs - y, defs_ref, op);
+	mrg_keep = 0;
 }
 
 /*  gua gda (acciaccatura) */
@@ -1314,7 +1624,7 @@ static void acciac(char *op)
 		x -= 5;
 		y += 4;
 	}
-	fprintf(fout,
+	out_printf(
 		"<path d=\"M%.2f %.2fl%.2f %.2f\" stroke=\"currentColor\" fill=\"none\"/>\n",
 		x, y, dx, -dy);
 }
@@ -1331,19 +1641,19 @@ static void arp_ltr(char type)
 	w = pop_free_val();
 	n = (w + 5) / 6;
 	if (type == 'a') {
-		fprintf(fout, "<g transform=\"rotate(270)\">\n");
+		out_printf("<g transform=\"rotate(270)\">\n");
 		t = x;
 		x = -y;
 		y = t;
 	}
 	y -= 4;
 	while (--n >= 0) {
-		fprintf(fout, "<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"#ltr\"/>\n",
-			x, y);
+		out_printf("<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#ltr\"/>\n",
+			x, y, defs_ref);
 			x += 6;
 	}
 	if (type == 'a')
-		fprintf(fout, "</g>\n");
+		out_printf("</g>\n");
 }
 
 /* sd su gd gu */
@@ -1366,7 +1676,12 @@ static void stem(char *op)
 	sym = ps_sym_lookup("y");
 	y = yoffs - sym->e->u.v;
 
-	fprintf(fout,
+	if (svg_merge) {			/* (no identifier) */
+		stroke_begin(" stroke=\"currentColor\" fill=\"none\"");
+		stroke_printf("M%.2f %.2fv%.2f", x, y, -h);
+		return;
+	}
+	out_printf(
 		"<path id=\"stem%d\" d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n",
 		id, x, y, -h);
 }
@@ -1392,12 +1707,12 @@ static void xml_str_out(char *p)
 			continue;
 		}
 		if (p - 1 != q)
-			fwrite(q, 1, p - 1 - q, fout);
+			out_write(q, p - 1 - q);
 		q = p;
-		fputs(r, fout);
+		out_puts(r);
 	}
 	if (p != q)
-		fputs(q, fout);
+		out_puts(q);
 }
 
 /*
@@ -1408,7 +1723,7 @@ static void show(char type)
 {
 	float x, y, w;
 	char tmp[4], *s, *p, *q;
-	int span;
+	int span, kern;
 
 	span = 0;
 	if (memcmp(&gcur, &gold, sizeof gcur) != 0) {
@@ -1422,6 +1737,7 @@ static void show(char type)
 		x = cx;
 		y = cy;
 		w = pop_free_val();
+		kern = 0;
 		p = tmp;
 		tmp[0] = '\0';
 		s = NULL;
@@ -1444,6 +1760,7 @@ static void show(char type)
 			s = NULL;
 		}
 		w = strw(p);
+		kern = type != 'x' && strk_n > 0;
 		if (type == 'x') {		/* gxshow */
 			w = pop_free_val();	/* inter TAB width */
 			q = strchr(p, '\t');
@@ -1452,35 +1769,47 @@ static void show(char type)
 		break;
 	}
 	if (span) {
-		fprintf(fout,"<tspan\n\t");
-		selfont(1);
-		fprintf(fout,">");
+		char attr[256];
+
+		*selfont(attr, 1) = '\0';
+		out_printf("<tspan");
+		if (css_on) {
+			gstate_out(attr);
+		} else {
+			out_printf("\n\t");
+			out_puts(attr);
+		}
+		if (kern)
+			strk(p, 1);
+		out_printf(">");
 	} else if (g != 2) {
-		fprintf(fout, "<text x=\"%.2f\" y=\"%.2f\"", x + xoffs, yoffs - y);
+		out_printf("<text x=\"%.2f\" y=\"%.2f\"", x + xoffs, yoffs - y);
 		switch (type) {
 		case 'c':
-			fprintf(fout, " text-anchor=\"middle\"");
+			out_printf(" text-anchor=\"middle\"");
 			w /= 2;
 			break;
 		case 'r':
-			fprintf(fout, " text-anchor=\"end\"");
+			out_printf(" text-anchor=\"end\"");
 			w = 0;
 			break;
 		case 'j':
-			fprintf(fout, " textLength=\"%.2f\"", w);
+			out_printf(" textLength=\"%.2f\"", w);
 			break;
 		}
+		if (kern)
+			strk(p, 1);
 
 //		if (gcur.rgb != 0)
-//			fprintf(fout, " fill=\"currentColor\"");
-		fputs(">", fout);
+//			out_printf(" fill=\"currentColor\"");
+		out_puts(">");
 		g = 2;
 	}
 
 back:
 	xml_str_out(p);
 	if (span)
-		fprintf(fout, "</tspan>");
+		out_printf("</tspan>");
 
 	if (type == 'x') {
 		p = p + strlen(p) + 1;		/* next string of gxshow */
@@ -1493,13 +1822,13 @@ back:
 			w = free_elt->u.v;
 			type = 's';
 		}
-		fprintf(fout, "<tspan dx=\"%.2f\">", w);
+		out_printf("<tspan dx=\"%.2f\">", w);
 		span = 1;
 		goto back;
 	}
 	if (type == 'b') {
 		setg(1);
-		fprintf(fout,
+		out_printf(
 			"<rect stroke=\"currentColor\" fill=\"none\" stroke-width=\"0.6\"\n"
 			"	x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\"/>\n",
 			xoffs + cx - 2, yoffs - y - gcur.font_s + 2, w + 4, gcur.font_s + 1);
@@ -1511,6 +1840,21 @@ back:
 
 static void ps_exec(char *op);
 
+FILE *svg_capture;			/* copy of the input stream (abcmbench) */
+
+/* PostScript operator profile (--psprof) */
+int psprof;
+#define PROF_HASH 256
+static struct prof_s {
+	struct prof_s *next;		/* hash link */
+	int calls;
+	char user;			/* user procedure */
+	double t;			/* time, including the inner operators */
+	long bytes;			/* SVG bytes, including the inner operators */
+	char name[1];
+} *prof_tb[PROF_HASH];
+static int nprof;
+
 /* execute a sequence
  * returns 1 on 'exit' or error */
 static int seq_exec(struct elt_s *e)
@@ -1561,7 +1905,7 @@ static int seq_exec(struct elt_s *e)
 
 /* execute a command */
 /* (in case of error, a string may be not freed, but it is not important!) */
-static void ps_exec(char *op)
+static void ps_op(char *op)
 {
 	struct ps_sym_s *sym;
 	struct elt_s *e, *e2;
@@ -1722,9 +2066,9 @@ stack_dump();
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
 			h = pop_free_val();
-			fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\"\n"
-				"	d=\"M%.2f %.2fv%.2f\"/>\n",
-				x, y, -h);
+			stroke_begin(" stroke=\"currentColor\" fill=\"none\"");
+			stroke_printf("M%.2f %.2fv%.2f", x, y, -h);
+			stroke_end();
 			return;
 		}
 		if (strcmp(op, "bclef") == 0) {
@@ -1764,7 +2108,7 @@ stack_dump();
 			dy = pop_free_val();
 			dx = pop_free_val();
 			h = pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<path fill=\"currentColor\"\n"
 				"	d=\"M%.2f %.2fl%.2f %.2fv%.2fl%.2f %.2f\"/>\n",
 				x, y, dx, -dy, h,-dx, dy);
@@ -1783,11 +2127,11 @@ stack_dump();
 			}
 			if (op[4] == 'b') {
 				w = 7 * strlen(s);
-				fprintf(fout,
+				out_printf(
 					"<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"12\" fill=\"white\"/>\n",
 					x - w / 2, y - 10, w);
 			}
-			fprintf(fout,
+			out_printf(
 				"<text font-family=\"Times\" font-size=\"12\" font-style=\"italic\" font-weight=\"normal\"\n"
 				"	x=\"%.2f\" y=\"%.2f\" text-anchor=\"middle\">%s</text>\n",
 				x, y, s + 1);
@@ -1800,7 +2144,7 @@ stack_dump();
 			w = pop_free_val();
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<rect stroke=\"currentColor\" fill=\"none\"\n"
 				"	x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\"/>\n",
 				x, y - h, w, h);
@@ -1811,7 +2155,7 @@ stack_dump();
 			h = pop_free_val();
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<rect stroke=\"currentColor\" fill=\"none\"\n"
 				"	x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\"/>\n",
 				x, y - h, boxend - (x - xoffs) + 6, h);
@@ -1831,11 +2175,11 @@ stack_dump();
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
 			h = pop_free_val() * 0.01;
-			fprintf(fout,
+			out_printf(
 				"<g transform=\"translate(%.2f,%.2f) scale(1,%.2f)\">\n"
-				"	<use xlink:href=\"#brace\"/>\n"
+				"	<use xlink:href=\"%s#brace\"/>\n"
 				"</g>\n",
-				x, y, h);
+				x, y, h, defs_ref);
 			return;
 		}
 		if (strcmp(op, "bracket") == 0) {
@@ -1843,7 +2187,7 @@ stack_dump();
 			y = yoffs - pop_free_val() - 3;
 			x = xoffs + pop_free_val() - 5;
 			h = pop_free_val() + 2;
-			fprintf(fout,
+			out_printf(
 				"<path fill=\"currentColor\"\n"
 				"	d=\"M%.2f %.2f\n"
 				"	c10.5 1 12 -4.5 12 -3.5c0 1 -3.5 5.5 -8.5 5.5\n"
@@ -1860,7 +2204,7 @@ stack_dump();
 			setg(1);
 			y = yoffs - pop_free_val() - 6;
 			x = xoffs + pop_free_val();
-			fprintf(fout, "<text x=\"%.2f\" y=\"%.2f\" font-family=\"Times\" font-size=\"30\"\n"
+			out_printf("<text x=\"%.2f\" y=\"%.2f\" font-family=\"Times\" font-size=\"30\"\n"
 				"	font-weight=\"bold\" font-style=\"italic\">,</text>\n",
 				x, y);
 			return;
@@ -1966,11 +2310,11 @@ curveto:
 			sym = ps_sym_lookup("defl");
 			x += w;
 			if ((int) sym->e->u.v & 1)
-				fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\"\n"
+				out_printf("<path stroke=\"currentColor\" fill=\"none\"\n"
 					"d=\"M%.2f %.2fl%.2f -2.2m0 -3.6l%.2f -2.2\"/>\n",
 					x, y, -w, w);
 			else
-				fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\"\n"
+				out_printf("<path stroke=\"currentColor\" fill=\"none\"\n"
 					"d=\"M%.2f %.2fl%.2f -4l%.2f -4\"/>\n",
 					x, y, -w, w);
 			return;
@@ -2040,7 +2384,7 @@ curveto:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout, "<text font-family=\"Times\" font-size=\"16\" font-weight=\"normal\" font-style=\"normal\"\n"
+			out_printf("<text font-family=\"Times\" font-size=\"16\" font-weight=\"normal\" font-style=\"normal\"\n"
 				"	x=\"%.2f\" y=\"%.2f\" text-anchor=\"middle\">%s</text>\n",
 				x, y, s + 1);
 			free(s);
@@ -2057,11 +2401,11 @@ curveto:
 			w = pop_free_val();
 			sym = ps_sym_lookup("defl");
 			if ((int) sym->e->u.v & 2)
-				fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\"\n"
+				out_printf("<path stroke=\"currentColor\" fill=\"none\"\n"
 					"d=\"M%.2f %.2fl%.2f -2.2m0 -3.6l%.2f -2.2\"/>\n",
 					x, y, w, -w);
 			else
-				fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\"\n"
+				out_printf("<path stroke=\"currentColor\" fill=\"none\"\n"
 					"d=\"M%.2f %.2fl%.2f -4l%.2f -4\"/>\n",
 					x, y, w, -w);
 			return;
@@ -2096,7 +2440,7 @@ curveto:
 			a3 = pop_free_val();
 			a2 = pop_free_val();
 			a1 = pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<path stroke=\"currentColor\" fill=\"none\" stroke-dasharray=\"5,5\"\n"
 				"	d=\"M%.2f %.2fc%.2f %.2f %.2f %.2f %.2f %.2f\"/>\n",
 					m1, m2, a1, -a2, a3, -a4, a5, -a6);
@@ -2110,7 +2454,7 @@ curveto:
 			y = yoffs - sym->e->u.v;
 			y -= pop_free_val();
 			x += pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<circle fill=\"currentColor\" cx=\"%.2f\" cy=\"%.2f\" r=\"1.2\"/>\n",
 				x, y);
 			return;
@@ -2124,7 +2468,7 @@ curveto:
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
 			h = pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<path stroke=\"currentColor\" fill=\"none\" stroke-dasharray=\"5,5\"\n"
 				"	d=\"M%.2f %.2fv%.2f\"/>\n",
 				x, y, -h);
@@ -2162,7 +2506,7 @@ curveto:
 				return;
 			}
 			path_end();
-			fprintf(fout, "\t\" fill-rule=\"evenodd\" fill=\"currentColor\"/>\n");
+			out_printf("\t\" fill-rule=\"evenodd\" fill=\"currentColor\"/>\n");
 			return;
 		}
 		if (strcmp(op, "eq") == 0) {
@@ -2219,7 +2563,7 @@ curveto:
 				return;
 			}
 			path_end();
-			fprintf(fout, "\t\" fill=\"currentColor\"/>\n");
+			out_printf("\t\" fill=\"currentColor\"/>\n");
 			return;
 		}
 		if (strcmp(op, "findfont") == 0) {
@@ -2245,7 +2589,7 @@ curveto:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout, "<text font-family=\"Bookman\" font-size=\"8\" font-weight=\"normal\" font-style=\"normal\"\n"
+			out_printf("<text font-family=\"Bookman\" font-size=\"8\" font-weight=\"normal\" font-style=\"normal\"\n"
 				"	x=\"%.2f\" y=\"%.2f\">%s</text>\n",
 				x, y, s + 1);
 			free(s);
@@ -2471,7 +2815,7 @@ curveto:
 			a3 = pop_free_val();
 			a2 = pop_free_val();
 			a1 = pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<path stroke=\"currentColor\" fill=\"none\"\n"
 				"	d=\"M%.2f %.2fc%.2f %.2f %.2f %.2f %.2f %.2f\"/>\n",
 					m1, m2, a1, -a2, a3, -a4, a5, -a6);
@@ -2527,7 +2871,7 @@ curveto:
 			d = 25 + (int) w / 20 * 3;
 			n = (w - 15.) / d;
 			x += (w - d * n - 5) / 2;
-			fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\" stroke-width=\"1.2\"\n"
+			out_printf("<path stroke=\"currentColor\" fill=\"none\" stroke-width=\"1.2\"\n"
 				"	stroke-dasharray=\"5,%d\"\n"
 				"	d=\"M%.2f %.2fh%d\"/>\n",
 				d - 5,
@@ -2702,7 +3046,7 @@ moveto:
 			if (path) {
 				path_print("\tM%.2f %.2f\n", xoffs + cx, yoffs - cy);
 			} else if (g == 2) {
-				fputs("</text>\n", fout);
+				out_puts("</text>\n");
 				g = 1;
 			}
 			return;
@@ -2744,10 +3088,10 @@ moveto:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout, "<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"#mrest\"/>\n"
+			out_printf("<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#mrest\"/>\n"
 				"<text font-family=\"Times\" font-size=\"15\" font-weight=\"bold\" font-style=\"normal\"\n"
 				"	x=\"%.2f\" y=\"%.2f\" text-anchor=\"middle\">%s</text>\n",
-				x, y, x, y - 28, s + 1);
+				x, y, defs_ref, x, y - 28, s + 1);
 			free(s);
 			return;
 		}
@@ -2795,7 +3139,7 @@ moveto:
 				x -= 3.5;
 			else
 				x -= 2.5;
-			fprintf(fout, "<text font-family=\"Times\" font-size=\"12\" font-weight=\"normal\" font-style=\"normal\"\n"
+			out_printf("<text font-family=\"Times\" font-size=\"12\" font-weight=\"normal\" font-style=\"normal\"\n"
 				"	x=\"%.2f\" y=\"%.2f\">8</text>\n",
 				x, y);
 			return;
@@ -2820,8 +3164,8 @@ moveto:
 			def_use(D_pclef);
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
-			fprintf(fout, "<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"#%s\"/>\n",
-				x, y, op);
+			out_printf("<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#%s\"/>\n",
+				x, y, defs_ref, op);
 			return;
 		}
 		if (strcmp(op, "pf") == 0) {
@@ -2834,7 +3178,7 @@ moveto:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout, "<text font-family=\"Times\" font-size=\"16\" font-weight=\"bold\" font-style=\"italic\"\n"
+			out_printf("<text font-family=\"Times\" font-size=\"16\" font-weight=\"bold\" font-style=\"italic\"\n"
 				"	x=\"%.2f\" y=\"%.2f\">%s</text>\n",
 				x, y, s + 1);
 			free(s);
@@ -2944,7 +3288,7 @@ rmoveto:
 			if (path) {
 				path_print("\tm%.2f %.2f\n", x, -y);
 			} else if (g == 2) {
-				fputs("</text>\n", fout);
+				out_puts("</text>\n");
 				g = 1;
 			}
 			cx += x;
@@ -3072,21 +3416,21 @@ rmoveto:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout,
+			out_printf(
 				"<text x=\"%.2f\" y=\"%.2f\">",
 				x + 4, y - h);
 			xml_str_out(s + 1);
-			fprintf(fout,
+			out_printf(
 				"</text>\n"
 				"<path stroke=\"currentColor\" fill=\"none\"\n"
 				"	d=\"M%.2f %.2f",
 				x, y);
 			if (i != 1)
-				fprintf(fout, "v20M%.2f %.2f", x, y);
-			fprintf(fout, "h%.2f", w);
+				out_printf("v20M%.2f %.2f", x, y);
+			out_printf("h%.2f", w);
 			if (i != 0)
-				fprintf(fout, "v20");
-			fprintf(fout, "\"/>\n");
+				out_printf("v20");
+			out_printf("\"/>\n");
 			free(s);
 			return;
 		}
@@ -3146,7 +3490,7 @@ rmoveto:
 			c3 = pop_free_val();
 			c2 = pop_free_val();
 			c1 = pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<path fill=\"currentColor\"\n"
 				"	d=\"M%.2f %.2fc%.2f %.2f %.2f %.2f %.2f %.2f\n"
 				"	l%.2f %.2fc%.2f %.2f %.2f %.2f %.2f %.2f\"/>\n",
@@ -3194,10 +3538,9 @@ rmoveto:
 		if (strcmp(op, "sep0") == 0) {
 			x = pop_free_val();
 			w = pop_free_val();
-			fprintf(fout,
-				"<path stroke=\"currentColor\" fill=\"none\"\n"
-				"	d=\"M%.2f %.2fh%.2f\"/>\n",
-					xoffs + x, yoffs, w);
+			stroke_begin(" stroke=\"currentColor\" fill=\"none\"");
+			stroke_printf("M%.2f %.2fh%.2f", xoffs + x, yoffs, w);
+			stroke_end();
 			return;
 		}
 		if (strcmp(op, "setdash") == 0) {
@@ -3257,27 +3600,27 @@ rmoveto:
 			x = xoffs + sym->e->u.v + 3.5;
 			sym = ps_sym_lookup("y");
 			y = yoffs - sym->e->u.v;
-			fprintf(fout,
+			out_printf(
 				"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 				"<path fill=\"currentColor\"\n"
 				"	d=\"",
 				x, y, -h);
 			if (n == 1) {
-				fprintf(fout,
+				out_printf(
 					"	M%.2f %.2fc0.6 5.6 9.6 9 5.6 18.4\n"
 					"	c1.6 -6 -1.3 -11.6 -5.6 -12.8\n",
 					x, y - h);
 			} else {
 				y -= h;
 				while (--n >= 0) {
-					fprintf(fout,
+					out_printf(
 						"M%.2f %.2fc0.9 3.7 9.1 6.4 6 12.4\n"
 						"	c1 -5.4 -4.2 -8.4 -6 -8.4\n",
 						x, y);
 					y += 5.4;
 				}
 			}
-			fprintf(fout, "\"/>\n");
+			out_printf("\"/>\n");
 			return;
 		}
 		if (strcmp(op, "sfd") == 0) {
@@ -3288,27 +3631,27 @@ rmoveto:
 			x = xoffs + sym->e->u.v - 3.5;
 			sym = ps_sym_lookup("y");
 			y = yoffs - sym->e->u.v;
-			fprintf(fout,
+			out_printf(
 				"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 				"<path fill=\"currentColor\"\n"
 				"	d=\"",
 				x, y, -h);
 			if (n == 1) {
-				fprintf(fout,
+				out_printf(
 					"M%.2f %.2fc0.6 -5.6 9.6 -9 5.6 -18.4\n"
 					"	c1.6 6 -1.3 11.6 -5.6 12.8\n",
 					x, y - h);
 			} else {
 				y -= h;
 				while (--n >= 0) {
-					fprintf(fout,
+					out_printf(
 					"M%.2f %.2fc0.9 -3.7 9.1 -6.4 6 -12.4\n"
 					"	c1 5.4 -4.2 8.4 -6 8.4\n",
 					x, y);
 					y -= 5.4;
 				}
 			}
-			fprintf(fout, "\"/>\n");
+			out_printf("\"/>\n");
 			return;
 		}
 		if (strcmp(op, "sfs") == 0) {
@@ -3322,14 +3665,14 @@ rmoveto:
 			if (h > 0) {
 				x += 3.5;
 				y -= 1;
-				fprintf(fout,
+				out_printf(
 					"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 					"<path fill=\"currentColor\"\n"
 					"	d=\"",
 					x, y, -h + 1);
 				y -= h - 1;
 				while (--n >= 0) {
-					fprintf(fout,
+					out_printf(
 						"M%.2f %.2fl7 3.2 0 3.2 -7 -3.2z\n",
 						x, y);
 					y += 5.4;
@@ -3337,20 +3680,20 @@ rmoveto:
 			} else {
 				x -= 3.5;
 				y += 1;
-				fprintf(fout,
+				out_printf(
 					"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 					"<path fill=\"currentColor\"\n"
 					"	d=\"",
 					x, y, -h - 1);
 				y -= h + 1;
 				while (--n >= 0) {
-					fprintf(fout,
+					out_printf(
 						"M%.2f %.2fl7 -3.2 0 -3.2 -7 3.2z\n",
 						x, y);
 					y -= 5.4;
 				}
 			}
-			fprintf(fout, "\"/>\n");
+			out_printf("\"/>\n");
 			return;
 		}
 		if (strcmp(op, "sgu") == 0) {
@@ -3361,27 +3704,27 @@ rmoveto:
 			x = xoffs + sym->e->u.v + 1.6;
 			sym = ps_sym_lookup("y");
 			y = yoffs - sym->e->u.v;
-			fprintf(fout,
+			out_printf(
 				"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 				"<path fill=\"currentColor\"\n"
 				"	d=\"",
 				x, y, -h);
 			if (n == 1) {
-				fprintf(fout,
+				out_printf(
 					"M%.2f %.2fc0.6 3.4 5.6 3.8 3 10\n"
 					"	c1.2 -4.4 -1.4 -7 -3 -7\n",
 					x, y - h);
 			} else {
 				y -= h;
 				while (--n >= 0) {
-					fprintf(fout,
+					out_printf(
 						"M%.2f %.2fc1 3.2 5.6 2.8 3.2 8\n"
 						"	c1.4 -4.8 -2.4 -5.4 -3.2 -5.2\n",
 					x, y);
 					y += 3.5;
 				}
 			}
-			fprintf(fout, "\"/>\n");
+			out_printf("\"/>\n");
 			return;
 		}
 		if (strcmp(op, "sgd") == 0) {
@@ -3392,27 +3735,27 @@ rmoveto:
 			x = xoffs + sym->e->u.v - 1.6;
 			sym = ps_sym_lookup("y");
 			y = yoffs - sym->e->u.v;
-			fprintf(fout,
+			out_printf(
 				"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 				"<path fill=\"currentColor\"\n"
 				"	d=\"",
 				x, y, -h);
 			if (n == 1) {
-				fprintf(fout,
+				out_printf(
 					"M%.2f %.2fc0.6 -3.4 5.6 -3.8 3 -10\n"
 					"	c1.2 4.4 -1.4 7 -3 7\n",
 					x, y - h);
 			} else {
 				y -= h;
 				while (--n >= 0) {
-					fprintf(fout,
+					out_printf(
 						"M%.2f %.2fc1 -3.2 5.6 -2.8 3.2 -8\n"
 						"	c1.4 4.8 -2.4 5.4 -3.2 5.2\n",
 						x, y);
 						y -= 3.5;
 				}
 			}
-			fprintf(fout, "\"/>\n");
+			out_printf("\"/>\n");
 			return;
 		}
 		if (strcmp(op, "sgs") == 0) {
@@ -3423,19 +3766,19 @@ rmoveto:
 			x = xoffs + sym->e->u.v + 1.6;
 			sym = ps_sym_lookup("y");
 			y = yoffs - sym->e->u.v;
-			fprintf(fout,
+			out_printf(
 				"<path d=\"M%.2f %.2fv%.2f\" stroke=\"currentColor\" fill=\"none\"/>\n"
 				"<path fill=\"currentColor\"\n"
 				"	d=\"",
 				x, y, -h);
 			y -= h;
 			while (--n >= 0) {
-				fprintf(fout,
+				out_printf(
 					"M%.2f %.2fl3 1.5 0 2 -3 -1.5z\n",
 					x, y);
 				y += 3;
 			}
-			fprintf(fout, "\"/>\n");
+			out_printf("\"/>\n");
 			return;
 		}
 		if (strcmp(op, "sfz") == 0) {
@@ -3445,7 +3788,7 @@ rmoveto:
 			s = pop_free_str();
 			if (s != 0)
 				free(s);
-			fprintf(fout, "<text font-family=\"Times\" font-size=\"14\" font-style=\"italic\" font-weight=\"normal\"\n"
+			out_printf("<text font-family=\"Times\" font-size=\"14\" font-style=\"italic\" font-weight=\"normal\"\n"
 				"	x=\"%.2f\" y=\"%.2f\">s<tspan\n"
 				"	font-size=\"16\" font-weight=\"bold\">f</tspan>z</text>\n",
 				x, y);
@@ -3475,8 +3818,8 @@ rmoveto:
 			def_use(D_showerror);
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
-			fprintf(fout, "<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"#%s\"/>\n",
-				x, y, op);
+			out_printf("<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#%s\"/>\n",
+				x, y, defs_ref, op);
 			return;
 		}
 		if (strcmp(op, "sld") == 0) {
@@ -3495,8 +3838,8 @@ rmoveto:
 			def_use(D_pclef);
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val();
-			fprintf(fout, "<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"#pclef\"/>\n",
-				x, y);
+			out_printf("<use x=\"%.2f\" y=\"%.2f\" xlink:href=\"%s#pclef\"/>\n",
+				x, y, defs_ref);
 			return;
 		}
 		if (strcmp(op, "setrgbcolor") == 0) {
@@ -3515,16 +3858,15 @@ rmoveto:
 			x = xoffs + pop_free_val();
 			n = pop_free_val();
 			w = pop_free_val();
-			fprintf(fout,
-				"<path stroke=\"currentColor\" fill=\"none\"\n"
-				"	d=\"M%.2f %.2f", x, y);
+			stroke_begin(" stroke=\"currentColor\" fill=\"none\"");
+			stroke_printf("M%.2f %.2f", x, y);
 			for (;;) {
-				fprintf(fout, "h%.2f", w);
+				stroke_printf("h%.2f", w);
 				if (--n <= 0)
 					break;
-				fprintf(fout, "m%.2f -6", -w);
+				stroke_printf("m%.2f -6", -w);
 			}
-			fprintf(fout, "\"/>\n");
+			stroke_end();
 			return;
 		}
 		if (strcmp(op, "stc") == 0) {
@@ -3537,8 +3879,19 @@ rmoveto:
 //				ps_error = 1;
 				return;
 			}
+			if (svg_merge) {
+				setg(1);
+				snprintf(path_buf, sizeof path_buf,
+					" stroke=\"currentColor\" fill=\"none\"%s",
+					gcur.dash);
+				stroke_begin(path_buf);
+				stroke_printf("M%s", path + 10);	/* skip '<path d="m' */
+				free(path);
+				path = NULL;
+				return;
+			}
 			path_end();
-			fprintf(fout, "\t\" stroke=\"currentColor\" fill=\"none\"%s/>\n",
+			out_printf("\t\" stroke=\"currentColor\" fill=\"none\"%s/>\n",
 					gcur.dash);
 			return;
 		}
@@ -3557,7 +3910,7 @@ rmoveto:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout, "<g font-family=\"Times\" font-size=\"18\" font-weight=\"bold\" font-style=\"normal\"\n"
+			out_printf("<g font-family=\"Times\" font-size=\"18\" font-weight=\"bold\" font-style=\"normal\"\n"
 				"	transform=\"translate(%.2f,%.2f) scale(1.2,1)\">\n"
 				"	<text x=\"0\" y=\"-7\" text-anchor=\"middle\">%s</text>\n"
 				"</g>\n",
@@ -3659,7 +4012,7 @@ translate:
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val() + 1.5;
 			h = pop_free_val();
-			fprintf(fout,
+			out_printf(
 				"<path stroke=\"currentColor\" fill=\"none\" stroke-width=\"3\"\n"
 				"	d=\"M%.2f %.2fv%.2f\"/>\n",
 				x, y, -h);
@@ -3676,22 +4029,22 @@ translate:
 			y = yoffs - pop_free_val();
 			x = xoffs + pop_free_val() - 4.5;
 			n = pop_free_val();
-			fprintf(fout, "<path fill=\"currentColor\" d=\"m%.2f %.2f\n\t",
+			out_printf("<path fill=\"currentColor\" d=\"m%.2f %.2f\n\t",
 				x, y);
 			for (;;) {
-				fputs("l9 -3v3l-9 3z", fout);
+				out_puts("l9 -3v3l-9 3z");
 				if (--n <= 0)
 					break;
-				fputs("m0 5.4", fout);
+				out_puts("m0 5.4");
 			}
-			fputs("\"/>", fout);
+			out_puts("\"/>");
 			return;
 		}
 		if (strcmp(op, "trl") == 0) {
 			setg(1);
 			y = yoffs - pop_free_val() - 2;
 			x = xoffs + pop_free_val() - 4;
-			fprintf(fout, "<text font-family=\"Times\" font-size=\"16\" font-weight=\"bold\" font-style=\"italic\"\n"
+			out_printf("<text font-family=\"Times\" font-size=\"16\" font-weight=\"bold\" font-style=\"italic\"\n"
 				"	x=\"%.2f\" y=\"%.2f\">tr</text>\n",
 				x, y);
 			return;
@@ -3718,7 +4071,7 @@ translate:
 				ps_error = 1;
 				return;
 			}
-			fprintf(fout, "<g font-family=\"Times\" font-size=\"16\" font-weight=\"bold\" font-style=\"normal\"\n"
+			out_printf("<g font-family=\"Times\" font-size=\"16\" font-weight=\"bold\" font-style=\"normal\"\n"
 				"	transform=\"translate(%.2f,%.2f) scale(1.2,1)\">\n"
 				"	<text y=\"-1\" text-anchor=\"middle\">%s</text>\n"
 				"	<text y=\"-13\" text-anchor=\"middle\">%s</text>\n"
@@ -3745,10 +4098,10 @@ translate:
 				h = -3;
 				y += 3;
 			}
-			fprintf(fout,
-				"<path stroke=\"currentColor\" fill=\"none\"\n"
-				"	d=\"M%.2f %.2fv%dl%.2f %.2fv%d\"/>\n",
+			stroke_begin(" stroke=\"currentColor\" fill=\"none\"");
+			stroke_printf("M%.2f %.2fv%dl%.2f %.2fv%d",
 				x, y, h, dx, -dy, -h);
+			stroke_end();
 			return;
 		}
 		if (strcmp(op, "turn") == 0) {
@@ -3780,7 +4133,7 @@ translate:
 			y = pop_free_val();
 			x = pop_free_val();
 			w = pop_free_val();
-			fprintf(fout, "<path stroke=\"currentColor\" fill=\"none\" stroke-width=\"0.8\"\n"
+			out_printf("<path stroke=\"currentColor\" fill=\"none\" stroke-width=\"0.8\"\n"
 				"	d=\"M%.2f %.2fh%.2f\"/>\n",
 				xoffs + x, yoffs - y, w);
 			return;
@@ -3827,7 +4180,108 @@ translate:
 	ps_error = 1;
 }
 
-void svg_write(char *buf, int len)
+/* -- get the profile entry of an operator -- */
+static struct prof_s *prof_get(char *op)
+{
+	struct prof_s *pr;
+	unsigned char *p;
+	unsigned h;
+
+	h = 0;
+	for (p = (unsigned char *) op; *p != '\0'; p++)
+		h = h * 31 + *p;
+	h %= PROF_HASH;
+	for (pr = prof_tb[h]; pr; pr = pr->next) {
+		if (strcmp(pr->name, op) == 0)
+			return pr;
+	}
+	pr = calloc(1, sizeof *pr + strlen(op));
+	if (!pr) {
+		fprintf(stderr, "Out of memory - abort\n");
+		exit(EXIT_FAILURE);
+	}
+	strcpy(pr->name, op);
+	pr->next = prof_tb[h];
+	prof_tb[h] = pr;
+	nprof++;
+	return pr;
+}
+
+/* -- execute a command and update its profile -- */
+static void ps_exec(char *op)
+{
+	struct prof_s *pr;
+	double t;
+	long o;
+
+	if (!psprof) {
+		ps_op(op);
+		return;
+	}
+	pr = prof_get(op);
+	pr->calls++;
+	if (ps_sym_lookup(op))
+		pr->user = 1;
+	o = fout ? fout_tell() : -1;
+	t = stats_now();
+	ps_op(op);
+	pr->t += stats_now() - t;
+	if (o >= 0 && fout) {
+		o = fout_tell() - o;
+		if (o > 0)			/* (no page change) */
+			pr->bytes += o;
+	}
+}
+
+static int prof_cmp(const void *a, const void *b)
+{
+	double t;
+
+	t = (*(struct prof_s **) b)->t - (*(struct prof_s **) a)->t;
+	return t > 0 ? 1 : t < 0 ? -1 : 0;
+}
+
+/* -- output the PostScript operator profile -- */
+void psprof_end(void)
+{
+	struct prof_s *pr, **tb;
+	int i, n;
+
+	if (!psprof || nprof == 0)
+		return;
+	tb = malloc(nprof * sizeof *tb);
+	if (!tb)
+		return;
+	n = 0;
+	for (i = 0; i < PROF_HASH; i++) {
+		for (pr = prof_tb[i]; pr; pr = pr->next)
+			tb[n++] = pr;
+	}
+	qsort(tb, n, sizeof *tb, prof_cmp);
+	if (psprof == STATS_TEXT)
+		fprintf(stderr, "PostScript operators (SVG)"
+			" - time and bytes include the inner operators:\n"
+			"  %-20s %8s %10s %10s\n",
+			"operator", "calls", "ms", "bytes");
+	for (i = 0; i < n; i++) {
+		pr = tb[i];
+		if (psprof == STATS_JSON) {
+			fputs("{\"type\":\"psop\",\"name\":", stderr);
+			json_str(stderr, pr->name);
+			fprintf(stderr, ",\"user\":%d,\"calls\":%d,"
+					"\"ms\":%.3f,\"bytes\":%ld}\n",
+				pr->user, pr->calls, pr->t * 1000, pr->bytes);
+		} else {
+			fprintf(stderr, "  %-20s %8d %10.3f %10ld%s\n",
+				pr->name, pr->calls, pr->t * 1000, pr->bytes,
+				pr->user ? "  (procedure)" : "");
+		}
+	}
+	free(tb);
+}
+
+/* -- interpret a PostScript sequence -- */
+static void svg_scan(char *buf, int len)
 {
 	int l;
 	struct elt_s *e, *e2;
@@ -3839,8 +4293,8 @@ void svg_write(char *buf, int len)
 	p = (unsigned char *) buf;
 #if 0
 	if (strncmp((char *) p, "%svg ", 5) == 0) {	/* %%beginsvg */
-		fwrite(p + 5, 1, len - 5, fout);
-		fputs("\n", fout);
+		out_write(p + 5, len - 5);
+		out_puts("\n");
 		return;
 	}
 #endif
@@ -3930,7 +4384,7 @@ void svg_write(char *buf, int len)
 						&row, &col, &x, &y);
 					w = h = 6;
 				}
-					fprintf(fout, "<abc type=\"%c\" row=\"%d\" col=\"%d\" x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%d\"/>\n",
+					out_printf("<abc type=\"%c\" row=\"%d\" col=\"%d\" x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%d\"/>\n",
 						type, row, col, xoffs + x, yoffs - y - h, w, h);
 				break;
 			}
@@ -3942,7 +4396,7 @@ void svg_write(char *buf, int len)
 					r = (unsigned char *) strchr((char *) q, ')');
 //					if (!r)
 //						break;
-					fprintf(fout, "<!-- subtitle: %.*s -->\n",
+					out_printf("<!-- subtitle: %.*s -->\n",
 							r - q, q);
 					break;
 				}
@@ -3953,7 +4407,7 @@ void svg_write(char *buf, int len)
 				r = (unsigned char *) strchr((char *) q, ')');
 //				if (!r)
 //					break;
-				fprintf(fout, "<!-- title: %.*s -->\n",
+				out_printf("<!-- title: %.*s -->\n",
 						r - q, q);
 				break;
 			}
@@ -4090,6 +4544,18 @@ void svg_write(char *buf, int len)
 	}
 }
 
+void svg_write(char *buf, int len)
+{
+	if (svg_capture) {		/* (a buffer ends on a token) */
+		fwrite(buf, 1, len, svg_capture);
+		putc('\n', svg_capture);
+	}
+	stats_start(ST_SVG);
+	svg_scan(buf, len);
+	mrg_flush();
+	stats_stop(ST_SVG);
+}
+
 int svg_output(FILE *out, const char *fmt, ...)
 {
 	va_list args;
@@ -4107,7 +4573,8 @@ void svg_close(void)
 	struct elt_s *e, *e2;
 
 	setg(0);
-	fputs("</svg>\n", fout);
+	css_flush();
+	out_puts("</svg>\n");
 	e = stack;
 	if (e != 0) {
 		stack = 0;
@@ -21,6 +21,9 @@
  * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335  USA
  */
 
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "abc2ps.h"
@@ -809,21 +812,97 @@ void define_font(char name[],
 		fprintf(fout, "/F%d{/%s exch selectfont}!\n", num, name);
 }
 
-/* -- output the symbol definitions -- */
-void define_symbols(void)
+
+/* the symbol definitions are built in memory and split into
+ * the definitions of the procedures, so that the EPS files
+ * may contain only the procedures they use */
+static char *head;			/* all the definitions */
+static int head_len, head_sz;
+static struct ps_def {
+	char *name;			/* (not null terminated) */
+	char *text;			/* definition */
+	int len;
+	short nlen;			/* length of the name */
+	short same;			/* index + 1 of the next one with the same name */
+	char used;			/* referenced or always output */
+} *def_tb;
+static int ndefs;
+#define HASH_SZ 1024			/* (must be a power of 2) */
+static short hash_tb[HASH_SZ];		/* index + 1 in def_tb */
+
+/* -- add text to the symbol definitions -- */
+static void head_add(const char *p, int len)
+{
+	if (head_len + len >= head_sz) {
+		head_sz = head_sz * 2 + len + 4096;
+		head = realloc(head, head_sz);
+		if (!head) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	memcpy(head + head_len, p, len);
+	head_len += len;
+	head[head_len] = '\0';
+}
+
+/* -- add formatted text to the symbol definitions -- */
+static void head_printf(const char *fmt, ...)
+{
+	va_list args;
+	char tmp[1024];
+	int len;
+
+	va_start(args, fmt);
+	len = vsnprintf(tmp, sizeof tmp, fmt, args);
+	va_end(args);
+	if (len >= (int) sizeof tmp)
+		len = sizeof tmp - 1;
+	head_add(tmp, len);
+}
+
+/* -- check if a character ends a PostScript name -- */
+static int is_delim(char c)
+{
+	return c == '\0' || c == ' ' || c == '\t' || c == '\n' || c == '\r'
+		|| strchr("()<>[]{}/%", c) != NULL;
+}
+
+/* -- find the hash slot of a name -- */
+static int def_find(char *p, int len)
+{
+	unsigned h;
+	int i, k;
+
+	h = 0;
+	for (i = 0; i < len; i++)
+		h = h * 31 + (unsigned char) p[i];
+	for (k = h & (HASH_SZ - 1); ; k = (k + 1) & (HASH_SZ - 1)) {
+		i = hash_tb[k];
+		if (i == 0)
+			return k;
+		i--;
+		if (def_tb[i].nlen == len
+		 && strncmp(def_tb[i].name, p, len) == 0)
+			return k;
+	}
+}
+
+/* -- build the symbol definitions -- */
+static void head_build(void)
 {
-	fputs(ps_head, fout);
+	head_add(ps_head, sizeof ps_head - 1);
 
 	/* len su - up stem */
-	fprintf(fout, "/su{dlw x y M %.1f %.1f RM %.1f sub 0 exch RL stroke}!\n",
+	head_printf("/su{dlw x y M %.1f %.1f RM %.1f sub 0 exch RL stroke}!\n",
 		STEM_XOFF, STEM_YOFF, STEM_YOFF);
 
 	/* len sd - down stem */
-	fprintf(fout, "/sd{dlw x y M %.1f %.1f RM %.1f add 0 exch RL stroke}!\n",
+	head_printf("/sd{dlw x y M %.1f %.1f RM %.1f add 0 exch RL stroke}!\n",
 		-STEM_XOFF, -STEM_YOFF, STEM_YOFF);
 
 	/* n len sfu - stem and n flags up */
-	fprintf(fout, "/sfu{	dlw x y M %.1f %.1f RM\n"
+	head_printf("/sfu{	dlw x y M %.1f %.1f RM\n"
 		"	%.1f sub 0 exch RL currentpoint stroke\n"
 		"	M dup 1 eq{\n"
 		"		pop\n"
@@ -843,7 +922,7 @@ void define_symbols(void)
 		STEM_XOFF, STEM_YOFF, STEM_YOFF);
 
 	/* n len sfd - stem and n flags down */
-	fprintf(fout, "/sfd{	dlw x y M %.1f %.1f RM\n"
+	head_printf("/sfd{	dlw x y M %.1f %.1f RM\n"
 		"	%.1f add 0 exch RL currentpoint stroke\n"
 		"	M dup 1 eq{\n"
 		"		pop\n"
@@ -863,7 +942,7 @@ void define_symbols(void)
 		-STEM_XOFF, -STEM_YOFF, STEM_YOFF);
 
 	/* n len sfs - stem and n straight flag down */
-	fprintf(fout, "/sfs{	dup 0 lt{\n"
+	head_printf("/sfs{	dup 0 lt{\n"
 		"		dlw x y M -%.1f -%.1f RM\n"
 		"		%.1f add 0 exch RL currentpoint stroke\n"
 		"		M{	currentpoint\n"
@@ -888,7 +967,7 @@ void define_symbols(void)
 		BEAM_DEPTH, BEAM_DEPTH, BEAM_DEPTH);
 
 	/* len gu - grace note stem up */
-	fprintf(fout, "/gu{	.6 SLW x y M\n"
+	head_printf("/gu{	.6 SLW x y M\n"
 		"	%.1f 0 RM 0 exch RL stroke}!\n"
 
 	/* len gd - grace note stem down */
@@ -897,7 +976,7 @@ void define_symbols(void)
 		GSTEM_XOFF, -GSTEM_XOFF);
 
 	/* n len sgu - gnote stem and n flag up */
-	fprintf(fout, "/sgu{	.6 SLW x y M %.1f 0 RM\n"
+	head_printf("/sgu{	.6 SLW x y M %.1f 0 RM\n"
 		"	0 exch RL currentpoint stroke\n"
 		"	M dup 1 eq{\n"
 		"		pop\n"
@@ -914,7 +993,7 @@ void define_symbols(void)
 		GSTEM_XOFF);
 
 	/* n len sgd - gnote stem and n flag down */
-	fprintf(fout, "/sgd{	.6 SLW x y M %.1f 0 RM\n"
+	head_printf("/sgd{	.6 SLW x y M %.1f 0 RM\n"
 		"	0 exch RL currentpoint stroke\n"
 		"	M dup 1 eq{\n"
 		"		pop\n"
@@ -931,7 +1010,7 @@ void define_symbols(void)
 		-GSTEM_XOFF);
 
 	/* n len sgs - gnote stem and n straight flag up */
-	fprintf(fout, "/sgs{	.6 SLW x y M %.1f 0 RM\n"
+	head_printf("/sgs{	.6 SLW x y M %.1f 0 RM\n"
 		"	0 exch RL currentpoint stroke\n"
 		"	M{	currentpoint\n"
 		"		3 -1.5 RL 0 -2 RL -3 1.5 RL\n"
@@ -939,3 +1018,135 @@ void define_symbols(void)
 		"	}repeat}!\n",
 		GSTEM_XOFF);
 }
+
+/* -- split the symbol definitions -- */
+/* a definition starts on a line beginning with '/',
+ * the other lines beginning with a tab are continuation lines
+ * and the other ones are kept in any case */
+static void head_split(void)
+{
+	char *p, *q;
+	int i, n;
+
+	head_build();
+	n = 0;
+	for (p = head; *p != '\0'; p++) {
+		if (*p == '\n' && p[1] != '\t' && p[1] != '\0')
+			n++;
+	}
+	def_tb = malloc((n + 1) * sizeof *def_tb);
+	if (!def_tb) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	memset(hash_tb, 0, sizeof hash_tb);
+	p = head;
+	while (*p != '\0') {
+		def_tb[ndefs].text = p;
+		def_tb[ndefs].used = 0;
+		def_tb[ndefs].nlen = 0;
+		def_tb[ndefs].same = 0;
+		if (*p == '/') {
+			for (q = p + 1; !is_delim(*q); q++)
+				;
+			def_tb[ndefs].name = p + 1;
+			def_tb[ndefs].nlen = q - p - 1;
+			i = def_find(p + 1, q - p - 1);
+			if (hash_tb[i] == 0) {
+				hash_tb[i] = ndefs + 1;
+			} else {			/* redefinition */
+				for (i = hash_tb[i] - 1; def_tb[i].same; )
+					i = def_tb[i].same - 1;
+				def_tb[i].same = ndefs + 1;
+			}
+		} else {
+			def_tb[ndefs].used = 1;		/* always */
+		}
+		for (;;) {
+			p = strchr(p, '\n') + 1;
+			if (*p != '\t')
+				break;
+		}
+		def_tb[ndefs].len = p - def_tb[ndefs].text;
+		ndefs++;
+	}
+}
+
+/* -- output all the symbol definitions -- */
+void define_symbols(void)
+{
+	if (!head)
+		head_split();
+	fputs(head, fout);
+}
+
+/* -- mark the definitions used by some PostScript code -- */
+/* the used definitions are also searched in the definitions */
+void ps_sym_scan(char *p, int len)
+{
+	char *q, *e;
+	int i;
+
+	if (!head)
+		head_split();
+	e = p + len;
+	while (p < e) {
+		switch (*p) {
+		case '%':			/* comment */
+			while (p < e && *p != '\n')
+				p++;
+			continue;
+		case '(': {			/* string */
+			int depth = 0;
+
+			for ( ; p < e; p++) {
+				if (*p == '\\')
+					p++;
+				else if (*p == '(')
+					depth++;
+				else if (*p == ')' && --depth == 0)
+					break;
+			}
+			p++;
+			continue;
+		    }
+		case '<':			/* hexadecimal string */
+			if (p + 1 < e && p[1] != '<') {
+				while (p < e && *p != '>')
+					p++;
+			}
+			p++;
+			continue;
+		case '/':
+			p++;
+			break;
+		}
+		for (q = p; q < e && !is_delim(*q); q++)
+			;
+		if (q == p) {
+			p++;
+			continue;
+		}
+		for (i = hash_tb[def_find(p, q - p)]; i != 0; i = def_tb[i].same) {
+			if (def_tb[--i].used)
+				break;
+			def_tb[i].used = 1;
+			ps_sym_scan(def_tb[i].text, def_tb[i].len);
+		}
+		p = q;
+	}
+}
+
+/* -- output the used symbol definitions and reset the marks -- */
+void define_used_symbols(void)
+{
+	int i;
+
+	for (i = 0; i < ndefs; i++) {
+		if (!def_tb[i].used)
+			continue;
+		fwrite(def_tb[i].text, 1, def_tb[i].len, fout);
+		if (def_tb[i].nlen != 0)
+			def_tb[i].used = 0;
+	}
+}
@@ -0,0 +1,712 @@
+/*
+ * TrueType fonts.
+ *
+ * The PDF and PNG outputs may take the glyphs of the texts from TrueType
+ * font files (see dlist.c). Only the fonts with TrueType outlines (table
+ * 'glyf') are used. The PDF files embed the used glyphs only, and
+ * the PNG images are drawn from the glyph outlines.
+ *
+ * This file is part of abcm2ps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <string.h>
+
+#include "abc2ps.h"
+
+struct ttf {
+	struct ttf *next;
+	char *name;			/* searched name */
+	struct ttf_m m;			/* metrics */
+	unsigned char *d;		/* font file */
+	long len;
+	int upem;			/* units per em */
+	int lfmt;			/* 'loca' format (1: long offsets) */
+	int nhm;			/* number of horizontal metrics */
+	long loca, glyf, glyf_len, hmtx; /* tables */
+	long cmap;			/* unicode 'cmap' subtable */
+	char cfmt;			/*	its format (4 or 12) */
+	char sym;			/*	symbol encoding */
+};
+
+static struct ttf *ttf_list;		/* loaded and missing fonts */
+
+struct ttf_pt {				/* point of a simple glyph */
+	float x, y;
+	int on;				/* (flags) on the curve */
+};
+
+/* composite glyphs */
+#define C_WORDS 0x01			/* arguments are words */
+#define C_XY 0x02			/* arguments are offsets */
+#define C_SCALE 0x08
+#define C_MORE 0x20			/* more components */
+#define C_XYSCALE 0x40
+#define C_2X2 0x80
+
+/* -- get the big-endian values of the font file -- */
+static unsigned g16(struct ttf *f, long o)
+{
+	if (o < 0 || o + 2 > f->len)
+		return 0;
+	return (f->d[o] << 8) | f->d[o + 1];
+}
+
+static unsigned long g32(struct ttf *f, long o)
+{
+	if (o < 0 || o + 4 > f->len)
+		return 0;
+	return ((unsigned long) f->d[o] << 24) | (f->d[o + 1] << 16)
+		| (f->d[o + 2] << 8) | f->d[o + 3];
+}
+
+#define s16(f, o) ((short) g16(f, o))
+
+/* -- put big-endian values -- */
+static void p16(unsigned char *p, unsigned v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void p32(unsigned char *p, unsigned long v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+/* -- find a table -- */
+/* return its offset or 0 if none */
+static long tab(struct ttf *f, char *tag, long *p_len)
+{
+	long o;
+	int i, n;
+
+	n = g16(f, 4);
+	for (i = 0, o = 12; i < n && o + 16 <= f->len; i++, o += 16) {
+		if (memcmp(f->d + o, tag, 4) != 0)
+			continue;
+		if (g32(f, o + 8) + g32(f, o + 12) > (unsigned long) f->len)
+			return 0;
+		if (p_len)
+			*p_len = g32(f, o + 12);
+		return g32(f, o + 8);
+	}
+	return 0;
+}
+
+/* -- get the PostScript name of the font -- */
+static void get_psname(struct ttf *f)
+{
+	long name, o, s;
+	int i, j, k, l, n, pid, c;
+
+	name = tab(f, "name", NULL);
+	n = name ? g16(f, name + 2) : 0;
+	for (i = 0; i < n; i++) {
+		o = name + 6 + i * 12;
+		if (g16(f, o + 6) != 6)		/* PostScript name */
+			continue;
+		pid = g16(f, o);
+		l = g16(f, o + 8);
+		s = name + g16(f, name + 4) + g16(f, o + 10);
+		k = 0;
+		for (j = 0; j < l && k < (int) sizeof f->m.name - 1; j++) {
+			if (pid == 0 || pid == 3)	/* UTF-16BE */
+				c = g16(f, s + j++);
+			else
+				c = s + j < f->len ? f->d[s + j] : 0;
+			if (c > ' ' && c < 0x7f && !strchr("()<>[]{}/%#", c))
+				f->m.name[k++] = c;
+		}
+		f->m.name[k] = '\0';
+		if (k > 0)
+			return;
+	}
+	for (k = 0; f->name[k] != '\0' && k < (int) sizeof f->m.name - 1; k++) {
+		c = f->name[k];
+		f->m.name[k] = isalnum(c) || c == '-' ? c : '_';
+	}
+	f->m.name[k] = '\0';
+}
+
+/* -- check the font and get its metrics -- */
+static int ttf_parse(struct ttf *f)
+{
+	long head, hhea, maxp, cmap, os2, post, o, l;
+	int i, n, pid, eid, fmt, v, best;
+
+	if (f->len < 12
+	 || (g32(f, 0) != 0x00010000 && memcmp(f->d, "true", 4) != 0))
+		return -1;			/* (CFF outlines or collection) */
+	head = tab(f, "head", NULL);
+	hhea = tab(f, "hhea", NULL);
+	maxp = tab(f, "maxp", NULL);
+	cmap = tab(f, "cmap", NULL);
+	f->loca = tab(f, "loca", NULL);
+	f->glyf = tab(f, "glyf", &f->glyf_len);
+	f->hmtx = tab(f, "hmtx", NULL);
+	if (!head || !hhea || !maxp || !cmap
+	 || !f->loca || !f->glyf || !f->hmtx)
+		return -1;
+	f->upem = g16(f, head + 18);
+	f->lfmt = s16(f, head + 50);
+	f->m.ng = g16(f, maxp + 4);
+	f->nhm = g16(f, hhea + 34);
+	if (f->upem == 0 || f->m.ng == 0 || f->nhm == 0)
+		return -1;
+
+	/* unicode character map */
+	best = 0;
+	n = g16(f, cmap + 2);
+	for (i = 0; i < n; i++) {
+		o = cmap + 4 + i * 8;
+		pid = g16(f, o);
+		eid = g16(f, o + 2);
+		l = cmap + g32(f, o + 4);
+		fmt = g16(f, l);
+		if (fmt == 12 && (pid == 0 || (pid == 3 && eid == 10)))
+			v = 3;
+		else if (fmt == 4 && (pid == 0 || (pid == 3 && eid == 1)))
+			v = 2;
+		else if (fmt == 4 && pid == 3 && eid == 0)
+			v = 1;			/* symbol font */
+		else
+			continue;
+		if (v > best) {
+			best = v;
+			f->cmap = l;
+			f->cfmt = fmt;
+			f->sym = v == 1;
+		}
+	}
+	if (best == 0)
+		return -1;
+
+	/* metrics for the PDF font descriptor (1/1000 em) */
+	for (i = 0; i < 4; i++)
+		f->m.bbox[i] = s16(f, head + 36 + i * 2) * 1000 / f->upem;
+	f->m.ascent = s16(f, hhea + 4) * 1000 / f->upem;
+	f->m.descent = s16(f, hhea + 6) * 1000 / f->upem;
+	f->m.capheight = f->m.ascent;
+	os2 = tab(f, "OS/2", &l);
+	if (os2 && g16(f, os2) >= 2 && l >= 90)
+		f->m.capheight = s16(f, os2 + 88) * 1000 / f->upem;
+	post = tab(f, "post", NULL);
+	if (post)
+		f->m.italic = s16(f, post + 4);
+	get_psname(f);
+	return 0;
+}
+
+/* -- search and load a font -- */
+/* return NULL when no font file */
+struct ttf *ttf_get(char *name)
+{
+	struct ttf *f;
+	FILE *fp;
+	char ttf_fn[128], fn[512];
+
+	for (f = ttf_list; f; f = f->next) {
+		if (strcmp(f->name, name) == 0)
+			return f->d ? f : NULL;
+	}
+	f = calloc(1, sizeof *f);
+	if (f)
+		f->name = strdup(name);
+	if (!f || !f->name) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	f->next = ttf_list;
+	ttf_list = f;
+	if (strlen(name) >= sizeof ttf_fn - 8)
+		return NULL;
+	sprintf(ttf_fn, "%s.ttf", name);
+	fp = open_file(ttf_fn, "ttf", fn);
+	if (!fp)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) == 0
+	 && (f->len = ftell(fp)) > 0
+	 && (f->d = malloc(f->len)) != NULL) {
+		rewind(fp);
+		if (fread(f->d, 1, f->len, fp) != (size_t) f->len) {
+			free(f->d);
+			f->d = NULL;
+		}
+	}
+	fclose(fp);
+	if (f->d && ttf_parse(f) != 0) {
+		error(1, 0, "Bad or unsupported TrueType font %s", fn);
+		free(f->d);
+		f->d = NULL;
+	}
+	return f->d ? f : NULL;
+}
+
+/* -- get the metrics of a font -- */
+struct ttf_m *ttf_metrics(struct ttf *f)
+{
+	return &f->m;
+}
+
+/* -- get the glyph of a unicode character in the character map -- */
+static int cmap_gid(struct ttf *f, unsigned long c)
+{
+	long o, ends, ro;
+	unsigned long g;
+	int n, lo, hi, mid;
+	unsigned start, r;
+
+	if (f->cfmt == 12) {
+		n = g32(f, f->cmap + 12);
+		lo = 0;
+		hi = n - 1;
+		while (lo <= hi) {
+			mid = (lo + hi) / 2;
+			o = f->cmap + 16 + mid * 12;
+			if (c < g32(f, o))
+				hi = mid - 1;
+			else if (c > g32(f, o + 4))
+				lo = mid + 1;
+			else
+				return g32(f, o + 8) + c - g32(f, o);
+		}
+		return 0;
+	}
+	if (c > 0xffff)
+		return 0;
+	n = g16(f, f->cmap + 6) / 2;		/* segments */
+	if (n == 0)
+		return 0;
+	ends = f->cmap + 14;
+	lo = 0;
+	hi = n - 1;
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (g16(f, ends + mid * 2) < c)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	start = g16(f, ends + n * 2 + 2 + lo * 2);
+	if (c > g16(f, ends + lo * 2) || c < start)
+		return 0;
+	ro = ends + n * 6 + 2 + lo * 2;		/* idRangeOffset */
+	r = g16(f, ro);
+	g = c;
+	if (r != 0) {
+		g = g16(f, ro + r + (c - start) * 2);
+		if (g == 0)
+			return 0;
+	}
+	return (g + g16(f, ends + n * 4 + 2 + lo * 2)) & 0xffff;
+}
+
+/* -- get the glyph of a unicode character -- */
+/* return 0 if none */
+int ttf_gid(struct ttf *f, int c)
+{
+	int g;
+
+	g = cmap_gid(f, c);
+	if (g == 0 && f->sym && c < 0x100)
+		g = cmap_gid(f, 0xf000 + c);
+	return g < f->m.ng ? g : 0;
+}
+
+/* -- get the advance width of a glyph (em) -- */
+float ttf_adv(struct ttf *f, int gid)
+{
+	if (gid >= f->nhm)
+		gid = f->nhm - 1;
+	return (float) g16(f, f->hmtx + gid * 4) / f->upem;
+}
+
+/* -- get the data of a glyph -- */
+/* return its offset, 0 if empty */
+static long glyph_get(struct ttf *f, int gid, long *p_len)
+{
+	unsigned long o1, o2;
+
+	*p_len = 0;
+	if (gid < 0 || gid >= f->m.ng)
+		return 0;
+	if (f->lfmt) {
+		o1 = g32(f, f->loca + gid * 4);
+		o2 = g32(f, f->loca + gid * 4 + 4);
+	} else {
+		o1 = g16(f, f->loca + gid * 2) * 2;
+		o2 = g16(f, f->loca + gid * 2 + 2) * 2;
+	}
+	if (o2 <= o1 || o2 > (unsigned long) f->glyf_len)
+		return 0;
+	*p_len = o2 - o1;
+	return f->glyf + o1;
+}
+
+/* -- get the next component of a composite glyph -- */
+/* return the offset of the next component */
+static long comp_get(struct ttf *f, long o, int *flags, int *gid,
+			float *m)
+{
+	*flags = g16(f, o);
+	*gid = g16(f, o + 2);
+	o += 4;
+	if (*flags & C_WORDS) {
+		m[4] = s16(f, o);
+		m[5] = s16(f, o + 2);
+		o += 4;
+	} else {
+		m[4] = (signed char) (g16(f, o) >> 8);
+		m[5] = (signed char) (g16(f, o) & 0xff);
+		o += 2;
+	}
+	if (!(*flags & C_XY))
+		m[4] = m[5] = 0;		/* (point matching) */
+	m[0] = m[3] = 1;
+	m[1] = m[2] = 0;
+	if (*flags & C_SCALE) {
+		m[0] = m[3] = s16(f, o) / 16384.;
+		o += 2;
+	} else if (*flags & C_XYSCALE) {
+		m[0] = s16(f, o) / 16384.;
+		m[3] = s16(f, o + 2) / 16384.;
+		o += 4;
+	} else if (*flags & C_2X2) {
+		m[0] = s16(f, o) / 16384.;
+		m[1] = s16(f, o + 2) / 16384.;
+		m[2] = s16(f, o + 4) / 16384.;
+		m[3] = s16(f, o + 6) / 16384.;
+		o += 8;
+	}
+	return o;
+}
+
+/* -- mark the components of a composite glyph -- */
+static void comp_mark(struct ttf *f, unsigned char *used, int gid, int level)
+{
+	long o, l, end;
+	float m[6];
+	int flags, g;
+
+	o = glyph_get(f, gid, &l);
+	if (l < 10 || s16(f, o) >= 0 || level > 8)
+		return;
+	end = o + l;
+	o += 10;
+	do {
+		o = comp_get(f, o, &flags, &g, m);
+		if (g < f->m.ng) {
+			used[g >> 3] |= 1 << (g & 7);
+			comp_mark(f, used, g, level + 1);
+		}
+	} while ((flags & C_MORE) && o < end);
+}
+
+/* -- output a path operation -- */
+static void path_out(void (*draw)(int op, float *v), int op, float *m,
+			float x1, float y1, float x2, float y2)
+{
+	float v[4];
+
+	v[0] = m[0] * x1 + m[2] * y1 + m[4];
+	v[1] = m[1] * x1 + m[3] * y1 + m[5];
+	v[2] = m[0] * x2 + m[2] * y2 + m[4];
+	v[3] = m[1] * x2 + m[3] * y2 + m[5];
+	draw(op, v);
+}
+
+/* -- output a contour of a simple glyph -- */
+static void contour(struct ttf_pt *pt, int k, float *m,
+			void (*draw)(int op, float *v))
+{
+	float sx, sy;
+	int i, j, s, cnt, pend;
+
+	for (s = 0; s < k; s++) {
+		if (pt[s].on)
+			break;
+	}
+	if (s < k) {				/* start on the curve */
+		sx = pt[s].x;
+		sy = pt[s].y;
+		pend = -1;
+		cnt = k;
+	} else {				/* only control points */
+		if (k < 2)
+			return;
+		sx = (pt[0].x + pt[1].x) / 2;
+		sy = (pt[0].y + pt[1].y) / 2;
+		pend = s = 1;
+		cnt = k - 1;
+	}
+	path_out(draw, 'm', m, sx, sy, sx, sy);
+	for (i = 0; i < cnt; i++) {
+		j = (s + 1 + i) % k;
+		if (pt[j].on) {
+			if (pend < 0)
+				path_out(draw, 'l', m, pt[j].x, pt[j].y,
+					pt[j].x, pt[j].y);
+			else
+				path_out(draw, 'q', m, pt[pend].x, pt[pend].y,
+					pt[j].x, pt[j].y);
+			pend = -1;
+			continue;
+		}
+		if (pend >= 0)			/* implied point on the curve */
+			path_out(draw, 'q', m, pt[pend].x, pt[pend].y,
+				(pt[pend].x + pt[j].x) / 2,
+				(pt[pend].y + pt[j].y) / 2);
+		pend = j;
+	}
+	if (pend >= 0)
+		path_out(draw, 'q', m, pt[pend].x, pt[pend].y, sx, sy);
+	path_out(draw, 'h', m, sx, sy, sx, sy);
+}
+
+/* -- output the outline of a glyph -- */
+static void outline(struct ttf *f, int gid, float *m, int level,
+			void (*draw)(int op, float *v))
+{
+	struct ttf_pt *pt;
+	long o, l, p, end;
+	float cm[6], t[6];
+	int nc, np, i, c, n, fl, flags, g, v, first, last;
+
+	o = glyph_get(f, gid, &l);
+	if (l < 10 || level > 8)
+		return;
+	end = o + l;
+	nc = s16(f, o);
+	if (nc < 0) {				/* composite glyph */
+		p = o + 10;
+		do {
+			p = comp_get(f, p, &flags, &g, cm);
+			t[0] = cm[0] * m[0] + cm[1] * m[2];
+			t[1] = cm[0] * m[1] + cm[1] * m[3];
+			t[2] = cm[2] * m[0] + cm[3] * m[2];
+			t[3] = cm[2] * m[1] + cm[3] * m[3];
+			t[4] = cm[4] * m[0] + cm[5] * m[2] + m[4];
+			t[5] = cm[4] * m[1] + cm[5] * m[3] + m[5];
+			outline(f, g, t, level + 1, draw);
+		} while ((flags & C_MORE) && p < end);
+		return;
+	}
+	if (nc == 0)
+		return;
+	np = g16(f, o + 10 + (nc - 1) * 2) + 1;
+	p = o + 10 + nc * 2;
+	p += 2 + g16(f, p);			/* (instructions) */
+	pt = malloc(np * sizeof *pt);
+	if (!pt) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* flags */
+	for (i = 0; i < np && p < end; ) {
+		fl = f->d[p++];
+		n = 1;
+		if ((fl & 0x08) && p < end)	/* repeat */
+			n += f->d[p++];
+		while (--n >= 0 && i < np)
+			pt[i++].on = fl;
+	}
+	if (i < np) {
+		free(pt);
+		return;
+	}
+
+	/* coordinates */
+	for (c = 0; c < 2; c++) {
+		v = 0;
+		for (i = 0; i < np; i++) {
+			fl = pt[i].on >> c;
+			if (fl & 0x02) {	/* short value */
+				n = p < end ? f->d[p++] : 0;
+				v += fl & 0x10 ? n : -n;
+			} else if (!(fl & 0x10)) {
+				v += s16(f, p);
+				p += 2;
+			}
+			if (c == 0)
+				pt[i].x = v;
+			else
+				pt[i].y = v;
+		}
+	}
+	for (i = 0; i < np; i++)
+		pt[i].on &= 1;
+
+	first = 0;
+	for (c = 0; c < nc; c++) {
+		last = g16(f, o + 10 + c * 2);
+		if (last < first || last >= np)
+			break;
+		contour(pt + first, last - first + 1, m, draw);
+		first = last + 1;
+	}
+	free(pt);
+}
+
+/* -- output the outline of a glyph -- */
+/* The matrix 'm' applies to the em coordinates.
+ * 'draw' gets the path operations: 'm' (moveto x y), 'l' (lineto x y),
+ * 'q' (quadratic Bezier curve x1 y1 x y) and 'h' (closepath). */
+void ttf_outline(struct ttf *f, int gid, float *m,
+		void (*draw)(int op, float *v))
+{
+	float t[6];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		t[i] = m[i] / f->upem;
+	t[4] = m[4];
+	t[5] = m[5];
+	outline(f, gid, t, 0, draw);
+}
+
+/* -- checksum of a table -- */
+static unsigned long cksum(unsigned char *p, long len)
+{
+	unsigned long s;
+
+	s = 0;
+	while (len > 0) {
+		s += ((unsigned long) p[0] << 24) | (p[1] << 16)
+			| (p[2] << 8) | p[3];
+		p += 4;
+		len -= 4;
+	}
+	return s & 0xffffffff;
+}
+
+/* -- build a font file with the used glyphs only -- */
+/* The glyph indexes don't change: the unused glyphs are empty.
+ * 'used' is a bit array which gets the components of the used
+ * composite glyphs. */
+unsigned char *ttf_subset(struct ttf *f, unsigned char *used, long *p_len)
+{
+	static char *tag_tb[] = {		/* (sorted) */
+		"cvt ", "fpgm", "glyf", "head", "hhea", "hmtx", "loca",
+		"maxp", "prep"
+	};
+#define NTAGS (sizeof tag_tb / sizeof tag_tb[0])
+	long t_off[NTAGS], t_len[NTAGS];
+	unsigned char *buf, *p, *dir, *head;
+	long o, l, total, glen;
+	int i, g, nt, sr, es;
+
+	used[0] |= 1;				/* .notdef */
+	for (g = 0; g < f->m.ng; g++) {
+		if (used[g >> 3] & (1 << (g & 7)))
+			comp_mark(f, used, g, 0);
+	}
+	glen = 0;
+	for (g = 0; g < f->m.ng; g++) {
+		if (used[g >> 3] & (1 << (g & 7))) {
+			glyph_get(f, g, &l);
+			glen += (l + 3) & ~3;
+		}
+	}
+
+	/* table sizes */
+	nt = 0;
+	total = 12;
+	for (i = 0; i < (int) NTAGS; i++) {
+		t_off[i] = tab(f, tag_tb[i], &t_len[i]);
+		if (tag_tb[i][0] == 'g')
+			t_len[i] = glen;
+		else if (tag_tb[i][0] == 'l')
+			t_len[i] = (f->m.ng + 1) * 4;
+		else if (!t_off[i])
+			continue;
+		nt++;
+		total += 16 + ((t_len[i] + 3) & ~3);
+	}
+	buf = calloc(1, total);
+	if (!buf) {
+		fprintf(stderr, "Out of memory.\n");
+		exit(EXIT_FAILURE);
+	}
+	for (sr = 1, es = 0; sr * 2 <= nt; sr *= 2, es++)
+		;
+	p32(buf, 0x00010000);
+	p16(buf + 4, nt);
+	p16(buf + 6, sr * 16);
+	p16(buf + 8, es);
+	p16(buf + 10, nt * 16 - sr * 16);
+	dir = buf + 12;
+	p = dir + nt * 16;
+	head = NULL;
+	for (i = 0; i < (int) NTAGS; i++) {
+		switch (tag_tb[i][0] == 'g' ? 'g'
+			: tag_tb[i][0] == 'l' ? 'l'
+			: strcmp(tag_tb[i], "head") == 0 ? 'h' : 0) {
+		case 'g': {			/* glyf */
+			unsigned char *q;
+
+			q = p;
+			for (g = 0; g < f->m.ng; g++) {
+				if (!(used[g >> 3] & (1 << (g & 7))))
+					continue;
+				o = glyph_get(f, g, &l);
+				memcpy(q, f->d + o, l);
+				q += (l + 3) & ~3;
+			}
+			break;
+		    }
+		case 'l':			/* loca (long) */
+			o = 0;
+			for (g = 0; g < f->m.ng; g++) {
+				p32(p + g * 4, o);
+				if (used[g >> 3] & (1 << (g & 7))) {
+					glyph_get(f, g, &l);
+					o += (l + 3) & ~3;
+				}
+			}
+			p32(p + g * 4, o);
+			break;
+		case 'h':
+			head = p;
+			/* fall thru */
+		default:
+			if (!t_off[i])
+				continue;
+			memcpy(p, f->d + t_off[i], t_len[i]);
+			if (head == p) {
+				p32(head + 8, 0);	/* checkSumAdjustment */
+				p16(head + 50, 1);	/* long 'loca' */
+			}
+			break;
+		}
+		memcpy(dir, tag_tb[i], 4);
+		p32(dir + 4, cksum(p, (t_len[i] + 3) & ~3));
+		p32(dir + 8, p - buf);
+		p32(dir + 12, t_len[i]);
+		dir += 16;
+		p += (t_len[i] + 3) & ~3;
+	}
+	if (head)
+		p32(head + 8, (0xb1b0afbaUL - cksum(buf, total)) & 0xffffffff);
+	*p_len = total;
+	return buf;
+}